@@ -16,9 +16,10 @@
  */
 
 #include "Riots_BMP280.h"
+#include "Riots_Memory.h"
+#include "Riots_Profile.h"
 #include <Wire.h>
 #include <stdio.h>
-#include <math.h>
 
 /**
  * Setup BMP280 library
@@ -27,6 +28,10 @@
  */
 byte Riots_BMP280::setup() {
 
+  // Start I2c, Wire.begin() resets the bus speed so restore the shared one
+  Wire.begin();
+  Riots_Memory::applyBusSpeed();
+
   // Get calibration data from device
   if (  readUInt(0x88, dig_T1) &&
         readInt(0x8A, dig_T2)  &&
@@ -53,13 +58,13 @@ byte Riots_BMP280::setup() {
  * @param value               Pointer to the memory where the int value should be written.
  * @return byte               1, if successful
  */
-byte Riots_BMP280::readInt(byte address, int &value) {
+byte Riots_BMP280::readInt(byte address, int16_t &value) {
 
   unsigned char data[2];  //byte is 4bit,1byte
   data[0] = address;
 
   if (readBytes(data,2)) {
-    value = (((int)data[1]<<8)|(int)data[0]);
+    value = (int16_t)(((uint16_t)data[1]<<8)|data[0]);
     return 1;
   }
   value = 0;
@@ -74,12 +79,12 @@ byte Riots_BMP280::readInt(byte address, int &value) {
  * @param value               Pointer to the memory where the unsigned int value should be written.
  * @return byte               1, if successful
  */
-byte Riots_BMP280::readUInt(byte address, unsigned int &value) {
+byte Riots_BMP280::readUInt(byte address, uint16_t &value) {
 
   unsigned char data[2];
   data[0] = address;
   if (readBytes(data,2)) {
-    value = (((unsigned int)data[1]<<8)|(unsigned int)data[0]);
+    value = (((uint16_t)data[1]<<8)|data[0]);
     return(1);
   }
   value = 0;
@@ -155,11 +160,11 @@ void Riots_BMP280::startMeasurement(byte low_resolution) {
 /**
  * Get values
  *
- * @param uP                  uP value to be used.
- * @param uT                  uT value to be used.
+ * @param adc_P               Raw 20 bit pressure reading.
+ * @param adc_T               Raw 20 bit temperature reading.
  * @return byte               result of the calculation.
  */
-byte Riots_BMP280::getUnCalValues(double &uP, double &uT) {
+byte Riots_BMP280::getUnCalValues(int32_t &adc_P, int32_t &adc_T) {
 
   byte result;
 
@@ -169,9 +174,9 @@ byte Riots_BMP280::getUnCalValues(double &uP, double &uT) {
 
   result = readBytes(data, 6);
   if (result) {
-    double factor = pow(2, 4);
-  uP = (( (data[0] *256.0) + data[1] + (data[2]/256.0))) * factor;
-  uT = (( (data[3] *256.0) + data[4] + (data[5]/256.0))) * factor;
+    // msb, lsb and the upper nibble of xlsb
+    adc_P = ((uint32_t)data[0] << 12) | ((uint32_t)data[1] << 4) | (data[2] >> 4);
+    adc_T = ((uint32_t)data[3] << 12) | ((uint32_t)data[4] << 4) | (data[5] >> 4);
   }
   return result ;
 }
@@ -183,19 +188,86 @@ byte Riots_BMP280::getUnCalValues(double &uP, double &uT) {
  */
 int32_t Riots_BMP280::getPressure() {
 
-  double uP,uT,P,T ;
-  byte result = getUnCalValues(uP, uT);
+  int32_t adc_P, adc_T;
+  byte result = getUnCalValues(adc_P, adc_T);
   if(result!=0){
+    _PROFILE_SCOPE(RIOTS_PROFILE_SENSOR_CALC);
+
     // Calculate the pressure
     // Temperature needs to be calculated first
+#ifdef RIOTS_BMP280_FLOAT_COMPENSATION
+    double uP = adc_P, uT = adc_T, P, T;
     calcTemperature(T,uT);
     calcPressure(P,uP);
     return (int32_t)P;
+#else
+    calcTemperature(adc_T);
+    return calcPressure(adc_P);
+#endif
   }
   return RIOTS_SENSOR_FAIL;
 
 }
 
+#ifndef RIOTS_BMP280_FLOAT_COMPENSATION
+/**
+ * Calculate temperature with the integer compensation of the BMP280 datasheet.
+ *
+ * @param adc_T               Raw temperature reading.
+ * @return int32_t            Temperature in 0.01 degrees Celsius.
+ */
+int32_t Riots_BMP280::calcTemperature(int32_t adc_T) {
+
+  int32_t var1, var2;
+
+  var1 = ((((adc_T>>3) - ((int32_t)dig_T1<<1))) * ((int32_t)dig_T2)) >> 11;
+  var2 = (((((adc_T>>4) - ((int32_t)dig_T1)) * ((adc_T>>4) - ((int32_t)dig_T1))) >> 12) * ((int32_t)dig_T3)) >> 14;
+  t_fine = var1 + var2;
+
+  return (t_fine * 5 + 128) >> 8;
+
+}
+
+/**
+ * Calculate pressure with the 32 bit integer compensation of the BMP280
+ * datasheet. Temperature needs to be calculated first for t_fine.
+ *
+ * @param adc_P               Raw pressure reading.
+ * @return int32_t            Pressure in Pa.
+ */
+int32_t Riots_BMP280::calcPressure(int32_t adc_P) {
+
+  int32_t var1, var2;
+  uint32_t p;
+
+  var1 = (((int32_t)t_fine)>>1) - (int32_t)64000;
+  var2 = (((var1>>2) * (var1>>2)) >> 11 ) * ((int32_t)dig_P6);
+  var2 = var2 + ((var1*((int32_t)dig_P5))<<1);
+  var2 = (var2>>2)+(((int32_t)dig_P4)<<16);
+  var1 = (((((int32_t)dig_P3) * (((var1>>2) * (var1>>2)) >> 13 )) >> 3) + ((((int32_t)dig_P2) * var1)>>1))>>18;
+  var1 = ((((32768+var1))*((int32_t)dig_P1))>>15);
+  if (var1 == 0) {
+    // avoid division by zero with missing calibration
+    return 0;
+  }
+
+  p = (((uint32_t)(((int32_t)1048576)-adc_P)-(var2>>12)))*3125;
+  if (p < 0x80000000) {
+    p = (p << 1) / ((uint32_t)var1);
+  }
+  else {
+    p = (p / (uint32_t)var1) * 2;
+  }
+  var1 = (((int32_t)dig_P9) * ((int32_t)(((p>>3) * (p>>3))>>13)))>>12;
+  var2 = (((int32_t)(p>>2)) * ((int32_t)dig_P8))>>13;
+  p = (uint32_t)((int32_t)p + ((var1 + var2 + dig_P7) >> 4));
+
+  return (int32_t)p;
+
+}
+
+#else
+
 /**
  * Calculate tempereture based on given values.
  *
@@ -208,7 +280,7 @@ void Riots_BMP280::calcTemperature(double &T, double &uT) {
 
   double var1 = (((double)adc_T)/16384.0-((double)dig_T1)/1024.0)*((double)dig_T2);
   double var2 = ((((double)adc_T)/131072.0 - ((double)dig_T1)/8192.0)*(((double)adc_T)/131072.0 - ((double)dig_T1)/8192.0))*((double)dig_T3);
-  t_fine = (long signed int)(var1+var2);
+  t_fine = (int32_t)(var1+var2);
 
   T = (var1+var2)/5120.0;
 
@@ -240,3 +312,5 @@ void Riots_BMP280::calcPressure(double &P,double uP) {
   P = p; //Pa
 
 }
+
+#endif // RIOTS_BMP280_FLOAT_COMPENSATION
@@ -37,17 +37,23 @@ class Riots_BMP280 {
     int32_t getPressure();
 
   private:
+#ifdef RIOTS_BMP280_FLOAT_COMPENSATION
   void calcPressure(double &P, double uP);
   void calcTemperature(double &T, double &uT);
-  byte readInt(byte address, int &value);
-  byte readUInt(byte address, unsigned int &value);
+#else
+  int32_t calcPressure(int32_t adc_P);
+  int32_t calcTemperature(int32_t adc_T);
+#endif
+  byte readInt(byte address, int16_t &value);
+  byte readUInt(byte address, uint16_t &value);
   byte readBytes(unsigned char *values, byte length);
   byte writeBytes(unsigned char *values, byte length);
-  byte getUnCalValues(double &uP, double &uT);
+  byte getUnCalValues(int32_t &adc_P, int32_t &adc_T);
 
-  int dig_T2, dig_T3, dig_T4, dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
-  unsigned int dig_P1, dig_T1;
-  long signed int t_fine;
+  // calibration words are 16 bit on every target, int is wider outside AVR
+  int16_t dig_T2, dig_T3, dig_T4, dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
+  uint16_t dig_P1, dig_T1;
+  int32_t t_fine;
   byte error;
 };
 #endif
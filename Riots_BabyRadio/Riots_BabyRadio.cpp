@@ -16,12 +16,12 @@
 #include "Arduino.h"
 #include <EEPROM.h>
 #include <SPI.h>
-#include <avr/wdt.h>
-#include <avr/sleep.h>
+#include "Riots_Hal.h"
 #include "aes.h"
 
 #include "Riots_Radio.h"
 #include "Riots_BabyRadio.h"
+#include "Riots_Profile.h"
 
 /**
  *
@@ -57,7 +57,10 @@ void Riots_BabyRadio::setup(byte indicativeLedsOn, byte debug, int nrfce, int nr
   rx_crypt_buff = riots_radio.getRXCryptBuffAddress();
   unique_aes = riots_radio.getPrivateKeyAddress();
   shared_aes = riots_radio.getSharedKeyAddress();
+  group_aes = riots_radio.getGroupKeyAddress();
+  group_page_aes = riots_radio.getGroupPageKeyAddress();
   own_address = riots_radio.getOwnRadioAddress();
+  stats = riots_radio.getStatsAddress();
 
 
   if (EEPROM.read(EEPROM_FIRST_BOOT) == 1) {
@@ -295,6 +298,9 @@ byte Riots_BabyRadio::update(byte sleep) {
     retvalue = RIOTS_SLEEP;
   }
 
+  // Write the completed firmware page while the next one is received
+  riots_flash.update();
+
   // Check data from Radio
   if ( riots_radio.update(0) == RIOTS_OK ) {
     if ( processMessage() == RIOTS_DATA_AVAILABLE ) {
@@ -350,6 +356,15 @@ uint32_t Riots_BabyRadio::getSeconds() {
 
 }
 
+/**
+* Returns memory address of the performance counters.
+*
+* @return Riots_Stats*  Counters of the radio and the baby.
+*/
+Riots_Stats* Riots_BabyRadio::getStatsAddress() {
+  return stats;
+}
+
 /**
 * Send pending messages from radio and check updates from the Riots network.
 *
@@ -361,6 +376,8 @@ uint32_t Riots_BabyRadio::getSeconds() {
 * @param value      Array of the data which should be sent
 */
 void Riots_BabyRadio::formMessage(byte type, byte length, byte addCounter, byte forward) {
+  _PROFILE_SCOPE(RIOTS_PROFILE_FORM_MESSAGE);
+
   plain_data[M_TYPE] = type;
   plain_data[M_LENGTH] = length;
 
@@ -483,6 +500,8 @@ byte Riots_BabyRadio::ringForward() {
   if (riots_radio.send() != RIOTS_OK) {
     _DEBUG_PRINT(F("Riots_BabyRadio::ringForward sent fail!"));
 
+    stats->ring_drops++;
+
     // Form ring backward message
     formMessage(TYPE_RING_EVENT_BACK, 0x8);
 
@@ -507,6 +526,8 @@ byte Riots_BabyRadio::ringBackward() {
   riots_radio.setTXAddress(RP);
 
   if (riots_radio.send() != RIOTS_OK) {
+    stats->ring_drops++;
+
     // Report failure to cloud
     memcpy(plain_data + M_VALUE, RP, 4);
     sendMessage(TYPE_CORE_NOT_REACHED, RIOTS_OK);
@@ -550,6 +571,10 @@ byte Riots_BabyRadio::routeForward() {
 * @return      true, if message was decrypted successfully and message was valid.
 */
 byte Riots_BabyRadio::processMessage() {
+  if ( riots_radio.getRxPipe() == RIOTS_GROUP_PIPE ) {
+    // Group frames are never routed or replied
+    return handleGroupMessage();
+  }
   if (riots_radio.decrypt(shared_aes) == RIOTS_OK) {
     // CRC matches with shared key, run deeper check
     if (checkSharedMessageValidity()) {
@@ -580,6 +605,65 @@ byte Riots_BabyRadio::processMessage() {
   return routeForward();
 }
 
+/**
+* Handles a firmware page sent to the update group. Only page data is accepted
+* from the group, missing pages are asked afterwards with TYPE_MISSING_PAGES.
+*
+* Each TYPE_LOAD_ADDRESS sent to the group carries a group sequence number,
+* which must be newer than the last one. The page packets are crypted with the
+* key of that sequence number, so frames of an earlier page or update are not
+* accepted.
+*
+* @return      RIOTS_OK, if page data was handled.
+*/
+byte Riots_BabyRadio::handleGroupMessage() {
+  bool response = false;
+
+  if ( riots_radio.getGroupSequence() == 0 || riots_radio.decrypt(group_page_aes) != RIOTS_OK ||
+       !checkGroupPageValidity() ) {
+    // Not a packet of the current page, only a load address starts the next one
+    if ( riots_radio.decrypt(group_aes) != RIOTS_OK || plain_data[M_TYPE] != TYPE_LOAD_ADDRESS ||
+         plain_data[M_LENGTH] != GROUP_LOAD_ADDRESS_LEN ) {
+      _DEBUG_PRINTLN(F("Riots_BabyRadio::handleGroupMessage: not a page message"));
+      return RIOTS_FAIL;
+    }
+    if ( !riots_radio.acceptGroupSequence((plain_data[M_VALUE+2]<<8) | plain_data[M_VALUE+3]) ) {
+      _DEBUG_PRINTLN(F("Riots_BabyRadio::handleGroupMessage: old group sequence"));
+      return RIOTS_FAIL;
+    }
+    // Riots_Flash takes the page address only
+    plain_data[M_LENGTH] = 0x02;
+  }
+
+#ifdef RIOTS_FLASH_MODE
+  flash_mode = 1;
+  flash_start = millis();
+#endif
+
+  updateLedStatus(0, RIOTS_FLASH_COLOR);
+
+  // No reply, the whole group would answer at once
+  riots_flash.handleFlashMessage(plain_data[M_TYPE], plain_data, &response);
+  return RIOTS_OK;
+}
+
+/**
+* Runs a type and length check for a page packet sent to the group.
+*
+* @return      true, if decrypted message is a valid page packet.
+*/
+bool Riots_BabyRadio::checkGroupPageValidity() {
+  switch (plain_data[M_TYPE]) {
+    case TYPE_PROG_PAGE:
+      return plain_data[M_LENGTH] >= 0x09 && plain_data[M_LENGTH] <= 0x0D;
+
+    case TYPE_PROG_PAGE_LZ:
+    case TYPE_PROG_PAGE_DELTA:
+      return plain_data[M_LENGTH] >= 0x02 && plain_data[M_LENGTH] <= 0x0D;
+  }
+  return false;
+}
+
 /**
 * Runs an operation and lenght check for the decrypted message.
 *
@@ -590,7 +674,7 @@ bool Riots_BabyRadio::checkSharedMessageValidity() {
   // run checks with the type and exact length of the message
   switch (plain_data[M_TYPE]) {
      case TYPE_CONFIRM_CONFIG:
-      if ( plain_data[1] == 0x02 ) {
+      if ( plain_data[1] == CONFIRM_CONFIG_LEN || plain_data[1] == CONFIRM_PAGE_LEN ) {
         return true;
       }
     break;
@@ -632,6 +716,7 @@ bool Riots_BabyRadio::checkSharedMessageValidity() {
     default:
       return false;
   }
+  return false;
 }
 
 /**
@@ -768,6 +853,11 @@ byte Riots_BabyRadio::validatePrivateMessage() {
     case TYPE_ENTER_PROGMODE:
     case TYPE_LEAVE_PROGMODE:
     case TYPE_LOAD_ADDRESS:
+    case TYPE_PAGE_HASH:
+    case TYPE_MISSING_PAGES:
+    case TYPE_GROUP_ADDRESS:
+    case TYPE_GROUP_KEY_PART1:
+    case TYPE_GROUP_KEY_PART2:
     case TYPE_PROG_FLASH:
       if (checkCounter() != RIOTS_OK){
         _DEBUG_PRINTLN(F(" Counter check failed"));
@@ -785,32 +875,55 @@ byte Riots_BabyRadio::validatePrivateMessage() {
       }
       break;
 
-    case TYPE_ENTER_PROGMODE:
     case TYPE_SET_BATTERY_OP:
+    case TYPE_MISSING_PAGES:
       if (plain_data[M_LENGTH] != 0x01) {
         length_fail = 1;
       }
       break;
 
+    case TYPE_ENTER_PROGMODE:
+      if (plain_data[M_LENGTH] != ENTER_PROGMODE_LEN && plain_data[M_LENGTH] != ENTER_PROGMODE_CAPS_LEN) {
+        length_fail = 1;
+      }
+      break;
+
     // TODO this is not in specification
     case TYPE_CHILD_ID:
     case TYPE_LOAD_ADDRESS:
-    case TYPE_PROG_FLASH:
     case TYPE_INIT_CONFIRM:
       if(plain_data[M_LENGTH] != 0x2) {
         length_fail = 1;
       }
       break;
 
+    case TYPE_PROG_FLASH:
+      if (plain_data[M_LENGTH] != PROG_FLASH_LEN && plain_data[M_LENGTH] != PROG_FLASH_RESUME_LEN) {
+        length_fail = 1;
+      }
+      break;
+
     case TYPE_MAMA_ADDRESS:
     case TYPE_DEBUG_ADDRESS:
     case TYPE_CHILD_ADDRESS:
-    case TYPE_LEAVE_PROGMODE:
+    case TYPE_GROUP_ADDRESS:
       if (plain_data[M_LENGTH] != 0x04) {
         length_fail = 1;
       }
       break;
 
+    case TYPE_PAGE_HASH:
+      if (plain_data[M_LENGTH] < PAGE_HASH_MIN_LEN || plain_data[M_LENGTH] > PAGE_HASH_MAX_LEN) {
+        length_fail = 1;
+      }
+      break;
+
+    case TYPE_LEAVE_PROGMODE:
+      if (plain_data[M_LENGTH] != LEAVE_PROGMODE_LEN && plain_data[M_LENGTH] != LEAVE_PROGMODE_CRC_LEN) {
+        length_fail = 1;
+      }
+      break;
+
     case TYPE_INIT_PARENT:
     case TYPE_SET_ADDRESS_PREV:
     case TYPE_SET_ADDRESS_NEXT:
@@ -827,6 +940,8 @@ byte Riots_BabyRadio::validatePrivateMessage() {
 
     case TYPE_AES_PART1:
     case TYPE_AES_PART2:
+    case TYPE_GROUP_KEY_PART1:
+    case TYPE_GROUP_KEY_PART2:
       if (plain_data[M_LENGTH] != 0x08) {
         length_fail = 1;
       }
@@ -855,6 +970,14 @@ byte Riots_BabyRadio::validatePrivateMessage() {
       }
     break;
 
+    case TYPE_PROG_PAGE_LZ:
+    case TYPE_PROG_PAGE_DELTA:
+      // packet counter and at least one token
+      if (plain_data[M_LENGTH] < 0x02 || plain_data[M_LENGTH] > 0x0D) {
+        length_fail = 1;
+      }
+    break;
+
     default:
       length_fail = 1;
     break;
@@ -1087,6 +1210,19 @@ byte Riots_BabyRadio::handlePrivateMessage() {
       sendMessage(TYPE_CONFIRM_CONFIG, RIOTS_OK);
       break;
 
+    case TYPE_GROUP_ADDRESS:
+      _DEBUG_PRINTLN(F(" TYPE_GROUP_ADDRESS"));
+      riots_radio.setGroupAddress(plain_data+M_VALUE);
+      sendMessage(TYPE_CONFIRM_CONFIG, RIOTS_OK);
+      break;
+
+    case TYPE_GROUP_KEY_PART1: /* FALLTHROUGH */
+    case TYPE_GROUP_KEY_PART2:
+      _DEBUG_PRINTLN(F(" TYPE_GROUP_KEY"));
+      riots_radio.saveGroupKey(plain_data[M_TYPE] - TYPE_GROUP_KEY_PART1, plain_data+M_VALUE);
+      sendMessage(TYPE_CONFIRM_CONFIG, RIOTS_OK);
+      break;
+
     case TYPE_CHILD_ADDRESS:
       _DEBUG_PRINTLN(F(" TYPE_CHILD_ADDRESS"));
 
@@ -1251,8 +1387,12 @@ byte Riots_BabyRadio::handlePrivateMessage() {
     case TYPE_ENTER_PROGMODE: /* FALLTHROUGH */
     case TYPE_LEAVE_PROGMODE:
     case TYPE_LOAD_ADDRESS:
+    case TYPE_PAGE_HASH:
+    case TYPE_MISSING_PAGES:
     case TYPE_PROG_FLASH:
     case TYPE_PROG_PAGE:
+    case TYPE_PROG_PAGE_LZ:
+    case TYPE_PROG_PAGE_DELTA:
 
 #ifdef RIOTS_FLASH_MODE
       flash_mode = 1;
@@ -1264,7 +1404,8 @@ byte Riots_BabyRadio::handlePrivateMessage() {
       flash_reply = riots_flash.handleFlashMessage(plain_data[M_TYPE], plain_data, &response);
 
       if ( response == true ) {
-        if ( plain_data[M_TYPE] == TYPE_PROG_PAGE ) {
+        if ( plain_data[M_TYPE] == TYPE_PROG_PAGE || plain_data[M_TYPE] == TYPE_PROG_PAGE_LZ ||
+             plain_data[M_TYPE] == TYPE_PROG_PAGE_DELTA ) {
           // Confirm LOAD_ADDRESS configuration after all packages has been received successfully
           // or when first failure happens
           plain_data[M_TYPE] = TYPE_LOAD_ADDRESS;
@@ -1356,8 +1497,8 @@ void Riots_BabyRadio::sendMessage(byte message, byte status) {
       plain_data[M_VALUE] = plain_data[M_TYPE]; // Received message type
       plain_data[M_STATUS] = status;
 
-      // Form message
-      formMessage(TYPE_CONFIRM_CONFIG, CONFIRM_CONFIG_LEN);
+      // Form message, flash confirms may carry more data
+      formMessage(TYPE_CONFIRM_CONFIG, riots_flash.addConfirmData(plain_data[M_VALUE], &plain_data[M_STATUS+1]));
       // Send message
       sendStatus = RIOTS_FAIL;
       while (sendStatus != RIOTS_OK && retries < 5) {
@@ -1398,6 +1539,7 @@ byte Riots_BabyRadio::checkCounter() {
     return RIOTS_OK;
   }
   _DEBUG_PRINTLN(F("Riots_Radio::checkCounter: FAILED"));
+  stats->counter_rejects++;
   return RIOTS_FAIL;
 }
 
@@ -1575,6 +1717,7 @@ bool Riots_BabyRadio::isRingCounterValid() {
     return true;
   }
   _DEBUG_PRINTLN(F("wrong counter"));
+  stats->counter_rejects++;
 
   return false;
 }
@@ -30,6 +30,7 @@ class Riots_BabyRadio : public Print {
     int32_t getData();
     uint8_t getIndex();
     uint32_t getSeconds();
+    Riots_Stats* getStatsAddress();
     virtual size_t write(uint8_t);
     virtual size_t write(const uint8_t *buffer, size_t size);
     using Print::write;
@@ -44,10 +45,13 @@ class Riots_BabyRadio : public Print {
     uint16_t current_ring_counter;      /*!< Counter of the ring event                                                      */
     byte* unique_aes;                   /*!< ptr to Unique AES128 key for the mama, data allocated in Riots_MaraRadio side  */
     byte* shared_aes;                   /*!< ptr to Shared AES128 key for the mama, data allocated in Riots_MaraRadio side  */
+    byte* group_aes;                    /*!< ptr to update group AES128 key, data allocated in Riots_Radio side             */
+    byte* group_page_aes;               /*!< ptr to group key of the page packets, data allocated in Riots_Radio side       */
     byte* own_address;                  /*!< ptr to own core radio address, data allocated in Riots_Radio side              */
     byte* plain_data;                   /*!< ptr to plain data which is used in both riot mamaradio and cloud               */
     byte* tx_crypt_buff;                /*!< tx_buffer to store crypted data and header                                     */
     byte* rx_crypt_buff;                /*!< rx_buffer to store crypted data and header                                     */
+    Riots_Stats* stats;                 /*!< ptr to performance counters, data allocated in Riots_Radio side                */
     byte MA[RF_ADDRESS_SIZE];           /*!< Mama radio address                                                             */
     byte CA[RF_ADDRESS_SIZE];           /*!< Child radio address                                                            */
     byte DA[RF_ADDRESS_SIZE];           /*!< Debug radio address                                                            */
@@ -88,6 +92,8 @@ class Riots_BabyRadio : public Print {
     byte validatePrivateMessage();
     byte handlePrivateMessage();
     byte handleSharedMessage();
+    byte handleGroupMessage();
+    bool checkGroupPageValidity();
     bool checkSharedMessageValidity();
     byte cloudForward();
     byte ringForward();
@@ -13,6 +13,7 @@
  */
 
 #include "Riots_Button.h"
+#include "Riots_Memory.h"
 #include "Wire.h"
 
 /**
@@ -31,8 +32,9 @@ Riots_Button::Riots_Button( ) {
  *
  */
 void Riots_Button::setup() {
-  // Start I2c
+  // Start I2c, Wire.begin() resets the bus speed so restore the shared one
   Wire.begin();
+  Riots_Memory::applyBusSpeed();
 
   // Check product id
   byte proid = capRead(PROID);
@@ -85,11 +87,17 @@ byte Riots_Button::read() {
  * @return byte               Status of the register.
  */
 byte Riots_Button::capRead(byte reg) {
+  byte val;
+
+  // Touch controller is not known to run in fast mode, other devices keep the shared speed
+  Riots_Memory::applyBusSpeed(RIOTS_I2C_STANDARD_MODE);
   Wire.beginTransmission(I2CA);
   Wire.write(reg);
   Wire.endTransmission();
   Wire.requestFrom(I2CA, 1);
-  return Wire.read();
+  val = Wire.read();
+  Riots_Memory::applyBusSpeed();
+  return val;
 }
 
 /**
@@ -100,8 +108,10 @@ byte Riots_Button::capRead(byte reg) {
  * @return byte               Status of the register.
  */
 void Riots_Button::capWrite(byte reg, byte val) {
+  Riots_Memory::applyBusSpeed(RIOTS_I2C_STANDARD_MODE);
   Wire.beginTransmission(I2CA);
   Wire.write(reg);
   Wire.write(val);
   Wire.endTransmission();
+  Riots_Memory::applyBusSpeed();
 }
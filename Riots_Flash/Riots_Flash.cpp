@@ -13,6 +13,8 @@
  */
 #include "Riots_Flash.h"
 #include "Riots_Helper.h"
+#include "Riots_Profile.h"
+#include "Riots_Lz.h"
 #include <EEPROM.h>
 
 /**
@@ -23,12 +25,23 @@
 uint8_t Riots_Flash::setup() {
 
   page_address = 0;
+  flash_buffer = page_buffers[0];
+  pending_buffer = NULL;
   packet_counter = 0;
   flashbuffer_index = 0;
+  received_packets = 0;
+  flash_caps = 0;
+  page_stream = false;
   reported  = false;
   eeprom_status = RIOTS_FAIL;
   next_boot_status=RIOTS_EMPTY;
   firmware_written=0;
+  image_crc = RIOTS_CRC32_INIT;
+  crc_in_order = false;
+  needed_pages = 0;
+  memset(staged_pages, 0, sizeof(staged_pages));
+  written_page = RIOTS_NO_PAGE;
+  checkpoint = false;
 
   if(riots_memory.setup(RIOTS_PRIMARY_EEPROM)) {
     eeprom_status = RIOTS_OK;
@@ -50,16 +63,31 @@ uint8_t Riots_Flash::setup() {
  */
 uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *response_needed) {
 
+  uint8_t image_header[RIOTS_IMAGE_HEADER_LEN];
+  _PROFILE_SCOPE(type == TYPE_PROG_PAGE || type == TYPE_PROG_PAGE_LZ || type == TYPE_PROG_PAGE_DELTA ?
+                 RIOTS_PROFILE_FLASH_PAGE : RIOTS_PROFILE_FLASH_CONTROL);
+
+  if (type != TYPE_PROG_PAGE && type != TYPE_PROG_PAGE_LZ && type != TYPE_PROG_PAGE_DELTA && type != TYPE_LOAD_ADDRESS) {
+    // Control messages read or replace the staged image, write the last page first
+    update();
+  }
+
   switch (type) {
     case TYPE_ENTER_PROGMODE:
       *response_needed = true;
 
       _DEBUG_PRINTLN(F(" TYPE_ENTER_PROGMODE"));
-      if (plain[M_LENGTH] != 0x1) {
+      if (plain[M_LENGTH] != ENTER_PROGMODE_LEN && plain[M_LENGTH] != ENTER_PROGMODE_CAPS_LEN) {
         _DEBUG_PRINTLN(F(" incorrect data length"));
         return RIOTS_FAIL;
       }
 
+      // Use the capabilities requested and supported, none for an older cloud
+      flash_caps = 0;
+      if (plain[M_LENGTH] == ENTER_PROGMODE_CAPS_LEN) {
+        flash_caps = plain[M_VALUE+1] & RIOTS_FLASH_CAPS;
+      }
+
       // Save next boot status
       next_boot_status = plain[M_VALUE];
       // Clear firmware written
@@ -95,7 +123,7 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
       *response_needed = true;
 
       _DEBUG_PRINTLN(F(" TYPE_PROG_FLASH"));
-      if (plain[M_LENGTH] != 0x2) {
+      if (plain[M_LENGTH] != PROG_FLASH_LEN && plain[M_LENGTH] != PROG_FLASH_RESUME_LEN) {
         _DEBUG_PRINTLN(F(" incorrect data length"));
         return RIOTS_FAIL;
       }
@@ -106,23 +134,70 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
 
       /* store firmware size to be flashed */
       firmware_size = (plain[M_VALUE]<<8) | plain[M_VALUE+1];
+      firmware_written = 0;
+      image_crc = RIOTS_CRC32_INIT;
+      crc_in_order = true;
+      memset(staged_pages, 0, sizeof(staged_pages));
+      written_page = RIOTS_NO_PAGE;
+      page_address_previous = 65535;
+
+      if (plain[M_LENGTH] == PROG_FLASH_RESUME_LEN) {
+        if (resumeCheckpoint(&plain[M_VALUE+2])) {
+          /* Image header is already corrupted, continue with the pages written */
+          _DEBUG_PRINTLN(F(" transfer resumed"));
+          crc_in_order = firmware_written == 0;
+          break;
+        }
+        startCheckpoint(&plain[M_VALUE+2]);
+      }
+      else {
+        clearCheckpoint();
+      }
 
 
       /* Corrupt (fill with 0x00) image in I2C eeprom to be flashed
          If wdt or button reset occurs during flash process, device will stay in booloader */
-      if(next_boot_status==BOOT_LOAD_OFFICIAL) {
-        riots_memory.startPageWrite(I2C_EEPROM_O_FW_ID, RIOTS_PRIMARY_EEPROM);
-      }
-      else if(next_boot_status==BOOT_LOAD_UNOFFICIAL) {
-        riots_memory.startPageWrite(I2C_EEPROM_UO_FW_ID, RIOTS_PRIMARY_EEPROM);
+      memset(image_header, 0x00, RIOTS_IMAGE_HEADER_LEN);
+      writeImageHeader(image_header);
+
+      break;
+
+
+    case TYPE_PAGE_HASH:
+      *response_needed = true;
+      _DEBUG_PRINTLN(F(" TYPE_PAGE_HASH"));
+
+      // Check message length, page index and whole hashes
+      if (plain[M_LENGTH] < PAGE_HASH_MIN_LEN || plain[M_LENGTH] > PAGE_HASH_MAX_LEN ||
+          (plain[M_LENGTH] - 1) % RIOTS_PAGE_HASH_SIZE != 0) {
+        _DEBUG_PRINTLN(F(" incorrect data length"));
+        return RIOTS_FAIL;
       }
-      for(uint8_t i=0; i<6; i++) {
-        riots_memory.pageFill(0x00);
+
+      if(next_boot_status==RIOTS_EMPTY) {
+        _DEBUG_PRINTLN(F(" incorrect boot status"));
+        return RIOTS_FAIL;
       }
-      riots_memory.stopPageWrite();
 
+      needed_pages = checkPageHashes(plain[M_VALUE], &plain[M_VALUE+1], (plain[M_LENGTH] - 1) / RIOTS_PAGE_HASH_SIZE);
       break;
 
+    case TYPE_MISSING_PAGES:
+      *response_needed = true;
+      _DEBUG_PRINTLN(F(" TYPE_MISSING_PAGES"));
+
+      if (plain[M_LENGTH] != MISSING_PAGES_LEN) {
+        _DEBUG_PRINTLN(F(" incorrect data length"));
+        return RIOTS_FAIL;
+      }
+
+      if(next_boot_status==RIOTS_EMPTY) {
+        _DEBUG_PRINTLN(F(" incorrect boot status"));
+        return RIOTS_FAIL;
+      }
+
+      needed_pages = findMissingPages(plain[M_VALUE]);
+      break;
 
     case TYPE_LOAD_ADDRESS:
       _DEBUG_PRINTLN(F(" TYPE_LOAD_ADDRESS"));
@@ -138,6 +213,14 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
         return RIOTS_FAIL;
       }
 
+      /* Same sliced page again before it was completed, keep the packets received so far */
+      if (received_packets != 0 && !page_stream && flashbuffer_index < I2C_EEPROM_PAGE_SIZE &&
+          page_address == (uint16_t)(((plain[M_VALUE]<<8) | plain[M_VALUE+1]) + i2c_offset)) {
+        _DEBUG_PRINTLN(F(" page continued"));
+        reported = false;
+        break;
+      }
+
       /* Store page address to be written next in I2C EEPROM */
       page_address = (plain[M_VALUE]<<8) | plain[M_VALUE+1];
 
@@ -155,10 +238,14 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
 
       flashbuffer_index = 0;
       packet_counter = 0;
+      received_packets = 0;
+      page_stream = false;
       reported = false;
       break;
 
     case TYPE_PROG_PAGE:
+    case TYPE_PROG_PAGE_LZ:
+    case TYPE_PROG_PAGE_DELTA:
       _DEBUG_PRINTLN(F(" TYPE_PROG_PAGE"));
 
       if(next_boot_status==RIOTS_EMPTY) {
@@ -166,25 +253,53 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
         return RIOTS_FAIL;
       }
 
-      uint8_t length;
+      uint8_t length, packet;
+      bool stream;
       length = ((plain[M_LENGTH])-1);
-      if(plain[M_VALUE] == packet_counter && (flashbuffer_index+length) <= I2C_EEPROM_PAGE_SIZE) {
-        memcpy(&flash_buffer[flashbuffer_index], &plain[M_VALUE+1], length);
-        flashbuffer_index+=length;
-        packet_counter++;
+      packet = plain[M_VALUE];
+      stream = (type != TYPE_PROG_PAGE || !(flash_caps & RIOTS_FLASH_CAP_SLICES));
+
+      if ( flashbuffer_index == I2C_EEPROM_PAGE_SIZE || isPacketReceived(packet) ) {
+        // Previous flash package received second time - do nothing
+        _DEBUG_PRINTLN(F(" ERROR: Flash package already received, skipping"));
+
+        if ( !page_stream && packet == RIOTS_PAGE_PACKETS - 1 && flashbuffer_index < I2C_EEPROM_PAGE_SIZE ) {
+          // Repeated last packet closes a retransmission round, report the packets still missing
+          *response_needed = true;
+          return RIOTS_FAIL;
+        }
+      }
+
+      else if ( (received_packets == 0 || stream == page_stream) &&
+                storePageData(type, packet, &plain[M_VALUE+1], length) ) {
+        page_stream = stream;
+        if ( packet < RIOTS_PAGE_BITMAP_SIZE ) {
+          bitSet(received_packets, packet);
+        }
+        reported = false;
+
         if(flashbuffer_index == I2C_EEPROM_PAGE_SIZE) {
           if (new_page) {
-            writeEepromPage();
-            firmware_written += I2C_EEPROM_PAGE_SIZE;
+            if (page_address - i2c_offset == firmware_written) {
+              image_crc = updateCrc(image_crc, flash_buffer, I2C_EEPROM_PAGE_SIZE);
+            }
+            else {
+              crc_in_order = false;
+            }
+            queuePage();
+            // Count every page once, even if it is sent again
+            if (stagePage((page_address - i2c_offset) / I2C_EEPROM_PAGE_SIZE)) {
+              firmware_written += I2C_EEPROM_PAGE_SIZE;
+            }
             page_address_previous = page_address - i2c_offset;
           }
           *response_needed = true;
         }
-      }
-
-      else if ( plain[M_VALUE] < packet_counter ) {
-        // Previous flash package received second time - do nothing
-        _DEBUG_PRINTLN(F(" ERROR: Flash package already received, skipping"));
+        else if ( !stream && packet == RIOTS_PAGE_PACKETS - 1 ) {
+          // Last packet received with gaps, report the missing packets
+          *response_needed = true;
+          return RIOTS_FAIL;
+        }
       }
 
       else {
@@ -202,7 +317,7 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
     case TYPE_LEAVE_PROGMODE:
       *response_needed = true;
       _DEBUG_PRINTLN(F(" TYPE_LEAVE_PROGMODE"));
-      if (plain[M_LENGTH] != 0x4) {
+      if (plain[M_LENGTH] != LEAVE_PROGMODE_LEN && plain[M_LENGTH] != LEAVE_PROGMODE_CRC_LEN) {
         _DEBUG_PRINTLN(F(" incorrect data length"));
         return RIOTS_FAIL;
       }
@@ -219,25 +334,32 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
         return RIOTS_FAIL;
       }
 
+      // Verify the written image before the boot status is committed
+      if(plain[M_LENGTH] == LEAVE_PROGMODE_CRC_LEN && firmware_written>0) {
+        uint32_t expected_crc;
+        expected_crc = ((uint32_t)plain[M_VALUE+4]<<24) | ((uint32_t)plain[M_VALUE+5]<<16) |
+                       ((uint32_t)plain[M_VALUE+6]<<8)  | plain[M_VALUE+7];
+        if (!verifyImage(expected_crc)) {
+          _DEBUG_PRINTLN(F(" image verification failed"));
+          // Do not resume a broken image, the transfer starts over
+          clearCheckpoint();
+          return RIOTS_FAIL;
+        }
+      }
+
+      // Image is complete, nothing to resume any more
+      clearCheckpoint();
+
       // Write boot status to EEPROM
       EEPROM.write(EEPROM_BOOT_STATUS, next_boot_status);
 
       // Write firmware ID and length to I2C EEPROM and perform reset
-      if(next_boot_status==BOOT_LOAD_OFFICIAL) {
-        _DEBUG_PRINTLN(F(" BOOT_LOAD_OFFICIAL"));
-        riots_memory.startPageWrite(I2C_EEPROM_O_FW_ID, RIOTS_PRIMARY_EEPROM);
-      }
-      else if(next_boot_status==BOOT_LOAD_UNOFFICIAL) {
-        _DEBUG_PRINTLN(F(" BOOT_LOAD_UNOFFICIAL"));
-        riots_memory.startPageWrite(I2C_EEPROM_UO_FW_ID, RIOTS_PRIMARY_EEPROM);
-      }
-
-      for(uint8_t i=0; i<4; i++) {
-        riots_memory.pageFill(plain[M_VALUE+i]);
-      }
-      riots_memory.pageFill((firmware_size>>8) & 0xFF);
-      riots_memory.pageFill(firmware_size & 0xFF);
-      riots_memory.stopPageWrite();
+      memcpy(image_header, &plain[M_VALUE], 4);
+      image_header[4] = (firmware_size>>8) & 0xFF;
+      image_header[5] = firmware_size & 0xFF;
+      writeImageHeader(image_header);
+      // Bootloader reads the header right after the reset
+      riots_memory.waitWriteCycle(RIOTS_PRIMARY_EEPROM);
 
       return RIOTS_RESET;
 
@@ -251,18 +373,504 @@ uint8_t Riots_Flash::handleFlashMessage(uint8_t type, uint8_t *plain, bool *resp
 }
 
 /**
- * Writes page to the EEPROM.
+ * Adds the flash data to the confirm of a flash message: the packets missing
+ * from the page, the pages needed, the page to resume from or the flash
+ * capabilities in use. Confirms of the messages and message forms an older
+ * cloud sends are left as they were.
+ *
+ * @param message_type  Type of the message confirmed
+ * @param data          Confirm data after the status, 2 bytes
+ * @return uint8_t      Length of the confirm, CONFIRM_CONFIG_LEN or CONFIRM_PAGE_LEN
+ */
+uint8_t Riots_Flash::addConfirmData(uint8_t message_type, uint8_t *data) {
+  uint16_t value;
+
+  switch (message_type) {
+    case TYPE_ENTER_PROGMODE:
+      if ( !flash_caps ) {
+        return CONFIRM_CONFIG_LEN;
+      }
+      value = flash_caps;
+      break;
+
+    case TYPE_PROG_FLASH:
+      // Resume page only for the resume form, which starts a checkpoint
+      if ( !checkpoint ) {
+        return CONFIRM_CONFIG_LEN;
+      }
+      value = getResumePage();
+      break;
+
+    case TYPE_LOAD_ADDRESS:
+      if ( !(flash_caps & RIOTS_FLASH_CAP_SLICES) ) {
+        return CONFIRM_CONFIG_LEN;
+      }
+      value = getMissingPackets();
+      break;
+
+    case TYPE_PAGE_HASH:
+    case TYPE_MISSING_PAGES:
+      value = getNeededPages();
+      break;
+
+    default:
+      return CONFIRM_CONFIG_LEN;
+  }
+
+  data[0] = (value>>8) & 0xFF;
+  data[1] = value & 0xFF;
+  return CONFIRM_PAGE_LEN;
+}
+
+/**
+ * Returns the bitmap of the packets still missing from the current page,
+ * bit N set for missing packet N.
+ *
+ * @return uint16_t   Missing packets, 0 when the page is complete.
+ */
+uint16_t Riots_Flash::getMissingPackets() {
+  if ( flashbuffer_index == I2C_EEPROM_PAGE_SIZE ) {
+    return 0;
+  }
+  if ( page_stream ) {
+    // packet count of a compressed page is not known, everything after the gap is missing
+    return ~received_packets;
+  }
+  return ~received_packets & RIOTS_PAGE_PACKETS_MASK;
+}
+
+/**
+ * Returns the bitmap of the pages needed after the last TYPE_PAGE_HASH or
+ * TYPE_MISSING_PAGES, bit N set when the Nth page of the message needs to be sent.
+ *
+ * @return uint16_t   Needed pages
+ */
+uint16_t Riots_Flash::getNeededPages() {
+  return needed_pages;
+}
+
+/**
+ * Returns the index of the first page not written yet, the cloud continues
+ * the transfer from it after TYPE_PROG_FLASH.
+ *
+ * @return uint16_t   First missing page, page count of the image if all are written
+ */
+uint16_t Riots_Flash::getResumePage() {
+  uint16_t page;
+
+  for (page = 0; page < RIOTS_IMAGE_PAGES && (uint32_t)page * I2C_EEPROM_PAGE_SIZE < firmware_size; page++) {
+    if ( !bitRead(staged_pages[page/8], page%8) ) {
+      break;
+    }
+  }
+  return page;
+}
+
+/**
+ * Compares the page hashes given by the cloud against the pages already in the
+ * I2C EEPROM. Matching pages are counted as written, so they can be skipped.
+ *
+ * @param first_page  Index of the first page in the image
+ * @param hashes      Page hashes, RIOTS_PAGE_HASH_SIZE bytes each
+ * @param count       Count of the hashes
+ * @return uint16_t   Bitmap of the pages needed, bit 0 for the first page
+ */
+uint16_t Riots_Flash::checkPageHashes(uint8_t first_page, uint8_t *hashes, uint8_t count) {
+  uint8_t *page_data;
+  uint16_t needed = 0;
+  uint16_t page;
+  uint32_t crc, hash;
+  uint8_t i;
+
+  // Control messages write the waiting page first, the buffer not receiving is free
+  page_data = (flash_buffer == page_buffers[0]) ? page_buffers[1] : page_buffers[0];
+
+  for (i = 0; i < count; i++) {
+    page = first_page + i;
+
+    if ( page >= RIOTS_IMAGE_PAGES || (uint32_t)(page + 1) * I2C_EEPROM_PAGE_SIZE > firmware_size ) {
+      bitSet(needed, i);
+      continue;
+    }
+
+    riots_memory.readBlock(i2c_offset + page * I2C_EEPROM_PAGE_SIZE, page_data, I2C_EEPROM_PAGE_SIZE, RIOTS_PRIMARY_EEPROM);
+    crc = ~updateCrc(RIOTS_CRC32_INIT, page_data, I2C_EEPROM_PAGE_SIZE);
+    hash = ((uint32_t)hashes[i*RIOTS_PAGE_HASH_SIZE]<<24)   | ((uint32_t)hashes[i*RIOTS_PAGE_HASH_SIZE+1]<<16) |
+           ((uint32_t)hashes[i*RIOTS_PAGE_HASH_SIZE+2]<<8)  | hashes[i*RIOTS_PAGE_HASH_SIZE+3];
+
+    if ( crc != hash ) {
+      bitSet(needed, i);
+    }
+    else if ( stagePage(page) ) {
+      checkpointPage(page);
+      firmware_written += I2C_EEPROM_PAGE_SIZE;
+      // written pages are no longer contiguous, leave the image check to the read back
+      crc_in_order = false;
+    }
+  }
+  return needed;
+}
+
+/**
+ * Finds the pages of the image not staged yet. After a group update the
+ * cloud sends these to each node separately.
+ *
+ * @param first_page  Index of the first page in the image
+ * @return uint16_t   Bitmap of the missing pages, bit 0 for the first page
+ */
+uint16_t Riots_Flash::findMissingPages(uint8_t first_page) {
+  uint16_t missing = 0;
+  uint16_t page;
+  uint8_t i;
+
+  for (i = 0; i < RIOTS_PAGE_BITMAP_SIZE; i++) {
+    page = first_page + i;
+    if ( page >= RIOTS_IMAGE_PAGES || (uint32_t)page * I2C_EEPROM_PAGE_SIZE >= firmware_size ) {
+      // past the end of the image
+      break;
+    }
+    if ( !bitRead(staged_pages[page/8], page%8) ) {
+      bitSet(missing, i);
+    }
+  }
+  return missing;
+}
+
+/**
+ * Marks the page of the image as staged in the I2C EEPROM.
+ *
+ * @param page        Index of the page in the image
+ * @return bool       True, if the page was not staged before
+ */
+bool Riots_Flash::stagePage(uint16_t page) {
+  if ( page >= RIOTS_IMAGE_PAGES || bitRead(staged_pages[page/8], page%8) ) {
+    return false;
+  }
+  bitSet(staged_pages[page/8], page%8);
+  return true;
+}
+
+/**
+ * Starts a new transfer checkpoint for the image.
+ *
+ * @param image_id    ID of the image, 4 bytes
+ */
+void Riots_Flash::startCheckpoint(uint8_t *image_id) {
+  uint8_t i;
+
+  // Invalidate first, a reset in the middle must not leave a mixed checkpoint
+  EEPROM.write(EEPROM_FLASH_STATUS, RIOTS_EMPTY);
+
+  for (i = 0; i < RIOTS_CHECKPOINT_SIZE; i++) {
+    if (EEPROM.read(EEPROM_FLASH_PAGES+i) != 0) {
+      EEPROM.write(EEPROM_FLASH_PAGES+i, 0);
+    }
+  }
+  for (i = 0; i < 4; i++) {
+    EEPROM.write(EEPROM_FLASH_IMAGE_ID+i, image_id[i]);
+  }
+  EEPROM.write(EEPROM_FLASH_SIZE, (firmware_size>>8) & 0xFF);
+  EEPROM.write(EEPROM_FLASH_SIZE+1, firmware_size & 0xFF);
+  EEPROM.write(EEPROM_FLASH_STATUS, next_boot_status);
+
+  firmware_written = 0;
+  checkpoint = true;
+}
+
+/**
+ * Restores the pages written from the checkpoint, if it belongs to the same
+ * image and image slot.
+ *
+ * @param image_id    ID of the image, 4 bytes
+ * @return bool       True, if the checkpoint was restored
+ */
+bool Riots_Flash::resumeCheckpoint(uint8_t *image_id) {
+  uint16_t page;
+  uint8_t i;
+
+  if (EEPROM.read(EEPROM_FLASH_STATUS) != next_boot_status ||
+      EEPROM.read(EEPROM_FLASH_SIZE) != ((firmware_size>>8) & 0xFF) ||
+      EEPROM.read(EEPROM_FLASH_SIZE+1) != (firmware_size & 0xFF)) {
+    return false;
+  }
+  for (i = 0; i < 4; i++) {
+    if (EEPROM.read(EEPROM_FLASH_IMAGE_ID+i) != image_id[i]) {
+      return false;
+    }
+  }
+
+  firmware_written = 0;
+  for (i = 0; i < RIOTS_CHECKPOINT_SIZE; i++) {
+    staged_pages[i] = EEPROM.read(EEPROM_FLASH_PAGES+i);
+  }
+  for (page = 0; page < RIOTS_IMAGE_PAGES; page++) {
+    if ( bitRead(staged_pages[page/8], page%8) ) {
+      firmware_written += I2C_EEPROM_PAGE_SIZE;
+    }
+  }
+  checkpoint = true;
+  return true;
+}
+
+/**
+ * Marks the page as written in the checkpoint.
+ *
+ * @param page        Index of the page in the image
+ */
+void Riots_Flash::checkpointPage(uint16_t page) {
+  uint8_t bits;
+
+  if ( !checkpoint || page >= RIOTS_IMAGE_PAGES ) {
+    return;
+  }
+  bits = EEPROM.read(EEPROM_FLASH_PAGES + page/8);
+  if ( !bitRead(bits, page%8) ) {
+    bitSet(bits, page%8);
+    EEPROM.write(EEPROM_FLASH_PAGES + page/8, bits);
+  }
+}
+
+/**
+ * Removes the checkpoint, the next transfer starts from the beginning.
+ */
+void Riots_Flash::clearCheckpoint() {
+  if (EEPROM.read(EEPROM_FLASH_STATUS) != RIOTS_EMPTY) {
+    EEPROM.write(EEPROM_FLASH_STATUS, RIOTS_EMPTY);
+  }
+  written_page = RIOTS_NO_PAGE;
+  checkpoint = false;
+}
+
+/**
+ * Checks if the packet of the current page has already been received.
+ *
+ * @param packet      Index of the packet
+ * @return bool       True, if the packet has been received
+ */
+bool Riots_Flash::isPacketReceived(uint8_t packet) {
+  if ( received_packets != 0 && page_stream ) {
+    return packet < packet_counter;
+  }
+  return packet < RIOTS_PAGE_BITMAP_SIZE && bitRead(received_packets, packet);
+}
+
+/**
+ * Copies or decompresses the data of a page packet to the flash buffer.
+ * Packets are appended in order, or with RIOTS_FLASH_CAP_SLICES raw packets
+ * go to their own slice of the page in any order.
+ *
+ * @param type        TYPE_PROG_PAGE for raw data, TYPE_PROG_PAGE_LZ for Riots_Lz tokens
+ *                    or TYPE_PROG_PAGE_DELTA for patch tokens
+ * @param packet      Index of the packet
+ * @param data        Data of the packet
+ * @param length      Length of the data
+ * @return bool       True, if the data was valid and fit to the page
+ */
+bool Riots_Flash::storePageData(uint8_t type, uint8_t packet, uint8_t *data, uint8_t length) {
+  uint8_t offset, expected;
+
+  if ( type != TYPE_PROG_PAGE || !(flash_caps & RIOTS_FLASH_CAP_SLICES) ) {
+    if ( packet != packet_counter ) {
+      return false;
+    }
+    if ( type == TYPE_PROG_PAGE_LZ ) {
+      if ( !Riots_Lz::decode(flash_buffer, I2C_EEPROM_PAGE_SIZE, &flashbuffer_index, data, length) ) {
+        return false;
+      }
+    }
+    else if ( type == TYPE_PROG_PAGE_DELTA ) {
+      if ( !applyDelta(data, length) ) {
+        return false;
+      }
+    }
+    else {
+      if ( flashbuffer_index + length > I2C_EEPROM_PAGE_SIZE ) {
+        return false;
+      }
+      memcpy(&flash_buffer[flashbuffer_index], data, length);
+      flashbuffer_index += length;
+    }
+    packet_counter++;
+    return true;
+  }
+
+  if ( packet >= RIOTS_PAGE_PACKETS ) {
+    return false;
+  }
+  offset = packet * RIOTS_PAGE_PACKET_DATA;
+  expected = I2C_EEPROM_PAGE_SIZE - offset;
+  if ( expected > RIOTS_PAGE_PACKET_DATA ) {
+    expected = RIOTS_PAGE_PACKET_DATA;
+  }
+  if ( length != expected ) {
+    return false;
+  }
+  memcpy(&flash_buffer[offset], data, length);
+  // count of the received bytes, page is complete when all the slices are in
+  flashbuffer_index += length;
+  return true;
+}
+
+/**
+ * Applies the patch tokens of a page packet to the flash buffer, copying
+ * the unchanged parts from the official image in the I2C EEPROM.
+ * Buffer index is updated only if all the tokens were valid.
+ *
+ * @param data        Patch tokens
+ * @param length      Length of the tokens
+ * @return bool       True, if the tokens were valid and fit to the page
+ */
+bool Riots_Flash::applyDelta(uint8_t *data, uint8_t length) {
+  uint8_t index = flashbuffer_index;
+  uint8_t i = 0;
+  uint8_t count;
+  uint16_t source;
+
+  while ( i < length ) {
+    if ( data[i] & RIOTS_DELTA_COPY ) {
+      if ( i + RIOTS_DELTA_COPY_LEN > length ) {
+        // truncated copy
+        return false;
+      }
+      count  = (data[i] & ~RIOTS_DELTA_COPY) + 1;
+      source = (data[i+1]<<8) | data[i+2];
+      i += RIOTS_DELTA_COPY_LEN;
+
+      if ( count > I2C_EEPROM_PAGE_SIZE - index || source > RIOTS_IMAGE_MAX_SIZE - count ) {
+        return false;
+      }
+      riots_memory.readBlock(I2C_EEPROM_O_FW + source, &flash_buffer[index], count, RIOTS_PRIMARY_EEPROM);
+    }
+    else {
+      count = data[i] + 1;
+      i++;
+
+      if ( count > length - i || count > I2C_EEPROM_PAGE_SIZE - index ) {
+        return false;
+      }
+      memcpy(&flash_buffer[index], &data[i], count);
+      i += count;
+    }
+    index += count;
+  }
+
+  flashbuffer_index = index;
+  return true;
+}
+
+/**
+ * Verifies the written image against the CRC32 given by the cloud. The CRC
+ * collected while the pages were received is checked first, then the image
+ * is read back from the I2C EEPROM to catch failed writes.
+ *
+ * @param expected_crc  CRC32 of the whole image
+ * @return bool         True, if the image is intact
+ */
+bool Riots_Flash::verifyImage(uint32_t expected_crc) {
+  uint32_t crc = RIOTS_CRC32_INIT;
+  uint16_t offset;
+
+  if ( crc_in_order && ~image_crc != expected_crc ) {
+    _DEBUG_PRINTLN(F(" received data does not match"));
+    return false;
+  }
+
+  // flash_buffer is free, as the last page has been written
+  for (offset = 0; offset < firmware_size; offset += I2C_EEPROM_PAGE_SIZE) {
+    riots_memory.readBlock(i2c_offset + offset, flash_buffer, I2C_EEPROM_PAGE_SIZE, RIOTS_PRIMARY_EEPROM);
+    crc = updateCrc(crc, flash_buffer, I2C_EEPROM_PAGE_SIZE);
+  }
+
+  return ~crc == expected_crc;
+}
+
+/**
+ * Updates CRC32 with the given data. Bitwise, to keep the lookup table out of RAM and flash.
+ *
+ * @param crc         CRC so far, RIOTS_CRC32_INIT to start
+ * @param data        Data to be added
+ * @param length      Length of the data
+ * @return uint32_t   Updated CRC, inverted bits give the final value
+ */
+uint32_t Riots_Flash::updateCrc(uint32_t crc, const uint8_t *data, uint16_t length) {
+  uint8_t bit;
+
+  while ( length-- ) {
+    crc ^= *data++;
+    for (bit = 0; bit < 8; bit++) {
+      if ( crc & 1 ) {
+        crc = (crc >> 1) ^ RIOTS_CRC32_POLY;
+      }
+      else {
+        crc >>= 1;
+      }
+    }
+  }
+  return crc;
+}
+
+/**
+ * Writes the completed page to the EEPROM, if one is waiting. Called from the
+ * radio update loop, so the write overlaps with receiving the next page.
+ */
+void Riots_Flash::update() {
+  if ( pending_buffer != NULL ) {
+    writeEepromPage();
+    pending_buffer = NULL;
+  }
+  else if ( written_page != RIOTS_NO_PAGE && riots_memory.isWriteDone(RIOTS_PRIMARY_EEPROM) ) {
+    checkpointPage(written_page);
+    written_page = RIOTS_NO_PAGE;
+  }
+}
+
+/**
+ * Hands the completed page over to update() and continues receiving to the
+ * other page buffer.
+ */
+void Riots_Flash::queuePage() {
+  // Previous page still waiting, write it now
+  update();
+
+  pending_buffer  = flash_buffer;
+  pending_address = page_address;
+  flash_buffer    = (flash_buffer == page_buffers[0]) ? page_buffers[1] : page_buffers[0];
+}
+
+/**
+ * Writes the waiting page to the EEPROM. Write cycle of the EEPROM runs in
+ * the background, Riots_Memory waits for it only on the next access.
  *
  */
 void Riots_Flash::writeEepromPage() {
   _DEBUG_PRINTLN(F("Write page to EEPROM"));
 
+  // Write cycle of the previous page ends before the next one starts
+  riots_memory.waitWriteCycle(RIOTS_PRIMARY_EEPROM);
+  if ( written_page != RIOTS_NO_PAGE ) {
+    checkpointPage(written_page);
+    written_page = RIOTS_NO_PAGE;
+  }
+
   /* sanity check */
-  if(page_address >= I2C_EEPROM_O_FW && page_address < I2C_EEPROM_FREE_SPACE) {
-    riots_memory.startPageWrite(page_address, RIOTS_PRIMARY_EEPROM);
-    for(uint8_t i=0; i<I2C_EEPROM_PAGE_SIZE; i++) {
-      riots_memory.pageFill(flash_buffer[i]);
-    }
-    riots_memory.stopPageWrite();
+  if(pending_address >= I2C_EEPROM_O_FW && pending_address < I2C_EEPROM_FREE_SPACE) {
+    riots_memory.writeBlock(pending_address, pending_buffer, I2C_EEPROM_PAGE_SIZE, RIOTS_PRIMARY_EEPROM);
+    written_page = (pending_address - i2c_offset) / I2C_EEPROM_PAGE_SIZE;
+  }
+}
+
+/**
+ * Writes firmware ID and length of the image to be flashed to the I2C EEPROM.
+ *
+ * @param header      Firmware ID (4 bytes) and length (2 bytes) of the image.
+ */
+void Riots_Flash::writeImageHeader(uint8_t *header) {
+  if(next_boot_status==BOOT_LOAD_OFFICIAL) {
+    _DEBUG_PRINTLN(F(" BOOT_LOAD_OFFICIAL"));
+    riots_memory.writeBlock(I2C_EEPROM_O_FW_ID, header, RIOTS_IMAGE_HEADER_LEN, RIOTS_PRIMARY_EEPROM);
+  }
+  else if(next_boot_status==BOOT_LOAD_UNOFFICIAL) {
+    _DEBUG_PRINTLN(F(" BOOT_LOAD_UNOFFICIAL"));
+    riots_memory.writeBlock(I2C_EEPROM_UO_FW_ID, header, RIOTS_IMAGE_HEADER_LEN, RIOTS_PRIMARY_EEPROM);
   }
 }
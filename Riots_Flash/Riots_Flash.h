@@ -16,22 +16,110 @@
 
 #include "Arduino.h"
 #include "Riots_Memory.h"
+#include "Riots_Helper.h"
+
+#define RIOTS_IMAGE_HEADER_LEN  6   // Firmware ID (4 bytes) and length (2 bytes) in front of the image
+
+/*
+ * Patch tokens of TYPE_PROG_PAGE_DELTA:
+ *
+ *   0x00 - 0x7F  literal run, followed by (token + 1) plain bytes
+ *   0x80 - 0xFF  copy of ((token & 0x7F) + 1) bytes from the official image,
+ *                followed by the 2 byte image offset to copy from
+ *
+ * Pages are written only when complete, so while the official image itself is
+ * being replaced the cloud may refer only to pages not rewritten yet.
+ */
+#define RIOTS_DELTA_COPY        0x80
+#define RIOTS_DELTA_COPY_LEN    3     // Token and image offset
+#define RIOTS_IMAGE_MAX_SIZE    0x6F80
+
+/*
+ * Flash capabilities, requested by the cloud in TYPE_ENTER_PROGMODE. The
+ * confirm tells the ones in use, older nodes reject the longer message and
+ * the cloud falls back to the plain transfer.
+ *
+ * RIOTS_FLASH_CAP_SLICES: raw TYPE_PROG_PAGE packets carry a fixed slice of the
+ * page, packet N holds the bytes starting from N * RIOTS_PAGE_PACKET_DATA and
+ * the last one the rest. The packets may arrive in any order and the page
+ * confirm carries the bitmap of the missing ones. Without it all the packets
+ * are appended in order, so raw, compressed and delta packets can be mixed.
+ */
+#define RIOTS_FLASH_CAP_SLICES  0x01
+#define RIOTS_FLASH_CAPS        (RIOTS_FLASH_CAP_SLICES)  // Capabilities supported
+#define RIOTS_PAGE_PACKET_DATA  12
+#define RIOTS_PAGE_PACKETS      ((I2C_EEPROM_PAGE_SIZE + RIOTS_PAGE_PACKET_DATA - 1) / RIOTS_PAGE_PACKET_DATA)
+#define RIOTS_PAGE_PACKETS_MASK ((1 << RIOTS_PAGE_PACKETS) - 1)
+#define RIOTS_PAGE_BITMAP_SIZE  16    // Packets tracked in the received bitmap
+
+// CRC32 (IEEE 802.3, reflected) of the image, sent big endian in TYPE_LEAVE_PROGMODE
+#define RIOTS_CRC32_INIT        0xFFFFFFFF
+#define RIOTS_CRC32_POLY        0xEDB88320
+
+/*
+ * TYPE_PAGE_HASH carries the index of the first page followed by up to two
+ * page hashes: the CRC32 of the page, big endian. Pages already holding the
+ * right bytes are counted as written and need not be sent.
+ */
+#define RIOTS_PAGE_HASH_SIZE    4
+#define RIOTS_IMAGE_PAGES       (RIOTS_IMAGE_MAX_SIZE / I2C_EEPROM_PAGE_SIZE)
+
+/*
+ * Transfer checkpoint in the internal EEPROM. TYPE_PROG_FLASH with an image ID
+ * starts the checkpoint, or resumes it when the ID, size and boot status match.
+ * A page is marked only after its EEPROM write cycle has ended, so the bitmap
+ * never claims a page which is not in the I2C EEPROM.
+ */
+#define RIOTS_CHECKPOINT_SIZE   ((RIOTS_IMAGE_PAGES + 7) / 8)
+#define RIOTS_NO_PAGE           0xFFFF
 
 class Riots_Flash {
   public:
     uint8_t handleFlashMessage(uint8_t type, uint8_t *plain, bool *response_needed);
     uint8_t setup();
+    void update();
+    uint8_t addConfirmData(uint8_t message_type, uint8_t *data);
   private:
 
+    uint16_t getMissingPackets();
+    uint16_t getNeededPages();
+    uint16_t getResumePage();
+
     void writeEepromPage ();
+    void queuePage();
+    void writeImageHeader(uint8_t *header);
+    bool storePageData(uint8_t type, uint8_t packet, uint8_t *data, uint8_t length);
+    bool isPacketReceived(uint8_t packet);
+    bool applyDelta(uint8_t *data, uint8_t length);
+    bool verifyImage(uint32_t expected_crc);
+    uint16_t checkPageHashes(uint8_t first_page, uint8_t *hashes, uint8_t count);
+    uint16_t findMissingPages(uint8_t first_page);
+    bool stagePage(uint16_t page);
+    void startCheckpoint(uint8_t *image_id);
+    bool resumeCheckpoint(uint8_t *image_id);
+    void checkpointPage(uint16_t page);
+    void clearCheckpoint();
+    static uint32_t updateCrc(uint32_t crc, const uint8_t *data, uint16_t length);
     uint16_t page_address;              /*!< Address of page to write next                                                        */
     uint16_t page_address_previous;     /*!< Address of previously written page                                                   */
     uint16_t i2c_offset;                /*!< Address offset (depending on do we write official or unofficial image                */
-    uint8_t flash_buffer[128];          /*!< Buffer to store data to be written to EEPROM                                         */
+    uint8_t page_buffers[2][I2C_EEPROM_PAGE_SIZE]; /*!< Page being received and page waiting to be written                       */
+    uint8_t *flash_buffer;              /*!< Buffer to store data to be written to EEPROM, one of page_buffers                    */
+    uint8_t *pending_buffer;            /*!< Completed page waiting to be written by update(), NULL if none                       */
+    uint16_t pending_address;           /*!< EEPROM address of the page waiting to be written                                     */
     uint16_t firmware_size;             /*!< Size of the firmware image to be written to EEPROM                                   */
     uint16_t firmware_written;          /*!< Amount of uint8_ts to written to EEPROM                                              */
+    uint32_t image_crc;                 /*!< CRC32 of the pages written so far, valid while written in order                      */
+    bool crc_in_order;                  /*!< Pages have been written in address order, so image_crc covers the image              */
+    uint8_t staged_pages[RIOTS_CHECKPOINT_SIZE]; /*!< Pages written or found up to date in the staged image                  */
+    uint16_t written_page;              /*!< Page in the EEPROM write cycle, checkpointed when done, RIOTS_NO_PAGE if none        */
+    bool checkpoint;                    /*!< Transfer progress is saved to the internal EEPROM                                    */
+    uint16_t needed_pages;              /*!< Pages needed after TYPE_PAGE_HASH or TYPE_MISSING_PAGES, bit 0 for its first page    */
     uint8_t packet_counter;             /*!< Index of next packet to be received with STK_PROG_PAGE                               */
-    uint8_t flashbuffer_index;          /*!< Index of uint8_t to be copied to flash_buffer                                        */
+    uint8_t flashbuffer_index;          /*!< Index of uint8_t to be copied to flash_buffer, count of bytes received for raw pages */
+    uint16_t received_packets;          /*!< Bitmap of the packets received for the current page                                  */
+    uint8_t flash_caps;                 /*!< Flash capabilities agreed in TYPE_ENTER_PROGMODE                                     */
+    bool page_stream;                   /*!< Current page is received in packet order, not as slices                              */
     uint8_t next_boot_status;           /*!< Tells what will be the next boot mode (BOOT_LOAD_OFFICIAL, _UNOFFICIAL OR _FAILSAFE) */
     uint8_t eeprom_status;              /*!< Status of external EEPROM (connected or not)                                         */
     bool reported;                      /*!< Do we have already reported status of the package to the cloud                       */
@@ -0,0 +1,272 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "aes.h"
+#include "Riots_Envelope.h"
+
+/**
+ * Starts a session with a new session key. Counters start from zero, so the
+ * key must not be used in an earlier session.
+ *
+ * @param session_key             AES128 session key, kept by the caller for the session.
+ */
+void Riots_Envelope::startSession(uint8_t* session_key) {
+  key        = session_key;
+  tx_counter = 0;
+  rx_counter = 0;
+}
+
+/**
+ * Starts a new envelope to the given buffer.
+ *
+ * @param frame_buffer            Buffer for the whole frame, including the header.
+ * @param buffer_size             Size of the buffer.
+ * @param operation               Operation byte written to the frame header.
+ */
+void Riots_Envelope::begin(uint8_t* frame_buffer, uint8_t buffer_size, uint8_t operation) {
+  buffer = frame_buffer;
+  size   = buffer_size;
+  if ( size > RIOTS_ENVELOPE_MAX_SIZE ) {
+    size = RIOTS_ENVELOPE_MAX_SIZE;
+  }
+
+  buffer[1] = operation;
+  buffer[2] = RIOTS_ENVELOPE_VERSION;
+  buffer[3] = 0; // record count
+  // counter is written when sealing
+  used = RIOTS_ENVELOPE_HEADER_SIZE + RIOTS_ENVELOPE_INFO_SIZE;
+}
+
+/**
+ * Checks if a record still fits to the envelope after padding and MAC.
+ *
+ * @param value_length            Length of the record value.
+ * @return bool                   True if the record fits
+ */
+bool Riots_Envelope::fits(uint8_t value_length) {
+  uint16_t needed = used + RIOTS_ENVELOPE_RECORD_HEADER + value_length;
+
+  if ( needed > size ) {
+    return false;
+  }
+  return sealedLength(needed) <= size;
+}
+
+/**
+ * Adds a TLV record to the envelope.
+ *
+ * @param type                    Type of the record.
+ * @param value                   Value of the record, can be NULL if length is 0.
+ * @param value_length            Length of the value.
+ * @return bool                   True if the record was added
+ */
+bool Riots_Envelope::addRecord(uint8_t type, const uint8_t* value, uint8_t value_length) {
+  if ( !fits(value_length) ) {
+    return false;
+  }
+  buffer[used++] = type;
+  buffer[used++] = value_length;
+  if ( value_length > 0 ) {
+    memcpy(buffer+used, value, value_length);
+    used += value_length;
+  }
+  buffer[3]++;
+  return true;
+}
+
+/**
+ * Pads the envelope, adds the counter and the MAC and crypts it in place.
+ *
+ * @return uint8_t                Length of the sealed frame, including the header
+ */
+uint8_t Riots_Envelope::seal() {
+  uint8_t total = sealedLength(used);
+  uint8_t derived[RIOTS_ENVELOPE_BLOCK_SIZE];
+  uint8_t mac[RIOTS_ENVELOPE_BLOCK_SIZE];
+  uint8_t i;
+
+  tx_counter++;
+  for (i = 0; i < 4; i++) {
+    buffer[RIOTS_ENVELOPE_COUNTER_OFFSET+i] = (uint8_t)(tx_counter >> (24 - 8*i));
+  }
+  buffer[0] = total - 1; // length - this value
+
+  // zero padding, MAC is calculated with the MAC bytes zeroed
+  memset(buffer+used, 0, total-used);
+  deriveKey(RIOTS_ENVELOPE_MAC_LABEL, derived);
+  calcMac(buffer, total, derived, mac);
+  memcpy(buffer+total-RIOTS_ENVELOPE_MAC_SIZE, mac, RIOTS_ENVELOPE_MAC_SIZE);
+
+  deriveKey(RIOTS_ENVELOPE_CRYPT_LABEL, derived);
+  for (i = RIOTS_ENVELOPE_HEADER_SIZE; i < total; i += RIOTS_ENVELOPE_BLOCK_SIZE) {
+    AES128_ECB_encrypt(buffer+i, derived, buffer+i);
+  }
+  memset(derived, 0, sizeof(derived));
+
+  used = total;
+  return total;
+}
+
+/**
+ * Returns the count of bytes used in the frame buffer.
+ *
+ * @return uint8_t                Length of the frame
+ */
+uint8_t Riots_Envelope::length() {
+  return used;
+}
+
+/**
+ * Returns the count of records in the envelope.
+ *
+ * @return uint8_t                Count of records
+ */
+uint8_t Riots_Envelope::records() {
+  return buffer[3];
+}
+
+/**
+ * Decrypts a sealed envelope in place and verifies its MAC and counter.
+ *
+ * @param frame                   Whole frame, including the header.
+ * @param frame_length            Length of the frame.
+ * @return bool                   True if the envelope is valid and not a replay
+ */
+bool Riots_Envelope::open(uint8_t* frame, uint8_t frame_length) {
+  uint8_t received[RIOTS_ENVELOPE_MAC_SIZE];
+  uint8_t derived[RIOTS_ENVELOPE_BLOCK_SIZE];
+  uint8_t mac[RIOTS_ENVELOPE_BLOCK_SIZE];
+  uint32_t counter = 0;
+  uint8_t i;
+
+  if ( frame_length < RIOTS_ENVELOPE_HEADER_SIZE + RIOTS_ENVELOPE_BLOCK_SIZE ||
+       (frame_length - RIOTS_ENVELOPE_HEADER_SIZE) % RIOTS_ENVELOPE_BLOCK_SIZE != 0 ||
+       frame[0] != frame_length - 1 ) {
+    return false;
+  }
+
+  deriveKey(RIOTS_ENVELOPE_CRYPT_LABEL, derived);
+  for (i = RIOTS_ENVELOPE_HEADER_SIZE; i < frame_length; i += RIOTS_ENVELOPE_BLOCK_SIZE) {
+    AES128_ECB_decrypt(frame+i, derived, frame+i);
+  }
+
+  memcpy(received, frame+frame_length-RIOTS_ENVELOPE_MAC_SIZE, RIOTS_ENVELOPE_MAC_SIZE);
+  memset(frame+frame_length-RIOTS_ENVELOPE_MAC_SIZE, 0, RIOTS_ENVELOPE_MAC_SIZE);
+  deriveKey(RIOTS_ENVELOPE_MAC_LABEL, derived);
+  calcMac(frame, frame_length, derived, mac);
+  memset(derived, 0, sizeof(derived));
+
+  if ( memcmp(received, mac, RIOTS_ENVELOPE_MAC_SIZE) != 0 || frame[2] != RIOTS_ENVELOPE_VERSION ) {
+    return false;
+  }
+
+  for (i = 0; i < 4; i++) {
+    counter = (counter << 8) | frame[RIOTS_ENVELOPE_COUNTER_OFFSET+i];
+  }
+  if ( counter <= rx_counter ) {
+    // replayed or reordered envelope
+    return false;
+  }
+  rx_counter = counter;
+  return true;
+}
+
+/**
+ * Iterates the records of an opened envelope.
+ *
+ * Set offset to 0 before the first call. Padding ends the records, as zero is
+ * not a valid record type.
+ *
+ * @param frame                   Opened frame, including the header.
+ * @param offset                  Iteration state, updated by the call.
+ * @param type                    Type of the record.
+ * @param value_length            Length of the record value.
+ * @param value                   Pointer to the record value inside the frame.
+ * @return bool                   True if a record was found
+ */
+bool Riots_Envelope::nextRecord(uint8_t* frame, uint8_t* offset, uint8_t* type, uint8_t* value_length, uint8_t** value) {
+  uint16_t end = frame[0] + 1 - RIOTS_ENVELOPE_MAC_SIZE;
+  uint16_t pos = *offset;
+
+  if ( pos == 0 ) {
+    pos = RIOTS_ENVELOPE_HEADER_SIZE + RIOTS_ENVELOPE_INFO_SIZE;
+  }
+
+  if ( pos + RIOTS_ENVELOPE_RECORD_HEADER > end || frame[pos] == 0 ) {
+    return false;
+  }
+  if ( pos + RIOTS_ENVELOPE_RECORD_HEADER + frame[pos+1] > end ) {
+    // truncated record
+    return false;
+  }
+
+  *type         = frame[pos];
+  *value_length = frame[pos+1];
+  *value        = frame+pos+RIOTS_ENVELOPE_RECORD_HEADER;
+  *offset       = pos + RIOTS_ENVELOPE_RECORD_HEADER + frame[pos+1];
+  return true;
+}
+
+/**
+ * Calculates the length of the sealed envelope.
+ *
+ * @param used                    Count of bytes used, including the header.
+ * @return uint8_t                Length after padding and MAC
+ */
+uint8_t Riots_Envelope::sealedLength(uint8_t used) {
+  uint16_t body = used - RIOTS_ENVELOPE_HEADER_SIZE + RIOTS_ENVELOPE_MAC_SIZE;
+
+  body = (body + RIOTS_ENVELOPE_BLOCK_SIZE - 1) / RIOTS_ENVELOPE_BLOCK_SIZE * RIOTS_ENVELOPE_BLOCK_SIZE;
+  return body + RIOTS_ENVELOPE_HEADER_SIZE;
+}
+
+/**
+ * Derives a key of the envelope from the session key.
+ *
+ * @param label                   RIOTS_ENVELOPE_CRYPT_LABEL or RIOTS_ENVELOPE_MAC_LABEL.
+ * @param derived                 Result, a full block.
+ */
+void Riots_Envelope::deriveKey(uint8_t label, uint8_t* derived) {
+  uint8_t block[RIOTS_ENVELOPE_BLOCK_SIZE];
+
+  memset(block, 0, RIOTS_ENVELOPE_BLOCK_SIZE);
+  block[0] = label;
+  AES128_ECB_encrypt(block, key, derived);
+}
+
+/**
+ * Calculates CBC-MAC over the frame header and the plain blocks. The header
+ * is the first block of the MAC, zero padded.
+ *
+ * @param frame                   Frame with plain blocks, including the header.
+ * @param length                  Length of the frame.
+ * @param mac_key                 AES128 key of the MAC.
+ * @param mac                     Result, a full block.
+ */
+void Riots_Envelope::calcMac(uint8_t* frame, uint8_t length, uint8_t* mac_key, uint8_t* mac) {
+  uint8_t i, j;
+
+  memset(mac, 0, RIOTS_ENVELOPE_BLOCK_SIZE);
+  mac[0] = frame[0];
+  mac[1] = frame[1];
+  AES128_ECB_encrypt(mac, mac_key, mac);
+  for (i = RIOTS_ENVELOPE_HEADER_SIZE; i < length; i += RIOTS_ENVELOPE_BLOCK_SIZE) {
+    for (j = 0; j < RIOTS_ENVELOPE_BLOCK_SIZE; j++) {
+      mac[j] ^= frame[i+j];
+    }
+    AES128_ECB_encrypt(mac, mac_key, mac);
+  }
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef Riots_Envelope_h
+#define Riots_Envelope_h
+
+#include <stdint.h>
+
+/*
+ * Envelope frame of the cloud protocol version 2:
+ *
+ *   [length][operation][ version | record count | counter | records... | padding | MAC ]
+ *                      `------------------ AES128 ECB crypted blocks -----------------'
+ *
+ * Every record is a TLV: [type][length][value...]. Padding is zeros and the
+ * last 4 bytes of the last block hold a truncated CBC-MAC. The MAC covers a
+ * first block with the length and operation bytes followed by the plain
+ * blocks, so neither the header nor the records can be changed.
+ *
+ * Counter is 32 bits, big endian, and grows with every sealed envelope of the
+ * session. Envelopes with a counter not above the last opened one are
+ * rejected as replays.
+ *
+ * The session key is not used as such: crypting and MAC have their own keys,
+ * derived by crypting a label block with the session key.
+ *
+ * This file depends only on aes.h, so the same encoder and decoder can be
+ * built on the cloud server side.
+ */
+#define RIOTS_ENVELOPE_VERSION        0x02
+#define RIOTS_ENVELOPE_BLOCK_SIZE     16
+#define RIOTS_ENVELOPE_HEADER_SIZE    2   // frame length and operation
+#define RIOTS_ENVELOPE_INFO_SIZE      6   // version, record count and counter
+#define RIOTS_ENVELOPE_COUNTER_OFFSET 4   // counter in the frame, after version and record count
+#define RIOTS_ENVELOPE_RECORD_HEADER  2   // record type and length
+#define RIOTS_ENVELOPE_MAC_SIZE       4
+#define RIOTS_ENVELOPE_MAX_SIZE       242 // length byte limits the envelope to 15 blocks
+#define RIOTS_ENVELOPE_CRYPT_LABEL    0x01 // label block of the crypting key
+#define RIOTS_ENVELOPE_MAC_LABEL      0x02 // label block of the MAC key
+
+// Envelope record types
+#define RIOTS_RECORD_KEEP_ALIVE       0x01
+#define RIOTS_RECORD_DATA_POST        0x02
+#define RIOTS_RECORD_SAVED_DATA_POST  0x03
+#define RIOTS_RECORD_STATS            0x04
+#define RIOTS_RECORD_RELAY_CREDIT     0x05
+
+class Riots_Envelope {
+  public:
+    void startSession(uint8_t* session_key);
+    void begin(uint8_t* frame_buffer, uint8_t buffer_size, uint8_t operation);
+    bool fits(uint8_t value_length);
+    bool addRecord(uint8_t type, const uint8_t* value, uint8_t value_length);
+    uint8_t seal();
+    uint8_t length();
+    uint8_t records();
+    bool open(uint8_t* frame, uint8_t frame_length);
+
+    static bool nextRecord(uint8_t* frame, uint8_t* offset, uint8_t* type, uint8_t* value_length, uint8_t** value);
+
+  private:
+    uint8_t* buffer;              /*!< Frame buffer, including the plain frame header                                */
+    uint8_t size;                 /*!< Size of the frame buffer                                                      */
+    uint8_t used;                 /*!< Count of bytes used in the frame buffer                                       */
+    uint8_t* key;                 /*!< Session key, the envelope keys are derived from it                            */
+    uint32_t tx_counter;          /*!< Counter of the last sealed envelope                                           */
+    uint32_t rx_counter;          /*!< Counter of the last opened envelope                                           */
+
+    void deriveKey(uint8_t label, uint8_t* derived);
+    static uint8_t sealedLength(uint8_t used);
+    static void calcMac(uint8_t* frame, uint8_t length, uint8_t* mac_key, uint8_t* mac);
+};
+
+#endif // Riots_Envelope_h
@@ -0,0 +1,43 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef Riots_Hal_h
+#define Riots_Hal_h
+
+/*
+ * Hardware access of the Riots libraries outside the Arduino API: watchdog,
+ * sleep, program memory, TWI and the few registers written directly.
+ *
+ * AVR builds use avr-libc. Other builds get the same names from
+ * Riots_HostHal.h, which the host build in host/ provides together with its
+ * Arduino API shims and simulated devices.
+ */
+#if defined(__AVR__)
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <util/twi.h>
+
+#define RIOTS_ADC_DISABLE()           (ADCSRA = 0)              // AD converter off before sleeping
+#define RIOTS_WDT_INTERRUPT_ENABLE()  (WDTCSR |= (1 << WDIE))   // Watchdog wakes up from sleep instead of resetting
+
+#else
+
+#include "Riots_HostHal.h"
+
+#endif
+
+#endif // Riots_Hal_h
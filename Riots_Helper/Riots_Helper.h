@@ -42,9 +42,18 @@
 #define PREV_BASE_ID            0x034C  // 4 bytes
 
 #define EEPROM_SLEEP_ENABLED    0x03B8  // 1 byte
+#define EEPROM_GROUP_ADDR       0x03BC  // 4 bytes
+
+// Checkpoint of the firmware transfer, survives resets during the transfer
+#define EEPROM_FLASH_IMAGE_ID   0x03C0  // 4 bytes
+#define EEPROM_FLASH_SIZE       0x03C4  // 2 bytes
+#define EEPROM_FLASH_STATUS     0x03C6  // 1 byte, boot status of the image, RIOTS_EMPTY if none
+#define EEPROM_FLASH_PAGES      0x03C8  // 28 bytes, bitmap of the pages written
 
 #define EEPROM_AES_CHANGING     0x0350  // 16 bytes
 #define EEPROM_AES_OLD          0x0360  // 16 bytes
+#define EEPROM_AES_GROUP        0x0370  // 16 bytes
+#define EEPROM_GROUP_SEQUENCE   0x0380  // 2 bytes, last group sequence number accepted
 
 #define EEPROM_CORE_INDEX       0x03A0  // 8 bytes
 #define EEPROM_IO_INDEX         0x03A8  // 1 byte
@@ -92,6 +101,17 @@
 
 #define MAGIC_ADDRESS_BYTE      0x42
 
+// Group radio addresses start with this byte, frames to them are sent without ACK
+#define RIOTS_GROUP_ADDRESS_MARK 0xEE
+#define RIOTS_GROUP_PIPE        1
+
+// Indexes of the decrypt failure counters
+#define RIOTS_STATS_SHARED_KEY  0
+#define RIOTS_STATS_UNIQUE_KEY  1
+#define RIOTS_STATS_GROUP_KEY   2
+#define RIOTS_STATS_OTHER_KEY   3   // any other key, e.g. a key update not activated yet
+#define RIOTS_STATS_KEY_COUNT   4
+
 #define M_TYPE                  0x0
 #define M_LENGTH                0x1
 #define M_VALUE                 0x2
@@ -101,17 +121,31 @@
 #define M_CHILD_ID              0xD
 #define M_LAST_DIGIT            0xF
 
-// Retry values
+// Retry values, these can be tuned from the build flags for ring sizing experiments
+#ifndef BABY_RADIO_RETRY_COUNT
 #define BABY_RADIO_RETRY_COUNT  4
+#endif
+#ifndef BABY_RADIO_RETRY_TIME
 #define BABY_RADIO_RETRY_TIME   38
+#endif
+#ifndef MAMA_RETRY_COUNT
 #define MAMA_RETRY_COUNT        4
+#endif
+#ifndef MAX_SKIPPED_RING_EVENTS
 #define MAX_SKIPPED_RING_EVENTS 8
+#endif
 
+#ifndef RIOTS_DELAY_MIN
 #define RIOTS_DELAY_MIN         7
+#endif
+#ifndef RIOTS_DELAY_MAX
 #define RIOTS_DELAY_MAX         23
+#endif
 
 // Max. radio airtime is 5.2ms, this is to check that no hangup happens
+#ifndef MAX_RADIO_AIRTIME
 #define MAX_RADIO_AIRTIME       100
+#endif
 
 // Default pins for Core v06
 #define RIOTS_IRQ_PIN           2
@@ -138,6 +172,7 @@
 #define TYPE_MAMA_ADDRESS     0x32
 #define TYPE_DEBUG_ADDRESS    0x33
 #define TYPE_CHILD_ADDRESS    0x34
+#define TYPE_GROUP_ADDRESS    0x35
 
 #define TYPE_SET_BATTERY_OP   0x36
 
@@ -146,6 +181,8 @@
 
 #define TYPE_AES_USAGE        0x42
 #define TYPE_CHILD_ID         0x43
+#define TYPE_GROUP_KEY_PART1  0x44
+#define TYPE_GROUP_KEY_PART2  0x45
 
 #define TYPE_CONFIRM_CONFIG   0x49
 #define TYPE_CORE_NOT_REACHED 0x4A
@@ -153,8 +190,12 @@
 #define TYPE_ENTER_PROGMODE   0x50
 #define TYPE_LEAVE_PROGMODE   0x51
 #define TYPE_LOAD_ADDRESS     0x55
+#define TYPE_PAGE_HASH        0x56  // hashes of the pages to be flashed, reply tells the pages needed
+#define TYPE_MISSING_PAGES    0x57  // reply tells the pages not received, after a group update
 #define TYPE_PROG_FLASH       0x60
 #define TYPE_PROG_PAGE        0x64
+#define TYPE_PROG_PAGE_LZ     0x65  // page data as Riots_Lz tokens
+#define TYPE_PROG_PAGE_DELTA  0x66  // page data as a patch against the official image
 
 #define TYPE_INIT_AES_PART1   0x72
 #define TYPE_INIT_AES_PART2   0x73
@@ -171,6 +212,17 @@
 #define INIT_STATUS_LEN       0x8
 #define INIT_IDS_LEN          0x8
 #define CONFIRM_CONFIG_LEN    0x2
+#define CONFIRM_PAGE_LEN      0x4   // Confirm with a flash bitmap or page index, see Riots_Flash::addConfirmData
+#define ENTER_PROGMODE_LEN    0x1   // Boot status
+#define ENTER_PROGMODE_CAPS_LEN 0x2 // Boot status and the flash capabilities requested by the cloud
+#define LEAVE_PROGMODE_LEN    0x4   // Firmware ID
+#define LEAVE_PROGMODE_CRC_LEN 0x8  // Firmware ID and CRC32 of the image
+#define PROG_FLASH_LEN        0x2   // Firmware size
+#define PROG_FLASH_RESUME_LEN 0x6   // Firmware size and image ID, resumes a transfer of the same image
+#define PAGE_HASH_MIN_LEN     0x5   // First page index and one hash
+#define PAGE_HASH_MAX_LEN     0x9   // First page index and two hashes
+#define MISSING_PAGES_LEN     0x1   // First page index
+#define GROUP_LOAD_ADDRESS_LEN 0x4  // Page address and group sequence number, TYPE_LOAD_ADDRESS sent to a group
 #define IM_ALIVE_NO_BASE_LEN  0x4
 #define IM_ALIVE_LEN          0x8
 #define CORE_NOT_REACHED_LEN  0x4
@@ -273,6 +325,7 @@
 
 #define CELLULAR_CONNECTION_RETRY_TIME        60000
 
+#if defined(__AVR__)
 /* Converts Arduino pin to right AVR PORT */
 #define __pinToPort(P) \
 (((P) <= 7) ? &PORTD : (((P) <= 13) ? &PORTB : &PORTC))
@@ -291,6 +344,11 @@
 
 #define digitalWriteFast(P, V) bitWrite(*__pinToPort(P), __pinToBit(P), (V));
 #define pinModeFast(P, V) bitWrite(*__pinToDDR(P), __pinToBit(P), (V));
+#else
+/* Other targets, e.g. a host build against Arduino API shims, use the portable calls */
+#define digitalWriteFast(P, V) digitalWrite((P), (V));
+#define pinModeFast(P, V) pinMode((P), (V));
+#endif
 
 
 #ifndef RIOTS_RADIO_DEBUG
@@ -308,6 +366,16 @@
   // #define RIOTS_FLASH_MODE
 #endif
 
+#ifndef RIOTS_PROFILE
+  // uncomment following to collect hot path timings, see Riots_Profile.h
+  // #define RIOTS_PROFILE
+#endif
+
+#ifndef RIOTS_BMP280_FLOAT_COMPENSATION
+  // uncomment following to use the floating point BMP280 compensation instead of the integer one
+  // #define RIOTS_BMP280_FLOAT_COMPENSATION
+#endif
+
 // RIOTS_DEBUG_TYPE_DEFINED flasg is for use using correct tracing for Serial Mama
 #ifndef RIOTS_DEBUG_TYPE_DEFINED
 #define RIOTS_DEBUG_TYPE_DEFINED
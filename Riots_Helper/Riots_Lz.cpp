@@ -0,0 +1,159 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include "Riots_Lz.h"
+
+/**
+ * Decodes the tokens of one frame to the page buffer.
+ *
+ * The page index is updated only if all the tokens were valid, so a frame
+ * can be received again after a failure.
+ *
+ * @param page                    Page buffer, also the window of the matches.
+ * @param page_size               Size of the page.
+ * @param page_index              Count of bytes already decoded to the page, updated by the call.
+ * @param tokens                  Tokens of the frame.
+ * @param length                  Length of the tokens.
+ * @return bool                   True if the tokens were valid and fit to the page
+ */
+bool Riots_Lz::decode(uint8_t* page, uint8_t page_size, uint8_t* page_index, const uint8_t* tokens, uint8_t length) {
+  uint8_t out = *page_index;
+  uint8_t i = 0;
+  uint8_t count;
+  uint16_t distance;
+
+  while ( i < length ) {
+    if ( tokens[i] & RIOTS_LZ_MATCH_FLAG ) {
+      if ( i + 1 >= length ) {
+        // truncated match
+        return false;
+      }
+      count    = (tokens[i] & ~RIOTS_LZ_MATCH_FLAG) + RIOTS_LZ_MIN_MATCH;
+      distance = tokens[i+1] + 1;
+      i += 2;
+
+      if ( distance > out || count > page_size - out ) {
+        return false;
+      }
+      // byte by byte, as the match may overlap with the bytes it produces
+      while ( count-- ) {
+        page[out] = page[out-distance];
+        out++;
+      }
+    }
+    else {
+      count = tokens[i] + 1;
+      i++;
+
+      if ( count > length - i || count > page_size - out ) {
+        return false;
+      }
+      memcpy(page+out, tokens+i, count);
+      i   += count;
+      out += count;
+    }
+  }
+
+  *page_index = out;
+  return true;
+}
+
+/**
+ * Encodes whole tokens from the page until the frame is full or the page ends.
+ * Call repeatedly with the same page index until it reaches the page size.
+ *
+ * @param page                    Page to be compressed.
+ * @param page_size               Size of the page.
+ * @param page_index              Count of bytes already encoded, updated by the call.
+ * @param tokens                  Buffer for the tokens of the frame.
+ * @param space                   Size of the token buffer, at least 2 bytes.
+ * @return uint8_t                Length of the tokens written
+ */
+uint8_t Riots_Lz::encode(const uint8_t* page, uint8_t page_size, uint8_t* page_index, uint8_t* tokens, uint8_t space) {
+  uint8_t position = *page_index;
+  uint8_t used = 0;
+  uint8_t run = 0;
+  bool run_open = false;
+  uint8_t count;
+  uint8_t distance;
+
+  while ( position < page_size ) {
+    count = findMatch(page, page_size, position, &distance);
+
+    if ( count >= RIOTS_LZ_MIN_MATCH ) {
+      if ( used + 2 > space ) {
+        break;
+      }
+      tokens[used++] = RIOTS_LZ_MATCH_FLAG | (count - RIOTS_LZ_MIN_MATCH);
+      tokens[used++] = distance - 1;
+      position += count;
+      run_open = false;
+    }
+    else if ( run_open && tokens[run] < RIOTS_LZ_MAX_LITERALS - 1 ) {
+      // extend the current literal run
+      if ( used + 1 > space ) {
+        break;
+      }
+      tokens[run]++;
+      tokens[used++] = page[position++];
+    }
+    else {
+      if ( used + 2 > space ) {
+        break;
+      }
+      run = used;
+      run_open = true;
+      tokens[used++] = 0;
+      tokens[used++] = page[position++];
+    }
+  }
+
+  *page_index = position;
+  return used;
+}
+
+/**
+ * Finds the longest match for the given position from the earlier bytes of the page.
+ *
+ * @param page                    Page to be compressed.
+ * @param page_size               Size of the page.
+ * @param position                Position to be matched.
+ * @param distance                Distance back to the longest match.
+ * @return uint8_t                Length of the longest match, 0 if none
+ */
+uint8_t Riots_Lz::findMatch(const uint8_t* page, uint8_t page_size, uint8_t position, uint8_t* distance) {
+  uint8_t best = 0;
+  uint8_t limit = page_size - position;
+  uint16_t back;
+  uint8_t count;
+
+  if ( limit > RIOTS_LZ_MAX_MATCH ) {
+    limit = RIOTS_LZ_MAX_MATCH;
+  }
+
+  for (back = 1; back <= position && back <= RIOTS_LZ_MAX_DISTANCE; back++) {
+    count = 0;
+    while ( count < limit && page[position-back+count] == page[position+count] ) {
+      count++;
+    }
+    if ( count > best ) {
+      best = count;
+      *distance = back;
+    }
+  }
+  return best;
+}
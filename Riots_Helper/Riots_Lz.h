@@ -0,0 +1,50 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef Riots_Lz_h
+#define Riots_Lz_h
+
+#include <stdint.h>
+
+/*
+ * Token stream of the compressed firmware pages (TYPE_PROG_PAGE_LZ):
+ *
+ *   0x00 - 0x7F  literal run, followed by (token + 1) plain bytes
+ *   0x80 - 0xFF  match, copies ((token & 0x7F) + 3) bytes starting
+ *                (next byte + 1) bytes back from the current position
+ *
+ * Every page is compressed on its own and matches refer only to the bytes of
+ * the same page, so the page buffer itself is the window and decompression
+ * needs no extra RAM. A frame holds only whole tokens, so every frame can be
+ * decoded as soon as it arrives.
+ *
+ * This file has no dependencies, so the same encoder and decoder can be
+ * built on the cloud server side.
+ */
+#define RIOTS_LZ_MATCH_FLAG           0x80
+#define RIOTS_LZ_MIN_MATCH            3
+#define RIOTS_LZ_MAX_MATCH            (0x7F + RIOTS_LZ_MIN_MATCH)
+#define RIOTS_LZ_MAX_LITERALS         0x80
+#define RIOTS_LZ_MAX_DISTANCE         0x100
+
+class Riots_Lz {
+  public:
+    static bool decode(uint8_t* page, uint8_t page_size, uint8_t* page_index, const uint8_t* tokens, uint8_t length);
+    static uint8_t encode(const uint8_t* page, uint8_t page_size, uint8_t* page_index, uint8_t* tokens, uint8_t space);
+
+  private:
+    static uint8_t findMatch(const uint8_t* page, uint8_t page_size, uint8_t position, uint8_t* distance);
+};
+
+#endif // Riots_Lz_h
@@ -15,7 +15,11 @@
 #ifndef RIOTS_MAMADEF_H
 #define RIOTS_MAMADEF_H
 
+#if defined(__AVR__)
+// Port macros below need the AVR registers, rest of the file is plain
+// definitions which can be shared with the cloud server side
 #include <avr/io.h>
+#endif
 // EEPROM INDEX
 
 #define _SET(type,name,bit)       type ## name  |= _BV(bit)
@@ -44,15 +48,45 @@
 // Cloud connection configurations
 #define RIOTS_CLOUD_ADDRESS       "mama.riots.fi"
 #define RIOTS_CLOUD_PORT          8000
-#define PINGING_INTERVAL          20000
-#define CONNECTION_RETRY_TIME     1000
+#define PINGING_INTERVAL          20000     // Keep alive is sent after this long idle time
+#define DHCP_MAINTAIN_INTERVAL    60000     // DHCP lease is checked this often
+#define MAMA_STATS_INTERVAL       600000    // Performance counters are sent to the cloud this often
+#define MAMA_STATS_LEN            36        // Counters of Riots_Stats in the stats record
+#define MAMA_STATS_RECORD_LEN     (MAMA_STATS_LEN + 1) // Counters and their XOR checksum
+#define CONNECTION_RETRY_TIME     1000      // First reconnection backoff
+#define CONNECTION_RETRY_MAX      64000     // Reconnection backoff is doubled up to this limit
+#define CLOUD_ADDRESS_REFRESH     3600000   // Cloud address is resolved again this often, TTL of the answer is not known
+#define CLOUD_CONNECT_TIMEOUT     5000      // Connection attempt is given up if the handshake takes longer
+#define CLOUD_SOURCE_PORT         49152     // First local port of the cloud connections
+#define CLOUD_RESOLVE_FAILURES    4         // Resolve address again after this many failed connections
 #define MAMA_CLOUD_PAUSE          64
+#define MAMA_CLOUD_TX_BUFFER_SIZE 98        // Outgoing frames are coalesced up to this size, holds 6 block envelope
+#define MAMA_CLOUD_TX_DEADLINE    20        // Max time in ms a frame can wait in the TX buffer
+#define MAMA_CLOUD_BLOB_PREFETCH  4         // Count of downlink datablobs decrypted ahead
+#define MAMA_RELAY_CREDIT_STEP    16        // Relay space is returned to the cloud after this many forwarded datablobs
+#define MAMA_RELAY_RETRIES        3         // Failed sends of a relayed datablob before the relay is dropped
 
 // Possible actions for cloud interaction
 
 #define NO_ACTION_REQUIRED        0x00
 #define SET_RADIO_RECEIVER        0x01
 #define FORWARD_DATA              0x02
+#define RELAY_DATA                0x03
+
+// Cloud connection states
+#define CLOUD_STATE_DISCONNECTED  0x00
+#define CLOUD_STATE_CONNECTED     0x01
+#define CLOUD_STATE_CONNECTING    0x02      // CONNECT command given, handshake is polled from update()
+
+// Cloud protocol versions
+#define RIOTS_CLOUD_PROTOCOL_V1   0x01      // One message per frame
+#define RIOTS_CLOUD_PROTOCOL_V2   0x02      // Records in MAC protected envelopes, see Riots_Envelope.h
+
+// Cloud downlink parser states
+#define CLOUD_RX_LENGTH           0x00
+#define CLOUD_RX_OPERATION        0x01
+#define CLOUD_RX_BODY             0x02
+#define CLOUD_RX_SKIP             0x03
 
 // Mama cloud message types
 #define NO_MESSAGE_TO_CLOUD       0x00
@@ -65,6 +99,16 @@
 #define I2C_EEPROM_MAX            64000
 #define I2C_EEPROM_MSG_SIZE       20
 
+/*
+ * Firmware relay staging after the message cache. SERVER_RELAY_POST carries a
+ * receiver block followed by datablobs for that receiver. The cloud may have
+ * I2C_RELAY_BLOBS datablobs in the relay at a time, CLIENT_RELAY_CREDIT gives
+ * back the space of the forwarded or dropped ones.
+ */
+#define I2C_RELAY_START           0xFC00
+#define I2C_RELAY_BLOBS           64        // 1 kB
+#define RELAY_CREDIT_LEN          2         // Freed datablobs and status
+
 enum Riots_Message {
   // possible client messages
   CLIENT_INTRODUCTION           = 0x01,
@@ -73,12 +117,18 @@ enum Riots_Message {
   CLIENT_SAVED_DATA_POST        = 0x04,
   CLIENT_DATA_NOT_RECEIVED      = 0x05,
   KEEP_ALIVE                    = 0x06,
+  CLIENT_PROTOCOL_OFFER         = 0x07,
+  CLIENT_ENVELOPE               = 0x08,
+  CLIENT_STATS_POST             = 0x09,   // sent only as a v2 record, RIOTS_RECORD_STATS
+  CLIENT_RELAY_CREDIT           = 0x0A,
 
   // Possible server initiated messages
   SERVER_VERIFICATION           = 0x21,
   SERVER_DATA_RECEIVER          = 0x22,
   SERVER_DATA_POST              = 0x23,
   SERVER_REQUESTS_INTRODUCTION  = 0x24,
+  SERVER_PROTOCOL_ACCEPT        = 0x25,
+  SERVER_RELAY_POST             = 0x26,
 
   // Debug over serial
   MAMA_SERIAL_DEBUG             = 0xDD,
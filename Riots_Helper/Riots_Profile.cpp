@@ -0,0 +1,72 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Riots_Profile.h"
+
+#ifdef RIOTS_PROFILE
+
+Riots_ProfilePoint Riots_Profile::points[RIOTS_PROFILE_POINTS];
+
+/**
+ * Adds a timing to the profiling point.
+ *
+ * @param point               Index of the profiling point.
+ * @param elapsed             Measured time in microseconds.
+ */
+void Riots_Profile::record(uint8_t point, uint32_t elapsed) {
+  Riots_ProfilePoint *p = &points[point];
+  // min and max saturate, the sum still holds the real time
+  uint16_t timing = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+
+  if ( p->count == 0 || timing < p->min ) {
+    p->min = timing;
+  }
+  if ( timing > p->max ) {
+    p->max = timing;
+  }
+  p->sum += elapsed;
+  p->count++;
+}
+
+/**
+ * Clears all the collected timings.
+ */
+void Riots_Profile::reset() {
+  memset(points, 0, sizeof(points));
+}
+
+/**
+ * Prints the collected timings, one profiling point per line:
+ * point, count, min, max and sum in microseconds.
+ *
+ * @param out                 Serial or Riots_BabyRadio for the debug radio channel.
+ */
+void Riots_Profile::dump(Print &out) {
+  for (uint8_t i = 0; i < RIOTS_PROFILE_POINTS; i++) {
+    if ( points[i].count == 0 ) {
+      continue;
+    }
+    out.print(i);
+    out.print(F(" n="));
+    out.print(points[i].count);
+    out.print(F(" min="));
+    out.print(points[i].min);
+    out.print(F(" max="));
+    out.print(points[i].max);
+    out.print(F(" sum="));
+    out.println(points[i].sum);
+  }
+}
+
+#endif // RIOTS_PROFILE
@@ -0,0 +1,90 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef Riots_Profile_h
+#define Riots_Profile_h
+
+#include "Riots_Helper.h"
+
+// Profiling points, timings are collected in microseconds with micros(). Its
+// resolution is 4 us on a 16 MHz AVR and 8 us on an 8 MHz one, so timings of
+// short points are read from sum/count over many calls rather than min/max.
+#define RIOTS_PROFILE_AES_ENCRYPT     0
+#define RIOTS_PROFILE_AES_DECRYPT     1
+#define RIOTS_PROFILE_RADIO_LOAD      2   // payload load over SPI in Riots_Radio::send
+#define RIOTS_PROFILE_RADIO_AIRTIME   3   // wait for the IRQ in Riots_Radio::send
+#define RIOTS_PROFILE_RADIO_SWITCH    4   // IRQ clearing and switch back to receiver
+#define RIOTS_PROFILE_MEMORY_READ     5   // Riots_Memory read transactions
+#define RIOTS_PROFILE_MEMORY_WRITE    6   // Riots_Memory write transactions, the write cycle is polled later
+#define RIOTS_PROFILE_CLOUD_READ      7   // socket reads in Riots_MamaCloud
+#define RIOTS_PROFILE_CLOUD_WRITE     8   // socket writes in Riots_MamaCloud
+#define RIOTS_PROFILE_FORM_MESSAGE    9   // Riots_BabyRadio::formMessage, padding, checksum and encrypt
+#define RIOTS_PROFILE_RADIO_DECRYPT   10  // Riots_Radio::decrypt, decrypt and validation
+#define RIOTS_PROFILE_CACHE_WRITE     11  // message saved to the mama cache
+#define RIOTS_PROFILE_CACHE_READ      12  // message replayed from the mama cache
+#define RIOTS_PROFILE_FLASH_PAGE      13  // TYPE_PROG_PAGE(_LZ/_DELTA) handling, page assembly and EEPROM write
+#define RIOTS_PROFILE_FLASH_CONTROL   14  // other Riots_Flash messages
+#define RIOTS_PROFILE_SENSOR_CALC     15  // conversion math of the BMP280, SHT21 and TMD3782x values
+#define RIOTS_PROFILE_POINTS          16
+
+#ifdef RIOTS_PROFILE
+
+#include "Arduino.h"
+
+struct Riots_ProfilePoint {
+  uint32_t sum;                 /*!< Sum of the timings                                 */
+  uint16_t min;                 /*!< Shortest timing                                    */
+  uint16_t max;                 /*!< Longest timing                                     */
+  uint16_t count;               /*!< Count of the timings                               */
+};
+
+class Riots_Profile {
+  public:
+    static void record(uint8_t point, uint32_t elapsed);
+    static void reset();
+    static void dump(Print &out);
+
+  private:
+    static Riots_ProfilePoint points[RIOTS_PROFILE_POINTS]; /*!< Collected timings per profiling point */
+};
+
+/**
+ * Timer recording the lifetime of the scope where it is declared.
+ */
+class Riots_ProfileScope {
+  public:
+    Riots_ProfileScope(uint8_t point) : point(point), start(micros()) {}
+    ~Riots_ProfileScope() { Riots_Profile::record(point, micros() - start); }
+
+  private:
+    uint8_t point;
+    uint32_t start;
+};
+
+  #define _PROFILE_SCOPE(point)       Riots_ProfileScope _riots_profile_scope(point)
+  #define _PROFILE_START(timer)       uint32_t timer = micros()
+  #define _PROFILE_LAP(point, timer)  do { Riots_Profile::record(point, micros() - timer); timer = micros(); } while(0)
+  #define _PROFILE_STOP(point, timer) Riots_Profile::record(point, micros() - timer)
+  #define _PROFILE_DUMP(out)          Riots_Profile::dump(out)
+  #define _PROFILE_RESET()            Riots_Profile::reset()
+#else
+  #define _PROFILE_SCOPE(point)
+  #define _PROFILE_START(timer)
+  #define _PROFILE_LAP(point, timer)
+  #define _PROFILE_STOP(point, timer)
+  #define _PROFILE_DUMP(out)
+  #define _PROFILE_RESET()
+#endif
+
+#endif // Riots_Profile_h
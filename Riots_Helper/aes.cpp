@@ -50,7 +50,8 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 /*****************************************************************************/
 #include <stdint.h>
 #include "aes.h"
-#include <avr/pgmspace.h>
+#include "Riots_Hal.h"
+#include "Riots_Profile.h"
 
 
 /*****************************************************************************/
@@ -467,6 +468,8 @@ static void InvCipher()
 
 void AES128_ECB_encrypt(uint8_t* input, uint8_t* key, uint8_t *output)
 {
+  _PROFILE_SCOPE(RIOTS_PROFILE_AES_ENCRYPT);
+
   // Copy the Key and CipherText
   Key = key;
   in = input;
@@ -481,6 +484,8 @@ void AES128_ECB_encrypt(uint8_t* input, uint8_t* key, uint8_t *output)
 
 void AES128_ECB_decrypt(uint8_t* input, uint8_t* key, uint8_t *output)
 {
+  _PROFILE_SCOPE(RIOTS_PROFILE_AES_DECRYPT);
+
   Key = key;
   in = input;
   out = output;
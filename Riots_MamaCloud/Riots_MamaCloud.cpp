@@ -14,21 +14,25 @@
 
 #include "Arduino.h"
 #include <EEPROM.h>
-#include <avr/wdt.h>
-#include <avr/sleep.h>
+#include "Riots_Hal.h"
 
 #include "aes.h"
 #include <SPI.h>
 #include <Time.h>
+#include <Dns.h>
+#include <utility/socket.h>
 
 #include "Riots_MamaCloud.h"
 #include "Riots_Mamadef.h"
+#include "Riots_Profile.h"
 
 #ifdef RIOTS_RADIO_DEBUG
 /* flag for printing IP address in the first time*/
 bool first_time = true;
 #endif
 uint8_t count;
+/* counters used if the radio side counters are not shared with setStatsAddress */
+Riots_Stats cloud_stats;
 
 /**
  * Saves memory addresses for the shared memory. These same memory chunks
@@ -48,12 +52,25 @@ void Riots_MamaCloud::setAddresses(byte* plain_data_adr,
   uni_aes     = uniq_key_addr;
 }
 
+/**
+ * Saves memory address of the performance counters, allocated in Riots_Radio side.
+ * Cloud counters are added there and the whole set is sent to the cloud periodically.
+ *
+ * @param stats_addr              Memory ptr to the counters from getStatsAddress().
+ */
+void Riots_MamaCloud::setStatsAddress(Riots_Stats* stats_addr) {
+  stats = stats_addr;
+}
+
 /**
  * Setups the ethetner shield and establish the connection to the DHCP
  *
  */
 void Riots_MamaCloud::setup(byte indicativeLedsOn) {
   _DEBUG_PRINTLN(F("Cloud"));
+  if ( stats == NULL ) {
+    stats = &cloud_stats;
+  }
   if ( indicativeLedsOn == 1) {
     indicativeLeds = 1;
     riots_RGBLed.setup();
@@ -63,6 +80,8 @@ void Riots_MamaCloud::setup(byte indicativeLedsOn) {
 
   /* initialize the pseudo-random number generator with unconnected pin */
   randomSeed(analogRead(2));
+  // local ports do not repeat the ones of the connections before a reset
+  source_port = CLOUD_SOURCE_PORT + random(1024);
 
   /* Reset the W5500 ethernet shield */
   pinMode(RIOTS_ETHERNET_RESET, OUTPUT);
@@ -78,16 +97,17 @@ void Riots_MamaCloud::setup(byte indicativeLedsOn) {
   activateLeds(RIOTS_CLOUD_INITALIZING_COLOR);
 
   if( riots_memory.setup(RIOTS_PRIMARY_EEPROM) ) {
+    // MAC address of the base never changes, read it once and use the cached copy
+    riots_memory.readBlock(I2C_EEPROM_MAC_ADDRESS, base_mac, MAC_ADDRESS_SIZE);
+
     /* Using 00 FE for the beginin of the MAC which should be inline with
      * IETF: http://tools.ietf.org/html/rfc7042
     */
     mac[0] = 0x00;
     mac[1] = 0xFE;
 
-    // fill rest of the mac with MAC address of the Base which is read from I2C EEPROM
-    for (int i=0; i < MAC_ADDRESS_SIZE; i++) {
-      mac[i+2] = riots_memory.read((I2C_EEPROM_MAC_ADDRESS+i));
-    }
+    // fill rest of the mac with MAC address of the Base
+    memcpy(mac+2, base_mac, MAC_ADDRESS_SIZE);
   }
   else {
     riots_RGBLed.setColor(RIOTS_CLOUD_FAIL_COLOR);
@@ -121,7 +141,23 @@ void Riots_MamaCloud::setup(byte indicativeLedsOn) {
   connection_verificated = false;
   pending_message = false;
   time_received = false;
-  myNextAttempt = 0;
+
+  // First connection is tried immediately
+  connection_state = CLOUD_STATE_DISCONNECTED;
+  cloud_ip_valid = false;
+  connect_failures = 0;
+  retry_delay = 0;
+  retry_backoff = 0;
+  myNextAttempt = millis();
+  tx_queue_len = 0;
+  tx_queue_envelope = false;
+  cloud_protocol = RIOTS_CLOUD_PROTOCOL_V1;
+  last_dhcp_maintain = millis();
+  last_stats_sent = millis();
+  rx_state = CLOUD_RX_LENGTH;
+  data_blobs_available = 0;
+  blob_ring_count = 0;
+  resetRelay();
 }
 
 /**
@@ -136,89 +172,265 @@ void Riots_MamaCloud::setup(byte indicativeLedsOn) {
  */
 byte Riots_MamaCloud::update(byte *action_needed) {
 
+  byte status = RIOTS_OK;
+
   *action_needed = NO_ACTION_REQUIRED;
 
   if ( RIOTS_OK == validateConnection() ) {
     if ( ethernet_client.available() > 0 ) {
+      // any downlink traffic keeps the connection alive
+      last_cloud_activity = millis();
+    }
 
-      byte length    = ethernet_client.read();
-      byte operation = ethernet_client.read();
-
-      switch ( operation ) {
-        case SERVER_VERIFICATION:
-          return validateSession();
-        break;
-
-        case SERVER_REQUESTS_INTRODUCTION:
-          session_key_received = false;
-          // Start negotiation from the begining
-          sendRequestToCloud(CLIENT_INTRODUCTION);
-        break;
-
-        case SERVER_DATA_RECEIVER:
-          validateReceiver();
-          *action_needed = SET_RADIO_RECEIVER;
-        break;
-
-        case SERVER_DATA_POST:
-          // substract length of the operation from the total amount of data
-          // and calculate total data blob count and save to member variable
-          data_blobs_available = (length - 1) / DATA_BLOCK_SIZE;
-          // increase the count by one
-          data_blobs_available++;
-          *action_needed = FORWARD_DATA;
-        break;
+    if ( tx_queue_len > 0 &&
+       ( ethernet_client.available() > 0 ||
+       ( millis() - tx_queue_started ) >= MAMA_CLOUD_TX_DEADLINE ) ) {
+      // send pending frames before handling the reply or when deadline expires
+      flushToCloud();
+    }
 
-        default:
-          _DEBUG_PRINTLN(operation, HEX);
-          uint16_t count = ethernet_client.available();
+    if ( data_blobs_available > 1 ) {
+      // decrypt ahead the datablobs while the INO side is busy with the radio
+      prefetchDataBlobs();
+    }
 
-          // clean the whole data buffer and do nothing
-          for (uint16_t i = 0; i < count; i++) {
-            ethernet_client.read();
-          }
-          return RIOTS_NOT_FOUND;
-        break;
+    if ( relay_staging > 0 ) {
+      // one page of the relay post per loop, the write cycle runs meanwhile
+      stageRelayChunk();
+    }
 
-      }
+    // Handle all the complete frames which do not need action from the INO side.
+    // Parsing is paused while datablobs of the previous post are still unread.
+    while ( *action_needed == NO_ACTION_REQUIRED && data_blobs_available <= 1 && relay_staging == 0 &&
+            parseCloudFrame(action_needed, &status) ) {
     }
-    else {
-      if ( ethernet_client.connected() ) {
-        // we are connected to network sending a keep alive request
-        if ( session_key_received &&
-          ( ( millis() - myNextConnection ) > PINGING_INTERVAL ) ) {
-          // update time
-          myNextConnection = millis();
 
-          // keep Ethernet/DHCP connection alive
-          Ethernet.maintain();
+    if ( *action_needed == NO_ACTION_REQUIRED && data_blobs_available <= 1 && relay_count > 0 &&
+         riots_memory.isWriteDone(RIOTS_SECONDARY_EEPROM) ) {
+      // one staged datablob per loop, receiver is read with getNextReceiverAddress
+      memcpy(plain_data, relay_receiver, sizeof(relay_receiver));
+      *action_needed = RELAY_DATA;
+    }
 
+    if ( rx_state == CLOUD_RX_LENGTH && ethernet_client.available() == 0 ) {
+      if ( ethernet_client.connected() ) {
+        // we are connected to network, send a keep alive request if connection is idle
+        if ( session_key_received && tx_queue_len == 0 &&
+          ( ( millis() - last_cloud_activity ) > PINGING_INTERVAL ) ) {
           // send alive request to keep connection alive
           sendRequestToCloud(KEEP_ALIVE);
+          flushToCloud();
           // indicate with the led
           activateLeds(RIOTS_CONNECTION_OK_COLOR);
         }
+        if ( session_key_received && cloud_protocol == RIOTS_CLOUD_PROTOCOL_V2 &&
+          ( ( millis() - last_stats_sent ) > MAMA_STATS_INTERVAL ) ) {
+          last_stats_sent = millis();
+          sendRequestToCloud(CLIENT_STATS_POST);
+        }
       }
     }
   }
-  return RIOTS_OK;
+  return status;
+}
+
+/**
+ * Parses the downlink from the cloud incrementally.
+ *
+ * Consumes only the bytes already received, the parser state is kept over the
+ * calls so frames split into several TCP segments are handled. Frames are not
+ * dispatched before the whole frame is available. Unknown and malformed frames
+ * are skipped by their length so the following frames stay in sync.
+ *
+ * @param action_needed           Byte representing the required action from the INO side
+ * @param status                  Set to error code if the handled frame was not valid
+ * @return bool                   True if parsing progressed, false if more data is needed
+ */
+bool Riots_MamaCloud::parseCloudFrame(byte *action_needed, byte *status) {
+
+  uint16_t available = ethernet_client.available();
+  byte body_length;
+  byte needed;
+
+  switch ( rx_state ) {
+    case CLOUD_RX_LENGTH:
+      if ( available >= DATA_HEADER_SIZE ) {
+        // read whole header at once
+        readFromCloud(blob_ring, DATA_HEADER_SIZE);
+        rx_length = blob_ring[0];
+        rx_operation = blob_ring[1];
+        rx_state = CLOUD_RX_BODY;
+        if ( rx_length == 0 ) {
+          // empty frame is ignored, second byte was the length of the next frame
+          rx_length = rx_operation;
+          rx_state = rx_length > 0 ? CLOUD_RX_OPERATION : CLOUD_RX_LENGTH;
+        }
+        return true;
+      }
+      if ( available == 0 ) {
+        return false;
+      }
+      rx_length = ethernet_client.read();
+      stats->cloud_bytes_down++;
+      if ( rx_length > 0 ) {
+        // empty frames are ignored
+        rx_state = CLOUD_RX_OPERATION;
+      }
+      return true;
+
+    case CLOUD_RX_OPERATION:
+      if ( available == 0 ) {
+        return false;
+      }
+      rx_operation = ethernet_client.read();
+      stats->cloud_bytes_down++;
+      rx_state = CLOUD_RX_BODY;
+      return true;
+
+    case CLOUD_RX_SKIP:
+      while ( rx_skip > 0 && available > 0 ) {
+        // datablob ring is free while frames are parsed, use it as a scratch
+        needed = sizeof(blob_ring);
+        if ( needed > rx_skip ) {
+          needed = rx_skip;
+        }
+        if ( needed > available ) {
+          needed = available;
+        }
+        readFromCloud(blob_ring, needed);
+        rx_skip -= needed;
+        available -= needed;
+      }
+      if ( rx_skip > 0 ) {
+        return false;
+      }
+      rx_state = CLOUD_RX_LENGTH;
+      return true;
+  }
+
+  // substract length of the operation from the total amount of data
+  body_length = rx_length - 1;
+
+  switch ( rx_operation ) {
+    case SERVER_VERIFICATION:
+      needed = 2*DATA_BLOCK_SIZE;
+    break;
+
+    case SERVER_DATA_RECEIVER:
+      needed = DATA_BLOCK_SIZE;
+    break;
+
+    case SERVER_DATA_POST:
+      // datablobs are left to the buffer, they are read by getNextDataBlob
+      needed = body_length;
+      if ( body_length == 0 || body_length % DATA_BLOCK_SIZE != 0 ) {
+        needed = 0xFF;
+      }
+    break;
+
+    case SERVER_REQUESTS_INTRODUCTION:
+      needed = 0;
+    break;
+
+    case SERVER_PROTOCOL_ACCEPT:
+      needed = 1;
+    break;
+
+    case SERVER_RELAY_POST:
+      // receiver block and at least one datablob, all staged before dispatching
+      needed = body_length;
+      if ( body_length < 2*DATA_BLOCK_SIZE || body_length % DATA_BLOCK_SIZE != 0 ) {
+        needed = 0xFF;
+      }
+    break;
+
+    default:
+      needed = 0xFF;
+    break;
+  }
+
+  if ( needed > body_length ) {
+    // Unknown or malformed frame, skip it without touching the next frames
+    _DEBUG_PRINTLN(rx_operation, HEX);
+    *status = RIOTS_NOT_FOUND;
+    rx_skip = body_length;
+    rx_state = CLOUD_RX_SKIP;
+    return true;
+  }
+
+  if ( available < needed ) {
+    // wait for the rest of the frame
+    return false;
+  }
+
+  // possible extra bytes in the end of frame are discarded
+  rx_skip = body_length - needed;
+  rx_state = CLOUD_RX_SKIP;
+
+  switch ( rx_operation ) {
+    case SERVER_VERIFICATION:
+      if ( RIOTS_OK != validateSession() ) {
+        *status = RIOTS_FAIL;
+      }
+    break;
+
+    case SERVER_REQUESTS_INTRODUCTION:
+      session_key_received = false;
+      // Start negotiation from the begining
+      sendRequestToCloud(CLIENT_INTRODUCTION);
+    break;
+
+    case SERVER_DATA_RECEIVER:
+      validateReceiver();
+      *action_needed = SET_RADIO_RECEIVER;
+    break;
+
+    case SERVER_DATA_POST:
+      // calculate total data blob count and save to member variable
+      data_blobs_available = body_length / DATA_BLOCK_SIZE;
+      // increase the count by one
+      data_blobs_available++;
+      *action_needed = FORWARD_DATA;
+    break;
+
+    case SERVER_PROTOCOL_ACCEPT:
+      // use envelopes only if the cloud accepted the offered version
+      readFromCloud(blob_ring, 1);
+      if ( blob_ring[0] == RIOTS_ENVELOPE_VERSION ) {
+        cloud_protocol = RIOTS_CLOUD_PROTOCOL_V2;
+        // envelope keys and counters of this session
+        envelope.startSession(sess_key);
+      }
+    break;
+
+    case SERVER_RELAY_POST:
+      if ( RIOTS_OK != stageRelayBlobs(body_length / DATA_BLOCK_SIZE - 1) ) {
+        *status = RIOTS_FAIL;
+      }
+    break;
+  }
+  return true;
 }
 
 /**
  * Reads the next data blob from the etherner shield buffer.
  *
+ * Datablobs are served from the prefetch ring, which is refilled from the
+ * ethernet shield when needed.
+ *
  * @return byte                   Number of datablobs available after this
  */
 byte Riots_MamaCloud::getNextDataBlob() {
 
   // read next data blob if there was originally more than 1 available
-  if ( data_blobs_available > 1 && ethernet_client.available() >= DATA_BLOCK_SIZE ) {
-    // There is atleast one more data blob left
-    for (int i = 0; i < DATA_BLOCK_SIZE; i++) {
-      rx_crypt_buff[i] = ethernet_client.read();
+  if ( data_blobs_available > 1 ) {
+    prefetchDataBlobs();
+    if ( blob_ring_count > 0 ) {
+      // There is atleast one more data blob left
+      memcpy(rx_crypt_buff, blob_ring+blob_ring_head*DATA_BLOCK_SIZE, DATA_BLOCK_SIZE);
+      blob_ring_head = (blob_ring_head + 1) % MAMA_CLOUD_BLOB_PREFETCH;
+      blob_ring_count--;
     }
-    // decrypt the data message with session_key
-    AES128_ECB_decrypt(rx_crypt_buff, sess_key, rx_crypt_buff);
   }
   if ( data_blobs_available > 0 ) {
     data_blobs_available--;
@@ -226,6 +438,196 @@ byte Riots_MamaCloud::getNextDataBlob() {
   return data_blobs_available;
 }
 
+/**
+ * Fills the free slots of the prefetch ring with datablobs from the ethernet shield.
+ *
+ * Blobs are read in as few reads as possible and decrypted with the session
+ * key in place.
+ */
+void Riots_MamaCloud::prefetchDataBlobs() {
+
+  byte in_buffer;
+  byte free_slot;
+  byte blobs;
+
+  while ( blob_ring_count < MAMA_CLOUD_BLOB_PREFETCH ) {
+    // datablobs still waiting in the ethernet shield
+    in_buffer = data_blobs_available - 1 - blob_ring_count;
+    if ( ethernet_client.available() / DATA_BLOCK_SIZE < in_buffer ) {
+      in_buffer = ethernet_client.available() / DATA_BLOCK_SIZE;
+    }
+
+    // slots are filled up to the end of the ring at once
+    free_slot = (blob_ring_head + blob_ring_count) % MAMA_CLOUD_BLOB_PREFETCH;
+    blobs = MAMA_CLOUD_BLOB_PREFETCH - free_slot;
+    if ( blobs > MAMA_CLOUD_BLOB_PREFETCH - blob_ring_count ) {
+      blobs = MAMA_CLOUD_BLOB_PREFETCH - blob_ring_count;
+    }
+    if ( blobs > in_buffer ) {
+      blobs = in_buffer;
+    }
+    if ( blobs == 0 ) {
+      return;
+    }
+
+    readFromCloud(blob_ring+free_slot*DATA_BLOCK_SIZE, blobs*DATA_BLOCK_SIZE);
+    for (byte i = free_slot; i < free_slot + blobs; i++) {
+      // decrypt the data message with session_key
+      AES128_ECB_decrypt(blob_ring+i*DATA_BLOCK_SIZE, sess_key, blob_ring+i*DATA_BLOCK_SIZE);
+    }
+    blob_ring_count += blobs;
+  }
+}
+
+/**
+ * Discards all the datablobs left from the current data post.
+ *
+ * Blobs are dropped from the prefetch ring and read out from the ethernet
+ * shield in blocks, without decrypting.
+ */
+void Riots_MamaCloud::discardDataBlobs() {
+
+  byte in_buffer;
+  byte blobs;
+
+  if ( data_blobs_available > 1 ) {
+    in_buffer = data_blobs_available - 1 - blob_ring_count;
+
+    while ( in_buffer > 0 ) {
+      blobs = in_buffer < MAMA_CLOUD_BLOB_PREFETCH ? in_buffer : MAMA_CLOUD_BLOB_PREFETCH;
+      readFromCloud(blob_ring, blobs*DATA_BLOCK_SIZE);
+      in_buffer -= blobs;
+    }
+  }
+  blob_ring_count = 0;
+  data_blobs_available = 0;
+}
+
+/**
+ * Starts staging the datablobs of SERVER_RELAY_POST to the relay in the
+ * secondary EEPROM. The receiver block is checked here, the datablobs are
+ * staged by stageRelayChunk on the following loops.
+ *
+ * @param blobs                   Count of the datablobs after the receiver block.
+ * @return byte                   RIOTS_OK if the datablobs will be staged
+ */
+byte Riots_MamaCloud::stageRelayBlobs(byte blobs) {
+
+  // receiver block, same as in SERVER_DATA_RECEIVER
+  readFromCloud(blob_ring, DATA_BLOCK_SIZE);
+  AES128_ECB_decrypt(blob_ring, sess_key, blob_ring);
+
+  if ( eeprom_status != RIOTS_OK || calcChecksum(blob_ring, DATA_BLOCK_SIZE) != 0 ||
+       blobs > I2C_RELAY_BLOBS - relay_count ||
+       ( relay_count > 0 && memcmp(relay_receiver, blob_ring, sizeof(relay_receiver)) != 0 ) ) {
+    // relay holds only one receiver at a time, the cloud has exceeded its credit
+    rx_skip += blobs*DATA_BLOCK_SIZE;
+    return RIOTS_FAIL;
+  }
+  memcpy(relay_receiver, blob_ring, sizeof(relay_receiver));
+  relay_staging = blobs;
+  stageRelayChunk();
+  return RIOTS_OK;
+}
+
+/**
+ * Stages the next datablobs of the relay post, if the secondary EEPROM has
+ * finished its previous write cycle. Datablobs are read from the ethernet
+ * shield, decrypted with the session key and written with one page write,
+ * whose write cycle then runs while the loop goes on.
+ */
+void Riots_MamaCloud::stageRelayChunk() {
+
+  byte slot;
+  byte chunk;
+
+  if ( relay_staging == 0 || !riots_memory.isWriteDone(RIOTS_SECONDARY_EEPROM) ) {
+    return;
+  }
+
+  // blocks are staged up to the end of the EEPROM page at once
+  slot = (relay_head + relay_count) % I2C_RELAY_BLOBS;
+  chunk = I2C_EEPROM_PAGE_SIZE/DATA_BLOCK_SIZE - slot % (I2C_EEPROM_PAGE_SIZE/DATA_BLOCK_SIZE);
+  if ( chunk > MAMA_CLOUD_BLOB_PREFETCH ) {
+    chunk = MAMA_CLOUD_BLOB_PREFETCH;
+  }
+  if ( chunk > relay_staging ) {
+    chunk = relay_staging;
+  }
+
+  // datablob ring is free while the relay post is staged
+  readFromCloud(blob_ring, chunk*DATA_BLOCK_SIZE);
+  riots_memory.startPageWrite(I2C_RELAY_START + slot*DATA_BLOCK_SIZE, RIOTS_SECONDARY_EEPROM);
+  for (byte i = 0; i < chunk; i++) {
+    AES128_ECB_decrypt(blob_ring+i*DATA_BLOCK_SIZE, sess_key, blob_ring+i*DATA_BLOCK_SIZE);
+    for (byte j = 0; j < DATA_BLOCK_SIZE; j++) {
+      riots_memory.pageFill(blob_ring[i*DATA_BLOCK_SIZE+j]);
+    }
+  }
+  riots_memory.stopPageWrite();
+
+  relay_count += chunk;
+  relay_staging -= chunk;
+}
+
+/**
+ * Reads the next staged datablob from the relay to the radio buffer. The
+ * datablob stays in the relay until relayDelivered is called for it.
+ *
+ * @return byte                   Count of the datablobs in the relay, including this one
+ */
+byte Riots_MamaCloud::getNextRelayBlob() {
+
+  if ( relay_count > 0 ) {
+    riots_memory.readBlock(I2C_RELAY_START + relay_head*DATA_BLOCK_SIZE, rx_crypt_buff, DATA_BLOCK_SIZE, RIOTS_SECONDARY_EEPROM);
+  }
+  return relay_count;
+}
+
+/**
+ * Handles the send status of the relayed datablob. Sent datablob is freed,
+ * failed one is tried again on the next loop. When the receiver is not
+ * reached the whole relay is dropped, the cloud repairs the firmware transfer
+ * by the page confirms of the receiver.
+ *
+ * @param status                  Status of the radio send
+ */
+void Riots_MamaCloud::relayDelivered(byte status) {
+
+  if ( relay_count == 0 ) {
+    return;
+  }
+
+  if ( status == RIOTS_OK ) {
+    relay_head = (relay_head + 1) % I2C_RELAY_BLOBS;
+    relay_count--;
+    relay_credit++;
+    relay_retries = 0;
+  }
+  else if ( ++relay_retries >= MAMA_RELAY_RETRIES ) {
+    relay_credit += relay_count;
+    relay_count = 0;
+    relay_retries = 0;
+    relay_status = RIOTS_FAIL;
+  }
+
+  if ( relay_credit >= MAMA_RELAY_CREDIT_STEP || ( relay_count == 0 && relay_credit > 0 ) ) {
+    sendRequestToCloud(CLIENT_RELAY_CREDIT);
+  }
+}
+
+/**
+ * Empties the relay. Credit of a new session starts from the whole relay.
+ */
+void Riots_MamaCloud::resetRelay() {
+  relay_head = 0;
+  relay_count = 0;
+  relay_staging = 0;
+  relay_credit = 0;
+  relay_retries = 0;
+  relay_status = RIOTS_OK;
+}
+
 /**
  * Forwards the message received from the radio side to the cloud.
  *
@@ -260,39 +662,206 @@ byte* Riots_MamaCloud::getNextReceiverAddress() {
  * Validates the connection to the DHCP, If the connection is valid and there is session
  * available is valid issues the first message in the handshaking protocol.
  *
+ * Connection attempts are made by the cached address of the cloud and they are
+ * spaced with exponential backoff, so that a missing uplink does not stall the
+ * radio side of the mama. The attempt itself does not wait for the handshake,
+ * it is followed on the next calls with pollConnection(). DHCP lease is
+ * maintained while connected and right before the attempts, never while
+ * backing off from a link that is down.
+ *
  * @return byte                   RIOTS_OK if successfully, otherwise error code
  */
 byte Riots_MamaCloud::validateConnection() {
 
-  if( RIOTS_OK == dhcpValidated() ) {
-    if ( millis() - myNextAttempt > CONNECTION_RETRY_TIME ) {
-      // time to re-check connection
-      if ( !ethernet_client.connected() ) {
-        myNextAttempt = millis();
-        // enable with CS
-        digitalWrite(RIOTS_ETHERNET_CS, LOW);
-        if (ethernet_client.connect(RIOTS_CLOUD_ADDRESS, RIOTS_CLOUD_PORT)) {
-          activateLeds(RIOTS_CLOUD_FAIL_COLOR);
-
-          // Issue introduction to server
-          sendRequestToCloud(CLIENT_INTRODUCTION);
-        }
-        else {
-          connection_verificated = false;
-          session_key_received = false;
-          ethernet_client.stop();
-          activateLeds(RIOTS_CONNECTION_FAIL_COLOR);
+  if( RIOTS_OK != dhcpValidated() ) {
+    return RIOTS_NOT_CONNECTED;
+  }
 
-          return RIOTS_NOT_CONNECTED;
-        }
-      }
-      else {
-      }
+  if ( connection_state == CLOUD_STATE_CONNECTED ) {
+    if ( ethernet_client.connected() ) {
+      maintainDhcp();
+      return RIOTS_OK;
+    }
+    // connection was lost, start reconnecting after a short while
+    _DEBUG_PRINTLN(F("Cloud lost"));
+    retry_backoff = 0;
+    connectionFailed();
+    return RIOTS_NOT_CONNECTED;
+  }
+
+  if ( connection_state == CLOUD_STATE_CONNECTING ) {
+    return pollConnection();
+  }
+
+  if ( millis() - myNextAttempt < retry_delay ) {
+    // still backing off
+    return RIOTS_NOT_CONNECTED;
+  }
+  myNextAttempt = millis();
+  // a renewed lease may be what the next attempt needs
+  maintainDhcp();
+
+  if ( !cloud_ip_valid || millis() - cloud_ip_resolved > CLOUD_ADDRESS_REFRESH ) {
+    if ( RIOTS_OK != resolveCloudAddress() ) {
+      connectionFailed();
+      return RIOTS_NOT_CONNECTED;
     }
   }
+
+  if ( RIOTS_OK != startConnection() ) {
+    connectionFailed();
+    return RIOTS_NOT_CONNECTED;
+  }
+  return pollConnection();
+}
+
+/**
+ * Opens a socket of the W5500 and gives it the CONNECT command. The command
+ * only sends the SYN, EthernetClient::connect() would wait here for the whole
+ * handshake and, without an answer, until the chip gives up retransmitting.
+ *
+ * @return byte                   RIOTS_OK if successfully, otherwise error code
+ */
+byte Riots_MamaCloud::startConnection() {
+  byte address[4] = { cloud_ip[0], cloud_ip[1], cloud_ip[2], cloud_ip[3] };
+  byte sock;
+
+  // enable with CS
+  digitalWrite(RIOTS_ETHERNET_CS, LOW);
+  for ( sock = 0; sock < MAX_SOCK_NUM; sock++ ) {
+    if ( EthernetClient(sock).status() == SnSR::CLOSED ) {
+      break;
+    }
+  }
+  if ( sock == MAX_SOCK_NUM ) {
+    return RIOTS_FAIL;
+  }
+
+  if ( ++source_port < CLOUD_SOURCE_PORT ) {
+    // wrapped around
+    source_port = CLOUD_SOURCE_PORT;
+  }
+  if ( !socket(sock, SnMR::TCP, source_port, 0) ) {
+    return RIOTS_FAIL;
+  }
+  // client owns the socket from now on, connectionFailed() closes it
+  ethernet_client = EthernetClient(sock);
+  if ( !connect(sock, address, RIOTS_CLOUD_PORT) ) {
+    return RIOTS_FAIL;
+  }
+  connection_state = CLOUD_STATE_CONNECTING;
+  connect_started = millis();
   return RIOTS_OK;
 }
 
+/**
+ * Follows the handshake started by startConnection() from the socket status
+ * and starts the session once the connection is established.
+ *
+ * @return byte                   RIOTS_OK if connected, otherwise error code
+ */
+byte Riots_MamaCloud::pollConnection() {
+  byte status = ethernet_client.status();
+
+  if ( status == SnSR::ESTABLISHED || status == SnSR::CLOSE_WAIT ) {
+    activateLeds(RIOTS_CLOUD_FAIL_COLOR);
+
+    connection_state = CLOUD_STATE_CONNECTED;
+    stats->cloud_reconnects++;
+    connect_failures = 0;
+    retry_delay = 0;
+    retry_backoff = 0;
+    last_cloud_activity = millis();
+
+    // Issue introduction to server
+    sendRequestToCloud(CLIENT_INTRODUCTION);
+    return RIOTS_OK;
+  }
+
+  if ( ( status == SnSR::INIT || status == SnSR::SYNSENT ) &&
+       millis() - connect_started < CLOUD_CONNECT_TIMEOUT ) {
+    // handshake is still going on
+    return RIOTS_NOT_CONNECTED;
+  }
+
+  // refused by the server or no answer in time
+  if ( ++connect_failures % CLOUD_RESOLVE_FAILURES == 0 ) {
+    // server may have moved, resolve the address again on next attempt
+    cloud_ip_valid = false;
+  }
+  connectionFailed();
+  return RIOTS_NOT_CONNECTED;
+}
+
+/**
+ * Keeps the Ethernet/DHCP connection alive. Ethernet.maintain() renews the
+ * lease only when it is due, but it blocks while the DHCP server does not
+ * answer, so it is checked at most every DHCP_MAINTAIN_INTERVAL.
+ */
+void Riots_MamaCloud::maintainDhcp() {
+  if ( millis() - last_dhcp_maintain > DHCP_MAINTAIN_INTERVAL ) {
+    last_dhcp_maintain = millis();
+    Ethernet.maintain();
+  }
+}
+
+/**
+ * Resolves the address of the cloud server and caches it. DNSClient waits for
+ * the answer, so the address is resolved only every CLOUD_ADDRESS_REFRESH and
+ * after CLOUD_RESOLVE_FAILURES failed connections, not on every attempt.
+ *
+ * @return byte                   RIOTS_OK if successfully, otherwise error code
+ */
+byte Riots_MamaCloud::resolveCloudAddress() {
+  DNSClient dns;
+
+  dns.begin(Ethernet.dnsServerIP());
+  if ( dns.getHostByName(RIOTS_CLOUD_ADDRESS, cloud_ip) == 1 ) {
+    cloud_ip_resolved = millis();
+    cloud_ip_valid = true;
+    return RIOTS_OK;
+  }
+  cloud_ip_valid = false;
+  return RIOTS_FAIL;
+}
+
+/**
+ * Closes the session and schedules the next connection attempt.
+ *
+ * Backoff is doubled on every failure up to CONNECTION_RETRY_MAX and the actual
+ * delay is randomized between half and full backoff, so that mamas do not
+ * reconnect in sync after a cloud outage.
+ */
+void Riots_MamaCloud::connectionFailed() {
+  connection_state = CLOUD_STATE_DISCONNECTED;
+  connection_verificated = false;
+  session_key_received = false;
+  tx_queue_len = 0;
+  tx_queue_envelope = false;
+  cloud_protocol = RIOTS_CLOUD_PROTOCOL_V1;
+  // new connection starts from the begining of a frame
+  rx_state = CLOUD_RX_LENGTH;
+  data_blobs_available = 0;
+  blob_ring_count = 0;
+  // staged datablobs belong to the lost session
+  resetRelay();
+  ethernet_client.stop();
+  activateLeds(RIOTS_CONNECTION_FAIL_COLOR);
+
+  if ( retry_backoff < CONNECTION_RETRY_TIME ) {
+    retry_backoff = CONNECTION_RETRY_TIME;
+  }
+  else if ( retry_backoff < CONNECTION_RETRY_MAX / 2 ) {
+    retry_backoff *= 2;
+  }
+  else {
+    retry_backoff = CONNECTION_RETRY_MAX;
+  }
+  // jitter only the wait, the backoff itself keeps growing
+  retry_delay = retry_backoff / 2 + random(retry_backoff / 2);
+  myNextAttempt = millis();
+}
+
 /**
  * Encrypts the data, checks the CRC matches and in the if ecerything is successfully
  * saves the new radio address for the previous received pointer.
@@ -302,9 +871,7 @@ byte Riots_MamaCloud::validateConnection() {
 byte Riots_MamaCloud::validateReceiver() {
 
   // Read entire data
-  for (uint8_t i = 0; i < DATA_BLOCK_SIZE; i++) {
-    rx_crypt_buff[i] = ethernet_client.read();
-  }
+  readFromCloud(rx_crypt_buff, DATA_BLOCK_SIZE);
 
   // decrypt the data with session key
   AES128_ECB_decrypt(rx_crypt_buff, sess_key, plain_data);
@@ -317,6 +884,26 @@ byte Riots_MamaCloud::validateReceiver() {
   return RIOTS_FAIL;
 }
 
+/**
+ * Reads a block of data from the ethernet shield.
+ *
+ * The whole block is read with a single socket read instead of a SPI
+ * transaction for every byte.
+ *
+ * @param buffer                  Destination of the data.
+ * @param length                  Count of bytes to read.
+ * @return bool                   True if the whole block was read
+ */
+bool Riots_MamaCloud::readFromCloud(byte* buffer, uint16_t length) {
+  _PROFILE_SCOPE(RIOTS_PROFILE_CLOUD_READ);
+  int received = ethernet_client.read(buffer, length);
+
+  if ( received > 0 ) {
+    stats->cloud_bytes_down += received;
+  }
+  return received == (int)length;
+}
+
 /**
  * Process possible saved message.
  *
@@ -345,15 +932,11 @@ void Riots_MamaCloud::processCachedMessage() {
  */
 byte Riots_MamaCloud::validateSession(){
 
-  uint8_t i;
-
-  // Read first 16 bytes
-  for (i = 0; i < DATA_BLOCK_SIZE; i++) {
-    rx_crypt_buff[i] = ethernet_client.read();
-  }
+  // Read both blocks at once, datablob ring is free while frames are parsed
+  readFromCloud(blob_ring, 2*DATA_BLOCK_SIZE);
 
-  // decrypt the message with unique key
-  AES128_ECB_decrypt(rx_crypt_buff, uni_aes, plain_data);
+  // decrypt the message with unique key straight from the read buffer
+  AES128_ECB_decrypt(blob_ring, uni_aes, plain_data);
 
   if ( calcChecksum(plain_data, DATA_BLOCK_SIZE) == 0 ) {
     // Checksum matches
@@ -368,13 +951,8 @@ byte Riots_MamaCloud::validateSession(){
     if (memcmp(challenge, &plain_data[4], 4) != 0) {
       return RIOTS_FAIL;
     }
-    // Read next 16 bytes
-    for (i = 0; i < DATA_BLOCK_SIZE; i++) {
-      rx_crypt_buff[i] = ethernet_client.read();
-    }
-
     // decrypt rest of message with unique key
-    AES128_ECB_decrypt(rx_crypt_buff, uni_aes, plain_data);
+    AES128_ECB_decrypt(blob_ring+DATA_BLOCK_SIZE, uni_aes, plain_data);
 
     if (memcmp(sess_key, plain_data, AES_KEY_SIZE) != 0) {
       memcpy(sess_key, plain_data, AES_KEY_SIZE);
@@ -422,15 +1000,8 @@ void Riots_MamaCloud::sendRequestToCloud(Riots_Message cloud_message_type) {
       plain_data[0] = 0x0D; // lenght - this value
       plain_data[1] = CLIENT_INTRODUCTION;
 
-      if( riots_memory.setup(RIOTS_PRIMARY_EEPROM) ) {
-        // Read mama address from i2c eeprom
-        plain_data[2] = riots_memory.read(I2C_EEPROM_MAC_ADDRESS);
-        plain_data[3] = riots_memory.read(I2C_EEPROM_MAC_ADDRESS+1);
-        plain_data[4] = riots_memory.read(I2C_EEPROM_MAC_ADDRESS+2);
-        plain_data[5] = riots_memory.read(I2C_EEPROM_MAC_ADDRESS+3);
-        // Initialize back to secondary EEPROM
-        riots_memory.setup(RIOTS_SECONDARY_EEPROM);
-      }
+      // Mama address is the MAC address of the base, cached in setup
+      memcpy(plain_data+2, base_mac, MAC_ADDRESS_SIZE);
 
       // Read MAC address from EEPROM (Same as mama address currently)
       plain_data[6] = EEPROM.read(EEPROM_RX_ADDR);
@@ -443,9 +1014,17 @@ void Riots_MamaCloud::sendRequestToCloud(Riots_Message cloud_message_type) {
 
       memcpy(plain_data+10, challenge, 4);
 
-      // Send message
-      ethernet_client.write(plain_data, 0x0E);
-      ethernet_client.flush();
+      queueToCloud(plain_data, 0x0E);
+
+      // Offer envelopes, the cloud answers with SERVER_PROTOCOL_ACCEPT if it supports them
+      cloud_protocol = RIOTS_CLOUD_PROTOCOL_V1;
+      plain_data[0] = 0x02; // length - this value
+      plain_data[1] = CLIENT_PROTOCOL_OFFER;
+      plain_data[2] = RIOTS_ENVELOPE_VERSION;
+      queueToCloud(plain_data, 0x03);
+
+      // Handshake is sent without any delay
+      flushToCloud();
     break;
 
     case CLIENT_VERIFICATION:
@@ -464,24 +1043,34 @@ void Riots_MamaCloud::sendRequestToCloud(Riots_Message cloud_message_type) {
       // crypt the data and keep the header as a plain data
       AES128_ECB_encrypt(plain_data, sess_key, tx_crypt_buff+2 );
 
-      // Send message
-      ethernet_client.write(tx_crypt_buff, 0x12);
-      ethernet_client.flush();
+      // Handshake is sent without any delay
+      queueToCloud(tx_crypt_buff, 0x12);
+      flushToCloud();
     break;
 
     case KEEP_ALIVE:
       activateLeds(RIOTS_BLUE_COLOR);
 
+      if ( cloud_protocol == RIOTS_CLOUD_PROTOCOL_V2 ) {
+        queueRecord(RIOTS_RECORD_KEEP_ALIVE, NULL, 0);
+        break;
+      }
+
       plain_data[0] = 0x01;               // length
       plain_data[1] = KEEP_ALIVE;         // operation
 
-      ethernet_client.write(plain_data, 0x02);
-      ethernet_client.flush();
+      queueToCloud(plain_data, 0x02);
     break;
 
     case CLIENT_DATA_POST:
       activateLeds(RIOTS_BLUE_COLOR);
 
+      if ( cloud_protocol == RIOTS_CLOUD_PROTOCOL_V2 ) {
+        // envelope is crypted as a whole
+        queueRecord(RIOTS_RECORD_DATA_POST, plain_data, DATA_BLOCK_SIZE);
+        break;
+      }
+
       //Using rx buff as we dont want to mess possible sending buffer.
       rx_crypt_buff[0]  = 0x11;  // length
       rx_crypt_buff[1]  = CLIENT_DATA_POST;  // type
@@ -489,21 +1078,60 @@ void Riots_MamaCloud::sendRequestToCloud(Riots_Message cloud_message_type) {
 
       // crypt the data and keep the header as a plain data
       AES128_ECB_encrypt(plain_data, sess_key, rx_crypt_buff+2 );
-      ethernet_client.write(rx_crypt_buff, 0x12);
-      ethernet_client.flush();
+      queueToCloud(rx_crypt_buff, 0x12);
     break;
 
     case CLIENT_SAVED_DATA_POST:
       activateLeds(RIOTS_BLUE_COLOR);
 
       byte send_buff[34];
+
+      if ( cloud_protocol == RIOTS_CLOUD_PROTOCOL_V2 ) {
+        // time and datablob of the saved message as such
+        if ( readCachedRecord(send_buff) ) {
+          queueRecord(RIOTS_RECORD_SAVED_DATA_POST, send_buff, I2C_EEPROM_MSG_SIZE);
+        }
+        break;
+      }
+
       send_buff[0] = 0x21;                  // Length
       send_buff[1] = CLIENT_SAVED_DATA_POST;// operation
       // read rest of the message
       if ( readLastCachedMessage(send_buff+2) ) {
         // succesfully read, send the message
-        ethernet_client.write(send_buff, 0x22);
-        ethernet_client.flush();
+        queueToCloud(send_buff, 0x22);
+    }
+    break;
+
+    case CLIENT_STATS_POST:
+      // Only a v2 cloud knows the counters
+      if ( cloud_protocol == RIOTS_CLOUD_PROTOCOL_V2 ) {
+        byte stats_record[MAMA_STATS_RECORD_LEN];
+        writeStatsRecord(stats_record);
+        queueRecord(RIOTS_RECORD_STATS, stats_record, MAMA_STATS_RECORD_LEN);
+      }
+    break;
+
+    case CLIENT_RELAY_CREDIT: {
+      byte credit_frame[2+DATA_BLOCK_SIZE];
+
+      credit_frame[2] = relay_credit;
+      credit_frame[3] = relay_status;
+      relay_credit = 0;
+      relay_status = RIOTS_OK;
+
+      if ( cloud_protocol == RIOTS_CLOUD_PROTOCOL_V2 ) {
+        queueRecord(RIOTS_RECORD_RELAY_CREDIT, credit_frame+2, RELAY_CREDIT_LEN);
+        break;
+      }
+
+      credit_frame[0] = 0x11;               // Length
+      credit_frame[1] = CLIENT_RELAY_CREDIT;// operation
+      fillRandomPadding(credit_frame+2+RELAY_CREDIT_LEN, DATA_BLOCK_SIZE-1-RELAY_CREDIT_LEN);
+      credit_frame[2+DATA_BLOCK_SIZE-1] = calcChecksum(credit_frame+2, DATA_BLOCK_SIZE-1);
+
+      AES128_ECB_encrypt(credit_frame+2, sess_key, credit_frame+2);
+      queueToCloud(credit_frame, 0x12);
     }
     break;
   }
@@ -512,6 +1140,147 @@ void Riots_MamaCloud::sendRequestToCloud(Riots_Message cloud_message_type) {
   }
 }
 
+/**
+ * Adds a frame to the TX buffer.
+ *
+ * Frames are coalesced so that several data posts are written to the ethernet
+ * shield with a single write. The buffer is flushed when it is full, before
+ * the reply from the cloud is read or when MAMA_CLOUD_TX_DEADLINE expires.
+ *
+ * @param frame                   Start of the frame, including the header.
+ * @param length                  Length of the frame.
+ */
+void Riots_MamaCloud::queueToCloud(byte* frame, byte length) {
+
+  if ( tx_queue_envelope ) {
+    // envelope is closed before other frames
+    flushToCloud();
+  }
+
+  if ( tx_queue_len + length > MAMA_CLOUD_TX_BUFFER_SIZE ) {
+    // no room for the frame, send the pending ones first
+    flushToCloud();
+  }
+
+  if ( length > MAMA_CLOUD_TX_BUFFER_SIZE ) {
+    // frame does not fit to the buffer at all
+    stats->cloud_bytes_up += ethernet_client.write(frame, length);
+    return;
+  }
+
+  if ( tx_queue_len == 0 ) {
+    tx_queue_started = millis();
+  }
+  memcpy(tx_queue+tx_queue_len, frame, length);
+  tx_queue_len += length;
+
+  if ( tx_queue_len == MAMA_CLOUD_TX_BUFFER_SIZE ) {
+    flushToCloud();
+  }
+}
+
+/**
+ * Adds a record to the envelope in the TX buffer.
+ *
+ * Envelope is opened to the empty TX buffer and it is sealed when the buffer
+ * is flushed, so all the records of a loop iteration share one frame and MAC.
+ *
+ * @param type                    Type of the record.
+ * @param value                   Value of the record.
+ * @param length                  Length of the value.
+ */
+void Riots_MamaCloud::queueRecord(byte type, byte* value, byte length) {
+
+  if ( tx_queue_len > 0 && ( !tx_queue_envelope || !envelope.fits(length) ) ) {
+    flushToCloud();
+  }
+
+  if ( tx_queue_len == 0 ) {
+    envelope.begin(tx_queue, MAMA_CLOUD_TX_BUFFER_SIZE, CLIENT_ENVELOPE);
+    tx_queue_envelope = true;
+    tx_queue_started = millis();
+  }
+
+  envelope.addRecord(type, value, length);
+  tx_queue_len = envelope.length();
+}
+
+/**
+ * Writes the counters to the stats record.
+ *
+ * Every counter is written by itself in little endian, in the order of
+ * Riots_Stats, so the record does not depend on the padding or byte order of
+ * the compiler. The XOR checksum of the counters follows them.
+ *
+ * @param record                  Buffer of MAMA_STATS_RECORD_LEN bytes.
+ */
+void Riots_MamaCloud::writeStatsRecord(byte* record) {
+  byte i, length = 0;
+
+  length = writeCounter(record, length, stats->cloud_bytes_up, 4);
+  length = writeCounter(record, length, stats->cloud_bytes_down, 4);
+  length = writeCounter(record, length, stats->radio_rx_frames, 2);
+  length = writeCounter(record, length, stats->radio_tx_frames, 2);
+  length = writeCounter(record, length, stats->radio_tx_failures, 2);
+  length = writeCounter(record, length, stats->radio_airtime_timeouts, 2);
+  length = writeCounter(record, length, stats->radio_rx_backlog, 2);
+  for ( i=0; i < RIOTS_STATS_KEY_COUNT; i++ ) {
+    length = writeCounter(record, length, stats->decrypt_failures[i], 2);
+  }
+  length = writeCounter(record, length, stats->counter_rejects, 2);
+  length = writeCounter(record, length, stats->ring_drops, 2);
+  length = writeCounter(record, length, stats->cloud_reconnects, 2);
+  length = writeCounter(record, length, stats->cloud_cached_records, 2);
+  length = writeCounter(record, length, stats->cloud_replayed_records, 2);
+
+  record[length] = 0;
+  for ( i=0; i < length; i++ ) {
+    record[length] ^= record[i];
+  }
+}
+
+/**
+ * Writes one counter to the stats record in little endian.
+ *
+ * @param record                  Start of the stats record.
+ * @param offset                  Offset of the counter in the record.
+ * @param value                   Value of the counter.
+ * @param size                    Size of the counter in bytes.
+ * @return byte                   Offset of the next counter.
+ */
+byte Riots_MamaCloud::writeCounter(byte* record, byte offset, uint32_t value, byte size) {
+  byte i;
+
+  for ( i=0; i < size; i++ ) {
+    record[offset+i] = (byte)((value >> (8*i)) & 0xFF);
+  }
+  return offset + size;
+}
+
+/**
+ * Writes all the frames in the TX buffer to the ethernet shield.
+ *
+ * Data is only handed to the shield, it is not waited to be drained.
+ */
+void Riots_MamaCloud::flushToCloud() {
+  size_t written;
+
+  if ( tx_queue_envelope ) {
+    tx_queue_len = envelope.seal();
+    tx_queue_envelope = false;
+  }
+  if ( tx_queue_len > 0 ) {
+    _PROFILE_SCOPE(RIOTS_PROFILE_CLOUD_WRITE);
+    written = ethernet_client.write(tx_queue, tx_queue_len);
+    stats->cloud_bytes_up += written;
+    if ( written == tx_queue_len ) {
+      // any uplink traffic keeps the connection alive
+      last_cloud_activity = millis();
+    }
+    tx_queue_len = 0;
+  }
+}
+
 /**
  * Helper function for calculating the CRC cheksum.
  *
@@ -575,14 +1344,11 @@ void Riots_MamaCloud::connectionSettingsVerificated() {
 void Riots_MamaCloud::sendCoreNotReached() {
 
   if (data_blobs_available > 1) {
-  // flush the datablobs by reading those out from ethernet buffer.
-    for (int i = 0; i < DATA_BLOCK_SIZE*(data_blobs_available-1); i++) {
-      ethernet_client.read();
-    }
-  // plain data should be filled with the appropriate core not reached at this point
-  // issue the message to the cloud.
-  sendRequestToCloud(CLIENT_DATA_POST);
-  data_blobs_available = 0;
+    // flush the datablobs of this core
+    discardDataBlobs();
+    // plain data should be filled with the appropriate core not reached at this point
+    // issue the message to the cloud.
+    sendRequestToCloud(CLIENT_DATA_POST);
   }
 }
 
@@ -595,22 +1361,26 @@ void Riots_MamaCloud::sendCoreNotReached() {
 void Riots_MamaCloud::saveMessage() {
 
   if ( eeprom_status == RIOTS_OK ) {
+    _PROFILE_SCOPE(RIOTS_PROFILE_CACHE_WRITE);
+
     // check the current address
     activateLeds(RIOTS_MAMA_SAVE_DATA_COLOR);
 
-    startFilling();
+    byte record[I2C_EEPROM_MSG_SIZE];
+    time_t current_time = now();
 
     // save first current time:
-    fillByte((byte)((now() >> 24) & 0xFF));
-    fillByte((byte)((now() >> 16) & 0xFF));
-    fillByte((byte)((now() >> 8) & 0xFF));
-    fillByte((byte)(now() & 0xFF));
+    record[0] = (byte)((current_time >> 24) & 0xFF);
+    record[1] = (byte)((current_time >> 16) & 0xFF);
+    record[2] = (byte)((current_time >> 8) & 0xFF);
+    record[3] = (byte)(current_time & 0xFF);
 
     // save current datablob
-    for(uint8_t i=0; i < DATA_BLOCK_SIZE; i++) {
-      fillByte(plain_data[i]);
-    }
-    stopFilling();
+    memcpy(record+4, plain_data, DATA_BLOCK_SIZE);
+
+    riots_memory.writeBlock(current_msg_ind, record, I2C_EEPROM_MSG_SIZE, RIOTS_SECONDARY_EEPROM);
+    stats->cloud_cached_records++;
+    current_msg_ind += I2C_EEPROM_MSG_SIZE;
     pending_message = true;
 
     if ( current_msg_ind > I2C_EEPROM_MAX ) {
@@ -633,40 +1403,6 @@ void Riots_MamaCloud::saveMessage() {
   }
 }
 
-/**
- * Start filling to secondary EEPROM.
- *
- */
-void Riots_MamaCloud::startFilling() {
-    // start eeprom writing
-  riots_memory.startPageWrite(current_msg_ind, RIOTS_SECONDARY_EEPROM);
-}
-
-/**
- * Stop EEPROM filling.
- *
- */
-void Riots_MamaCloud::stopFilling() {
-    // stop eeprom writing
-    riots_memory.stopPageWrite();
-}
-
-/**
- * Writes a single byte to the SECONDARY eeprom.
- *
- * @param ch                      Byte to be written in EEPROM
- */
-void Riots_MamaCloud::fillByte(byte ch) {
-
-  current_msg_ind++;
-  if ( current_msg_ind % 128 == 0 ) {
-    // eeprom is 128 aligned, we need to jump to the next page
-    stopFilling();
-    startFilling();
-  }
-  riots_memory.pageFill(ch);
-}
-
 /**
  * Reads last cached message from the eeprom
  *
@@ -676,17 +1412,12 @@ void Riots_MamaCloud::fillByte(byte ch) {
  * @return bool                   True if the EEPROM is available.
  */
 bool Riots_MamaCloud::readLastCachedMessage(byte* read_buffer) {
-  if ( eeprom_status == RIOTS_OK ) {
-    _DEBUG_PRINT(last_saved_msg_ind);
-//    _DEBUG_PRINTLN(F("-->SEND"));
+  // read the whole record so that the datablob lands to the second block
+  // and the time just before it
+  if ( readCachedRecord(read_buffer+(DATA_BLOCK_SIZE-4)) ) {
 
-    // give a starting point to eeprom reader
-    riots_memory.startRead(last_saved_msg_ind, RIOTS_SECONDARY_EEPROM);
-
-    read_buffer[0] = riots_memory.sequentialRead();
-    read_buffer[1] = riots_memory.sequentialRead();
-    read_buffer[2] = riots_memory.sequentialRead();
-    read_buffer[3] = riots_memory.sequentialRead();
+    // move time to the begining of the first block
+    memcpy(read_buffer, read_buffer+(DATA_BLOCK_SIZE-4), 4);
 
     // add random filling
     fillRandomPadding(read_buffer+4, 11);
@@ -694,18 +1425,30 @@ bool Riots_MamaCloud::readLastCachedMessage(byte* read_buffer) {
     // add checksum
     read_buffer[15] = calcChecksum(read_buffer, DATA_BLOCK_SIZE-1);
 
-    // read datablob - 1 to the end of the buffer
-    for(uint8_t i=0; i < DATA_BLOCK_SIZE-1; i++) {
-      read_buffer[DATA_BLOCK_SIZE+i] = riots_memory.sequentialRead();
-    }
-    //read last byte to last index (datablock size x 2 - 1)
-    read_buffer[(DATA_BLOCK_SIZE*2)-1] = riots_memory.readLast();
-
     // encrypt the first part of the data
     AES128_ECB_encrypt(read_buffer, sess_key, read_buffer);
 
     // encrypt the second part of data with the session key
     AES128_ECB_encrypt(read_buffer+DATA_BLOCK_SIZE, sess_key, read_buffer+DATA_BLOCK_SIZE);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Reads the oldest cached record, time and datablob, from the eeprom as such.
+ *
+ * @param record                  Buffer for I2C_EEPROM_MSG_SIZE bytes.
+ * @return bool                   True if the EEPROM is available.
+ */
+bool Riots_MamaCloud::readCachedRecord(byte* record) {
+  if ( eeprom_status == RIOTS_OK ) {
+    _PROFILE_SCOPE(RIOTS_PROFILE_CACHE_READ);
+    _DEBUG_PRINT(last_saved_msg_ind);
+//    _DEBUG_PRINTLN(F("-->SEND"));
+
+    riots_memory.readBlock(last_saved_msg_ind, record, I2C_EEPROM_MSG_SIZE, RIOTS_SECONDARY_EEPROM);
+    stats->cloud_replayed_records++;
 
     // increase the counter
     last_saved_msg_ind += I2C_EEPROM_MSG_SIZE;
@@ -18,23 +18,25 @@
 #include "Riots_Helper.h"
 #include "Ethernet.h"
 #include "Riots_Mamadef.h"
+#include "Riots_Envelope.h"
 #include "Riots_Memory.h"
+#include "Riots_Radio.h"
 #include "Riots_RGBLed.h"
 
 class Riots_MamaCloud {
   public:
     void setAddresses(byte* plain_data_adr, byte* tx_crypt_buff_adr, byte* rx_crypt_buff_adr, byte* uniq_key_addr );
+    void setStatsAddress(Riots_Stats* stats_addr);
     void setup(byte indicativeLedsOn=0);
     byte update(byte *action_needed);
     byte* getNextReceiverAddress();
     byte getNextDataBlob();
+    byte getNextRelayBlob();
+    void relayDelivered(byte status);
     byte forwardToCloud();
     void processCachedMessage();
     void connectionSettingsVerificated();
     void sendCoreNotReached();
-    void startFilling();
-    void stopFilling();
-    void fillByte(byte ch);
 
   private:
     EthernetClient ethernet_client;/*!< Instance of the EthernetClient libary, used for connection network           */
@@ -42,6 +44,7 @@ class Riots_MamaCloud {
     Riots_Memory riots_memory;    /*!< Instance for reading and writing base's EEPROM                                */
     byte sess_key[16];            /*!< Received AES key for current TCP session                                      */
     byte challenge[4];            /*!< Challenge used for verifying the both direction connections                   */
+    byte base_mac[MAC_ADDRESS_SIZE]; /*!< MAC address of the base, read once from the primary EEPROM                */
     uint16_t current_msg_ind;     /*!< Next index where saved message should be saved to EEPROM                      */
     uint16_t last_saved_msg_ind;  /*!< Index of EEPROM where saved message should be read and forwarded              */
     byte* uni_aes;                /*!< ptr to Unique AES128 key for the mama, data allocated in Riots_MaraRadio side */
@@ -52,26 +55,76 @@ class Riots_MamaCloud {
     byte* tx_crypt_buff;          /*!< buffer to store crypted tx data and header                                    */
     byte data_blobs_available;    /*!< Count of the datablobs still available for reading                            */
     bool session_key_received;    /*!< Do we have connection available and valid session key.                        */
-    uint32_t myNextConnection;    /*!< Time for the next keep alive request                                          */
-    uint32_t myNextAttempt;       /*!< Time for the next connectiong attempt                                         */
+    uint32_t last_cloud_activity; /*!< Time of the last uplink or downlink traffic, keep alive is sent when idle     */
+    uint32_t last_dhcp_maintain;  /*!< Time of the previous DHCP lease check                                         */
+    uint32_t myNextAttempt;       /*!< Time of the previous connection attempt                                       */
+    uint32_t retry_delay;         /*!< Jittered wait before the next connection attempt                              */
+    uint32_t retry_backoff;       /*!< Current backoff without jitter, doubled on every failure                      */
+    uint32_t cloud_ip_resolved;   /*!< Time when the cloud address was resolved                                      */
+    uint32_t connect_started;     /*!< Time of the CONNECT command of the ongoing attempt                            */
+    uint16_t source_port;         /*!< Local port of the previous connection attempt                                 */
+    IPAddress cloud_ip;           /*!< Cached address of the cloud server                                            */
+    bool cloud_ip_valid;          /*!< Is the cached cloud address valid                                             */
+    byte connect_failures;        /*!< Count of failed connection attempts in a row                                  */
+    byte connection_state;        /*!< State of the cloud connection                                                 */
     byte eeprom_status;           /*!< Status of base eeprom                                                         */
     bool eeprom_looped_once;      /*!< internal eeprom has been filled once with full of data                        */
     bool connection_verificated;  /*!< Have the connection verified with the cloud                                   */
     bool pending_message;         /*!< Do we have saved messages in EEPROM                                           */
     bool time_received;           /*!< Have we yet received a correct time from the cloud.                           */
     byte indicativeLeds;          /*!< Has led indication requested from the INO                                     */
+    byte tx_queue[MAMA_CLOUD_TX_BUFFER_SIZE]; /*!< Outgoing frames waiting to be written to the cloud          */
+    byte tx_queue_len;            /*!< Count of bytes waiting in the tx_queue                                        */
+    uint32_t tx_queue_started;    /*!< Time when the first frame was added to the empty tx_queue                     */
+    bool tx_queue_envelope;       /*!< Does the tx_queue hold an open envelope                                       */
+    Riots_Envelope envelope;      /*!< Envelope encoder working on the tx_queue                                      */
+    byte cloud_protocol;          /*!< Protocol version accepted by the cloud                                        */
+    Riots_Stats* stats;           /*!< ptr to performance counters, data allocated in Riots_Radio side               */
+    uint32_t last_stats_sent;     /*!< Time when the counters were sent to the cloud                                 */
+    byte rx_state;                /*!< State of the downlink frame parser                                            */
+    byte rx_length;               /*!< Length of the frame currently parsed                                          */
+    byte rx_operation;            /*!< Operation of the frame currently parsed                                       */
+    byte rx_skip;                 /*!< Count of bytes still to be discarded from the current frame                   */
+    byte blob_ring[MAMA_CLOUD_BLOB_PREFETCH*DATA_BLOCK_SIZE]; /*!< Ring of prefetched and decrypted datablobs   */
+    byte blob_ring_head;          /*!< Index of the next datablob in the blob_ring                                   */
+    byte blob_ring_count;         /*!< Count of the datablobs in the blob_ring                                       */
+    byte relay_receiver[4];       /*!< Receiver block of the datablobs in the relay                                  */
+    byte relay_head;              /*!< Slot of the next datablob to be forwarded from the relay                      */
+    byte relay_count;             /*!< Count of the datablobs staged in the relay                                    */
+    byte relay_staging;           /*!< Count of the datablobs of the relay post still in the ethernet shield         */
+    byte relay_credit;            /*!< Count of the freed relay slots not yet reported to the cloud                  */
+    byte relay_retries;           /*!< Failed sends of the current relayed datablob                                  */
+    byte relay_status;            /*!< Status reported with the next relay credit                                    */
 
     // private functions starts from here
     void saveMessage();
     byte dhcpValidated();
     byte validateConnection();
+    bool parseCloudFrame(byte *action_needed, byte *status);
+    void prefetchDataBlobs();
+    void discardDataBlobs();
+    byte stageRelayBlobs(byte blobs);
+    void stageRelayChunk();
+    void resetRelay();
+    bool readFromCloud(byte* buffer, uint16_t length);
+    byte resolveCloudAddress();
+    byte startConnection();
+    byte pollConnection();
+    void maintainDhcp();
+    void connectionFailed();
     byte validateSession();
     byte validateReceiver();
     bool isMamaConfigMessage();
     void sendRequestToCloud(Riots_Message cloud_message_type);
+    void queueToCloud(byte* frame, byte length);
+    void flushToCloud();
+    void queueRecord(byte type, byte* value, byte length);
+    void writeStatsRecord(byte* record);
+    byte writeCounter(byte* record, byte offset, uint32_t value, byte size);
     void fillRandomPadding(byte* start_ptr, byte length);
     byte calcChecksum(byte* input, byte lenght);
     bool readLastCachedMessage(byte* read_buffer);
+    bool readCachedRecord(byte* record);
     void activateLeds(uint32_t rgb);
  };
 
@@ -16,8 +16,7 @@
 
 #include "aes.h"
 #include "nRF24L01.h"
-#include <avr/wdt.h>
-#include <avr/sleep.h>
+#include "Riots_Hal.h"
 
 #include <SPI.h>
 
@@ -52,6 +51,7 @@ void Riots_MamaRadio::setup(byte indicativeLedsOn, byte debug, int nrfce, int nr
   unique_aes      = riots_radio.getPrivateKeyAddress();
   shared_aes      = riots_radio.getSharedKeyAddress();
   own_address     = riots_radio.getOwnRadioAddress();
+  stats           = riots_radio.getStatsAddress();
 
   // If this is First Boot Firmware ID has been changed on EEPROM
   if (EEPROM.read(EEPROM_FIRST_BOOT) == 1) {
@@ -97,6 +97,7 @@ void Riots_MamaRadio::setRadioReceiverAddress(byte *new_address) {
     // Update new address to the radio
     riots_radio.setTXAddress(new_address);
     own_config_message = false;
+    group_send = new_address[0] == RIOTS_GROUP_ADDRESS_MARK;
   }
 }
 
@@ -127,6 +128,15 @@ byte* Riots_MamaRadio::getRXCryptBuffAddress() {
   return rx_crypt_buff;
 }
 
+/**
+ * Returns memory address of the performance counters
+ *
+ * @return                    Address of the counters
+ */
+Riots_Stats* Riots_MamaRadio::getStatsAddress() {
+  return stats;
+}
+
 /**
  * Returns memory address of the private key
  *
@@ -147,6 +157,9 @@ byte* Riots_MamaRadio::getPrivateKeyAddress() {
 */
 byte Riots_MamaRadio::update(byte sleep) {
 
+  // Write the completed firmware page while the next one is received
+  riots_flash.update();
+
   // Have we received data from radio hardware?
   return riots_radio.update(sleep);
 }
@@ -165,7 +178,8 @@ byte Riots_MamaRadio::processMsg(bool *reply_needed) {
   else {
   // Copy to TX buffer as we are going to forward this
     memcpy(tx_crypt_buff, rx_crypt_buff, RF_PAYLOAD_SIZE);
-    return riots_radio.send();
+    // Group members do not ACK, the frame is sent once
+    return riots_radio.send(group_send);
   }
 }
 
@@ -243,13 +257,18 @@ byte Riots_MamaRadio::handleOwnConfigMessage(bool *reply_needed) {
       case TYPE_ENTER_PROGMODE:  /* Fall through, flash related messages are handled in flash library */
       case TYPE_LEAVE_PROGMODE:
       case TYPE_LOAD_ADDRESS:
+      case TYPE_PAGE_HASH:
+      case TYPE_MISSING_PAGES:
       case TYPE_PROG_FLASH:
         status = checkCounter();
       case TYPE_PROG_PAGE:
+      case TYPE_PROG_PAGE_LZ:
+      case TYPE_PROG_PAGE_DELTA:
         status = riots_flash.handleFlashMessage(last_message_type, plain_data, reply_needed );
         if ( *reply_needed ) {
           *reply_needed = CONFIRM_CONFIG;
-          if ( last_message_type == TYPE_PROG_PAGE ) {
+          if ( last_message_type == TYPE_PROG_PAGE || last_message_type == TYPE_PROG_PAGE_LZ ||
+               last_message_type == TYPE_PROG_PAGE_DELTA ) {
             // Confirm LOAD_ADDRESS configuration after all packages has been received successfully
             // or when first failure happens
             if (indicativeLeds == 1) {
@@ -332,9 +351,10 @@ void Riots_MamaRadio::createResponse(byte answer_type, byte message_type, byte s
   plain_data[M_CHILD_ID+1]  = childId[1];
 
   if (answer_type == TYPE_CONFIRM_CONFIG) {
-    plain_data[M_LENGTH]    = 0x2;
     plain_data[M_VALUE]     = message_type; // Received message type
     plain_data[M_STATUS]    = status;
+    // Flash confirms may carry more data
+    plain_data[M_LENGTH]    = riots_flash.addConfirmData(message_type, &plain_data[M_STATUS+1]);
   }
 
   else if (answer_type == TYPE_CORE_NOT_REACHED) {
@@ -388,5 +408,6 @@ byte Riots_MamaRadio::checkCounter() {
     configCounter[1] = plain_data[M_COUNTER+1];
     return RIOTS_OK;
   }
+  stats->counter_rejects++;
   return RIOTS_FAIL;
 }
@@ -28,6 +28,7 @@ class Riots_MamaRadio{
     byte* getTXCryptBuffAddress();
     byte* getRXCryptBuffAddress();
     byte* getPrivateKeyAddress();
+    Riots_Stats* getStatsAddress();
     byte update(byte sleep=0);
     byte checkRiotsMsgValidity();
     bool messageDelivered(byte status);
@@ -48,7 +49,9 @@ class Riots_MamaRadio{
     byte* plain_data;                   /*!< ptr to plain data which is shared between the libraries                        */
     byte* tx_crypt_buff;                /*!< buffer to store crypted tx data and header                                     */
     byte* rx_crypt_buff;                /*!< buffer to store crypted rx data and header                                     */
+    Riots_Stats* stats;                 /*!< ptr to performance counters, data allocated in Riots_Radio side                */
     bool own_config_message;            /*!< Is next message meant for me?                                                  */
+    bool group_send;                    /*!< Is next message sent to an update group, without ACK                           */
     bool first_aes_part_received;       /*!< Have we received first part of new AES key                                     */
     byte last_message_type;             /*!< Last delivered message type                                                    */
     bool alive_msg_sent;                /*!< Have we sent alive message to the cloud                                        */
@@ -13,14 +13,147 @@
  */
 
 #include "Riots_Memory.h"
-#include <util/twi.h>
+#include "Riots_Helper.h"
+#include "Riots_Profile.h"
+#include "Riots_Hal.h"
 
-// Start I2c
+/* I2C bus speed, shared with the libraries using Wire. Standard mode until
+   setup() has found the EEPROM with F_SCL. */
+uint32_t Riots_Memory::bus_speed = RIOTS_I2C_STANDARD_MODE;
+bool Riots_Memory::bus_probed = false;
+
+/* EEPROMs busy with their internal write cycle, polled before they are accessed again */
+uint8_t Riots_Memory::write_pending = 0;
+uint8_t Riots_Memory::write_device = 0;
+uint32_t Riots_Memory::write_started[RIOTS_EEPROM_COUNT];
+
+/**
+ * Start I2C and check that the EEPROM answers.
+ *
+ * Bus is probed with the preferred speed first. If the EEPROM does not answer
+ * or the bus hangs, speed is dropped to the standard mode and probed again.
+ * Until a probe has succeeded, the libraries using Wire stay in the standard
+ * mode.
+ *
+ * @param eeprom_addr         I2C bus address of the EEPROM.
+ * @return uint8_t            1 if the EEPROM was found, otherwise 0.
+ */
 uint8_t Riots_Memory::setup(uint8_t eeprom_addr) {
-  uint8_t ret = 1;
+  uint8_t ret;
+
+  if( !bus_probed ) {
+    bus_speed = F_SCL;
+  }
+  applyBusSpeed();
+  // EEPROM does not answer during its write cycle, that is not a bus problem
+  waitWriteCycle(eeprom_addr);
+  ret = probe(eeprom_addr);
+  if( !ret ) {
+    // a write cycle may still run from before the reset
+    delay(I2C_WRITE_CYCLE_TIME);
+    ret = probe(eeprom_addr);
+  }
+  if( !ret && bus_speed > RIOTS_I2C_STANDARD_MODE ) {
+    // Fast mode failed, fall back to standard mode for good
+    setBusSpeed(RIOTS_I2C_STANDARD_MODE);
+    ret = probe(eeprom_addr);
+  }
+  // without an answer at all the preferred speed is probed again with the next EEPROM
+  bus_probed = ret;
+  return ret;
+}
+
+/**
+ * Sets new I2C bus speed and takes it into use.
+ *
+ * @param scl_freq            SCL frequency in Hz.
+ */
+void Riots_Memory::setBusSpeed(uint32_t scl_freq) {
+  bus_speed = scl_freq;
+  bus_probed = true;
+  applyBusSpeed();
+}
+
+/**
+ * Returns the I2C bus speed currently in use.
+ *
+ * @return uint32_t           SCL frequency in Hz.
+ */
+uint32_t Riots_Memory::getBusSpeed() {
+  return bus_speed;
+}
+
+/**
+ * Writes the shared bus speed to the TWI bit rate register. Wire.begin()
+ * resets the speed to 100 kHz, so Wire users call this after it.
+ */
+void Riots_Memory::applyBusSpeed() {
+  applyBusSpeed(bus_speed);
+}
+
+/**
+ * Writes the speed to the TWI bit rate register without changing the shared
+ * one, for a device slower than the rest of the bus. The shared speed is
+ * restored with applyBusSpeed() after its transaction.
+ *
+ * @param scl_freq            SCL frequency in Hz.
+ */
+void Riots_Memory::applyBusSpeed(uint32_t scl_freq) {
   TWSR = 0; // set prescalar to zero
-  TWBR = ((F_CPU/F_SCL)-16)/2; // set SCL frequency in TWI bit register
-  ret = I2C_Start();
+  TWBR = ((F_CPU/scl_freq)-16)/2; // set SCL frequency in TWI bit register
+}
+
+/**
+ * Returns the index of the EEPROM in the write cycle tracking.
+ *
+ * @param eeprom_addr         I2C bus address of the EEPROM.
+ * @return uint8_t            Index, RIOTS_EEPROM_COUNT if the EEPROM is not tracked.
+ */
+uint8_t Riots_Memory::eepromIndex(uint8_t eeprom_addr) {
+  uint8_t index = (uint8_t)(eeprom_addr - RIOTS_PRIMARY_EEPROM) >> 1;
+
+  return index < RIOTS_EEPROM_COUNT ? index : RIOTS_EEPROM_COUNT;
+}
+
+/**
+ * Polls the EEPROM in the write cycle without blocking. The EEPROM does not
+ * acknowledge its address until the cycle has ended (ACK polling). Every
+ * EEPROM has its own write cycle, so a write to the other one does not
+ * affect the result.
+ *
+ * @param eeprom_addr         I2C bus address of the EEPROM.
+ * @return bool               True if no write cycle is pending.
+ */
+bool Riots_Memory::isWriteDone(uint8_t eeprom_addr) {
+  uint16_t timeout = I2C_TIMEOUT;
+  uint8_t index = eepromIndex(eeprom_addr);
+
+  if( index == RIOTS_EEPROM_COUNT || !bitRead(write_pending, index) ) {
+    return true;
+  }
+
+  // let the stop condition of the write finish first
+  while( (TWCR & (1<<TWSTO)) && --timeout );
+
+  if( probe(eeprom_addr) || millis() - write_started[index] > I2C_WRITE_CYCLE_TIME ) {
+    bitClear(write_pending, index);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Waits until the given EEPROM has finished its write cycle. Accesses to
+ * the other EEPROM do not need to wait.
+ *
+ * @param eeprom_addr         I2C bus address of the EEPROM.
+ */
+void Riots_Memory::waitWriteCycle(uint8_t eeprom_addr) {
+  while( !isWriteDone(eeprom_addr) );
+}
+
+uint8_t Riots_Memory::probe(uint8_t eeprom_addr) {
+  uint8_t ret = I2C_Start();
   if(ret) {
     ret = I2C_SendAddr(eeprom_addr); // send bus address
   }
@@ -28,13 +161,25 @@ uint8_t Riots_Memory::setup(uint8_t eeprom_addr) {
   return ret;
 }
 
+uint8_t Riots_Memory::I2C_Wait() {
+  uint16_t timeout = I2C_TIMEOUT;
+  while( !(TWCR & (1<<TWINT)) ) {
+    if( --timeout == 0 ) {
+      // bus hangs, release the TWI hardware
+      TWCR = 0;
+      return 0;
+    }
+  }
+  return 1;
+}
+
 uint8_t Riots_Memory::I2C_Start() {
   // reset TWI control register
   TWCR = 0;
   // transmit START condition
   TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
   // wait for end of transmission
-  while( !(TWCR & (1<<TWINT)) );
+  if( !I2C_Wait() ) { return 0; }
 
   // check if the start condition was successfully transmitted
 	if((TWSR & 0xF8) != TW_START){ return 0; }
@@ -44,7 +189,7 @@ uint8_t Riots_Memory::I2C_Start() {
 uint8_t Riots_Memory::I2C_SendAddr(uint8_t addr) {
   TWDR = addr; // load device's bus address
   TWCR = TW_SEND; // and send it
-  while (!TW_READY); // wait
+  if( !I2C_Wait() ) { return 0; } // wait
   return (TW_STATUS==0x18); // return 1 if found; 0 otherwise
 }
 
@@ -52,7 +197,7 @@ uint8_t Riots_Memory::I2C_Write(uint8_t data) {
   TWDR = data; // load data to be sent
 
   TWCR = (1<<TWINT) | (1<<TWEN);
-  while ((TWCR & (1<<TWINT)) == 0);
+  if( !I2C_Wait() ) { return 1; }
 
   if( (TWSR & 0xF8) != TW_MT_DATA_ACK ){ return 1; }
   return 0;
@@ -60,30 +205,29 @@ uint8_t Riots_Memory::I2C_Write(uint8_t data) {
 
 uint8_t Riots_Memory::I2C_ReadNACK() {
   TWCR = (1<<TWINT)|(1<<TWEN);
-  while ((TWCR & (1<<TWINT)) == 0);
+  if( !I2C_Wait() ) { return I2C_READ_FAILED; }
   return TWDR;
 }
 
 uint8_t Riots_Memory::I2C_ReadACK() {
   TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWEA);
-  while ((TWCR & (1<<TWINT)) == 0);
+  if( !I2C_Wait() ) { return I2C_READ_FAILED; }
   return TWDR;
 }
 
 /* Writes a single byte to I2C eeprom */
 void Riots_Memory::write(uint16_t page_addr, uint8_t data, uint8_t eeprom_addr) {
-  I2C_Start();
-  I2C_SendAddr(eeprom_addr); // send bus address
-  I2C_Write((page_addr>>8)&0xFF); // first uint8_t = device register address
-  I2C_Write(page_addr&0xFF); // first uint8_t = device register address
+  _PROFILE_SCOPE(RIOTS_PROFILE_MEMORY_WRITE);
+  startPageWrite(page_addr, eeprom_addr);
   I2C_Write(data);
-  I2C_Stop();
-  //Todo: Check from data sheet is shorter delay enough for single byte write
-  delay(5);
+  stopPageWrite();
 }
 
 void Riots_Memory::startPageWrite(uint16_t page_addr, uint8_t eeprom_addr) {
+  waitWriteCycle(eeprom_addr);
   I2C_Start();
+  // stopPageWrite() starts the write cycle of this EEPROM
+  write_device = eeprom_addr;
   I2C_SendAddr(eeprom_addr); // send bus address
   I2C_Write((page_addr>>8)&0xFF); // first uint8_t = device register address
   I2C_Write(page_addr&0xFF); // first uint8_t = device register address
@@ -95,12 +239,19 @@ void Riots_Memory::pageFill(uint8_t data) {
 }
 
 void Riots_Memory::stopPageWrite() {
+  uint8_t index = eepromIndex(write_device);
+
   I2C_Stop();
-  delay(5);
+  // write cycle runs in the background, next access to the EEPROM polls for its end
+  if( index < RIOTS_EEPROM_COUNT ) {
+    bitSet(write_pending, index);
+    write_started[index] = millis();
+  }
 }
 
 
 void Riots_Memory::startRead(uint16_t page_addr, uint8_t eeprom_addr) {
+  waitWriteCycle(eeprom_addr);
   I2C_Start();
   I2C_SendAddr(eeprom_addr); // send bus address
   I2C_Write((page_addr>>8) & 0xFF);
@@ -121,11 +272,69 @@ uint8_t Riots_Memory::readLast() {
   return data;
 }
 
+/**
+ * Reads a block of data with a single sequential read.
+ *
+ * @param addr                First EEPROM address to read.
+ * @param data                Buffer where the data is read to.
+ * @param length              Count of bytes to read.
+ * @param eeprom_addr         I2C bus address of the EEPROM.
+ */
+void Riots_Memory::readBlock(uint16_t addr, uint8_t *data, uint16_t length, uint8_t eeprom_addr) {
+  _PROFILE_SCOPE(RIOTS_PROFILE_MEMORY_READ);
+
+  if( length == 0 ) {
+    return;
+  }
+  startRead(addr, eeprom_addr);
+  for(uint16_t i=0; i < length-1; i++) {
+    data[i] = I2C_ReadACK();
+    if( !(TWCR & (1<<TWEN)) ) {
+      // bus hang released the TWI, do not wait for every remaining byte
+      memset(&data[i], I2C_READ_FAILED, length-i);
+      return;
+    }
+  }
+  data[length-1] = readLast();
+}
+
+/**
+ * Writes a block of data. Write is split to page writes so that no write
+ * wraps around the end of an EEPROM page.
+ *
+ * @param addr                First EEPROM address to write.
+ * @param data                Data to be written.
+ * @param length              Count of bytes to write.
+ * @param eeprom_addr         I2C bus address of the EEPROM.
+ */
+void Riots_Memory::writeBlock(uint16_t addr, const uint8_t *data, uint16_t length, uint8_t eeprom_addr) {
+  uint16_t chunk;
+  _PROFILE_SCOPE(RIOTS_PROFILE_MEMORY_WRITE);
+
+  while( length > 0 ) {
+    // write only up to the end of the current page
+    chunk = I2C_EEPROM_PAGE_SIZE - (addr % I2C_EEPROM_PAGE_SIZE);
+    if( chunk > length ) {
+      chunk = length;
+    }
+    startPageWrite(addr, eeprom_addr);
+    for(uint16_t i=0; i < chunk; i++) {
+      I2C_Write(data[i]);
+    }
+    stopPageWrite();
+
+    addr   += chunk;
+    data   += chunk;
+    length -= chunk;
+  }
+}
 
 /* Reads a single byte from I2C eeprom */
 uint8_t Riots_Memory::read(uint16_t page_addr, uint8_t eeprom_addr) {
   uint8_t data = 0;
+  _PROFILE_SCOPE(RIOTS_PROFILE_MEMORY_READ);
 
+  waitWriteCycle(eeprom_addr);
   I2C_Start();
   I2C_SendAddr(eeprom_addr); // send bus address
   I2C_Write((page_addr>>8) & 0xFF);
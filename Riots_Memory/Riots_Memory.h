@@ -20,11 +20,20 @@
 
 #define RIOTS_PRIMARY_EEPROM    0xA0  // I2C bus address of primary x24C01 EEPROM
 #define RIOTS_SECONDARY_EEPROM  0xA2  // I2C bus address of secondary x24C01 EEPROM
-#define F_SCL 100000L                 // I2C clock speed 100 kHz
+#define RIOTS_EEPROM_COUNT      2     // EEPROMs with tracked write cycles, from RIOTS_PRIMARY_EEPROM on
+#define RIOTS_I2C_STANDARD_MODE 100000L // I2C clock speed 100 kHz, supported by every device on the bus
+#define RIOTS_I2C_FAST_MODE     400000L // I2C clock speed 400 kHz, supported by 24-series EEPROMs and Riots sensors
+#ifndef F_SCL
+#define F_SCL RIOTS_I2C_FAST_MODE       // Preferred I2C clock speed, used after setup() has probed it
+#endif
+#define I2C_TIMEOUT 2000              // Max. polls of TWINT before I2C transaction is considered failed
+#define I2C_READ_FAILED 0xFF          // Data of a failed read, a released bus reads as ones
+#define I2C_WRITE_CYCLE_TIME 5        // Max. EEPROM write cycle time in ms, polling gives up after this
 #define TW_SEND 0x84                  // send data (TWINT,TWEN)
-#define TW_START 0xA4                 // send start condition (TWINT,TWSTA,TWEN)
 #define TW_READY (TWCR & 0x80)        // ready when TWINT returns to logic 1.
-#define TW_STATUS (TWSR & 0xF8)       // returns value of status register
+#ifndef TW_STATUS
+#define TW_STATUS (TWSR & 0xF8)       // returns value of status register, util/twi.h has the same
+#endif
 #define TW_STOP 0x94                  // send stop condition (TWINT,TWSTO,TWEN)
 #define I2C_Stop() TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO) // inline macro for stop condition
 #define TW_NACK 0x84                  // read data with NACK (last uint8_t)
@@ -40,8 +49,24 @@ class Riots_Memory {
     static void startRead(uint16_t page_addr, uint8_t eeprom_addr);                               /*!< Starts reading from the given address*/
     static uint8_t sequentialRead();                                                              /*!< Starts sequntial reading             */
     static uint8_t readLast();                                                                    /*!< Read last data and stops reading     */
+    static void readBlock(uint16_t addr, uint8_t *data, uint16_t length, uint8_t eeprom_addr=RIOTS_PRIMARY_EEPROM);       /*!< Reads a block */
+    static void writeBlock(uint16_t addr, const uint8_t *data, uint16_t length, uint8_t eeprom_addr=RIOTS_PRIMARY_EEPROM);/*!< Writes a block*/
+    static void setBusSpeed(uint32_t scl_freq);                                                   /*!< Sets and applies the I2C bus speed   */
+    static uint32_t getBusSpeed();                                                                /*!< Returns the current I2C bus speed    */
+    static void applyBusSpeed();                                                                  /*!< Restores bus speed after Wire.begin()*/
+    static void applyBusSpeed(uint32_t scl_freq);                                                 /*!< Uses a speed for a slower device     */
+    static bool isWriteDone(uint8_t eeprom_addr);                                                 /*!< Polls if the write cycle has ended   */
+    static void waitWriteCycle(uint8_t eeprom_addr);                                              /*!< Waits for the write cycle of EEPROM  */
 
   private:
+    static uint32_t bus_speed;                                                                    /*!< I2C bus speed shared with Wire users */
+    static bool bus_probed;                                                                       /*!< Has setup() found the bus speed      */
+    static uint8_t write_pending;                                                                 /*!< Bit per EEPROM in its write cycle    */
+    static uint8_t write_device;                                                                  /*!< EEPROM of the page write in progress */
+    static uint32_t write_started[RIOTS_EEPROM_COUNT];                                            /*!< Times when the write cycles started  */
+    static uint8_t eepromIndex(uint8_t eeprom_addr);                                              /*!< Index of the EEPROM in write tracking*/
+    static uint8_t I2C_Wait();                                                                    /*!< Waits for the TWINT flag             */
+    static uint8_t probe(uint8_t eeprom_addr);                                                    /*!< Checks that the EEPROM answers       */
     static void I2C_Init();                                                                       /*!< Initializes I2C bus                  */
     static uint8_t I2C_Start();                                                                   /*!< Starts I2C communication             */
     static uint8_t I2C_SendAddr(uint8_t addr);                                                    /*!< Sends data to given address          */
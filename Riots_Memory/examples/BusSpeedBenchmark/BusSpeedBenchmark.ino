@@ -0,0 +1,93 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * I2C bus speed benchmark for a Mama.
+ *
+ * A full firmware image is staged page by page, as Riots_Flash does, and the
+ * message cache is drained record by record, as Riots_MamaCloud does. Both are
+ * run in the standard mode and in the fast mode and the times are printed to
+ * the serial port.
+ *
+ * The secondary EEPROM is used for both, the cached messages in it are lost.
+ */
+#include "Riots_Helper.h"
+#include "Riots_Mamadef.h"
+#include "Riots_Memory.h"
+
+#define BENCH_PAGES     (0x6F80 / I2C_EEPROM_PAGE_SIZE) // pages of a full image
+#define BENCH_RECORDS   1000                            // cached messages drained
+
+uint8_t buffer[I2C_EEPROM_PAGE_SIZE];
+
+/**
+ * Writes the pages of an image, the last write cycle included.
+ */
+unsigned long stageImage() {
+  unsigned long start = millis();
+
+  for (uint16_t page = 0; page < BENCH_PAGES; page++) {
+    buffer[0] = page;
+    Riots_Memory::writeBlock(I2C_EEPROM_MIN + page*I2C_EEPROM_PAGE_SIZE, buffer, I2C_EEPROM_PAGE_SIZE,
+                             RIOTS_SECONDARY_EEPROM);
+  }
+  Riots_Memory::waitWriteCycle(RIOTS_SECONDARY_EEPROM);
+  return millis() - start;
+}
+
+/**
+ * Reads the cached messages one record at a time.
+ */
+unsigned long drainCache() {
+  unsigned long start = millis();
+
+  for (uint16_t record = 0; record < BENCH_RECORDS; record++) {
+    Riots_Memory::readBlock(I2C_EEPROM_MIN + record*I2C_EEPROM_MSG_SIZE, buffer, I2C_EEPROM_MSG_SIZE,
+                            RIOTS_SECONDARY_EEPROM);
+  }
+  return millis() - start;
+}
+
+void bench(uint32_t scl_freq) {
+  Riots_Memory::setBusSpeed(scl_freq);
+  Serial.print(scl_freq / 1000);
+  Serial.print(F(" kHz: image staged in "));
+  Serial.print(stageImage());
+  Serial.print(F(" ms, "));
+  Serial.print(BENCH_RECORDS);
+  Serial.print(F(" cached messages drained in "));
+  Serial.print(drainCache());
+  Serial.println(F(" ms"));
+}
+
+void setup() {
+  Serial.begin(38400);
+  memset(buffer, 0x5A, sizeof(buffer));
+
+  if ( !Riots_Memory::setup(RIOTS_SECONDARY_EEPROM) ) {
+    Serial.println(F("Secondary EEPROM not found"));
+    return;
+  }
+  if ( Riots_Memory::getBusSpeed() < RIOTS_I2C_FAST_MODE ) {
+    Serial.println(F("Fast mode probe failed, the bus stays in the standard mode"));
+    bench(RIOTS_I2C_STANDARD_MODE);
+    return;
+  }
+
+  bench(RIOTS_I2C_STANDARD_MODE);
+  bench(RIOTS_I2C_FAST_MODE);
+}
+
+void loop() {
+}
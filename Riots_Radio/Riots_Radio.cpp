@@ -16,12 +16,12 @@
 #include "Arduino.h"
 #include <EEPROM.h>
 #include <SPI.h>
-#include <avr/wdt.h>
-#include <avr/sleep.h>
+#include "Riots_Hal.h"
 #include "aes.h"
 #include "nRF24L01.h"
 
 #include "Riots_Radio.h"
+#include "Riots_Profile.h"
 
 /**
  * Setup function sets given ce, csn, irq and reset pins.
@@ -39,6 +39,8 @@ int Riots_Radio::setup(int nrfce, int nrfcsn, int nrfirq, int nrfrst) {
 
   wdt_reset();
 
+  memset(&stats, 0, sizeof(stats));
+
   ce_pin = nrfce;
   if(ce_pin == 0xFF) ce_pin = EEPROM.read(EEPROM_RADIO_CE);
   if(ce_pin == 0xFF || ce_pin == 0x00) ce_pin = RIOTS_CE_PIN;
@@ -85,7 +87,15 @@ int Riots_Radio::setup(int nrfce, int nrfcsn, int nrfirq, int nrfrst) {
   for (int i=0; i < AES_KEY_SIZE; i++) {
     shared_aes[i] = EEPROM.read(EEPROM_AES_CHANGING+i);
     unique_aes[i] = EEPROM.read(EEPROM_AES_UNIQUE+i);
+    group_aes[i]  = EEPROM.read(EEPROM_AES_GROUP+i);
+  }
+  // Sequence survives resets, group frames captured before are not accepted again
+  group_sequence = (EEPROM.read(EEPROM_GROUP_SEQUENCE)<<8) | EEPROM.read(EEPROM_GROUP_SEQUENCE+1);
+  if (group_sequence == 0xFFFF) {
+    // erased EEPROM, no sequence accepted yet
+    group_sequence = 0;
   }
+  deriveGroupPageKey();
 
   // Configure nrf24l01 radio
   regw(W_REGISTER | EN_AA,      0x01);            // Enable auto-ack for data pipe 0
@@ -95,6 +105,23 @@ int Riots_Radio::setup(int nrfce, int nrfcsn, int nrfirq, int nrfrst) {
   regw(W_REGISTER | RF_CH,      0x42);            // Channel selection
   regw(W_REGISTER | RX_PW_P0,   RF_PAYLOAD_SIZE); // 16 bytes payload
   regw(W_REGISTER | RF_SETUP,   0x26);            // 250kbps transmission rate
+  regw(W_REGISTER | RX_PW_P1,   RF_PAYLOAD_SIZE); // 16 bytes payload for the group pipe
+
+  // nRF24L01 ignores FEATURE until ACTIVATE, nRF24L01+ ignores ACTIVATE. ACTIVATE
+  // toggles the features, so it is not sent again once they are enabled.
+  if (regr(FEATURE) != (1 << EN_DYN_ACK)) {
+    regw(ACTIVATE, 0x73);
+  }
+  regw(W_REGISTER | FEATURE,    1 << EN_DYN_ACK); // Allow sending without ACK to groups
+
+  // Listen to the group address if one is configured
+  for (int i=0; i < RF_ADDRESS_SIZE; i++) {
+    GA[i] = EEPROM.read(EEPROM_GROUP_ADDR+i);
+  }
+  if (GA[0] == RIOTS_GROUP_ADDRESS_MARK) {
+    regw4(W_REGISTER | RX_ADDR_P1, GA);
+    regw(W_REGISTER | EN_RXADDR, (1 << ERX_P0) | (1 << ERX_P1)); // Receive the group pipe too, EN_AA leaves it without auto-ack
+  }
 
   // Flush FIFOS
   digitalWriteFast(csn_pin, LOW);
@@ -175,6 +202,33 @@ byte* Riots_Radio::getPrivateKeyAddress() {
 }
 
 
+/**
+ * Returns memory address of the group key
+ *
+ * @return            Address of the group key array
+ */
+byte* Riots_Radio::getGroupKeyAddress() {
+  return group_aes;
+}
+
+/**
+ * Returns memory address of the group key of the page packets
+ *
+ * @return            Address of the page key array
+ */
+byte* Riots_Radio::getGroupPageKeyAddress() {
+  return group_page_aes;
+}
+
+/**
+ * Returns pipe of the last received frame, RIOTS_GROUP_PIPE for group frames
+ *
+ * @return            Pipe number
+ */
+byte Riots_Radio::getRxPipe() {
+  return rx_pipe;
+}
+
 /**
  * Returns memory address of the shared key
  *
@@ -189,22 +243,33 @@ byte* Riots_Radio::getDebugBufferAddress() {
   return debug_buffer;
 }
 
+/**
+ * Returns memory address of the performance counters
+ *
+ * @return            Address of the counters
+ */
+Riots_Stats* Riots_Radio::getStatsAddress() {
+  return &stats;
+}
+
 /**
 * Sends a message to previous configured recipient
 *
+* @param no_ack     Send without waiting ACK, used for the group addresses
 * @return byte      False if message was not delivered successfully
 */
-byte Riots_Radio::send() {
+byte Riots_Radio::send(byte no_ack) {
 
   byte retvalue;
 
   long send_start = millis();
+  _PROFILE_START(timer);
 
   // Switch to transmitter mode
   transmitter();
   // Write radiosend buffer to SPI
   digitalWriteFast(csn_pin, LOW);
-  SPI.transfer(W_TX_PAYLOAD);
+  SPI.transfer(no_ack ? W_TX_PAYLOAD_NOACK : W_TX_PAYLOAD);
 
   _DEBUG_EXT_PRINT(F("Riots_Radio::send tx_crypt_buff: "));
   for (int i=0; i<RF_PAYLOAD_SIZE; i++) {
@@ -214,18 +279,27 @@ byte Riots_Radio::send() {
   }
   _DEBUG_EXT_PRINTLN(F(""));
   digitalWriteFast(csn_pin, HIGH);
+  _PROFILE_LAP(RIOTS_PROFILE_RADIO_LOAD, timer);
   digitalWriteFast(ce_pin, HIGH);
 
   while(digitalRead(irq_pin)) {
     if((millis() - send_start) > MAX_RADIO_AIRTIME) {
       // fix problem where IRQ pin occassionally doesn't go down
+      stats.radio_airtime_timeouts++;
       break;
     }
   }
   digitalWriteFast(ce_pin, LOW);
+  _PROFILE_LAP(RIOTS_PROFILE_RADIO_AIRTIME, timer);
 
   retvalue = writeInterrupt();
   receiver();
+  _PROFILE_STOP(RIOTS_PROFILE_RADIO_SWITCH, timer);
+
+  stats.radio_tx_frames++;
+  if ( retvalue != RIOTS_OK ) {
+    stats.radio_tx_failures++;
+  }
 
   return retvalue;
 }
@@ -250,11 +324,11 @@ void Riots_Radio::wdtSleep() {
 
   set_sleep_mode(SLEEP_MODE_PWR_DOWN);
   // Turn off ad converter
-  ADCSRA = 0;
+  RIOTS_ADC_DISABLE();
   // Power down radio
   regw(W_REGISTER | CONFIG,      0x0D);
   // Enable watchdog interrupt
-  WDTCSR |= (1 << WDIE);
+  RIOTS_WDT_INTERRUPT_ENABLE();
   // Reset watchdog
   wdt_reset();
   // Enter to sleep mode
@@ -299,6 +373,7 @@ byte Riots_Radio::update(byte sleep) {
 */
 byte Riots_Radio::decrypt(byte *key) {
   byte checksum = 0;
+  _PROFILE_SCOPE(RIOTS_PROFILE_RADIO_DECRYPT);
 
   // Uses a given key for decrypting
   AES128_ECB_decrypt(rx_crypt_buff, key, plain_data);
@@ -314,6 +389,22 @@ byte Riots_Radio::decrypt(byte *key) {
       return RIOTS_OK;
     }
   }
+  if ( key == shared_aes ) {
+    stats.decrypt_failures[RIOTS_STATS_SHARED_KEY]++;
+  }
+  else if ( key == unique_aes ) {
+    stats.decrypt_failures[RIOTS_STATS_UNIQUE_KEY]++;
+  }
+  else if ( key == group_aes ) {
+    stats.decrypt_failures[RIOTS_STATS_GROUP_KEY]++;
+  }
+  else if ( key == group_page_aes ) {
+    // Tried first for every group frame, failures are counted with the group key
+    return RIOTS_FAIL;
+  }
+  else {
+    stats.decrypt_failures[RIOTS_STATS_OTHER_KEY]++;
+  }
   return RIOTS_FAIL;
 }
 
@@ -437,7 +528,8 @@ void Riots_Radio::readData() {
   // Read payload
   _DEBUG_EXT_PRINT(F("Riots_Radio::readData rx_crypt_buff: "));
   digitalWrite(csn_pin, LOW);
-  SPI.transfer(R_RX_PAYLOAD);
+  // STATUS is clocked out with the command, it tells the pipe of the payload
+  rx_pipe = (SPI.transfer(R_RX_PAYLOAD) >> RX_P_NO) & 0x07;
   for (int i=0; i < RF_PAYLOAD_SIZE; i++) {
     rx_crypt_buff[i] = SPI.transfer(0);
     _DEBUG_EXT_PRINT(rx_crypt_buff[i],HEX);
@@ -445,6 +537,7 @@ void Riots_Radio::readData() {
   }
   _DEBUG_EXT_PRINTLN(F(""));
   digitalWrite(csn_pin, HIGH);
+  stats.radio_rx_frames++;
 
   // Clear interrupt
   digitalWrite(csn_pin, LOW);
@@ -461,6 +554,7 @@ void Riots_Radio::readData() {
   // Data in RX FIFO
   if((fifostat & (1 << RX_EMPTY)) == 0) {
     rxbuffer = 1;
+    stats.radio_rx_backlog++;
   }
   else {
     rxbuffer = 0;
@@ -484,6 +578,22 @@ void Riots_Radio::regw(byte reg, byte val) {
   digitalWrite(csn_pin, HIGH);
 }
 
+/**
+* Reads value of the register.
+*
+* @param reg      Register to be read.
+* @return byte    Value of the register.
+*/
+byte Riots_Radio::regr(byte reg) {
+  byte val;
+
+  digitalWrite(csn_pin, LOW);
+  SPI.transfer(R_REGISTER | reg);
+  val = SPI.transfer(0x00);
+  digitalWrite(csn_pin, HIGH);
+  return val;
+}
+
 /**
 * Writes given values to register.
 *
@@ -516,6 +626,97 @@ void Riots_Radio::saveNewAesKey(byte part_number, byte *new_key) {
   }
 }
 
+/**
+* Saves a part of the group key to memory and EEPROM
+*
+* @param part_number    Part 0 or 1 of the key
+* @param group_key_part 8 bytes of the key
+*/
+void Riots_Radio::saveGroupKey(byte part_number, byte *group_key_part) {
+  if ( part_number == 0 || part_number == 1) {
+    // allow only correct numbers, to prevent memory writing problems
+    memcpy(group_aes+(part_number*AES_MSG_DELIVERY_SIZE), group_key_part, AES_MSG_DELIVERY_SIZE);
+    // New update, sequence numbers start over
+    saveGroupSequence(0);
+    for (int i = 0; i < AES_MSG_DELIVERY_SIZE; i++) {
+      EEPROM.write(EEPROM_AES_GROUP+(part_number*AES_MSG_DELIVERY_SIZE)+i, group_key_part[i]);
+    }
+  }
+}
+
+/**
+* Saves the group address to EEPROM and starts listening to it. Address not
+* starting with RIOTS_GROUP_ADDRESS_MARK leaves the group.
+*
+* @param address        Group radio address
+*/
+void Riots_Radio::setGroupAddress(byte *address) {
+  memcpy(GA, address, RF_ADDRESS_SIZE);
+  saveGroupSequence(0);
+  for (int i = 0; i < RF_ADDRESS_SIZE; i++) {
+    EEPROM.write(EEPROM_GROUP_ADDR+i, GA[i]);
+  }
+
+  if (GA[0] == RIOTS_GROUP_ADDRESS_MARK) {
+    regw4(W_REGISTER | RX_ADDR_P1, GA);
+    regw(W_REGISTER | EN_RXADDR, (1 << ERX_P0) | (1 << ERX_P1));
+  }
+  else {
+    regw(W_REGISTER | EN_RXADDR, (1 << ERX_P0));
+  }
+}
+
+/**
+* Accepts the group sequence number of a TYPE_LOAD_ADDRESS sent to the group.
+* Sequence numbers grow within an update, an older or repeated one is a replay.
+* Page packets following the load address are crypted with the group key whose
+* first two bytes are XORed with the sequence number, so they are accepted only
+* for the page they were sent for. The last sequence number is kept in EEPROM,
+* so a captured frame is not accepted again after a reset either.
+*
+* @param sequence       Group sequence number, starts from 1 for a new group key
+* @return bool          True, if the sequence number is newer than the last one
+*/
+bool Riots_Radio::acceptGroupSequence(uint16_t sequence) {
+  // 0xFFFF would read back as an erased EEPROM
+  if (sequence <= group_sequence || sequence == 0xFFFF) {
+    return false;
+  }
+  saveGroupSequence(sequence);
+  deriveGroupPageKey();
+  return true;
+}
+
+/**
+* Stores the last group sequence number accepted to memory and EEPROM
+*
+* @param sequence       Group sequence number, 0 for a new group key or address
+*/
+void Riots_Radio::saveGroupSequence(uint16_t sequence) {
+  group_sequence = sequence;
+  EEPROM.write(EEPROM_GROUP_SEQUENCE, (sequence >> 8) & 0xFF);
+  EEPROM.write(EEPROM_GROUP_SEQUENCE+1, sequence & 0xFF);
+}
+
+/**
+* Derives the key of the page packets from the group key and the last group
+* sequence number, see acceptGroupSequence
+*/
+void Riots_Radio::deriveGroupPageKey() {
+  memcpy(group_page_aes, group_aes, AES_KEY_SIZE);
+  group_page_aes[0] ^= (group_sequence >> 8) & 0xFF;
+  group_page_aes[1] ^= group_sequence & 0xFF;
+}
+
+/**
+* Returns the last group sequence number accepted
+*
+* @return uint16_t      Sequence number, 0 if no page has been started with the group key
+*/
+uint16_t Riots_Radio::getGroupSequence() {
+  return group_sequence;
+}
+
 /**
 * Saves received keys to the EEPROM
 *
@@ -17,6 +17,29 @@
 
 #include "Riots_Helper.h"
 
+/**
+ * Performance counters shared by the radio, the baby/mama libraries and the cloud.
+ *
+ * Counters are free running and wrap around. They are written one by one in
+ * this order to the stats record of the cloud, MAMA_STATS_LEN bytes in little
+ * endian followed by their XOR checksum.
+ */
+struct Riots_Stats {
+  uint32_t cloud_bytes_up;                          /*!< Bytes written to the cloud socket                  */
+  uint32_t cloud_bytes_down;                        /*!< Bytes read from the cloud socket                   */
+  uint16_t radio_rx_frames;                         /*!< Frames read from the radio                         */
+  uint16_t radio_tx_frames;                         /*!< Frames sent with the radio                         */
+  uint16_t radio_tx_failures;                       /*!< Sent frames without ACK                            */
+  uint16_t radio_airtime_timeouts;                  /*!< IRQ did not arrive within MAX_RADIO_AIRTIME        */
+  uint16_t radio_rx_backlog;                        /*!< RX FIFO had more frames waiting after a read       */
+  uint16_t decrypt_failures[RIOTS_STATS_KEY_COUNT]; /*!< Frames not opened, per key (RIOTS_STATS_*_KEY)      */
+  uint16_t counter_rejects;                         /*!< Messages rejected because of the counter           */
+  uint16_t ring_drops;                              /*!< Ring events not delivered to the next core         */
+  uint16_t cloud_reconnects;                        /*!< Successful connections to the cloud                */
+  uint16_t cloud_cached_records;                    /*!< Messages saved to EEPROM while cloud was away      */
+  uint16_t cloud_replayed_records;                  /*!< Saved messages sent to the cloud                   */
+};
+
 class Riots_Radio {
   public:
     int setup(int nrfce, int nrfcsn, int nrfirq, int nrfrst);
@@ -27,11 +50,19 @@ class Riots_Radio {
     byte* getRXCryptBuffAddress();
     byte* getTXCryptBuffAddress();
     byte* getPrivateKeyAddress();
+    byte* getGroupKeyAddress();
+    byte* getGroupPageKeyAddress();
     byte* getOwnRadioAddress();
+    Riots_Stats* getStatsAddress();
     void activateNewAesKey();
     void saveNewAesKey(byte part_number, byte *aes_key_part);
+    void saveGroupKey(byte part_number, byte *group_key_part);
+    void setGroupAddress(byte *address);
+    bool acceptGroupSequence(uint16_t sequence);
+    uint16_t getGroupSequence();
+    byte getRxPipe();
     byte decrypt(byte* aes_key);
-    byte send();
+    byte send(byte no_ack=0);
     byte update(byte sleep);
     byte validityCheck();
     void setTXAddress(byte *address);
@@ -40,12 +71,18 @@ class Riots_Radio {
     byte unique_aes[AES_KEY_SIZE];      /*!< Unique AES128 key for the child                */
     byte shared_aes[AES_KEY_SIZE];      /*!< Public AES128 key for the RIOTS network        */
     byte aes_update[AES_KEY_SIZE];      /*!< Public AES128 key for the RIOTS network        */
+    byte group_aes[AES_KEY_SIZE];       /*!< AES128 key of the update group                 */
+    byte group_page_aes[AES_KEY_SIZE];  /*!< Group key of the page packets, see acceptGroupSequence */
+    uint16_t group_sequence;            /*!< Last group sequence number accepted, 0 if none, kept in EEPROM */
     byte CA[RF_ADDRESS_SIZE];           /*!< Own core radio address                         */
     byte SA[RF_ADDRESS_SIZE];           /*!< Transmitter address of the radio               */
+    byte GA[RF_ADDRESS_SIZE];           /*!< Group address, received on RIOTS_GROUP_PIPE    */
+    byte rx_pipe;                       /*!< Pipe of the last received frame                */
     byte plain_data[RF_PAYLOAD_SIZE+2]; /*!< Shared data buffer, used for plain data        */
     byte tx_crypt_buff[RF_PAYLOAD_SIZE+2]; /*!< Shared tx data buffer, used for crypted data      */
     byte rx_crypt_buff[RF_PAYLOAD_SIZE+2]; /*!< Shared rx data buffer, used for crypted data*/
     byte debug_buffer[RF_PAYLOAD_SIZE];
+    Riots_Stats stats;                  /*!< Performance counters, shared with other libraries */
     byte sendStatus;                    /*!< Status of sending                              */
     byte sendCount;                     /*!< Count message resended attempts                */
     byte debugger;                      /*!< Is debugger enabled                            */
@@ -59,6 +96,8 @@ class Riots_Radio {
 
     /* Private functions start here */
     void wdtSleep();
+    void saveGroupSequence(uint16_t sequence);
+    void deriveGroupPageKey();
     byte mamaSend();
     byte radioSend();
     byte resend();
@@ -68,6 +107,7 @@ class Riots_Radio {
     byte writeInterrupt();
     void readData();
     void regw(byte reg, byte val);
+    byte regr(byte reg);
     void regw4(byte reg, byte val[]);
     void aeskey(byte key[]);
     bool checkCRC();
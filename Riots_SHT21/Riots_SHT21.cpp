@@ -13,6 +13,8 @@
  */
 
 #include "Riots_SHT21.h"
+#include "Riots_Memory.h"
+#include "Riots_Profile.h"
 
 /**
  * Default contstructor
@@ -20,6 +22,9 @@
  * @return Riots_SHT21        Riots SHT21 library instance.
  */
 byte Riots_SHT21::setup() {
+  // Start I2c, Wire.begin() resets the bus speed so restore the shared one
+  Wire.begin();
+  Riots_Memory::applyBusSpeed();
   return RIOTS_OK;
 }
 
@@ -57,6 +62,8 @@ int Riots_SHT21::readTemperature() {
     return RIOTS_SENSOR_FAIL;
   }
 
+  _PROFILE_SCOPE(RIOTS_PROFILE_SENSOR_CALC);
+
   // Clear status bits
   temperature &= 0xFFFC;
 
@@ -80,6 +87,8 @@ int Riots_SHT21::readHumidity() {
   if(humidity == 0) {
     return RIOTS_SENSOR_FAIL;
   }
+  _PROFILE_SCOPE(RIOTS_PROFILE_SENSOR_CALC);
+
   // Clear status bits
   humidity &= 0xFFFC;
   float humicalc = (125*(humidity/pow(2,16)))-6;
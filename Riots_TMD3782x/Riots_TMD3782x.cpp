@@ -13,6 +13,8 @@
  */
 
 #include "Riots_TMD3782x.h"
+#include "Riots_Memory.h"
+#include "Riots_Profile.h"
 #include "Wire.h"
 
 /**
@@ -31,8 +33,9 @@ Riots_TMD3782x::Riots_TMD3782x() {
  */
 void Riots_TMD3782x::setup() {
 
-  // Start I2c
+  // Start I2c, Wire.begin() resets the bus speed so restore the shared one
   Wire.begin();
+  Riots_Memory::applyBusSpeed();
 
   // Check product ID
   byte proid = byteRead(RIOTS_TMD3782X_PRODUCT_ID_REG);
@@ -135,6 +138,7 @@ void Riots_TMD3782x::readRgbcData () {
  * @return double             Temperature of the color in kelvin scale.
  */
 double Riots_TMD3782x::getColorTemperature() {
+  _PROFILE_SCOPE(RIOTS_PROFILE_SENSOR_CALC);
 
   // CT (degrees Kelvin) = CT_Coef*(B’/R’) + CT_Offset
 
@@ -155,6 +159,7 @@ double Riots_TMD3782x::getColorTemperature() {
  */
 
 double Riots_TMD3782x::getLux() {
+  _PROFILE_SCOPE(RIOTS_PROFILE_SENSOR_CALC);
 
   // G” = R_Coef * R’ + G_Coef * G’ + B_Coef * B’
 
@@ -0,0 +1,252 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "SPI.h"
+#include "Time.h"
+#include "Riots_HostHal.h"
+#include "HostI2c.h"
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+SPIClass SPI;
+
+HostTwiRegister TWCR(HOST_TWCR);
+HostTwiRegister TWSR(HOST_TWSR);
+HostTwiRegister TWDR(HOST_TWDR);
+HostTwiRegister TWBR(HOST_TWBR);
+
+/* Time */
+
+unsigned long millis() {
+  hostNode()->advance(HOST_CALL_COST_US);
+  return hostNode()->micros() / 1000;
+}
+
+unsigned long micros() {
+  hostNode()->advance(HOST_CALL_COST_US);
+  return hostNode()->micros();
+}
+
+void delay(unsigned long ms) {
+  hostNode()->advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  hostNode()->advance(us);
+}
+
+/* Pins */
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if( pin < HOST_PIN_COUNT ) {
+    hostNode()->pin_modes[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  HostNode *node = hostNode();
+
+  if( pin >= HOST_PIN_COUNT ) {
+    return;
+  }
+  node->pin_values[pin] = value ? HIGH : LOW;
+  if( node->pin_devices[pin] ) {
+    node->pin_devices[pin]->pinWritten(pin, node->pin_values[pin]);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  HostNode *node = hostNode();
+
+  node->advance(HOST_CALL_COST_US);
+  if( pin >= HOST_PIN_COUNT ) {
+    return LOW;
+  }
+  if( node->pin_devices[pin] ) {
+    return node->pin_devices[pin]->pinRead(pin);
+  }
+  // unconnected inputs are pulled up
+  return node->pin_modes[pin] == OUTPUT ? node->pin_values[pin] : HIGH;
+}
+
+int analogRead(uint8_t pin) {
+  (void)pin;
+  hostNode()->advance(100);
+  return 0;
+}
+
+void analogWrite(uint8_t pin, int value) {
+  digitalWrite(pin, value > 127 ? HIGH : LOW);
+}
+
+/* Random numbers, every node has its own sequence */
+
+void randomSeed(unsigned long seed) {
+  if( seed ) {
+    hostNode()->random_state = seed;
+  }
+}
+
+long random(long howbig) {
+  uint32_t &x = hostNode()->random_state;
+
+  if( howbig <= 0 ) {
+    return 0;
+  }
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  if( howsmall >= howbig ) {
+    return howsmall;
+  }
+  return random(howbig - howsmall) + howsmall;
+}
+
+/* Print */
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+
+  while( size-- ) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::printNumber(unsigned long value, int base) {
+  char buffer[8 * sizeof(long) + 1];
+  char *str = &buffer[sizeof(buffer) - 1];
+
+  if( base < 2 ) {
+    base = 10;
+  }
+  *str = '\0';
+  do {
+    unsigned long digit = value % base;
+    value /= base;
+    *--str = digit < 10 ? '0' + digit : 'A' + digit - 10;
+  } while( value );
+  return write(str);
+}
+
+size_t Print::printSigned(long value, int base) {
+  if( base == DEC && value < 0 ) {
+    return print('-') + printNumber(-(unsigned long)value, base);
+  }
+  return printNumber((unsigned long)value, base);
+}
+
+size_t Print::print(double value, int digits) {
+  char buffer[40];
+
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+  return write(buffer);
+}
+
+size_t HardwareSerial::write(uint8_t data) {
+  if( hostNode()->serial_echo ) {
+    putchar(data);
+  }
+  return 1;
+}
+
+/* EEPROM */
+
+uint8_t EEPROMClass::read(int address) {
+  return hostNode()->eeprom[address % HOST_EEPROM_SIZE];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  hostNode()->eeprom[address % HOST_EEPROM_SIZE] = value;
+  // 3.3 ms erase and write
+  hostNode()->advance(3300);
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+  if( read(address) != value ) {
+    write(address, value);
+  }
+}
+
+/* SPI */
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  HostNode *node = hostNode();
+
+  node->spi_bytes++;
+  if( node->spi ) {
+    return node->spi->transfer(data);
+  }
+  node->advance(HOST_SPI_BYTE_US);
+  return 0xFF;
+}
+
+/* Time library */
+
+time_t now() {
+  HostNode *node = hostNode();
+
+  return node->unix_time + (millis() - node->unix_time_set) / 1000;
+}
+
+void setTime(time_t t) {
+  hostNode()->unix_time = t;
+  hostNode()->unix_time_set = millis();
+}
+
+/* Watchdog and sleep */
+
+void wdt_reset() {
+  hostNode()->wdt_resets++;
+}
+
+void wdt_enable(uint8_t timeout) {
+  (void)timeout;
+}
+
+void wdt_disable() {
+}
+
+void set_sleep_mode(uint8_t mode) {
+  (void)mode;
+}
+
+void sleep_mode() {
+  hostNode()->sleep(HOST_WDT_SLEEP_US);
+}
+
+/* TWI registers */
+
+HostTwiRegister& HostTwiRegister::operator=(uint8_t value) {
+  if( hostNode()->i2c ) {
+    hostNode()->i2c->writeRegister(reg, value);
+  }
+  return *this;
+}
+
+HostTwiRegister::operator uint8_t() const {
+  if( hostNode()->i2c ) {
+    return hostNode()->i2c->readRegister(reg);
+  }
+  // no bus, nothing answers
+  return reg == HOST_TWCR ? (1 << TWINT) : (reg == HOST_TWSR ? TW_NO_INFO : 0xFF);
+}
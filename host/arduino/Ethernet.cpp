@@ -0,0 +1,344 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Ethernet.h"
+#include "utility/socket.h"
+
+/**
+ * Socket of the chip, a POSIX socket once the SYN has reached the network.
+ */
+struct HostSocket {
+  int fd;                       /*!< POSIX socket, -1 if none                   */
+  uint8_t status;               /*!< Sn_SR of the socket                        */
+  uint8_t address[4];           /*!< Destination address of CONNECT             */
+  uint16_t port;                /*!< Destination port of CONNECT                */
+  uint32_t connect_ms;          /*!< Time of the CONNECT command                */
+};
+
+static HostSocket sockets[MAX_SOCK_NUM];
+
+EthernetClass Ethernet;
+
+static bool link_up = true;
+static uint16_t connect_port = 0;
+
+/**
+ * Takes the link down, begin() fails and SYNs get no answer while it is down.
+ */
+void hostEthernetSetLink(bool up) {
+  link_up = up;
+}
+
+/**
+ * Redirects every connection to the local port, 0 keeps the port asked for.
+ */
+void hostEthernetSetPort(uint16_t port) {
+  connect_port = port;
+}
+
+EthernetClass::EthernetClass() : maintain_calls(0), dns_lookups(0), connect_calls(0) {
+  for( uint8_t s = 0; s < MAX_SOCK_NUM; s++ ) {
+    sockets[s].fd = -1;
+  }
+}
+
+int EthernetClass::begin(uint8_t *mac) {
+  (void)mac;
+  // DHCP takes a while
+  delay(link_up ? 100 : HOST_DHCP_TIMEOUT_MS);
+  return link_up ? 1 : 0;
+}
+
+/**
+ * Lease is never due on the host, but a DHCP request without a link
+ * blocks until it times out.
+ */
+int EthernetClass::maintain() {
+  maintain_calls++;
+  if( !link_up ) {
+    delay(HOST_DHCP_TIMEOUT_MS);
+  }
+  return 0;
+}
+
+IPAddress EthernetClass::localIP() {
+  return IPAddress(127, 0, 0, 1);
+}
+
+IPAddress EthernetClass::dnsServerIP() {
+  return IPAddress(127, 0, 0, 1);
+}
+
+int DNSClient::getHostByName(const char *host, IPAddress &result) {
+  (void)host;
+  Ethernet.dns_lookups++;
+  if( !link_up ) {
+    return 0;
+  }
+  result = IPAddress(127, 0, 0, 1);
+  return 1;
+}
+
+/**
+ * Sends the SYN of the socket, the POSIX connect does not wait for the answer.
+ */
+static void sendSyn(HostSocket *socket) {
+  struct sockaddr_in address;
+  int one = 1;
+
+  socket->fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if( socket->fd < 0 ) {
+    socket->status = SnSR::CLOSED;
+    return;
+  }
+  setsockopt(socket->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(socket->fd, F_SETFL, fcntl(socket->fd, F_GETFL) | O_NONBLOCK);
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(connect_port ? connect_port : socket->port);
+  memcpy(&address.sin_addr.s_addr, socket->address, 4);
+  if( ::connect(socket->fd, (struct sockaddr *)&address, sizeof(address)) == 0 ) {
+    socket->status = SnSR::ESTABLISHED;
+  }
+  else if( errno != EINPROGRESS ) {
+    // refused, as with RST from the server
+    close(socket->fd);
+    socket->fd = -1;
+    socket->status = SnSR::CLOSED;
+  }
+}
+
+/**
+ * Follows the handshake of a socket in SYNSENT. Without a link the SYN is
+ * retransmitted until the chip gives up, once the link is back the next
+ * retransmission reaches the server.
+ */
+static void updateStatus(HostSocket *socket) {
+  struct pollfd ready;
+  int error = 0;
+  socklen_t length = sizeof(error);
+
+  if( socket->status != SnSR::SYNSENT ) {
+    return;
+  }
+  if( socket->fd < 0 ) {
+    if( millis() - socket->connect_ms >= HOST_TCP_TIMEOUT_MS ) {
+      socket->status = SnSR::CLOSED;
+    }
+    else if( link_up ) {
+      sendSyn(socket);
+    }
+    return;
+  }
+  ready.fd = socket->fd;
+  ready.events = POLLOUT;
+  if( poll(&ready, 1, 0) != 1 ) {
+    return;
+  }
+  getsockopt(socket->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+  if( error == 0 ) {
+    socket->status = SnSR::ESTABLISHED;
+    return;
+  }
+  close(socket->fd);
+  socket->fd = -1;
+  socket->status = SnSR::CLOSED;
+}
+
+uint8_t socket(SOCKET s, uint8_t protocol, uint16_t port, uint8_t flag) {
+  (void)port;
+  (void)flag;
+  close(s);
+  if( protocol != SnMR::TCP ) {
+    // only TCP sockets are modelled
+    return 0;
+  }
+  sockets[s].status = SnSR::INIT;
+  return 1;
+}
+
+void close(SOCKET s) {
+  if( sockets[s].fd >= 0 ) {
+    close(sockets[s].fd);
+    sockets[s].fd = -1;
+  }
+  sockets[s].status = SnSR::CLOSED;
+}
+
+uint8_t connect(SOCKET s, uint8_t *addr, uint16_t port) {
+  HostSocket *socket = &sockets[s];
+
+  if( (addr[0] == 0 && addr[1] == 0 && addr[2] == 0 && addr[3] == 0) || port == 0 ) {
+    return 0;
+  }
+  Ethernet.connect_calls++;
+  memcpy(socket->address, addr, 4);
+  socket->port = port;
+  socket->connect_ms = millis();
+  socket->status = SnSR::SYNSENT;
+  if( link_up ) {
+    sendSyn(socket);
+  }
+  return 1;
+}
+
+void disconnect(SOCKET s) {
+  close(s);
+}
+
+EthernetClient::EthernetClient() : sock(MAX_SOCK_NUM) {
+}
+
+EthernetClient::EthernetClient(uint8_t sock) : sock(sock) {
+}
+
+uint8_t EthernetClient::status() {
+  if( sock == MAX_SOCK_NUM ) {
+    return SnSR::CLOSED;
+  }
+  updateStatus(&sockets[sock]);
+  return sockets[sock].status;
+}
+
+/**
+ * Blocks until the handshake is done or the chip gives up on it.
+ */
+int EthernetClient::connect(IPAddress ip, uint16_t port) {
+  uint8_t address[4] = { ip[0], ip[1], ip[2], ip[3] };
+
+  stop();
+  for( sock = 0; sock < MAX_SOCK_NUM; sock++ ) {
+    if( sockets[sock].status == SnSR::CLOSED ) {
+      break;
+    }
+  }
+  if( sock == MAX_SOCK_NUM ) {
+    return 0;
+  }
+  if( !socket(sock, SnMR::TCP, 0, 0) || !::connect(sock, address, port) ) {
+    stop();
+    return 0;
+  }
+  while( status() != SnSR::ESTABLISHED ) {
+    if( status() == SnSR::CLOSED ) {
+      sock = MAX_SOCK_NUM;
+      return 0;
+    }
+    delay(1);
+  }
+  return 1;
+}
+
+int EthernetClient::connect(const char *host, uint16_t port) {
+  IPAddress ip;
+  DNSClient dns;
+
+  if( dns.getHostByName(host, ip) != 1 ) {
+    return 0;
+  }
+  return connect(ip, port);
+}
+
+/**
+ * Like the W5100 client, connected while there is data left to read.
+ */
+uint8_t EthernetClient::connected() {
+  uint8_t data;
+
+  if( status() != SnSR::ESTABLISHED ) {
+    return 0;
+  }
+  if( !link_up ) {
+    return 0;
+  }
+  ssize_t n = recv(sockets[sock].fd, &data, 1, MSG_PEEK | MSG_DONTWAIT);
+  if( n == 0 ) {
+    return 0;
+  }
+  if( n < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+    return 0;
+  }
+  return 1;
+}
+
+void EthernetClient::stop() {
+  if( sock != MAX_SOCK_NUM ) {
+    close(sock);
+    sock = MAX_SOCK_NUM;
+  }
+}
+
+int EthernetClient::available() {
+  int count = 0;
+
+  if( status() != SnSR::ESTABLISHED || ioctl(sockets[sock].fd, FIONREAD, &count) < 0 ) {
+    return 0;
+  }
+  return count;
+}
+
+int EthernetClient::read() {
+  uint8_t data;
+
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int EthernetClient::read(uint8_t *buffer, size_t size) {
+  if( status() != SnSR::ESTABLISHED ) {
+    return -1;
+  }
+  ssize_t n = recv(sockets[sock].fd, buffer, size, MSG_DONTWAIT);
+  return n > 0 ? (int)n : -1;
+}
+
+int EthernetClient::peek() {
+  uint8_t data;
+
+  if( status() != SnSR::ESTABLISHED || recv(sockets[sock].fd, &data, 1, MSG_PEEK | MSG_DONTWAIT) != 1 ) {
+    return -1;
+  }
+  return data;
+}
+
+size_t EthernetClient::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+size_t EthernetClient::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+
+  if( status() != SnSR::ESTABLISHED || !link_up ) {
+    return 0;
+  }
+  while( written < size ) {
+    ssize_t n = send(sockets[sock].fd, buffer + written, size - written, MSG_NOSIGNAL);
+    if( n < 0 ) {
+      if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+        continue;
+      }
+      break;
+    }
+    written += n;
+  }
+  return written;
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef Ethernet_h
+#define Ethernet_h
+
+#include "Arduino.h"
+#include "utility/w5100.h"
+
+/**
+ * IPv4 address.
+ */
+class IPAddress {
+  public:
+    IPAddress() { bytes[0] = bytes[1] = bytes[2] = bytes[3] = 0; }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { bytes[0] = a; bytes[1] = b; bytes[2] = c; bytes[3] = d; }
+    uint8_t operator[](int index) const { return bytes[index]; }
+    uint8_t& operator[](int index) { return bytes[index]; }
+    bool operator==(const IPAddress &other) const { return memcmp(bytes, other.bytes, 4) == 0; }
+
+  private:
+    uint8_t bytes[4];
+};
+
+#define HOST_DHCP_TIMEOUT_MS  1000
+#define HOST_TCP_TIMEOUT_MS   31800   // W5500 gives up the SYN retransmissions with the default RTR and RCR
+
+/**
+ * Ethernet of the host. The network is the loopback interface: DHCP gives
+ * 127.0.0.1, every name resolves to it and connections go to the local
+ * port set with hostEthernetSetPort(), e.g. a simulated cloud server.
+ */
+class EthernetClass {
+  public:
+    EthernetClass();
+    int begin(uint8_t *mac);
+    int maintain();
+    IPAddress localIP();
+    IPAddress dnsServerIP();
+
+    uint32_t maintain_calls;      /*!< Count of maintain() calls                  */
+    uint32_t dns_lookups;         /*!< Count of getHostByName() calls             */
+    uint32_t connect_calls;       /*!< Count of CONNECT commands of the sockets   */
+};
+
+/**
+ * TCP client on a socket of the host, reads never block. Like the library
+ * client connect() waits for the handshake, a client made of a socket index
+ * takes over a socket connected with the socket layer.
+ */
+class EthernetClient : public Stream {
+  public:
+    EthernetClient();
+    EthernetClient(uint8_t sock);
+    uint8_t status();
+    int connect(IPAddress ip, uint16_t port);
+    int connect(const char *host, uint16_t port);
+    uint8_t connected();
+    void stop();
+    int available();
+    int read();
+    int read(uint8_t *buffer, size_t size);
+    int peek();
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    void flush() {}
+    operator bool() { return sock != MAX_SOCK_NUM; }
+
+  private:
+    uint8_t sock;
+};
+
+class DNSClient {
+  public:
+    void begin(const IPAddress &server) { (void)server; }
+    int getHostByName(const char *host, IPAddress &result);
+};
+
+extern EthernetClass Ethernet;
+
+void hostEthernetSetLink(bool up);
+void hostEthernetSetPort(uint16_t port);
+
+#endif // Ethernet_h
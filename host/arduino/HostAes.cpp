@@ -0,0 +1,42 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * aes.cpp of Riots_Helper is built here, with its public functions renamed.
+ * The functions of aes.h wrap them and count every block on the selected
+ * node, so the library code has no hook of the host build.
+ */
+#define AES128_ECB_encrypt hostAesEncrypt
+#define AES128_ECB_decrypt hostAesDecrypt
+#include "aes.cpp"
+#undef AES128_ECB_encrypt
+#undef AES128_ECB_decrypt
+
+#include "HostNode.h"
+
+/* AES block, counted and timed on the selected node */
+static void countBlock() {
+  hostNode()->aes_blocks++;
+  hostNode()->advance(hostNode()->aes_block_us);
+}
+
+void AES128_ECB_encrypt(uint8_t* input, uint8_t* key, uint8_t *output) {
+  countBlock();
+  hostAesEncrypt(input, key, output);
+}
+
+void AES128_ECB_decrypt(uint8_t* input, uint8_t* key, uint8_t *output) {
+  countBlock();
+  hostAesDecrypt(input, key, output);
+}
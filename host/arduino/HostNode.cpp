@@ -0,0 +1,59 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "HostNode.h"
+
+static HostNode default_node;
+static HostNode *selected_node = &default_node;
+
+HostNode::HostNode(uint16_t node_id) : id(node_id), time_us(0), sleep_us(0), spi(0), i2c(0),
+  random_state(0x9E3779B9UL ^ node_id), unix_time(0), unix_time_set(0), wdt_resets(0),
+  aes_blocks(0), aes_block_us(0), spi_bytes(0), serial_echo(false) {
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  memset(pin_values, 0, sizeof(pin_values));
+  memset(pin_modes, 0, sizeof(pin_modes));
+  memset(pin_devices, 0, sizeof(pin_devices));
+}
+
+void HostNode::advance(uint32_t us) {
+  time_us += us;
+}
+
+/**
+ * Timer 0 based time, it does not run while the node sleeps.
+ */
+uint32_t HostNode::micros() {
+  return (uint32_t)(time_us - sleep_us);
+}
+
+void HostNode::sleep(uint32_t us) {
+  time_us += us;
+  sleep_us += us;
+}
+
+void HostNode::attachPin(uint8_t pin, HostPinDevice *device) {
+  if( pin < HOST_PIN_COUNT ) {
+    pin_devices[pin] = device;
+  }
+}
+
+HostNode* hostNode() {
+  return selected_node;
+}
+
+void hostSelectNode(HostNode *node) {
+  selected_node = node ? node : &default_node;
+}
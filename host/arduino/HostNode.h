@@ -0,0 +1,86 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostNode_h
+#define HostNode_h
+
+#include <stdint.h>
+
+/*
+ * A simulated Riots board of the host build. The Arduino API shims work on the
+ * selected node, so several boards can run the real library code in one
+ * process: a simulator selects a node, runs its loop and moves on.
+ *
+ * Time of a node is simulated too. It advances with delay(), with the cost of
+ * the API calls and with the bus transfers of the devices, never with the
+ * wall clock, so every run gives the same result.
+ */
+#define HOST_EEPROM_SIZE      1024  // ATmega328P internal EEPROM
+#define HOST_PIN_COUNT        32
+#define HOST_CALL_COST_US     1     // time spent by millis(), micros() and pin reads, lets busy loops time out
+#define HOST_SPI_BYTE_US      2     // 4 MHz SPI
+
+class HostI2cBus;
+
+/**
+ * Device attached to the SPI bus of a node.
+ */
+class HostSpiDevice {
+  public:
+    virtual ~HostSpiDevice() {}
+    virtual uint8_t transfer(uint8_t data) = 0;
+};
+
+/**
+ * Device attached to the pins of a node.
+ */
+class HostPinDevice {
+  public:
+    virtual ~HostPinDevice() {}
+    virtual void pinWritten(uint8_t pin, uint8_t value) = 0;
+    virtual uint8_t pinRead(uint8_t pin) = 0;
+};
+
+class HostNode {
+  public:
+    HostNode(uint16_t node_id = 0);
+
+    void advance(uint32_t us);
+    uint32_t micros();
+    void sleep(uint32_t us);
+    void attachPin(uint8_t pin, HostPinDevice *device);
+
+    uint16_t id;                            /*!< Identifier of the node in a simulation                   */
+    uint64_t time_us;                       /*!< Simulated time of the node                                */
+    uint64_t sleep_us;                      /*!< Time spent powered down, timers do not run then           */
+    uint8_t eeprom[HOST_EEPROM_SIZE];       /*!< Internal EEPROM, erased to 0xFF                           */
+    uint8_t pin_values[HOST_PIN_COUNT];     /*!< Values written to the pins                                */
+    uint8_t pin_modes[HOST_PIN_COUNT];      /*!< Modes of the pins                                         */
+    HostPinDevice *pin_devices[HOST_PIN_COUNT]; /*!< Devices attached to the pins                          */
+    HostSpiDevice *spi;                     /*!< Device on the SPI bus, selected with its own CSN pin      */
+    HostI2cBus *i2c;                        /*!< I2C bus of the node, used by Wire and the TWI registers   */
+    uint32_t random_state;                  /*!< State of random(), seeded from the node id                */
+    uint32_t unix_time;                     /*!< Time given with setTime()                                 */
+    uint32_t unix_time_set;                 /*!< millis() when the time was set                            */
+    uint32_t wdt_resets;                    /*!< Count of wdt_reset() calls                                */
+    uint32_t aes_blocks;                    /*!< AES blocks encrypted or decrypted                         */
+    uint32_t aes_block_us;                  /*!< Time of one AES block, not modelled by default            */
+    uint32_t spi_bytes;                     /*!< Bytes transferred on the SPI bus                          */
+    bool serial_echo;                       /*!< Serial output is written to stdout                        */
+};
+
+HostNode* hostNode();
+void hostSelectNode(HostNode *node);
+
+#endif // HostNode_h
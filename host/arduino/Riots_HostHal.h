@@ -0,0 +1,96 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef Riots_HostHal_h
+#define Riots_HostHal_h
+
+/*
+ * Host side of Riots_Hal.h. Watchdog and sleep work on the selected HostNode,
+ * program memory is plain memory and the TWI registers drive the I2C bus of
+ * the node synchronously: an operation completes when TWINT is written.
+ */
+#include <stdint.h>
+
+#include "HostNode.h"
+
+/* Watchdog, the host never resets */
+#define WDTO_8S                       9
+void wdt_reset();
+void wdt_enable(uint8_t timeout);
+void wdt_disable();
+
+/* Sleep, power down lasts until the 8 s watchdog interrupt */
+#define SLEEP_MODE_IDLE               0
+#define SLEEP_MODE_PWR_DOWN           2
+#define HOST_WDT_SLEEP_US             8000000UL
+void set_sleep_mode(uint8_t mode);
+void sleep_mode();
+
+/* Interrupt handlers are plain functions */
+#define ISR(vector)                   void vector(void)
+
+/* Program memory */
+#define PROGMEM
+#define pgm_read_byte_near(address)   (*(const uint8_t *)(address))
+#define pgm_read_byte(address)        (*(const uint8_t *)(address))
+
+#define RIOTS_ADC_DISABLE()
+#define RIOTS_WDT_INTERRUPT_ENABLE()
+
+/* TWCR bits */
+#define TWINT                         7
+#define TWEA                          6
+#define TWSTA                         5
+#define TWSTO                         4
+#define TWWC                          3
+#define TWEN                          2
+#define TWIE                          0
+
+/* TWI status codes of util/twi.h */
+#define TW_START                      0x08
+#define TW_REP_START                  0x10
+#define TW_MT_SLA_ACK                 0x18
+#define TW_MT_SLA_NACK                0x20
+#define TW_MT_DATA_ACK                0x28
+#define TW_MT_DATA_NACK               0x30
+#define TW_MR_SLA_ACK                 0x40
+#define TW_MR_SLA_NACK                0x48
+#define TW_MR_DATA_ACK                0x50
+#define TW_MR_DATA_NACK               0x58
+#define TW_NO_INFO                    0xF8
+
+#define HOST_TWCR                     0
+#define HOST_TWSR                     1
+#define HOST_TWDR                     2
+#define HOST_TWBR                     3
+
+/**
+ * TWI register of the selected node.
+ */
+class HostTwiRegister {
+  public:
+    explicit HostTwiRegister(uint8_t reg) : reg(reg) {}
+    HostTwiRegister& operator=(uint8_t value);
+    operator uint8_t() const;
+
+  private:
+    uint8_t reg;
+};
+
+extern HostTwiRegister TWCR;
+extern HostTwiRegister TWSR;
+extern HostTwiRegister TWDR;
+extern HostTwiRegister TWBR;
+
+#endif // Riots_HostHal_h
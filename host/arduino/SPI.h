@@ -0,0 +1,41 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPI_h
+#define SPI_h
+
+#include <stdint.h>
+
+#define MSBFIRST        1
+#define LSBFIRST        0
+#define SPI_MODE0       0x00
+#define SPI_CLOCK_DIV2  0x04
+#define SPI_CLOCK_DIV4  0x00
+
+/**
+ * SPI bus of the selected node, transfers go to its HostSpiDevice.
+ */
+class SPIClass {
+  public:
+    void begin() {}
+    void end() {}
+    void setBitOrder(uint8_t order) { (void)order; }
+    void setDataMode(uint8_t mode) { (void)mode; }
+    void setClockDivider(uint8_t divider) { (void)divider; }
+    uint8_t transfer(uint8_t data);
+};
+
+extern SPIClass SPI;
+
+#endif // SPI_h
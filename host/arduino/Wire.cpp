@@ -0,0 +1,117 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Wire.h"
+#include "Riots_HostHal.h"
+#include "HostI2c.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire() : tx_address(0), tx_length(0), rx_length(0), rx_index(0) {
+}
+
+void TwoWire::begin() {
+  rx_length = 0;
+  rx_index = 0;
+  tx_length = 0;
+  TWSR = 0;
+  TWBR = HOST_TWBR_100KHZ;
+  TWCR = (1 << TWEN) | (1 << TWEA);
+}
+
+void TwoWire::setClock(uint32_t clock) {
+  TWBR = ((F_CPU / clock) - 16) / 2;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  tx_address = address;
+  tx_length = 0;
+}
+
+/**
+ * Sends the buffered bytes.
+ *
+ * @return uint8_t            0 success, 2 address NACK, 3 data NACK, 4 no bus.
+ */
+uint8_t TwoWire::endTransmission(uint8_t send_stop) {
+  HostI2cBus *bus = hostNode()->i2c;
+  uint8_t ret = 0;
+
+  if( !bus ) {
+    return 4;
+  }
+  if( !bus->start(tx_address, false) ) {
+    ret = 2;
+  }
+  for( uint8_t i = 0; ret == 0 && i < tx_length; i++ ) {
+    if( !bus->write(tx_buffer[i]) ) {
+      ret = 3;
+    }
+  }
+  if( send_stop || ret ) {
+    bus->stop();
+  }
+  tx_length = 0;
+  return ret;
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity) {
+  HostI2cBus *bus = hostNode()->i2c;
+
+  rx_index = 0;
+  rx_length = 0;
+  if( !bus ) {
+    return 0;
+  }
+  if( quantity > WIRE_BUFFER_LENGTH ) {
+    quantity = WIRE_BUFFER_LENGTH;
+  }
+  if( bus->start(address, true) ) {
+    for( int i = 0; i < quantity; i++ ) {
+      rx_buffer[rx_length++] = bus->read(i + 1 < quantity);
+    }
+  }
+  bus->stop();
+  return rx_length;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if( tx_length >= WIRE_BUFFER_LENGTH ) {
+    return 0;
+  }
+  tx_buffer[tx_length++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity) {
+  size_t n = 0;
+
+  while( n < quantity && write(data[n]) ) {
+    n++;
+  }
+  return n;
+}
+
+int TwoWire::available() {
+  hostNode()->advance(HOST_CALL_COST_US);
+  return rx_length - rx_index;
+}
+
+int TwoWire::read() {
+  return rx_index < rx_length ? rx_buffer[rx_index++] : -1;
+}
+
+int TwoWire::peek() {
+  return rx_index < rx_length ? rx_buffer[rx_index] : -1;
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+
+#define WIRE_BUFFER_LENGTH  32
+
+/**
+ * Wire on the I2C bus of the selected node. Like on AVR, begin() sets the
+ * TWI bit rate to 100 kHz.
+ */
+class TwoWire : public Stream {
+  public:
+    TwoWire();
+    void begin();
+    void setClock(uint32_t clock);
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    uint8_t endTransmission(uint8_t send_stop = 1);
+    uint8_t requestFrom(int address, int quantity);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t quantity);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+
+  private:
+    uint8_t tx_address;
+    uint8_t tx_buffer[WIRE_BUFFER_LENGTH];
+    uint8_t tx_length;
+    uint8_t rx_buffer[WIRE_BUFFER_LENGTH];
+    uint8_t rx_length;
+    uint8_t rx_index;
+};
+
+extern TwoWire Wire;
+
+#endif // TwoWire_h
@@ -0,0 +1,30 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef Socket_h
+#define Socket_h
+
+#include "utility/w5100.h"
+
+/*
+ * Socket layer of the Ethernet library. connect() only issues the CONNECT
+ * command, the handshake is followed with EthernetClient::status().
+ */
+uint8_t socket(SOCKET s, uint8_t protocol, uint16_t port, uint8_t flag);
+void close(SOCKET s);
+uint8_t connect(SOCKET s, uint8_t *addr, uint16_t port);
+void disconnect(SOCKET s);
+
+#endif // Socket_h
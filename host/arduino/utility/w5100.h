@@ -0,0 +1,51 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef W5100_h
+#define W5100_h
+
+#include "Arduino.h"
+
+/*
+ * Socket registers of the WIZnet chips as far as the host needs them, the
+ * sockets themselves are modelled in Ethernet.cpp.
+ */
+#define MAX_SOCK_NUM 8    // W5500 has eight sockets
+
+typedef uint8_t SOCKET;
+
+class SnMR {
+  public:
+    static const uint8_t CLOSE  = 0x00;
+    static const uint8_t TCP    = 0x01;
+    static const uint8_t UDP    = 0x02;
+};
+
+class SnSR {
+  public:
+    static const uint8_t CLOSED      = 0x00;
+    static const uint8_t INIT        = 0x13;
+    static const uint8_t LISTEN      = 0x14;
+    static const uint8_t SYNSENT     = 0x15;
+    static const uint8_t SYNRECV     = 0x16;
+    static const uint8_t ESTABLISHED = 0x17;
+    static const uint8_t FIN_WAIT    = 0x18;
+    static const uint8_t CLOSING     = 0x1A;
+    static const uint8_t TIME_WAIT   = 0x1B;
+    static const uint8_t CLOSE_WAIT  = 0x1C;
+    static const uint8_t LAST_ACK    = 0x1D;
+};
+
+#endif // W5100_h
@@ -0,0 +1,185 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* riots_bench, runs the registered benchmarks and compares them to a baseline */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "HostBench.h"
+
+struct HostBenchMetric {
+  std::string kind;
+  std::string name;
+  double value;
+};
+
+static HostBenchRegistration *registrations = NULL;
+static std::vector<HostBenchMetric> results;
+
+HostBenchRegistration::HostBenchRegistration(const char *name, HostBenchFunction function) :
+  name(name), function(function), next(NULL) {
+  // keep the order of the declarations
+  HostBenchRegistration **last = &registrations;
+  while ( *last ) {
+    last = &(*last)->next;
+  }
+  *last = this;
+}
+
+static void addResult(const char *kind, const char *bench, const char *metric, double value) {
+  HostBenchMetric result;
+
+  result.kind = kind;
+  result.name = std::string(bench) + "." + metric;
+  result.value = value;
+  results.push_back(result);
+}
+
+void HostBench::sim(const char *metric, double value) {
+  addResult("sim", name, metric, value);
+}
+
+void HostBench::host(const char *metric, double ns) {
+  addResult("host", name, metric, ns);
+}
+
+uint64_t HostBench::hostNanoseconds() {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Reads the lines "sim <name> <value>" of a baseline file */
+static bool readBaseline(const char *path, std::map<std::string, double> *baseline) {
+  FILE *file = fopen(path, "r");
+  char line[256];
+  char kind[8];
+  char name[HOST_BENCH_NAME_SIZE * 2];
+  double value;
+
+  if ( file == NULL ) {
+    perror(path);
+    return false;
+  }
+  while ( fgets(line, sizeof(line), file) ) {
+    if ( line[0] == '#' ) {
+      continue;
+    }
+    if ( sscanf(line, "%7s %127s %lf", kind, name, &value) == 3 && strcmp(kind, "sim") == 0 ) {
+      (*baseline)[name] = value;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+static bool writeBaseline(const char *path) {
+  FILE *file = fopen(path, "w");
+
+  if ( file == NULL ) {
+    perror(path);
+    return false;
+  }
+  fprintf(file, "# riots_bench baseline: sim <benchmark.metric> <value>\n");
+  fprintf(file, "# deterministic counts and simulated time only, host timings are not stored\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    if ( results[i].kind == "sim" ) {
+      fprintf(file, "sim %s %.1f\n", results[i].name.c_str(), results[i].value);
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+static bool selected(const char *name, int argc, char **argv, int first) {
+  if ( first >= argc ) {
+    return true;
+  }
+  for (int i = first; i < argc; i++) {
+    if ( strcmp(argv[i], name) == 0 ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int main(int argc, char **argv) {
+  const char *baseline_path = NULL;
+  const char *write_path = NULL;
+  std::map<std::string, double> baseline;
+  int regressions = 0;
+  int first = 1;
+
+  while ( first + 1 < argc && argv[first][0] == '-' ) {
+    if ( strcmp(argv[first], "--baseline") == 0 ) {
+      baseline_path = argv[first+1];
+    }
+    else if ( strcmp(argv[first], "--write") == 0 ) {
+      write_path = argv[first+1];
+    }
+    else {
+      break;
+    }
+    first += 2;
+  }
+  if ( first < argc && argv[first][0] == '-' ) {
+    fprintf(stderr, "usage: riots_bench [--baseline file] [--write file] [name...]\n");
+    return 2;
+  }
+  if ( baseline_path && !readBaseline(baseline_path, &baseline) ) {
+    return 2;
+  }
+
+  for (HostBenchRegistration *r = registrations; r; r = r->next) {
+    if ( selected(r->name, argc, argv, first) ) {
+      HostBench bench(r->name);
+      r->function(&bench);
+    }
+  }
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const HostBenchMetric &result = results[i];
+    std::map<std::string, double>::const_iterator base = baseline.find(result.name);
+
+    printf("%-4s %-40s %12.1f", result.kind.c_str(), result.name.c_str(), result.value);
+    if ( base == baseline.end() ) {
+      printf(baseline_path && result.kind == "sim" ? "  (new)\n" : "\n");
+      continue;
+    }
+
+    // a count growing from zero is a regression too
+    double change = base->second ? (result.value - base->second) / base->second : (result.value > 0 ? 1 : 0);
+    printf("  %12.1f  %+6.1f%%", base->second, 100 * change);
+    if ( result.kind == "sim" && change > HOST_BENCH_TOLERANCE ) {
+      printf("  REGRESSION");
+      regressions++;
+    }
+    else if ( result.kind == "sim" && change < -HOST_BENCH_TOLERANCE ) {
+      printf("  improved, update the baseline");
+    }
+    printf("\n");
+  }
+
+  if ( write_path && !writeBaseline(write_path) ) {
+    return 2;
+  }
+  return regressions ? 1 : 0;
+}
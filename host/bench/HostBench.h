@@ -0,0 +1,94 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostBench_h
+#define HostBench_h
+
+/*
+ * Benchmarks of the host build, run by riots_bench:
+ *
+ *   riots_bench [--baseline host/bench/baseline.txt] [--write file] [name...]
+ *
+ * A benchmark reports two kinds of metrics:
+ *
+ *   sim   deterministic counts: AES blocks, SPI and I2C traffic and the
+ *         simulated time of the bus and radio models. These are the same on
+ *         every run and machine, so they are compared against the baseline and
+ *         a regression of more than HOST_BENCH_TOLERANCE fails.
+ *   host  nanoseconds of the PC per operation. These depend on the machine, so
+ *         they are only printed, never stored in the baseline.
+ *
+ * Run the benchmarks with --write to update the committed baseline after an
+ * intended change.
+ */
+#include <stdint.h>
+
+#define HOST_BENCH_TOLERANCE          0.05  // 5 %
+#define HOST_BENCH_REPEATS            5     // host timings, fastest of the repeats is kept
+#define HOST_BENCH_NAME_SIZE          64
+
+class HostBench;
+typedef void (*HostBenchFunction)(HostBench *bench);
+
+class HostBench {
+  public:
+    HostBench(const char *name) : name(name) {}
+
+    void sim(const char *metric, double value);
+    void host(const char *metric, double ns);
+    static uint64_t hostNanoseconds();
+
+    /* Host nanoseconds per call of the operation, fastest of the repeats */
+    template <typename Operation> void measure(const char *metric, uint32_t iterations, Operation operation) {
+      uint64_t best = 0;
+
+      for (uint8_t repeat = 0; repeat < HOST_BENCH_REPEATS; repeat++) {
+        uint64_t start = hostNanoseconds();
+        for (uint32_t i = 0; i < iterations; i++) {
+          operation();
+        }
+        uint64_t elapsed = hostNanoseconds() - start;
+        if ( repeat == 0 || elapsed < best ) {
+          best = elapsed;
+        }
+      }
+      host(metric, (double)best / iterations);
+    }
+
+    const char *name;
+};
+
+/**
+ * Registers a benchmark to riots_bench, declared with HOST_BENCH.
+ */
+class HostBenchRegistration {
+  public:
+    HostBenchRegistration(const char *name, HostBenchFunction function);
+
+    const char *name;
+    HostBenchFunction function;
+    HostBenchRegistration *next;
+};
+
+#define HOST_BENCH(name) \
+  static void name(HostBench *bench); \
+  static HostBenchRegistration name##_registration(#name, name); \
+  static void name(HostBench *bench)
+
+/* Keeps the compiler from dropping the result of a benchmarked call */
+template <typename Value> inline void hostBenchKeep(const Value &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif // HostBench_h
@@ -0,0 +1,48 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_BabyRadio::send, formMessage with its padding, checksum and encryption */
+#include "Arduino.h"
+#include "HostNetwork.h"
+#include "HostBench.h"
+
+#define BENCH_SENDS       20
+#define BENCH_START_US    1000000ULL
+#define BENCH_SEND_US     100000ULL
+
+/* Ring event and cloud event of one send(), each formed and sent on its own */
+HOST_BENCH(form_message) {
+  HostNetwork *network = new HostNetwork(2);
+  HostNetworkNode *baby = network->babies[0];
+  uint64_t send_us = 0, start;
+  uint32_t blocks = 0, spi = 0;
+
+  network->run(BENCH_START_US);
+  for( uint8_t i = 0; i < BENCH_SENDS; i++ ) {
+    uint32_t node_blocks = baby->node.aes_blocks;
+    uint32_t node_spi = baby->node.spi_bytes;
+
+    hostSelectNode(&baby->node);
+    start = baby->node.time_us;
+    baby->baby->send(HOST_NETWORK_IO, 0, 0);
+    send_us += baby->node.time_us - start;
+    blocks += baby->node.aes_blocks - node_blocks;
+    spi += baby->node.spi_bytes - node_spi;
+    network->run(BENCH_START_US + (i + 1) * BENCH_SEND_US);
+  }
+  bench->sim("send_us", (double)send_us / BENCH_SENDS);
+  bench->sim("send_aes_blocks", (double)blocks / BENCH_SENDS);
+  bench->sim("send_spi_bytes", (double)spi / BENCH_SENDS);
+  delete network;
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Riots_BMP280 readings with the integer compensation, see bench_bmp280_float.cpp */
+#include "Riots_BMP280.h"
+#include "Riots_Memory.h"
+#include "HostBmp280.h"
+#include "HostBench.h"
+
+// local to this file, other benchmarks have boards of their own
+namespace {
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostBmp280 bmp;
+  Riots_BMP280 sensor;
+
+  Board() : node(1), bus(&node), bmp(&node) {
+    hostSelectNode(&node);
+    sensor.setup();
+  }
+};
+
+}
+
+HOST_BENCH(bmp280_int) {
+  // as after Riots_Memory::setup() has found the fast mode
+  Riots_Memory::setBusSpeed(RIOTS_I2C_FAST_MODE);
+  Board *board = new Board();
+  uint64_t start = board->node.time_us;
+  uint32_t transactions = board->bus.transactions;
+
+  hostBenchKeep(board->sensor.getPressure());
+  bench->sim("read_us", (double)(board->node.time_us - start));
+  bench->sim("read_bus_transactions", board->bus.transactions - transactions);
+  bench->measure("read_ns", 20000, [&]() { hostBenchKeep(board->sensor.getPressure()); });
+  delete board;
+}
+
+/* The same reading with the bus in the standard mode */
+HOST_BENCH(bmp280_standard_mode) {
+  Riots_Memory::setBusSpeed(RIOTS_I2C_STANDARD_MODE);
+  Board *board = new Board();
+  uint64_t start = board->node.time_us;
+
+  hostBenchKeep(board->sensor.getPressure());
+  bench->sim("read_us", (double)(board->node.time_us - start));
+  Riots_Memory::setBusSpeed(RIOTS_I2C_FAST_MODE);
+  delete board;
+}
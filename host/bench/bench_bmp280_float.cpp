@@ -0,0 +1,56 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Riots_BMP280 readings with the floating point compensation. The driver is
+ * built here once more with RIOTS_BMP280_FLOAT_COMPENSATION, renamed so that
+ * it links next to the integer one. The I2C transfers of both are the same,
+ * the difference of read_ns to bmp280_int is the cost of the math.
+ */
+#define RIOTS_BMP280_FLOAT_COMPENSATION
+#define Riots_BMP280 Riots_BMP280Float
+#include "Riots_BMP280.cpp"
+
+#include "Riots_Memory.h"
+#include "HostBmp280.h"
+#include "HostBench.h"
+
+// local to this file, other benchmarks have boards of their own
+namespace {
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostBmp280 bmp;
+  Riots_BMP280Float sensor;
+
+  Board() : node(1), bus(&node), bmp(&node) {
+    hostSelectNode(&node);
+    sensor.setup();
+  }
+};
+
+}
+
+HOST_BENCH(bmp280_float) {
+  Riots_Memory::setBusSpeed(RIOTS_I2C_FAST_MODE);
+  Board *board = new Board();
+  uint64_t start = board->node.time_us;
+
+  hostBenchKeep(board->sensor.getPressure());
+  bench->sim("read_us", (double)(board->node.time_us - start));
+  bench->measure("read_ns", 20000, [&]() { hostBenchKeep(board->sensor.getPressure()); });
+  delete board;
+}
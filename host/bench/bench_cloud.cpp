@@ -0,0 +1,53 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_MamaCloud messages cached to the secondary EEPROM during an outage and replayed after it */
+#include "Arduino.h"
+#include "HostGateway.h"
+#include "HostBench.h"
+
+#define BENCH_BABIES      10
+#define BENCH_START_US    2000000ULL
+#define BENCH_OUTAGE_US   3000000ULL
+
+HOST_BENCH(cloud_cache) {
+  HostGateway *gateway = new HostGateway(BENCH_BABIES);
+  Riots_Stats *stats = gateway->radio->getStatsAddress();
+  uint64_t outage_start = BENCH_START_US + 1000000ULL;
+  uint64_t outage_end = outage_start + BENCH_OUTAGE_US;
+  uint32_t transactions, bytes, cycles;
+
+  gateway->replayBabies(1000000UL, BENCH_START_US, outage_end);
+  gateway->setOutage(outage_start, outage_end);
+  gateway->run(outage_start);
+
+  // cache writes while the link is down
+  transactions = gateway->bus.transactions;
+  bytes = gateway->bus.bytes;
+  cycles = gateway->secondary.write_cycles;
+  gateway->run(outage_end);
+  bench->sim("cached_records", stats->cloud_cached_records);
+  bench->sim("write_cycles", gateway->secondary.write_cycles - cycles);
+  bench->sim("write_bus_transactions", gateway->bus.transactions - transactions);
+  bench->sim("write_bus_bytes", gateway->bus.bytes - bytes);
+
+  // replay once the cloud is back
+  transactions = gateway->bus.transactions;
+  bytes = gateway->bus.bytes;
+  gateway->run(outage_end + 10000000ULL);
+  bench->sim("replayed_records", stats->cloud_replayed_records);
+  bench->sim("replay_bus_transactions", gateway->bus.transactions - transactions);
+  bench->sim("replay_bus_bytes", gateway->bus.bytes - bytes);
+  delete gateway;
+}
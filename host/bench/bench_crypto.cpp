@@ -0,0 +1,115 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* AES blocks, cloud envelopes and firmware page compression */
+#include <string.h>
+
+#include "Arduino.h"
+#include "aes.h"
+#include "Riots_Envelope.h"
+#include "Riots_Lz.h"
+#include "HostBench.h"
+
+static uint8_t bench_key[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+HOST_BENCH(aes_block) {
+  HostNode node(1);
+  uint8_t block[16], out[16];
+
+  // boards of the previous benchmarks are gone, count the blocks to a node of our own
+  hostSelectNode(&node);
+  memset(block, 0x5A, sizeof(block));
+  AES128_ECB_encrypt(block, bench_key, out);
+  AES128_ECB_decrypt(out, bench_key, block);
+  bench->sim("blocks", node.aes_blocks);
+  bench->measure("encrypt_ns", 20000, [&]() { AES128_ECB_encrypt(block, bench_key, out); block[0] = out[0]; });
+  bench->measure("decrypt_ns", 20000, [&]() { AES128_ECB_decrypt(block, bench_key, out); block[0] = out[0]; });
+}
+
+HOST_BENCH(envelope) {
+  HostNode node(1);
+  Riots_Envelope sender, receiver;
+  uint8_t frame[98], value[16];
+  uint8_t length = 0;
+  uint32_t blocks;
+
+  hostSelectNode(&node);
+  memset(value, 0x33, sizeof(value));
+  sender.startSession(bench_key);
+  receiver.startSession(bench_key);
+  // four data posts, the most a tx buffer holds
+  bench->measure("seal_ns", 2000, [&]() {
+    sender.begin(frame, sizeof(frame), 0x08);
+    for( uint8_t i = 0; i < 4; i++ ) {
+      sender.addRecord(RIOTS_RECORD_DATA_POST, value, sizeof(value));
+    }
+    length = sender.seal();
+    hostBenchKeep(frame);
+  });
+  bench->sim("four_posts_bytes", length);
+
+  blocks = node.aes_blocks;
+  sender.begin(frame, sizeof(frame), 0x08);
+  for( uint8_t i = 0; i < 4; i++ ) {
+    sender.addRecord(RIOTS_RECORD_DATA_POST, value, sizeof(value));
+  }
+  length = sender.seal();
+  bench->sim("seal_aes_blocks", node.aes_blocks - blocks);
+  blocks = node.aes_blocks;
+  hostBenchKeep(receiver.open(frame, length));
+  bench->sim("open_aes_blocks", node.aes_blocks - blocks);
+  bench->measure("seal_open_ns", 2000, [&]() {
+    sender.begin(frame, sizeof(frame), 0x08);
+    for( uint8_t i = 0; i < 4; i++ ) {
+      sender.addRecord(RIOTS_RECORD_DATA_POST, value, sizeof(value));
+    }
+    hostBenchKeep(receiver.open(frame, sender.seal()));
+  });
+}
+
+HOST_BENCH(lz_page) {
+  uint8_t page[128], tokens[13], decoded[128];
+  uint32_t state = 0x1234567;
+  uint16_t packets = 0, token_bytes = 0;
+
+  // code-like page: repeated instruction words with varying operands
+  for( uint8_t i = 0; i < sizeof(page); i += 2 ) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    page[i] = (state & 0x03) ? 0x0E : (uint8_t)state;
+    page[i+1] = 0x94;
+  }
+
+  bench->measure("encode_ns", 500, [&]() {
+    uint8_t index = 0;
+    packets = 0;
+    token_bytes = 0;
+    while( index < sizeof(page) ) {
+      token_bytes += Riots_Lz::encode(page, sizeof(page), &index, tokens, sizeof(tokens));
+      packets++;
+    }
+  });
+  bench->sim("packets", packets);
+  bench->sim("token_bytes", token_bytes);
+  bench->measure("encode_decode_ns", 500, [&]() {
+    uint8_t index = 0, decoded_index = 0, length;
+    while( index < sizeof(page) ) {
+      length = Riots_Lz::encode(page, sizeof(page), &index, tokens, sizeof(tokens));
+      Riots_Lz::decode(decoded, sizeof(decoded), &decoded_index, tokens, length);
+    }
+    hostBenchKeep(decoded);
+  });
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_Flash page assembly of TYPE_PROG_PAGE, _LZ and _DELTA and the EEPROM writes */
+#include <string.h>
+
+#include "Riots_Flash.h"
+#include "Riots_Lz.h"
+#include "HostEeprom24.h"
+#include "HostBench.h"
+
+#define BENCH_PAGES   4
+
+// local to this file, other benchmarks have boards of their own
+namespace {
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostEeprom24 primary;
+  Riots_Flash flash;
+
+  Board() : node(1), bus(&node), primary(&node, RIOTS_PRIMARY_EEPROM >> 1) {
+    hostSelectNode(&node);
+  }
+};
+
+}
+
+static uint8_t sendMessage(Board *board, uint8_t type, const uint8_t *value, uint8_t length) {
+  uint8_t plain[RF_PAYLOAD_SIZE+2];
+  bool response_needed;
+
+  plain[M_LENGTH] = length;
+  memcpy(&plain[M_VALUE], value, length);
+  return board->flash.handleFlashMessage(type, plain, &response_needed);
+}
+
+/* Code-like image, repeated instruction words with varying operands */
+static void makeImage(uint8_t *image, uint16_t size) {
+  uint32_t state = 0x1234567;
+
+  for( uint16_t i = 0; i < size; i += 2 ) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    image[i] = (state & 0x03) ? 0x0E : (uint8_t)state;
+    image[i+1] = 0x94;
+  }
+}
+
+/* Sends the image in pages of the given type, reports the cost per page */
+static void benchPages(HostBench *bench, uint8_t type) {
+  Board *board = new Board();
+  uint8_t image[BENCH_PAGES * I2C_EEPROM_PAGE_SIZE];
+  uint8_t value[RF_PAYLOAD_SIZE];
+  uint8_t index, length;
+  uint16_t address, source;
+  uint32_t packets = 0, transactions, bytes;
+  uint64_t start;
+
+  makeImage(image, sizeof(image));
+  // the official image holds the same code, moved by a few words
+  memcpy(&board->primary.memory[I2C_EEPROM_O_FW + 8], image, sizeof(image));
+  board->flash.setup();
+  value[0] = BOOT_LOAD_UNOFFICIAL;
+  sendMessage(board, TYPE_ENTER_PROGMODE, value, ENTER_PROGMODE_LEN);
+  value[0] = sizeof(image) >> 8;
+  value[1] = sizeof(image) & 0xFF;
+  sendMessage(board, TYPE_PROG_FLASH, value, PROG_FLASH_LEN);
+  board->node.time_us += HOST_EEPROM24_WRITE_US;
+
+  start = board->node.time_us;
+  transactions = board->bus.transactions;
+  bytes = board->bus.bytes;
+  for( uint16_t page = 0; page < BENCH_PAGES; page++ ) {
+    address = page * I2C_EEPROM_PAGE_SIZE;
+    value[0] = address >> 8;
+    value[1] = address & 0xFF;
+    sendMessage(board, TYPE_LOAD_ADDRESS, value, 2);
+    index = 0;
+    for( uint8_t packet = 0; index < I2C_EEPROM_PAGE_SIZE; packet++ ) {
+      value[0] = packet;
+      if( type == TYPE_PROG_PAGE_LZ ) {
+        length = Riots_Lz::encode(&image[address], I2C_EEPROM_PAGE_SIZE, &index, &value[1], RF_PAYLOAD_SIZE - 3);
+      }
+      else if( type == TYPE_PROG_PAGE_DELTA ) {
+        // whole page copied from the official image in two tokens
+        source = address + 8 + index;
+        value[1] = RIOTS_DELTA_COPY | (I2C_EEPROM_PAGE_SIZE / 2 - 1);
+        value[2] = source >> 8;
+        value[3] = source & 0xFF;
+        length = RIOTS_DELTA_COPY_LEN;
+        index += I2C_EEPROM_PAGE_SIZE / 2;
+      }
+      else {
+        length = I2C_EEPROM_PAGE_SIZE - index < RIOTS_PAGE_PACKET_DATA ? I2C_EEPROM_PAGE_SIZE - index : RIOTS_PAGE_PACKET_DATA;
+        memcpy(&value[1], &image[address + index], length);
+        index += length;
+      }
+      sendMessage(board, type, value, length + 1);
+      packets++;
+    }
+    board->flash.update();
+  }
+  // last page written before leaving
+  board->flash.update();
+  Riots_Memory::waitWriteCycle(RIOTS_PRIMARY_EEPROM);
+
+  bench->sim("page_us", (double)(board->node.time_us - start) / BENCH_PAGES);
+  bench->sim("page_packets", (double)packets / BENCH_PAGES);
+  bench->sim("page_bus_transactions", (double)(board->bus.transactions - transactions) / BENCH_PAGES);
+  bench->sim("page_bus_bytes", (double)(board->bus.bytes - bytes) / BENCH_PAGES);
+  delete board;
+}
+
+HOST_BENCH(flash_page_raw) {
+  benchPages(bench, TYPE_PROG_PAGE);
+}
+
+HOST_BENCH(flash_page_lz) {
+  benchPages(bench, TYPE_PROG_PAGE_LZ);
+}
+
+HOST_BENCH(flash_page_delta) {
+  benchPages(bench, TYPE_PROG_PAGE_DELTA);
+}
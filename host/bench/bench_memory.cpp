@@ -0,0 +1,74 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_Memory block transfers against the 24-series EEPROM model */
+#include "Riots_Memory.h"
+#include "HostEeprom24.h"
+#include "HostBench.h"
+
+#define BENCH_BLOCK   256
+
+// local to this file, other benchmarks have boards of their own
+namespace {
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostEeprom24 primary;
+
+  Board(uint32_t max_scl) : node(1), bus(&node), primary(&node, RIOTS_PRIMARY_EEPROM >> 1, max_scl) {
+    hostSelectNode(&node);
+  }
+};
+
+}
+
+/* Block write and read of the EEPROM answering at the given SCL */
+static void benchBlocks(HostBench *bench, uint32_t max_scl) {
+  Board *board = new Board(max_scl);
+  uint8_t data[BENCH_BLOCK];
+  uint64_t start;
+  uint32_t bytes;
+
+  Riots_Memory::setup(RIOTS_PRIMARY_EEPROM);
+  for( uint16_t i = 0; i < sizeof(data); i++ ) {
+    data[i] = (uint8_t)i;
+  }
+
+  start = board->node.time_us;
+  Riots_Memory::writeBlock(0x0100, data, sizeof(data));
+  Riots_Memory::waitWriteCycle(RIOTS_PRIMARY_EEPROM);
+  bench->sim("write_block_us", (double)(board->node.time_us - start));
+
+  start = board->node.time_us;
+  bytes = board->bus.bytes;
+  Riots_Memory::readBlock(0x0100, data, sizeof(data));
+  bench->sim("read_block_us", (double)(board->node.time_us - start));
+  bench->sim("read_block_bus_bytes", board->bus.bytes - bytes);
+
+  start = board->node.time_us;
+  for( uint16_t i = 0; i < 16; i++ ) {
+    hostBenchKeep(Riots_Memory::read(0x0100 + i));
+  }
+  bench->sim("read_byte_us", (double)(board->node.time_us - start) / 16);
+  delete board;
+}
+
+HOST_BENCH(memory_fast_mode) {
+  benchBlocks(bench, RIOTS_I2C_FAST_MODE);
+}
+
+HOST_BENCH(memory_standard_mode) {
+  benchBlocks(bench, RIOTS_I2C_STANDARD_MODE);
+}
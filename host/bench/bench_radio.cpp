@@ -0,0 +1,131 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_Radio send and receive through the nRF24L01 model */
+#include "Arduino.h"
+#include "Riots_Radio.h"
+#include "aes.h"
+#include "HostNrf24.h"
+#include "HostBench.h"
+
+#define BENCH_FRAMES  100
+
+// local to this file, other benchmarks have boards of their own
+namespace {
+
+struct Board {
+  HostNode node;
+  HostNrf24 nrf;
+  Riots_Radio radio;
+
+  Board(uint16_t id, HostRadioMedium *medium) : node(id), nrf(&node, medium, RIOTS_CE_PIN, RIOTS_CSN_PIN, RIOTS_IRQ_PIN) {
+    hostSelectNode(&node);
+    for( uint8_t i = 0; i < RF_ADDRESS_SIZE; i++ ) {
+      node.eeprom[EEPROM_RX_ADDR + i] = (uint8_t)(0x10 * id + i);
+    }
+    radio.setup(0xFF, 0xFF, 0xFF, 0xFF);
+  }
+};
+
+}
+
+HOST_BENCH(radio_send) {
+  HostRadioMedium medium;
+  Board *mama = new Board(1, &medium);
+  Board *baby = new Board(2, &medium);
+  uint64_t send_us = 0, receive_us = 0, start;
+  uint32_t send_spi = 0, receive_spi = 0, spi;
+
+  for( uint16_t i = 0; i < BENCH_FRAMES; i++ ) {
+    hostSelectNode(&mama->node);
+    mama->radio.setTXAddress(baby->radio.getOwnRadioAddress());
+    memset(mama->radio.getTXCryptBuffAddress(), (uint8_t)i, RF_PAYLOAD_SIZE);
+    start = mama->node.time_us;
+    spi = mama->node.spi_bytes;
+    mama->radio.send();
+    send_us += mama->node.time_us - start;
+    send_spi += mama->node.spi_bytes - spi;
+
+    hostSelectNode(&baby->node);
+    if( baby->node.time_us < mama->node.time_us ) {
+      baby->node.advance(mama->node.time_us - baby->node.time_us);
+    }
+    start = baby->node.time_us;
+    spi = baby->node.spi_bytes;
+    while( baby->radio.update(0) != RIOTS_OK ) {
+      delay(1);
+    }
+    receive_us += baby->node.time_us - start;
+    receive_spi += baby->node.spi_bytes - spi;
+  }
+
+  bench->sim("send_us", (double)send_us / BENCH_FRAMES);
+  bench->sim("receive_us", (double)receive_us / BENCH_FRAMES);
+  bench->sim("send_spi_bytes", (double)send_spi / BENCH_FRAMES);
+  bench->sim("receive_spi_bytes", (double)receive_spi / BENCH_FRAMES);
+  bench->sim("airtime_us", (double)mama->nrf.airtime_us / BENCH_FRAMES);
+  bench->sim("tx_frames", mama->nrf.tx_frames);
+  delete baby;
+  delete mama;
+}
+
+HOST_BENCH(radio_no_receiver) {
+  HostRadioMedium medium;
+  Board *mama = new Board(1, &medium);
+  byte nobody[RF_ADDRESS_SIZE] = { 0x77, 0x77, 0x77, 0x77 };
+  uint64_t start;
+
+  mama->radio.setTXAddress(nobody);
+  start = mama->node.time_us;
+  mama->radio.send();
+  bench->sim("send_us", (double)(mama->node.time_us - start));
+  bench->sim("tx_frames", mama->nrf.tx_frames);
+  delete mama;
+}
+
+/* Riots_Radio::decrypt and the checksum and length validation of a frame */
+HOST_BENCH(radio_decrypt) {
+  HostRadioMedium medium;
+  Board *board = new Board(1, &medium);
+  Riots_Radio *radio = &board->radio;
+  Riots_Stats *stats = radio->getStatsAddress();
+  byte plain[RF_PAYLOAD_SIZE];
+  byte other_key[AES_KEY_SIZE];
+  uint32_t blocks;
+
+  memset(other_key, 0x42, sizeof(other_key));
+  memset(plain, 0x21, sizeof(plain));
+  plain[M_LENGTH] = 6;
+  plain[RF_PAYLOAD_SIZE-1] = 0;
+  for( uint8_t i = 0; i < RF_PAYLOAD_SIZE - 1; i++ ) {
+    plain[RF_PAYLOAD_SIZE-1] ^= plain[i];
+  }
+  AES128_ECB_encrypt(plain, radio->getSharedKeyAddress(), radio->getRXCryptBuffAddress());
+
+  blocks = board->node.aes_blocks;
+  for( uint16_t i = 0; i < BENCH_FRAMES; i++ ) {
+    hostBenchKeep(radio->decrypt(radio->getSharedKeyAddress()));
+  }
+  bench->sim("valid_aes_blocks", (double)(board->node.aes_blocks - blocks) / BENCH_FRAMES);
+
+  // frame of another network, every try fails the checksum
+  blocks = board->node.aes_blocks;
+  for( uint16_t i = 0; i < BENCH_FRAMES; i++ ) {
+    radio->decrypt(other_key);
+  }
+  bench->sim("other_key_aes_blocks", (double)(board->node.aes_blocks - blocks) / BENCH_FRAMES);
+  bench->sim("other_key_failures", stats->decrypt_failures[RIOTS_STATS_OTHER_KEY]);
+  bench->measure("decrypt_ns", 20000, [&]() { hostBenchKeep(radio->decrypt(radio->getSharedKeyAddress())); });
+  delete board;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_SHT21 and Riots_TMD3782x readings and their conversion math */
+#include "Riots_Memory.h"
+#include "Riots_SHT21.h"
+#include "Riots_TMD3782x.h"
+#include "HostSht21.h"
+#include "HostTmd3782x.h"
+#include "HostBench.h"
+
+// local to this file, other benchmarks have boards of their own
+namespace {
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostSht21 sht;
+  HostTmd3782x tmd;
+  Riots_SHT21 sht21;
+  Riots_TMD3782x tmd3782x;
+
+  Board() : node(1), bus(&node), sht(&node), tmd(&node) {
+    hostSelectNode(&node);
+    // as after Riots_Memory::setup() has found the fast mode
+    Riots_Memory::setBusSpeed(RIOTS_I2C_FAST_MODE);
+    sht21.setup();
+    tmd3782x.setup();
+  }
+};
+
+}
+
+HOST_BENCH(sht21) {
+  Board *board = new Board();
+  uint32_t transactions = board->bus.transactions;
+  uint32_t bytes = board->bus.bytes;
+  uint64_t start;
+
+  board->sht21.startMeasurement();
+  delay(HOST_SHT21_MEAS_US / 1000);
+  start = board->node.time_us;
+  hostBenchKeep(board->sht21.readHumidity());
+  hostBenchKeep(board->sht21.readTemperature());
+  bench->sim("read_us", (double)(board->node.time_us - start));
+  bench->sim("bus_transactions", board->bus.transactions - transactions);
+  bench->sim("bus_bytes", board->bus.bytes - bytes);
+  // the conversions of the same readings, the bus transfers of the model take little host time
+  bench->measure("read_ns", 20000, [&]() {
+    hostBenchKeep(board->sht21.readHumidity());
+    hostBenchKeep(board->sht21.readTemperature());
+  });
+  delete board;
+}
+
+HOST_BENCH(tmd3782x) {
+  Board *board = new Board();
+  uint32_t transactions, bytes;
+  uint64_t start;
+
+  delay(200);
+  start = board->node.time_us;
+  transactions = board->bus.transactions;
+  bytes = board->bus.bytes;
+  board->tmd3782x.readRgbcData();
+  bench->sim("read_us", (double)(board->node.time_us - start));
+  bench->sim("bus_transactions", board->bus.transactions - transactions);
+  bench->sim("bus_bytes", board->bus.bytes - bytes);
+  bench->measure("convert_ns", 20000, [&]() {
+    hostBenchKeep(board->tmd3782x.getColorTemperature());
+    hostBenchKeep(board->tmd3782x.getLux());
+  });
+  delete board;
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include "HostBmp280.h"
+
+// dig_T1..dig_T3 and dig_P1..dig_P9 of the datasheet example
+static const uint16_t host_bmp280_example[12] = { 27504, 26435, (uint16_t)-1000, 36477, (uint16_t)-10685, 3024,
+                                                  2855, 140, (uint16_t)-7, 15500, (uint16_t)-14600, 6000 };
+
+HostBmp280::HostBmp280(HostNode *node, uint32_t max_scl) : HostI2cDevice(HOST_BMP280_ADDRESS, max_scl),
+  pointer(0), pointer_set(false) {
+  memset(registers, 0, sizeof(registers));
+  registers[HOST_BMP280_CHIP_ID] = 0x58;
+  setCalibration(host_bmp280_example);
+  // datasheet example readings
+  setRaw(415148, 519888);
+  if( node->i2c ) {
+    node->i2c->attach(this);
+  }
+}
+
+/* Calibration words, little endian from 0x88 */
+void HostBmp280::setCalibration(const uint16_t *words) {
+  for( uint8_t i = 0; i < 12; i++ ) {
+    registers[HOST_BMP280_CALIBRATION + 2*i] = (uint8_t)words[i];
+    registers[HOST_BMP280_CALIBRATION + 2*i + 1] = (uint8_t)(words[i] >> 8);
+  }
+}
+
+/* 20-bit readings as msb, lsb and the upper nibble of xlsb */
+void HostBmp280::setRaw(int32_t adc_P, int32_t adc_T) {
+  uint8_t *result = &registers[HOST_BMP280_RESULT];
+
+  result[0] = (uint8_t)(adc_P >> 12);
+  result[1] = (uint8_t)(adc_P >> 4);
+  result[2] = (uint8_t)(adc_P << 4);
+  result[3] = (uint8_t)(adc_T >> 12);
+  result[4] = (uint8_t)(adc_T >> 4);
+  result[5] = (uint8_t)(adc_T << 4);
+}
+
+bool HostBmp280::select(bool read) {
+  if( !read ) {
+    pointer_set = false;
+  }
+  return true;
+}
+
+bool HostBmp280::write(uint8_t data) {
+  if( !pointer_set ) {
+    pointer = data;
+    pointer_set = true;
+  }
+  else {
+    registers[pointer++] = data;
+  }
+  return true;
+}
+
+uint8_t HostBmp280::read(bool ack) {
+  (void)ack;
+  return registers[pointer++];
+}
+
+void HostBmp280::stop() {
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef HostBmp280_h
+#define HostBmp280_h
+
+#include "HostI2c.h"
+
+#define HOST_BMP280_ADDRESS       0x77
+#define HOST_BMP280_REGISTERS     0x100
+#define HOST_BMP280_CALIBRATION   0x88
+#define HOST_BMP280_CHIP_ID       0xD0
+#define HOST_BMP280_RESULT        0xF7
+
+/**
+ * BMP280 pressure sensor. Register reads auto-increment, the calibration is
+ * the example of the datasheet until it is set, and the raw readings of the
+ * result registers are given with setRaw().
+ */
+class HostBmp280 : public HostI2cDevice {
+  public:
+    HostBmp280(HostNode *node, uint32_t max_scl = 400000UL);
+
+    bool select(bool read);
+    bool write(uint8_t data);
+    uint8_t read(bool ack);
+    void stop();
+
+    void setCalibration(const uint16_t *words);
+    void setRaw(int32_t adc_P, int32_t adc_T);
+
+    uint8_t registers[HOST_BMP280_REGISTERS];
+
+  private:
+    uint8_t pointer;                        /*!< Register pointer                       */
+    bool pointer_set;                       /*!< First byte of a write sets the pointer */
+};
+
+#endif // HostBmp280_h
@@ -0,0 +1,79 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "HostEeprom24.h"
+
+HostEeprom24::HostEeprom24(HostNode *node, uint8_t address, uint32_t max_scl) : HostI2cDevice(address, max_scl),
+  write_cycles(0), busy_nacks(0), node(node), busy_until(0), pointer(0), address_bytes(0), data_bytes(0), writing(false) {
+  memset(memory, 0xFF, sizeof(memory));
+  if( node->i2c ) {
+    node->i2c->attach(this);
+  }
+}
+
+bool HostEeprom24::busy() {
+  return node->time_us < busy_until;
+}
+
+bool HostEeprom24::select(bool read) {
+  if( busy() ) {
+    busy_nacks++;
+    return false;
+  }
+  writing = !read;
+  if( writing ) {
+    address_bytes = 0;
+    data_bytes = 0;
+    memset(page_used, 0, sizeof(page_used));
+  }
+  return true;
+}
+
+bool HostEeprom24::write(uint8_t data) {
+  if( address_bytes < 2 ) {
+    pointer = address_bytes == 0 ? (uint16_t)(data << 8) : (uint16_t)(pointer | data);
+    address_bytes++;
+    return true;
+  }
+  // address counter wraps within the page
+  uint8_t offset = (pointer + data_bytes) % HOST_EEPROM24_PAGE_SIZE;
+  page[offset] = data;
+  page_used[offset] = true;
+  data_bytes++;
+  return true;
+}
+
+uint8_t HostEeprom24::read(bool ack) {
+  (void)ack;
+  return memory[pointer++];
+}
+
+void HostEeprom24::stop() {
+  if( writing && address_bytes == 2 && data_bytes > 0 ) {
+    uint16_t page_start = pointer - pointer % HOST_EEPROM24_PAGE_SIZE;
+    for( uint16_t i = 0; i < HOST_EEPROM24_PAGE_SIZE; i++ ) {
+      if( page_used[i] ) {
+        memory[page_start + i] = page[i];
+      }
+    }
+    pointer = page_start + (pointer + data_bytes) % HOST_EEPROM24_PAGE_SIZE;
+    write_cycles++;
+    busy_until = node->time_us + HOST_EEPROM24_WRITE_US;
+  }
+  writing = false;
+  address_bytes = 0;
+  data_bytes = 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostEeprom24_h
+#define HostEeprom24_h
+
+#include "HostI2c.h"
+
+#define HOST_EEPROM24_SIZE        65536UL
+#define HOST_EEPROM24_PAGE_SIZE   128
+#define HOST_EEPROM24_WRITE_US    5000    // tWR, address is not acknowledged meanwhile
+
+/**
+ * 24-series EEPROM with 16-bit addressing, e.g. 24LC512. Page writes wrap
+ * within the page and start the write cycle at the stop condition.
+ */
+class HostEeprom24 : public HostI2cDevice {
+  public:
+    HostEeprom24(HostNode *node, uint8_t address, uint32_t max_scl = 400000UL);
+
+    bool select(bool read);
+    bool write(uint8_t data);
+    uint8_t read(bool ack);
+    void stop();
+    bool busy();
+
+    uint8_t memory[HOST_EEPROM24_SIZE];
+    uint32_t write_cycles;                  /*!< Count of write cycles started          */
+    uint32_t busy_nacks;                    /*!< Addresses not acknowledged in a write cycle */
+
+  private:
+    HostNode *node;
+    uint64_t busy_until;
+    uint16_t pointer;                       /*!< Address counter                        */
+    uint8_t address_bytes;                  /*!< Address bytes received in this write   */
+    uint8_t data_bytes;                     /*!< Data bytes received in this write      */
+    uint8_t page[HOST_EEPROM24_PAGE_SIZE];  /*!< Page buffer of the write               */
+    bool page_used[HOST_EEPROM24_PAGE_SIZE];
+    bool writing;
+};
+
+#endif // HostEeprom24_h
@@ -0,0 +1,169 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HostI2c.h"
+#include "Arduino.h"
+#include "Riots_HostHal.h"
+
+HostI2cBus::HostI2cBus(HostNode *node) : transactions(0), bytes(0), twcr_polls(0), hold_after(0), node(node), device_count(0),
+  selected(0), started(false), reading(false), twcr(0), twsr(TW_NO_INFO), twdr(0xFF), twbr(HOST_TWBR_100KHZ) {
+  node->i2c = this;
+}
+
+void HostI2cBus::attach(HostI2cDevice *device) {
+  if( device_count < HOST_I2C_MAX_DEVICES ) {
+    devices[device_count++] = device;
+  }
+}
+
+/**
+ * SCL frequency set in TWBR, prescaler is always 1.
+ */
+uint32_t HostI2cBus::sclFrequency() {
+  return F_CPU / (16 + 2 * (uint32_t)twbr);
+}
+
+void HostI2cBus::clock(uint8_t bits) {
+  node->advance((uint32_t)bits * 1000000UL / sclFrequency() + 1);
+}
+
+/**
+ * Sends a start, or a repeated start, and the address. Devices slower than
+ * the bus do not acknowledge.
+ */
+bool HostI2cBus::start(uint8_t address, bool read) {
+  if( selected ) {
+    selected->stop();
+  }
+  selected = 0;
+  reading = read;
+  transactions++;
+  bytes++;
+  clock(10);
+  for( uint8_t i = 0; i < device_count; i++ ) {
+    if( devices[i]->address == address ) {
+      if( sclFrequency() <= devices[i]->max_scl && devices[i]->select(read) ) {
+        selected = devices[i];
+      }
+      break;
+    }
+  }
+  return selected != 0;
+}
+
+bool HostI2cBus::write(uint8_t data) {
+  bytes++;
+  clock(9);
+  return selected && !reading && selected->write(data);
+}
+
+uint8_t HostI2cBus::read(bool ack) {
+  bytes++;
+  clock(9);
+  if( !selected || !reading ) {
+    return 0xFF;
+  }
+  return selected->read(ack);
+}
+
+void HostI2cBus::stop() {
+  clock(1);
+  if( selected ) {
+    selected->stop();
+  }
+  selected = 0;
+  started = false;
+}
+
+/**
+ * Write to a TWI register. Writing TWINT to TWCR runs the operation the
+ * other bits ask for and sets TWINT again with its status in TWSR.
+ */
+void HostI2cBus::writeRegister(uint8_t reg, uint8_t value) {
+  switch( reg ) {
+    case HOST_TWSR:
+      twsr = (twsr & 0xF8) | (value & 0x03);
+      return;
+    case HOST_TWDR:
+      twdr = value;
+      return;
+    case HOST_TWBR:
+      twbr = value;
+      return;
+  }
+
+  twcr = value;
+  if( !(value & (1 << TWEN)) ) {
+    // TWI off, bus released
+    selected = 0;
+    started = false;
+    twsr = TW_NO_INFO;
+    return;
+  }
+  if( !(value & (1 << TWINT)) ) {
+    return;
+  }
+  if( hold_after && bytes >= hold_after ) {
+    // SCL held low by a device, the operation never completes
+    twcr = value & ~(1 << TWINT);
+    return;
+  }
+
+  if( value & (1 << TWSTO) ) {
+    stop();
+    twsr = TW_NO_INFO;
+    // TWSTO clears when the stop has been sent, TWINT is not set
+    twcr = value & ~((1 << TWSTO) | (1 << TWINT));
+    return;
+  }
+
+  if( value & (1 << TWSTA) ) {
+    twsr = (started || selected) ? TW_REP_START : TW_START;
+    started = true;
+  }
+  else if( started ) {
+    bool read = twdr & 0x01;
+    bool ack = start(twdr >> 1, read);
+    started = false;
+    if( read ) {
+      twsr = ack ? TW_MR_SLA_ACK : TW_MR_SLA_NACK;
+    }
+    else {
+      twsr = ack ? TW_MT_SLA_ACK : TW_MT_SLA_NACK;
+    }
+  }
+  else if( reading ) {
+    bool ack = value & (1 << TWEA);
+    twdr = read(ack);
+    twsr = ack ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+  }
+  else {
+    twsr = write(twdr) ? TW_MT_DATA_ACK : TW_MT_DATA_NACK;
+  }
+  twcr |= (1 << TWINT);
+}
+
+uint8_t HostI2cBus::readRegister(uint8_t reg) {
+  switch( reg ) {
+    case HOST_TWCR:
+      twcr_polls++;
+      return twcr;
+    case HOST_TWSR:
+      return twsr;
+    case HOST_TWDR:
+      return twdr;
+    default:
+      return twbr;
+  }
+}
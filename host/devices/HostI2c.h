@@ -0,0 +1,82 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostI2c_h
+#define HostI2c_h
+
+#include <stdint.h>
+
+#include "HostNode.h"
+
+#define HOST_I2C_MAX_DEVICES  8
+#define HOST_TWBR_100KHZ      32    // Wire.begin() at 8 MHz
+
+/**
+ * Device on the I2C bus. Addresses are 7-bit, the R/W bit is given separately.
+ */
+class HostI2cDevice {
+  public:
+    HostI2cDevice(uint8_t address, uint32_t max_scl) : address(address), max_scl(max_scl) {}
+    virtual ~HostI2cDevice() {}
+    virtual bool select(bool read) = 0;       /*!< Address phase, returns ACK             */
+    virtual bool write(uint8_t data) = 0;     /*!< Data from the master, returns ACK      */
+    virtual uint8_t read(bool ack) = 0;       /*!< Data to the master                     */
+    virtual void stop() = 0;                  /*!< Stop or repeated start                 */
+
+    uint8_t address;                          /*!< 7-bit bus address                      */
+    uint32_t max_scl;                         /*!< Fastest SCL the device answers at      */
+};
+
+/**
+ * I2C bus of a node with the TWI state of the ATmega328P. Transfers advance
+ * the time of the node with the SCL period set in TWBR.
+ */
+class HostI2cBus {
+  public:
+    HostI2cBus(HostNode *node);
+
+    void attach(HostI2cDevice *device);
+    uint32_t sclFrequency();
+
+    /* Bus transactions used by Wire and the TWI registers */
+    bool start(uint8_t address, bool read);
+    bool write(uint8_t data);
+    uint8_t read(bool ack);
+    void stop();
+
+    /* TWI registers */
+    void writeRegister(uint8_t reg, uint8_t value);
+    uint8_t readRegister(uint8_t reg);
+
+    uint32_t transactions;                    /*!< Count of start conditions              */
+    uint32_t bytes;                           /*!< Count of bytes moved, addresses included */
+    uint32_t twcr_polls;                      /*!< Count of TWCR reads                    */
+    uint32_t hold_after;                      /*!< SCL is held low after this many bytes, 0 never */
+
+  private:
+    void clock(uint8_t bits);
+
+    HostNode *node;
+    HostI2cDevice *devices[HOST_I2C_MAX_DEVICES];
+    uint8_t device_count;
+    HostI2cDevice *selected;                  /*!< Device addressed since the last start  */
+    bool started;                             /*!< Start condition sent, address expected */
+    bool reading;                             /*!< Master receiver mode                   */
+    uint8_t twcr;
+    uint8_t twsr;
+    uint8_t twdr;
+    uint8_t twbr;
+};
+
+#endif // HostI2c_h
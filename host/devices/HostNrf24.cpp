@@ -0,0 +1,447 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "HostNrf24.h"
+#include "nRF24L01.h"
+
+#define HOST_NRF24_NO_COMMAND   0xFF
+#define HOST_NRF24_IRQ_FLAGS    ((1 << RX_DR) | (1 << TX_DS) | (1 << MAX_RT))
+#define HOST_NRF24_ACTIVATE_KEY 0x73
+
+HostRadioMedium::HostRadioMedium(uint32_t seed) : frames(0), lost(0), collisions(0), radio_count(0), loss(0),
+  latency_us(0), random_state(seed ? seed : 1), air_index(0) {
+  memset(link_loss_set, 0, sizeof(link_loss_set));
+  memset(air, 0, sizeof(air));
+}
+
+void HostRadioMedium::attach(HostNrf24 *radio) {
+  if( radio_count < HOST_NRF24_MAX_RADIOS ) {
+    radio->index = radio_count;
+    radios[radio_count++] = radio;
+  }
+}
+
+/**
+ * Sets the probability to lose a frame on every link.
+ */
+void HostRadioMedium::setLoss(float probability) {
+  loss = probability;
+}
+
+/**
+ * Sets the probability to lose a frame from one radio to another, the
+ * direction of ACKs is set separately.
+ */
+void HostRadioMedium::setLinkLoss(HostNrf24 *from, HostNrf24 *to, float probability) {
+  link_loss[from->index][to->index] = probability;
+  link_loss_set[from->index][to->index] = true;
+}
+
+/**
+ * Sets an extra delay from the end of a frame to the RX FIFO of the receiver,
+ * e.g. for repeaters on the way. ACKs are not delayed.
+ */
+void HostRadioMedium::setLatency(uint32_t us) {
+  latency_us = us;
+}
+
+float HostRadioMedium::linkLoss(uint8_t from, uint8_t to) {
+  return link_loss_set[from][to] ? link_loss[from][to] : loss;
+}
+
+bool HostRadioMedium::chance(float probability) {
+  if( probability <= 0 ) {
+    return false;
+  }
+  // xorshift32, the same seed gives the same losses
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return (random_state & 0xFFFFFF) < (uint32_t)(probability * 0x1000000);
+}
+
+bool HostRadioMedium::collides(uint8_t channel, uint64_t start_us, uint64_t end_us) {
+  bool collision = false;
+
+  for( uint8_t i = 0; i < sizeof(air) / sizeof(air[0]); i++ ) {
+    if( air[i].end_us > start_us && air[i].start_us < end_us && air[i].channel == channel ) {
+      collision = true;
+    }
+  }
+  air[air_index].channel = channel;
+  air[air_index].start_us = start_us;
+  air[air_index].end_us = end_us;
+  air_index = (air_index + 1) % (sizeof(air) / sizeof(air[0]));
+  return collision;
+}
+
+/**
+ * Sends one frame from the radio to every radio listening to its address.
+ *
+ * @return bool               True if an ACK came back, only when need_ack is set.
+ */
+bool HostRadioMedium::transmit(HostNrf24 *from, const uint8_t *payload, uint8_t length, uint8_t pid,
+                               uint64_t start_us, uint32_t airtime_us, bool need_ack) {
+  bool acked = false;
+  uint8_t pipe;
+
+  frames++;
+  if( collides(from->channel(), start_us, start_us + airtime_us) ) {
+    collisions++;
+    return false;
+  }
+  for( uint8_t i = 0; i < radio_count; i++ ) {
+    HostNrf24 *to = radios[i];
+    if( to == from || !to->listens(from->channel(), from->txAddress(), &pipe) ) {
+      continue;
+    }
+    if( chance(linkLoss(from->index, to->index)) ) {
+      lost++;
+      continue;
+    }
+    if( !to->receive(from, payload, length, pid, pipe, start_us + airtime_us + latency_us) ) {
+      continue;
+    }
+    // ACK goes to RX_ADDR_P0 of the sender, it has to equal TX_ADDR
+    if( need_ack && to->acksPipe(pipe) && !chance(linkLoss(to->index, from->index)) &&
+        memcmp(from->rx_address[0], from->txAddress(), HOST_NRF24_ADDRESS_SIZE) == 0 ) {
+      acked = true;
+    }
+  }
+  return acked;
+}
+
+HostNrf24::HostNrf24(HostNode *node, HostRadioMedium *medium, uint8_t ce_pin, uint8_t csn_pin, uint8_t irq_pin,
+                     bool plus) : node(node), index(0), airtime_us(0), tx_frames(0), rx_frames(0), rx_overflows(0),
+  ignored_commands(0), medium(medium), ce_pin(ce_pin), csn_pin(csn_pin), irq_pin(irq_pin), plus(plus),
+  activated(false), ce(false), csn(true), cmd(HOST_NRF24_NO_COMMAND), cmd_index(0), rx_count(0), pending_count(0),
+  tx_count(0), tx_pid(0), tx_done_us(0), tx_result(0), tx_busy(false) {
+  // reset values of the registers used
+  memset(reg, 0, sizeof(reg));
+  reg[CONFIG] = 0x08;
+  reg[EN_AA] = 0x3F;
+  reg[EN_RXADDR] = 0x03;
+  reg[SETUP_AW] = 0x03;
+  reg[SETUP_RETR] = 0x03;
+  reg[RF_CH] = 0x02;
+  reg[RF_SETUP] = 0x0F;
+  memset(rx_address[0], 0xE7, HOST_NRF24_ADDRESS_SIZE);
+  memset(rx_address[1], 0xC2, HOST_NRF24_ADDRESS_SIZE);
+  memset(tx_address, 0xE7, HOST_NRF24_ADDRESS_SIZE);
+  memset(last_pid, 0xFF, sizeof(last_pid));
+
+  node->spi = this;
+  node->attachPin(ce_pin, this);
+  node->attachPin(csn_pin, this);
+  node->attachPin(irq_pin, this);
+  medium->attach(this);
+}
+
+bool HostNrf24::featureActive() {
+  return plus || activated;
+}
+
+uint8_t HostNrf24::channel() {
+  return reg[RF_CH];
+}
+
+const uint8_t* HostNrf24::txAddress() {
+  return tx_address;
+}
+
+uint8_t HostNrf24::status() {
+  uint8_t pipe = rx_count ? rx_fifo[0].pipe : 0x07;
+
+  return (reg[STATUS] & HOST_NRF24_IRQ_FLAGS) | (pipe << RX_P_NO) | (tx_count == HOST_NRF24_FIFO_DEPTH ? 1 : 0);
+}
+
+uint8_t HostNrf24::fifoStatus() {
+  uint8_t fifo = 0;
+
+  if( rx_count == 0 ) fifo |= (1 << RX_EMPTY);
+  if( rx_count == HOST_NRF24_FIFO_DEPTH ) fifo |= (1 << RX_FULL);
+  if( tx_count == 0 ) fifo |= (1 << TX_EMPTY);
+  if( tx_count == HOST_NRF24_FIFO_DEPTH ) fifo |= (1 << FIFO_FULL);
+  return fifo;
+}
+
+/**
+ * Time on air of one frame with the data rate of RF_SETUP.
+ */
+uint32_t HostNrf24::frameTime(uint8_t length) {
+  uint32_t bits = HOST_NRF24_FRAME_BITS + length * 8 + HOST_NRF24_CRC_BITS;
+  uint32_t rate = 1000000UL;
+
+  if( reg[RF_SETUP] & (1 << RF_DR_LOW) ) {
+    rate = 250000UL;
+  }
+  else if( reg[RF_SETUP] & (1 << RF_DR_HIGH) ) {
+    rate = 2000000UL;
+  }
+  return bits * 1000000UL / rate;
+}
+
+/**
+ * Applies what has happened until the current time of the node: end of the
+ * transmission in progress and frames arrived from the air.
+ */
+void HostNrf24::update() {
+  uint64_t now = node->time_us;
+
+  if( tx_busy && now >= tx_done_us ) {
+    tx_busy = false;
+    reg[STATUS] |= tx_result;
+    if( tx_result == (1 << TX_DS) && tx_count ) {
+      memmove(&tx_fifo[0], &tx_fifo[1], sizeof(tx_fifo[0]) * (HOST_NRF24_FIFO_DEPTH - 1));
+      tx_count--;
+    }
+    startTransmit();
+  }
+
+  for( uint8_t i = 0; i < pending_count; ) {
+    if( pending[i].arrival_us > now ) {
+      i++;
+      continue;
+    }
+    if( rx_count < HOST_NRF24_FIFO_DEPTH ) {
+      rx_fifo[rx_count++] = pending[i];
+      reg[STATUS] |= (1 << RX_DR);
+      rx_frames++;
+    }
+    else {
+      rx_overflows++;
+    }
+    memmove(&pending[i], &pending[i + 1], sizeof(pending[0]) * (pending_count - i - 1));
+    pending_count--;
+  }
+}
+
+/**
+ * Sends the payload at the head of the TX FIFO in PTX mode with CE high.
+ * Retransmits and their delays are resolved at once, the result shows up
+ * in STATUS when the time of the node reaches the end of the last attempt.
+ */
+void HostNrf24::startTransmit() {
+  if( tx_busy || tx_count == 0 || !ce || (reg[CONFIG] & (1 << PRIM_RX)) || !(reg[CONFIG] & (1 << PWR_UP)) ||
+      (reg[STATUS] & (1 << MAX_RT)) ) {
+    return;
+  }
+
+  bool need_ack = !tx_fifo[0].no_ack && (reg[EN_AA] & (1 << ENAA_P0));
+  uint8_t retransmits = need_ack ? (reg[SETUP_RETR] & 0x0F) : 0;
+  uint32_t airtime = frameTime(tx_fifo[0].length);
+  uint32_t retransmit_delay = ((reg[SETUP_RETR] >> ARD) + 1) * 250UL;
+  uint64_t start = node->time_us + HOST_NRF24_SETTLE_US;
+
+  tx_pid = (tx_pid + 1) & 0x03;
+  tx_result = (1 << MAX_RT);
+  for( uint8_t attempt = 0; attempt <= retransmits; attempt++ ) {
+    bool acked = medium->transmit(this, tx_fifo[0].payload, tx_fifo[0].length, tx_pid, start, airtime, need_ack);
+    tx_frames++;
+    airtime_us += airtime;
+    if( !need_ack ) {
+      start += airtime;
+      tx_result = (1 << TX_DS);
+      break;
+    }
+    if( acked ) {
+      start += airtime + HOST_NRF24_SETTLE_US + frameTime(0);
+      tx_result = (1 << TX_DS);
+      break;
+    }
+    start += airtime + retransmit_delay;
+  }
+  tx_done_us = start;
+  tx_busy = true;
+}
+
+/**
+ * Tells if the radio receives the address on the channel now.
+ */
+bool HostNrf24::listens(uint8_t channel, const uint8_t *address, uint8_t *pipe) {
+  update();
+  if( !ce || !(reg[CONFIG] & (1 << PRIM_RX)) || !(reg[CONFIG] & (1 << PWR_UP)) || reg[RF_CH] != channel ) {
+    return false;
+  }
+  for( uint8_t i = 0; i < 2; i++ ) {
+    if( (reg[EN_RXADDR] & (1 << i)) && memcmp(rx_address[i], address, HOST_NRF24_ADDRESS_SIZE) == 0 ) {
+      *pipe = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HostNrf24::acksPipe(uint8_t pipe) {
+  return reg[EN_AA] & (1 << pipe);
+}
+
+/**
+ * Takes a frame from the air. It shows up in the RX FIFO at its arrival
+ * time. A retransmit of the frame already received is acknowledged again
+ * but not stored.
+ *
+ * @return bool               False if there was no room for the frame.
+ */
+bool HostNrf24::receive(HostNrf24 *from, const uint8_t *payload, uint8_t length, uint8_t pid, uint8_t pipe,
+                        uint64_t arrival_us) {
+  if( last_pid[from->index] == pid ) {
+    return true;
+  }
+  if( pending_count == HOST_NRF24_MAX_PENDING || rx_count + pending_count >= HOST_NRF24_FIFO_DEPTH ) {
+    rx_overflows++;
+    return false;
+  }
+  last_pid[from->index] = pid;
+  memset(pending[pending_count].payload, 0, HOST_NRF24_PAYLOAD_SIZE);
+  memcpy(pending[pending_count].payload, payload, length);
+  pending[pending_count].length = reg[RX_PW_P0 + pipe];
+  pending[pending_count].pipe = pipe;
+  pending[pending_count].arrival_us = arrival_us;
+  pending_count++;
+  return true;
+}
+
+void HostNrf24::pinWritten(uint8_t pin, uint8_t value) {
+  update();
+  if( pin == csn_pin ) {
+    if( !value && csn ) {
+      cmd = HOST_NRF24_NO_COMMAND;
+      cmd_index = 0;
+    }
+    else if( value && !csn ) {
+      endCommand();
+    }
+    csn = value;
+  }
+  else if( pin == ce_pin ) {
+    ce = value;
+    startTransmit();
+  }
+}
+
+uint8_t HostNrf24::pinRead(uint8_t pin) {
+  update();
+  if( pin == irq_pin ) {
+    // IRQ is active low, CONFIG masks the sources
+    return (status() & HOST_NRF24_IRQ_FLAGS & ~reg[CONFIG]) ? 0 : 1;
+  }
+  return 0;
+}
+
+uint8_t HostNrf24::transfer(uint8_t data) {
+  uint8_t reply = 0xFF;
+
+  node->advance(HOST_SPI_BYTE_US);
+  if( csn ) {
+    return reply;
+  }
+  update();
+  if( cmd == HOST_NRF24_NO_COMMAND ) {
+    cmd = data;
+    cmd_index = 0;
+    if( cmd == FLUSH_TX ) {
+      tx_count = 0;
+    }
+    else if( cmd == FLUSH_RX ) {
+      rx_count = 0;
+    }
+    return status();
+  }
+
+  if( cmd < W_REGISTER ) {
+    uint8_t r = cmd & REGISTER_MASK;
+    if( r == RX_ADDR_P0 || r == RX_ADDR_P1 ) {
+      reply = rx_address[r - RX_ADDR_P0][cmd_index % HOST_NRF24_ADDRESS_SIZE];
+    }
+    else if( r == TX_ADDR ) {
+      reply = tx_address[cmd_index % HOST_NRF24_ADDRESS_SIZE];
+    }
+    else if( r == STATUS ) {
+      reply = status();
+    }
+    else if( r == FIFO_STATUS ) {
+      reply = fifoStatus();
+    }
+    else if( r < HOST_NRF24_REGISTERS ) {
+      reply = reg[r];
+    }
+  }
+  else if( cmd == R_RX_PAYLOAD ) {
+    reply = rx_count ? rx_fifo[0].payload[cmd_index % HOST_NRF24_PAYLOAD_SIZE] : 0;
+  }
+  if( cmd_index < HOST_NRF24_PAYLOAD_SIZE ) {
+    buffer[cmd_index] = data;
+  }
+  cmd_index++;
+  return reply;
+}
+
+/**
+ * Completes the command when CSN goes high.
+ */
+void HostNrf24::endCommand() {
+  uint8_t length = cmd_index < HOST_NRF24_PAYLOAD_SIZE ? cmd_index : HOST_NRF24_PAYLOAD_SIZE;
+
+  if( cmd == HOST_NRF24_NO_COMMAND || cmd_index == 0 ) {
+    return;
+  }
+  if( cmd >= W_REGISTER && cmd <= (W_REGISTER | REGISTER_MASK) ) {
+    uint8_t r = cmd & REGISTER_MASK;
+    if( r == RX_ADDR_P0 || r == RX_ADDR_P1 || r == TX_ADDR ) {
+      uint8_t *address = r == TX_ADDR ? tx_address : rx_address[r - RX_ADDR_P0];
+      memcpy(address, buffer, length < HOST_NRF24_ADDRESS_SIZE ? length : HOST_NRF24_ADDRESS_SIZE);
+    }
+    else if( r == STATUS ) {
+      // interrupt flags are cleared by writing 1
+      reg[STATUS] &= ~(buffer[0] & HOST_NRF24_IRQ_FLAGS);
+      startTransmit();
+    }
+    else if( (r == FEATURE || r == DYNPD) && !featureActive() ) {
+      ignored_commands++;
+    }
+    else if( r < HOST_NRF24_REGISTERS && r != FIFO_STATUS ) {
+      reg[r] = buffer[0];
+      startTransmit();
+    }
+  }
+  else if( cmd == ACTIVATE ) {
+    if( buffer[0] == HOST_NRF24_ACTIVATE_KEY && !plus ) {
+      activated = !activated;
+    }
+  }
+  else if( cmd == W_TX_PAYLOAD || cmd == W_TX_PAYLOAD_NOACK ) {
+    bool no_ack = cmd == W_TX_PAYLOAD_NOACK;
+    if( no_ack && (!featureActive() || !(reg[FEATURE] & (1 << EN_DYN_ACK))) ) {
+      // command does not exist before FEATURE enables it
+      ignored_commands++;
+    }
+    else if( tx_count < HOST_NRF24_FIFO_DEPTH ) {
+      memcpy(tx_fifo[tx_count].payload, buffer, length);
+      tx_fifo[tx_count].length = length;
+      tx_fifo[tx_count].no_ack = no_ack;
+      tx_count++;
+      startTransmit();
+    }
+  }
+  else if( cmd == R_RX_PAYLOAD ) {
+    if( rx_count ) {
+      memmove(&rx_fifo[0], &rx_fifo[1], sizeof(rx_fifo[0]) * (HOST_NRF24_FIFO_DEPTH - 1));
+      rx_count--;
+    }
+  }
+  cmd = HOST_NRF24_NO_COMMAND;
+}
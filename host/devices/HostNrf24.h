@@ -0,0 +1,152 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostNrf24_h
+#define HostNrf24_h
+
+#include <stdint.h>
+
+#include "HostNode.h"
+
+#define HOST_NRF24_REGISTERS      0x1E
+#define HOST_NRF24_ADDRESS_SIZE   5
+#define HOST_NRF24_PAYLOAD_SIZE   32
+#define HOST_NRF24_FIFO_DEPTH     3
+#define HOST_NRF24_MAX_RADIOS     64
+#define HOST_NRF24_MAX_PENDING    8     // frames in the air towards one radio
+#define HOST_NRF24_SETTLE_US      130   // PLL settling before every TX and RX
+#define HOST_NRF24_FRAME_BITS     57    // preamble, 5 byte address and packet control field
+#define HOST_NRF24_CRC_BITS       16
+
+class HostNrf24;
+
+struct HostRadioFrame {
+  uint8_t payload[HOST_NRF24_PAYLOAD_SIZE];
+  uint8_t length;
+  uint8_t pipe;
+  uint64_t arrival_us;                  /*!< Time at the receiver when the frame has been received */
+};
+
+/**
+ * Shared air of the simulated radios. Frames reach every radio listening to
+ * the channel and the address, unless they are lost on the link or collide
+ * with a frame already in the air on the same channel.
+ */
+class HostRadioMedium {
+  public:
+    HostRadioMedium(uint32_t seed = 1);
+
+    void attach(HostNrf24 *radio);
+    void setLoss(float loss);
+    void setLinkLoss(HostNrf24 *from, HostNrf24 *to, float loss);
+    void setLatency(uint32_t us);
+    bool transmit(HostNrf24 *from, const uint8_t *payload, uint8_t length, uint8_t pid, uint64_t start_us,
+                  uint32_t airtime_us, bool need_ack);
+
+    uint32_t frames;                    /*!< Frames sent                              */
+    uint32_t lost;                      /*!< Frames lost on a link                    */
+    uint32_t collisions;                /*!< Frames lost in a collision               */
+
+  private:
+    bool chance(float probability);
+    float linkLoss(uint8_t from, uint8_t to);
+    bool collides(uint8_t channel, uint64_t start_us, uint64_t end_us);
+
+    HostNrf24 *radios[HOST_NRF24_MAX_RADIOS];
+    uint8_t radio_count;
+    float loss;
+    uint32_t latency_us;                /*!< Extra delay of a frame to the RX FIFO    */
+    float link_loss[HOST_NRF24_MAX_RADIOS][HOST_NRF24_MAX_RADIOS];
+    bool link_loss_set[HOST_NRF24_MAX_RADIOS][HOST_NRF24_MAX_RADIOS];
+    uint32_t random_state;
+    struct {
+      uint8_t channel;
+      uint64_t start_us;
+      uint64_t end_us;
+    } air[16];                          /*!< Latest frames in the air, for collisions */
+    uint8_t air_index;
+};
+
+/**
+ * nRF24L01(+) on the SPI bus and the CE, CSN and IRQ pins of a node.
+ *
+ * Only the features the Riots libraries use are modelled: static payloads,
+ * auto-ack with retransmits, W_TX_PAYLOAD_NOACK and the 3 frame FIFOs. The
+ * plain nRF24L01 ignores FEATURE, and thus W_TX_PAYLOAD_NOACK, until the
+ * ACTIVATE command has been sent.
+ */
+class HostNrf24 : public HostSpiDevice, public HostPinDevice {
+  public:
+    HostNrf24(HostNode *node, HostRadioMedium *medium, uint8_t ce_pin, uint8_t csn_pin, uint8_t irq_pin, bool plus = true);
+
+    uint8_t transfer(uint8_t data);
+    void pinWritten(uint8_t pin, uint8_t value);
+    uint8_t pinRead(uint8_t pin);
+
+    /* Used by the medium */
+    bool listens(uint8_t channel, const uint8_t *address, uint8_t *pipe);
+    bool receive(HostNrf24 *from, const uint8_t *payload, uint8_t length, uint8_t pid, uint8_t pipe, uint64_t arrival_us);
+    bool acksPipe(uint8_t pipe);
+    uint8_t channel();
+    const uint8_t* txAddress();
+
+    HostNode *node;
+    uint8_t index;                      /*!< Index of the radio in the medium          */
+    uint8_t reg[HOST_NRF24_REGISTERS];
+    uint8_t rx_address[2][HOST_NRF24_ADDRESS_SIZE]; /*!< RX_ADDR_P0 and RX_ADDR_P1, LSB first   */
+    uint8_t tx_address[HOST_NRF24_ADDRESS_SIZE];    /*!< TX_ADDR, LSB first                     */
+    uint64_t airtime_us;                /*!< Time spent transmitting, retransmits included */
+    uint32_t tx_frames;                 /*!< Frames transmitted, retransmits included  */
+    uint32_t rx_frames;                 /*!< Frames received to the RX FIFO            */
+    uint32_t rx_overflows;              /*!< Frames dropped because the RX FIFO was full */
+    uint32_t ignored_commands;          /*!< Commands or writes the chip did not accept */
+
+  private:
+    void endCommand();
+    void update();
+    void startTransmit();
+    uint32_t frameTime(uint8_t length);
+    uint8_t status();
+    uint8_t fifoStatus();
+    bool featureActive();
+
+    HostRadioMedium *medium;
+    uint8_t ce_pin;
+    uint8_t csn_pin;
+    uint8_t irq_pin;
+    bool plus;                          /*!< nRF24L01+, FEATURE works without ACTIVATE */
+    bool activated;                     /*!< ACTIVATE 0x73 has been sent              */
+    bool ce;
+    bool csn;
+    uint8_t cmd;                        /*!< Command of the SPI transaction, 0xFF none */
+    uint8_t cmd_index;                  /*!< Bytes after the command                   */
+    uint8_t buffer[HOST_NRF24_PAYLOAD_SIZE];
+    HostRadioFrame rx_fifo[HOST_NRF24_FIFO_DEPTH];
+    uint8_t rx_count;
+    HostRadioFrame pending[HOST_NRF24_MAX_PENDING];
+    uint8_t pending_count;
+    struct {
+      uint8_t payload[HOST_NRF24_PAYLOAD_SIZE];
+      uint8_t length;
+      bool no_ack;
+    } tx_fifo[HOST_NRF24_FIFO_DEPTH];
+    uint8_t tx_count;
+    uint8_t tx_pid;                     /*!< Packet id of the payload in the air       */
+    uint8_t last_pid[HOST_NRF24_MAX_RADIOS]; /*!< Last packet id per sender, repeats are dropped */
+    uint64_t tx_done_us;                /*!< Time when the transmission in progress ends */
+    uint8_t tx_result;                  /*!< STATUS bit set at tx_done_us              */
+    bool tx_busy;
+};
+
+#endif // HostNrf24_h
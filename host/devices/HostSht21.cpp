@@ -0,0 +1,124 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "HostSht21.h"
+
+#define HOST_SHT21_MEASURE_RH       0xF5
+#define HOST_SHT21_READ_T           0xE0
+#define HOST_SHT21_WRITE_USER       0xE6
+#define HOST_SHT21_READ_USER        0xE7
+#define HOST_SHT21_RESET            0xFE
+
+/* CRC-8 of the datasheet, x^8 + x^5 + x^4 + 1 */
+static uint8_t crc8(const uint8_t *data, uint8_t length) {
+  uint8_t crc = 0;
+
+  for( uint8_t i = 0; i < length; i++ ) {
+    crc ^= data[i];
+    for( uint8_t bit = 0; bit < 8; bit++ ) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+HostSht21::HostSht21(HostNode *node, uint32_t max_scl) : HostI2cDevice(HOST_SHT21_ADDRESS, max_scl),
+  user_register(HOST_SHT21_USER_DEFAULT), measurements(0), busy_nacks(0), node(node), ready_at(0), command(0),
+  command_bytes(0), result_length(0), result_index(0) {
+  // 24.7 C and 44.9 %RH
+  setRaw(0x6840, 0x7C82);
+  if( node->i2c ) {
+    node->i2c->attach(this);
+  }
+}
+
+void HostSht21::setRaw(uint16_t temperature, uint16_t humidity) {
+  raw_temperature = temperature;
+  raw_humidity = humidity;
+}
+
+bool HostSht21::select(bool read) {
+  if( !read ) {
+    command_bytes = 0;
+    return true;
+  }
+  result_index = 0;
+  result_length = 0;
+  switch( command ) {
+    case HOST_SHT21_MEASURE_RH:
+      if( node->time_us < ready_at ) {
+        busy_nacks++;
+        return false;
+      }
+      result[0] = raw_humidity >> 8;
+      result[1] = raw_humidity;
+      result[2] = crc8(result, 2);
+      result_length = 3;
+      break;
+
+    case HOST_SHT21_READ_T:
+      result[0] = raw_temperature >> 8;
+      result[1] = raw_temperature;
+      result_length = 2;
+      break;
+
+    case HOST_SHT21_READ_USER:
+      result[0] = user_register;
+      result_length = 1;
+      break;
+
+    default:
+      return false;
+  }
+  return true;
+}
+
+bool HostSht21::write(uint8_t data) {
+  if( command_bytes++ > 0 ) {
+    if( command == HOST_SHT21_WRITE_USER && command_bytes == 2 ) {
+      user_register = data;
+      return true;
+    }
+    return false;
+  }
+  command = data;
+  switch( command ) {
+    case HOST_SHT21_MEASURE_RH:
+      measurements++;
+      ready_at = node->time_us + ( (user_register & HOST_SHT21_RESOLUTION_BITS) == HOST_SHT21_RESOLUTION_BITS ?
+                                   HOST_SHT21_FAST_MEAS_US : HOST_SHT21_MEAS_US );
+      return true;
+
+    case HOST_SHT21_RESET:
+      user_register = HOST_SHT21_USER_DEFAULT;
+      command = 0;
+      return true;
+
+    case HOST_SHT21_READ_T:
+    case HOST_SHT21_WRITE_USER:
+    case HOST_SHT21_READ_USER:
+      return true;
+  }
+  command = 0;
+  return false;
+}
+
+uint8_t HostSht21::read(bool ack) {
+  (void)ack;
+  return result_index < result_length ? result[result_index++] : 0xFF;
+}
+
+void HostSht21::stop() {
+}
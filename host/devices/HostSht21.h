@@ -0,0 +1,61 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef HostSht21_h
+#define HostSht21_h
+
+#include "HostI2c.h"
+
+#define HOST_SHT21_ADDRESS          0x40
+#define HOST_SHT21_USER_DEFAULT     0x3A    // 12 bit RH and 14 bit temperature
+#define HOST_SHT21_RESOLUTION_BITS  0x81    // D7 and D0 of the user register
+#define HOST_SHT21_MEAS_US          23000   // RH and temperature conversion at the full resolution
+#define HOST_SHT21_FAST_MEAS_US     10000   // the same at 11 bits
+
+/**
+ * SHT21 humidity and temperature sensor, with the "read temperature of the
+ * previous RH measurement" command (0xE0) of the Si70xx parts the Riots
+ * library uses. A measurement without hold master (0xF5) does not acknowledge
+ * reads until its conversion time has passed. The raw readings are given
+ * with setRaw(), the status bits included.
+ */
+class HostSht21 : public HostI2cDevice {
+  public:
+    HostSht21(HostNode *node, uint32_t max_scl = 400000UL);
+
+    bool select(bool read);
+    bool write(uint8_t data);
+    uint8_t read(bool ack);
+    void stop();
+
+    void setRaw(uint16_t temperature, uint16_t humidity);
+
+    uint8_t user_register;
+    uint16_t raw_temperature;
+    uint16_t raw_humidity;
+    uint32_t measurements;                  /*!< Count of RH measurements started       */
+    uint32_t busy_nacks;                    /*!< Reads not acknowledged during a conversion */
+
+  private:
+    HostNode *node;
+    uint64_t ready_at;                      /*!< Time the conversion ends               */
+    uint8_t command;                        /*!< Last command, 0 if none                */
+    uint8_t command_bytes;                  /*!< Bytes received in this write           */
+    uint8_t result[3];                      /*!< Bytes of the read                      */
+    uint8_t result_length;
+    uint8_t result_index;
+};
+
+#endif // HostSht21_h
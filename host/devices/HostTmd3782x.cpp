@@ -0,0 +1,105 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include "HostTmd3782x.h"
+
+#define HOST_TMD3782X_COMMAND     0x80
+#define HOST_TMD3782X_TYPE_MASK   0x60
+#define HOST_TMD3782X_TYPE_AUTO   0x20
+#define HOST_TMD3782X_PON_AEN     0x03
+#define HOST_TMD3782X_AVALID      0x01
+
+HostTmd3782x::HostTmd3782x(HostNode *node, uint32_t max_scl) : HostI2cDevice(HOST_TMD3782X_ADDRESS, max_scl),
+  node(node), enabled_at(0), pointer(0), increment(false), command_set(false) {
+  memset(registers, 0, sizeof(registers));
+  registers[HOST_TMD3782X_ATIME] = 0xFF;
+  registers[HOST_TMD3782X_ID] = 0x60;
+  // daylight, IR of 100 counts in every channel
+  setRgbc(1000, 400, 500, 300);
+  if( node->i2c ) {
+    node->i2c->attach(this);
+  }
+}
+
+void HostTmd3782x::setRgbc(uint16_t clear, uint16_t red, uint16_t green, uint16_t blue) {
+  uint16_t channels[4] = { clear, red, green, blue };
+
+  for( uint8_t i = 0; i < 4; i++ ) {
+    registers[HOST_TMD3782X_CDATA + 2*i] = (uint8_t)channels[i];
+    registers[HOST_TMD3782X_CDATA + 2*i + 1] = (uint8_t)(channels[i] >> 8);
+  }
+}
+
+/* AVALID after one integration time with the ADC enabled */
+void HostTmd3782x::updateStatus() {
+  uint64_t integration = (uint64_t)(256 - registers[HOST_TMD3782X_ATIME]) * HOST_TMD3782X_CYCLE_US;
+
+  if( (registers[HOST_TMD3782X_ENABLE] & HOST_TMD3782X_PON_AEN) == HOST_TMD3782X_PON_AEN &&
+      node->time_us >= enabled_at + integration ) {
+    registers[HOST_TMD3782X_STATUS] |= HOST_TMD3782X_AVALID;
+  }
+  else {
+    registers[HOST_TMD3782X_STATUS] &= ~HOST_TMD3782X_AVALID;
+  }
+}
+
+bool HostTmd3782x::select(bool read) {
+  if( !read ) {
+    command_set = false;
+  }
+  return true;
+}
+
+bool HostTmd3782x::write(uint8_t data) {
+  uint8_t enable = registers[HOST_TMD3782X_ENABLE];
+
+  if( !command_set ) {
+    if( !(data & HOST_TMD3782X_COMMAND) ) {
+      return false;
+    }
+    pointer = data & (HOST_TMD3782X_REGISTERS - 1);
+    increment = (data & HOST_TMD3782X_TYPE_MASK) == HOST_TMD3782X_TYPE_AUTO;
+    command_set = true;
+    return true;
+  }
+  if( pointer != HOST_TMD3782X_ID && pointer != HOST_TMD3782X_STATUS && pointer < HOST_TMD3782X_CDATA ) {
+    registers[pointer] = data;
+  }
+  if( pointer == HOST_TMD3782X_ENABLE && (enable & HOST_TMD3782X_PON_AEN) != (data & HOST_TMD3782X_PON_AEN) ) {
+    // integration starts over
+    enabled_at = node->time_us;
+  }
+  if( increment ) {
+    pointer = (pointer + 1) & (HOST_TMD3782X_REGISTERS - 1);
+  }
+  return true;
+}
+
+uint8_t HostTmd3782x::read(bool ack) {
+  uint8_t value;
+
+  (void)ack;
+  updateStatus();
+  value = registers[pointer];
+  if( increment ) {
+    pointer = (pointer + 1) & (HOST_TMD3782X_REGISTERS - 1);
+  }
+  return value;
+}
+
+void HostTmd3782x::stop() {
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef HostTmd3782x_h
+#define HostTmd3782x_h
+
+#include "HostI2c.h"
+
+#define HOST_TMD3782X_ADDRESS     0x39
+#define HOST_TMD3782X_REGISTERS   0x20
+#define HOST_TMD3782X_ENABLE      0x00
+#define HOST_TMD3782X_ATIME       0x01
+#define HOST_TMD3782X_CONFIG      0x0D
+#define HOST_TMD3782X_CONTROL     0x0F
+#define HOST_TMD3782X_ID          0x12
+#define HOST_TMD3782X_STATUS      0x13
+#define HOST_TMD3782X_CDATA       0x14    // CDATA, RDATA, GDATA and BDATA, little endian
+#define HOST_TMD3782X_CYCLE_US    2400    // integration cycle, ATIME counts them down from 256
+
+/**
+ * TMD3782x color and light sensor. The command byte selects the register,
+ * its type bits the repeated byte or the auto-increment protocol. The status
+ * has AVALID once an integration time has passed with PON and AEN set. The
+ * channel counts are given with setRgbc().
+ */
+class HostTmd3782x : public HostI2cDevice {
+  public:
+    HostTmd3782x(HostNode *node, uint32_t max_scl = 400000UL);
+
+    bool select(bool read);
+    bool write(uint8_t data);
+    uint8_t read(bool ack);
+    void stop();
+
+    void setRgbc(uint16_t clear, uint16_t red, uint16_t green, uint16_t blue);
+
+    uint8_t registers[HOST_TMD3782X_REGISTERS];
+
+  private:
+    void updateStatus();
+
+    HostNode *node;
+    uint64_t enabled_at;                    /*!< Time PON and AEN were set              */
+    uint8_t pointer;                        /*!< Register of the last command           */
+    bool increment;                         /*!< Auto-increment protocol                */
+    bool command_set;                       /*!< First byte of a write is the command   */
+};
+
+#endif // HostTmd3782x_h
@@ -0,0 +1,513 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "HostCloudServer.h"
+#include "Riots_Helper.h"
+#include "Riots_Mamadef.h"
+#include "aes.h"
+
+#define HOST_CLOUD_FRAME_MAX      256   // length byte and up to 255 bytes
+
+static uint8_t blockChecksum(const uint8_t *block, uint8_t length) {
+  uint8_t checksum = 0;
+
+  for( uint8_t i = 0; i < length; i++ ) {
+    checksum ^= block[i];
+  }
+  return checksum;
+}
+
+static uint32_t readTime(const uint8_t *block) {
+  return ((uint32_t)block[0] << 24) | ((uint32_t)block[1] << 16) | ((uint32_t)block[2] << 8) | block[3];
+}
+
+/**
+ * Reads a counter of the stats record, in little endian.
+ */
+static uint32_t readCounter(const uint8_t **field, uint8_t size) {
+  uint32_t value = 0;
+
+  for( uint8_t i = 0; i < size; i++ ) {
+    value |= (uint32_t)(*field)[i] << (8*i);
+  }
+  *field += size;
+  return value;
+}
+
+/**
+ * AES of the server is counted on the node of the server while the object lives.
+ */
+class HostCloudScope {
+  public:
+    HostCloudScope(HostNode *node) : previous(hostNode()) { hostSelectNode(node); }
+    ~HostCloudScope() { hostSelectNode(previous); }
+
+  private:
+    HostNode *previous;
+};
+
+/**
+ * @param mama_key                Unique AES key of the Mama, as in its EEPROM_AES_UNIQUE.
+ * @param protocol                Envelope version accepted from the Mama, 0 keeps the session on version 1.
+ */
+HostCloudServer::HostCloudServer(const uint8_t *mama_key, uint8_t protocol) : protocol(protocol), connected(false),
+  verified(false), envelopes(false), verified_us(0), sessions(0), keep_alives(0), stats_posts(0), relay_credit(0),
+  relay_failures(0), bad_frames(0), node(0), envelope(), listen_fd(-1), client_fd(-1), rx_length(0), now_us(0),
+  random_state(0x2545F491) {
+  memset(mac, 0, sizeof(mac));
+  memset(mama_address, 0, sizeof(mama_address));
+  memcpy(unique_key, mama_key, sizeof(unique_key));
+  memset(session_key, 0, sizeof(session_key));
+  memset(&stats, 0, sizeof(stats));
+}
+
+HostCloudServer::~HostCloudServer() {
+  disconnect();
+  if( listen_fd >= 0 ) {
+    close(listen_fd);
+  }
+}
+
+/**
+ * Starts listening to a free port of the loopback interface.
+ *
+ * @return bool                   False if the socket could not be opened
+ */
+bool HostCloudServer::listen() {
+  struct sockaddr_in address;
+  int one = 1;
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if( listen_fd < 0 ) {
+    return false;
+  }
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = 0;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if( bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || ::listen(listen_fd, 1) < 0 ) {
+    close(listen_fd);
+    listen_fd = -1;
+    return false;
+  }
+  fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+/**
+ * Port to give to hostEthernetSetPort().
+ */
+uint16_t HostCloudServer::port() {
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+
+  if( listen_fd < 0 || getsockname(listen_fd, (struct sockaddr *)&address, &length) < 0 ) {
+    return 0;
+  }
+  return ntohs(address.sin_port);
+}
+
+/**
+ * Accepts a new connection and handles the frames received so far.
+ *
+ * @param now_us                  Time of the simulation, stored with the messages.
+ */
+void HostCloudServer::poll(uint64_t now_us) {
+  HostCloudScope scope(&node);
+
+  this->now_us = now_us;
+  accept();
+  receive();
+}
+
+/**
+ * Closes the connection of the Mama, it is noticed on the next connected().
+ */
+void HostCloudServer::disconnect() {
+  if( client_fd >= 0 ) {
+    close(client_fd);
+    client_fd = -1;
+  }
+  connected = false;
+  verified = false;
+  envelopes = false;
+  rx_length = 0;
+}
+
+void HostCloudServer::accept() {
+  int one = 1;
+  int fd = ::accept(listen_fd, NULL, NULL);
+
+  if( fd < 0 ) {
+    return;
+  }
+  // a reconnecting Mama replaces its old connection
+  disconnect();
+  client_fd = fd;
+  setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+  connected = true;
+}
+
+/**
+ * Reads what the Mama has written and handles the complete frames.
+ */
+void HostCloudServer::receive() {
+  uint16_t start = 0;
+
+  while( client_fd >= 0 ) {
+    ssize_t n = recv(client_fd, rx + rx_length, sizeof(rx) - rx_length, MSG_DONTWAIT);
+    if( n == 0 || ( n < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) ) {
+      disconnect();
+      return;
+    }
+    if( n < 0 ) {
+      break;
+    }
+    rx_length += n;
+
+    while( rx_length - start >= 1 && rx_length - start >= rx[start] + 1 ) {
+      uint16_t length = rx[start] + 1;
+      if( length > 0xFF ) {
+        // longer than any frame of the Mama
+        bad_frames++;
+      }
+      else if( length > 1 ) {
+        handleFrame(rx + start, length);
+      }
+      start += length;
+    }
+    memmove(rx, rx + start, rx_length - start);
+    rx_length -= start;
+    start = 0;
+  }
+}
+
+/**
+ * @param frame                   Whole frame, including the length byte.
+ * @param length                  Length of the frame.
+ */
+void HostCloudServer::handleFrame(uint8_t *frame, uint8_t length) {
+  uint8_t offset = 0, type, value_length, *value;
+
+  switch( frame[1] ) {
+    case CLIENT_INTRODUCTION:
+      if( length < 14 ) {
+        break;
+      }
+      introduction(frame);
+      return;
+
+    case CLIENT_PROTOCOL_OFFER:
+      if( length < 3 ) {
+        break;
+      }
+      if( protocol != 0 && frame[2] == protocol ) {
+        uint8_t accept[3] = { 0x02, SERVER_PROTOCOL_ACCEPT, protocol };
+        envelope.startSession(session_key);
+        envelopes = true;
+        sendFrame(accept, sizeof(accept));
+      }
+      return;
+
+    case CLIENT_VERIFICATION:
+      if( length < 2 + HOST_CLOUD_BLOCK_SIZE || !openBlock(frame + 2) ) {
+        break;
+      }
+      verified = true;
+      verified_us = now_us;
+      initMama();
+      return;
+
+    case CLIENT_DATA_POST:
+      if( length < 2 + HOST_CLOUD_BLOCK_SIZE || !openBlock(frame + 2) ) {
+        break;
+      }
+      addMessage(frame + 2, 0);
+      return;
+
+    case CLIENT_SAVED_DATA_POST:
+      if( length < 2 + 2*HOST_CLOUD_BLOCK_SIZE || !openBlock(frame + 2) || !openBlock(frame + 2 + HOST_CLOUD_BLOCK_SIZE) ) {
+        break;
+      }
+      addMessage(frame + 2 + HOST_CLOUD_BLOCK_SIZE, readTime(frame + 2));
+      return;
+
+    case KEEP_ALIVE:
+      keep_alives++;
+      return;
+
+    case CLIENT_RELAY_CREDIT:
+      if( length < 2 + HOST_CLOUD_BLOCK_SIZE || !openBlock(frame + 2) ) {
+        break;
+      }
+      relayCredit(frame + 2);
+      return;
+
+    case CLIENT_ENVELOPE:
+      if( !envelopes || !envelope.open(frame, length) ) {
+        break;
+      }
+      while( Riots_Envelope::nextRecord(frame, &offset, &type, &value_length, &value) ) {
+        handleRecord(type, value, value_length);
+      }
+      return;
+  }
+  bad_frames++;
+}
+
+void HostCloudServer::handleRecord(uint8_t type, uint8_t *value, uint8_t length) {
+  switch( type ) {
+    case RIOTS_RECORD_KEEP_ALIVE:
+      keep_alives++;
+      return;
+
+    case RIOTS_RECORD_DATA_POST:
+      if( length != HOST_CLOUD_BLOCK_SIZE || blockChecksum(value, HOST_CLOUD_BLOCK_SIZE) != 0 ) {
+        break;
+      }
+      addMessage(value, 0);
+      return;
+
+    case RIOTS_RECORD_SAVED_DATA_POST:
+      if( length != 4 + HOST_CLOUD_BLOCK_SIZE || blockChecksum(value + 4, HOST_CLOUD_BLOCK_SIZE) != 0 ) {
+        break;
+      }
+      addMessage(value + 4, readTime(value));
+      return;
+
+    case RIOTS_RECORD_STATS:
+      if( length != MAMA_STATS_RECORD_LEN || blockChecksum(value, length) != 0 ) {
+        break;
+      }
+      readStats(value);
+      stats_posts++;
+      return;
+
+    case RIOTS_RECORD_RELAY_CREDIT:
+      if( length != RELAY_CREDIT_LEN ) {
+        break;
+      }
+      relayCredit(value);
+      return;
+  }
+  bad_frames++;
+}
+
+/**
+ * Decodes the counters of a stats record as the cloud does, field by field in
+ * the order of Riots_Stats.
+ */
+void HostCloudServer::readStats(const uint8_t *record) {
+  const uint8_t *field = record;
+
+  stats.cloud_bytes_up = readCounter(&field, 4);
+  stats.cloud_bytes_down = readCounter(&field, 4);
+  stats.radio_rx_frames = readCounter(&field, 2);
+  stats.radio_tx_frames = readCounter(&field, 2);
+  stats.radio_tx_failures = readCounter(&field, 2);
+  stats.radio_airtime_timeouts = readCounter(&field, 2);
+  stats.radio_rx_backlog = readCounter(&field, 2);
+  for( uint8_t i = 0; i < RIOTS_STATS_KEY_COUNT; i++ ) {
+    stats.decrypt_failures[i] = readCounter(&field, 2);
+  }
+  stats.counter_rejects = readCounter(&field, 2);
+  stats.ring_drops = readCounter(&field, 2);
+  stats.cloud_reconnects = readCounter(&field, 2);
+  stats.cloud_cached_records = readCounter(&field, 2);
+  stats.cloud_replayed_records = readCounter(&field, 2);
+}
+
+/**
+ * Answers CLIENT_INTRODUCTION with the time, the challenge and a new
+ * session key, crypted with the unique key of the Mama.
+ */
+void HostCloudServer::introduction(uint8_t *frame) {
+  uint8_t reply[2 + 2*HOST_CLOUD_BLOCK_SIZE];
+  uint32_t time = HOST_CLOUD_TIME + (uint32_t)(now_us / 1000000);
+
+  memcpy(mac, frame + 2, sizeof(mac));
+  memcpy(mama_address, frame + 6, sizeof(mama_address));
+  verified = false;
+  envelopes = false;
+  sessions++;
+
+  // session number keeps the key apart from the previous one
+  for( uint8_t i = 0; i < sizeof(session_key); i += 4 ) {
+    uint32_t value = nextRandom();
+    memcpy(session_key + i, &value, 4);
+  }
+  memcpy(session_key, &sessions, sizeof(sessions));
+
+  reply[0] = sizeof(reply) - 1;
+  reply[1] = SERVER_VERIFICATION;
+  uint8_t *block = reply + 2;
+  block[0] = time >> 24;
+  block[1] = time >> 16;
+  block[2] = time >> 8;
+  block[3] = time;
+  memcpy(block + 4, frame + 10, 4);
+  for( uint8_t i = 8; i < HOST_CLOUD_BLOCK_SIZE - 1; i++ ) {
+    block[i] = nextRandom();
+  }
+  block[HOST_CLOUD_BLOCK_SIZE - 1] = blockChecksum(block, HOST_CLOUD_BLOCK_SIZE - 1);
+  AES128_ECB_encrypt(block, unique_key, block);
+  AES128_ECB_encrypt(session_key, unique_key, reply + 2 + HOST_CLOUD_BLOCK_SIZE);
+  sendFrame(reply, sizeof(reply));
+}
+
+/**
+ * Sends TYPE_INIT_MAMA to the Mama itself, crypted with its unique key. The
+ * TYPE_IM_ALIVE answer tells the INO that the Mama may send its cached messages.
+ */
+void HostCloudServer::initMama() {
+  uint8_t message[HOST_CLOUD_BLOCK_SIZE];
+
+  memset(message, 0, sizeof(message));
+  message[M_TYPE] = TYPE_INIT_MAMA;
+  message[M_LENGTH] = 0x04;
+  message[HOST_CLOUD_BLOCK_SIZE - 1] = blockChecksum(message, HOST_CLOUD_BLOCK_SIZE - 1);
+  AES128_ECB_encrypt(message, unique_key, message);
+  sendDataPost(mama_address, message, 1);
+}
+
+/**
+ * Decrypts a block crypted with the session key in place.
+ *
+ * @return bool                   True if the XOR checksum of the block is valid
+ */
+bool HostCloudServer::openBlock(uint8_t *block) {
+  AES128_ECB_decrypt(block, session_key, block);
+  return blockChecksum(block, HOST_CLOUD_BLOCK_SIZE) == 0;
+}
+
+void HostCloudServer::addMessage(const uint8_t *block, uint32_t saved_time) {
+  HostCloudMessage message;
+
+  memcpy(message.block, block, HOST_CLOUD_BLOCK_SIZE);
+  message.received_us = now_us;
+  message.saved_time = saved_time;
+  messages.push_back(message);
+}
+
+void HostCloudServer::relayCredit(const uint8_t *credit) {
+  relay_credit += credit[0];
+  if( credit[1] != RIOTS_OK ) {
+    relay_failures++;
+  }
+}
+
+/**
+ * Block with the radio address of the receiver, SERVER_DATA_RECEIVER and the
+ * first block of SERVER_RELAY_POST.
+ */
+void HostCloudServer::receiverBlock(const uint8_t *receiver, uint8_t *block) {
+  memcpy(block, receiver, 4);
+  for( uint8_t i = 4; i < HOST_CLOUD_BLOCK_SIZE - 1; i++ ) {
+    block[i] = nextRandom();
+  }
+  block[HOST_CLOUD_BLOCK_SIZE - 1] = blockChecksum(block, HOST_CLOUD_BLOCK_SIZE - 1);
+  AES128_ECB_encrypt(block, session_key, block);
+}
+
+/**
+ * Sends SERVER_DATA_RECEIVER and SERVER_DATA_POST, the Mama forwards the
+ * datablobs to the receiver as such.
+ *
+ * @param receiver                Radio address of the receiver, 4 bytes.
+ * @param blobs                   Radio frames crypted for the receiver, 16 bytes each.
+ * @param count                   Count of the datablobs, 1 - 15.
+ * @return bool                   False if there is no session or the count is not valid
+ */
+bool HostCloudServer::sendDataPost(const uint8_t *receiver, const uint8_t *blobs, uint8_t count) {
+  HostCloudScope scope(&node);
+  uint8_t frame[HOST_CLOUD_FRAME_MAX];
+
+  if( !verified || count == 0 || count > 15 ) {
+    return false;
+  }
+  frame[0] = 1 + HOST_CLOUD_BLOCK_SIZE;
+  frame[1] = SERVER_DATA_RECEIVER;
+  receiverBlock(receiver, frame + 2);
+  sendFrame(frame, 2 + HOST_CLOUD_BLOCK_SIZE);
+
+  frame[0] = 1 + count*HOST_CLOUD_BLOCK_SIZE;
+  frame[1] = SERVER_DATA_POST;
+  for( uint8_t i = 0; i < count; i++ ) {
+    AES128_ECB_encrypt((uint8_t *)blobs + i*HOST_CLOUD_BLOCK_SIZE, session_key, frame + 2 + i*HOST_CLOUD_BLOCK_SIZE);
+  }
+  sendFrame(frame, 2 + count*HOST_CLOUD_BLOCK_SIZE);
+  return true;
+}
+
+/**
+ * Sends SERVER_RELAY_POST, the Mama stages the datablobs and forwards them
+ * one per loop. The relay space comes back in relay_credit.
+ *
+ * @param receiver                Radio address of the receiver, 4 bytes.
+ * @param blobs                   Radio frames crypted for the receiver, 16 bytes each.
+ * @param count                   Count of the datablobs, 1 - 14.
+ * @return bool                   False if there is no session or the count is not valid
+ */
+bool HostCloudServer::sendRelayPost(const uint8_t *receiver, const uint8_t *blobs, uint8_t count) {
+  HostCloudScope scope(&node);
+  uint8_t frame[HOST_CLOUD_FRAME_MAX];
+
+  if( !verified || count == 0 || count > 14 ) {
+    return false;
+  }
+  frame[0] = 1 + (count + 1)*HOST_CLOUD_BLOCK_SIZE;
+  frame[1] = SERVER_RELAY_POST;
+  receiverBlock(receiver, frame + 2);
+  for( uint8_t i = 0; i < count; i++ ) {
+    AES128_ECB_encrypt((uint8_t *)blobs + i*HOST_CLOUD_BLOCK_SIZE, session_key,
+                       frame + 2 + (i + 1)*HOST_CLOUD_BLOCK_SIZE);
+  }
+  sendFrame(frame, 2 + (count + 1)*HOST_CLOUD_BLOCK_SIZE);
+  return true;
+}
+
+void HostCloudServer::sendFrame(const uint8_t *frame, uint16_t length) {
+  uint16_t written = 0;
+
+  while( client_fd >= 0 && written < length ) {
+    ssize_t n = send(client_fd, frame + written, length - written, MSG_NOSIGNAL);
+    if( n < 0 ) {
+      if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+        continue;
+      }
+      disconnect();
+      return;
+    }
+    written += n;
+  }
+}
+
+/* xorshift32, the runs are repeatable */
+uint32_t HostCloudServer::nextRandom() {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
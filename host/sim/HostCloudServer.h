@@ -0,0 +1,112 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostCloudServer_h
+#define HostCloudServer_h
+
+/*
+ * Stand-in of the Riots cloud on a local TCP port, for one Mama at a time.
+ * It speaks the protocol of Riots_Mamadef.h: answers CLIENT_INTRODUCTION with
+ * SERVER_VERIFICATION and a new session key, accepts envelopes when offered
+ * and collects the data posts, saved data posts, keep alives and relay
+ * credits of both protocol versions. Datablobs and relay posts can be sent
+ * down to the Mama.
+ *
+ * As the cloud does, a verified session is followed by TYPE_INIT_MAMA to the
+ * Mama itself. Its TYPE_IM_ALIVE answer, a data post, lets the Mama INO send
+ * the messages cached while the cloud was away.
+ *
+ * The server runs in the thread of the simulation: poll() accepts, reads and
+ * answers whatever the Mama has written so far, without blocking. The time
+ * given to poll() is stored with the received messages.
+ *
+ * AES of the server is counted on a node of its own, not on the Mama.
+ */
+#include <stdint.h>
+
+#include <vector>
+
+#include "HostNode.h"
+#include "Riots_Envelope.h"
+#include "Riots_Radio.h"
+
+#define HOST_CLOUD_BLOCK_SIZE     16
+#define HOST_CLOUD_RX_SIZE        1024
+#define HOST_CLOUD_TIME           1500000000UL  // unix time given in SERVER_VERIFICATION
+
+/**
+ * Datablob received from the Mama.
+ */
+struct HostCloudMessage {
+  uint8_t block[HOST_CLOUD_BLOCK_SIZE];   /*!< Plain radio message forwarded by the Mama      */
+  uint64_t received_us;                   /*!< Time given to poll() when it was received      */
+  uint32_t saved_time;                    /*!< Time of a saved data post, 0 for a live one    */
+};
+
+class HostCloudServer {
+  public:
+    HostCloudServer(const uint8_t *mama_key, uint8_t protocol = RIOTS_ENVELOPE_VERSION);
+    ~HostCloudServer();
+
+    bool listen();
+    uint16_t port();
+    void poll(uint64_t now_us);
+    void disconnect();
+    bool sendDataPost(const uint8_t *receiver, const uint8_t *blobs, uint8_t count);
+    bool sendRelayPost(const uint8_t *receiver, const uint8_t *blobs, uint8_t count);
+
+    uint8_t protocol;                       /*!< Envelope version accepted, 0 only version 1     */
+    bool connected;                         /*!< A Mama is connected                            */
+    bool verified;                          /*!< CLIENT_VERIFICATION of the session was valid   */
+    bool envelopes;                         /*!< Session uses envelopes                         */
+    uint8_t mac[4];                         /*!< Base MAC of the last CLIENT_INTRODUCTION       */
+    uint8_t mama_address[4];                /*!< Radio address of the last CLIENT_INTRODUCTION  */
+    uint64_t verified_us;                   /*!< Time the last session was verified             */
+    std::vector<HostCloudMessage> messages; /*!< Data posts and saved data posts, in order      */
+    uint32_t sessions;                      /*!< CLIENT_INTRODUCTIONs answered                  */
+    uint32_t keep_alives;
+    uint32_t stats_posts;
+    Riots_Stats stats;                      /*!< Counters of the last stats record              */
+    uint32_t relay_credit;                  /*!< Relay slots given back by the Mama             */
+    uint32_t relay_failures;                /*!< Relay credits with a failed status             */
+    uint32_t bad_frames;                    /*!< Unknown frames or ones failing their checks    */
+    HostNode node;                          /*!< AES of the server is counted here              */
+
+  private:
+    void accept();
+    void receive();
+    void handleFrame(uint8_t *frame, uint8_t length);
+    void handleRecord(uint8_t type, uint8_t *value, uint8_t length);
+    void readStats(const uint8_t *record);
+    void introduction(uint8_t *frame);
+    void initMama();
+    bool openBlock(uint8_t *block);
+    void addMessage(const uint8_t *block, uint32_t saved_time);
+    void relayCredit(const uint8_t *credit);
+    void receiverBlock(const uint8_t *receiver, uint8_t *block);
+    void sendFrame(const uint8_t *frame, uint16_t length);
+    uint32_t nextRandom();
+
+    uint8_t unique_key[16];                 /*!< Unique key of the Mama                         */
+    uint8_t session_key[16];
+    Riots_Envelope envelope;
+    int listen_fd;
+    int client_fd;
+    uint8_t rx[HOST_CLOUD_RX_SIZE];
+    uint16_t rx_length;
+    uint64_t now_us;
+    uint32_t random_state;
+};
+
+#endif // HostCloudServer_h
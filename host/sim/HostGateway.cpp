@@ -0,0 +1,332 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "HostGateway.h"
+#include "Riots_Helper.h"
+#include "Riots_Memory.h"
+#include "aes.h"
+
+static const uint8_t network_key[AES_KEY_SIZE] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                                   0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static const uint8_t mama_key[AES_KEY_SIZE]    = { 0x60, 0x3D, 0xEB, 0x10, 0x15, 0xCA, 0x71, 0xBE,
+                                                   0x2B, 0x73, 0xAE, 0xF0, 0x85, 0x7D, 0x77, 0x81 };
+static const uint8_t base_mac[MAC_ADDRESS_SIZE] = { 0x52, 0x49, 0x4F, 0x54 };
+
+/* Radio address of the node, the Mama is node 0 and the replay node 1 */
+static void writeAddress(uint8_t *address, uint16_t id) {
+  address[0] = HOST_GATEWAY_ADDRESS_MARK;
+  address[1] = 0x00;
+  address[2] = id >> 8;
+  address[3] = id;
+}
+
+static bool compareTime(const HostGatewayMessage &a, const HostGatewayMessage &b) {
+  return a.time_us < b.time_us;
+}
+
+/**
+ * Sets up the Mama as the INO does and connects it to the server.
+ *
+ * @param baby_count              Count of the replayed Babies.
+ * @param protocol                Envelope version the server accepts, 0 keeps the Mama on version 1.
+ * @param seed                    Seed of the radio medium and of the schedule.
+ */
+HostGateway::HostGateway(uint16_t baby_count, uint8_t protocol, uint32_t seed) : medium(seed), mama_node(0),
+  bus(&mama_node), primary(&mama_node, RIOTS_PRIMARY_EEPROM >> 1), secondary(&mama_node, RIOTS_SECONDARY_EEPROM >> 1),
+  mama_nrf(&mama_node, &medium, RIOTS_CE_PIN, RIOTS_CSN_PIN, RIOTS_IRQ_PIN), radio(NULL), cloud(NULL),
+  replay_node(1), replay_nrf(&replay_node, &medium, RIOTS_CE_PIN, RIOTS_CSN_PIN, RIOTS_IRQ_PIN), replay(NULL),
+  server(mama_key, protocol), baby_count(baby_count), loop_us(HOST_GATEWAY_LOOP_US), cloud_messages(0),
+  duplicates(0), downlink_frames(0), outage_start_us(0), outage_end_us(0), counters(baby_count, 0),
+  first_unsent(0), collected(0), random_state(seed ? seed : 1) {
+  uint8_t mama_address[RF_ADDRESS_SIZE];
+
+  server.listen();
+  hostEthernetSetPort(server.port());
+  hostEthernetSetLink(true);
+
+  configure(&mama_node, 0);
+  memcpy(primary.memory + I2C_EEPROM_MAC_ADDRESS, base_mac, MAC_ADDRESS_SIZE);
+  configure(&replay_node, 1);
+
+  // value initialized, the libraries expect zeroed globals
+  hostSelectNode(&mama_node);
+  radio = new Riots_MamaRadio();
+  cloud = new Riots_MamaCloud();
+  radio->setup(0);
+  cloud->setAddresses(radio->getPlainDataAddress(), radio->getTXCryptBuffAddress(),
+                      radio->getRXCryptBuffAddress(), radio->getPrivateKeyAddress());
+  cloud->setStatsAddress(radio->getStatsAddress());
+  cloud->setup();
+
+  hostSelectNode(&replay_node);
+  replay = new Riots_Radio();
+  replay->setup(0xFF, 0xFF, 0xFF, 0xFF);
+  writeAddress(mama_address, 0);
+  replay->setTXAddress(mama_address);
+}
+
+HostGateway::~HostGateway() {
+  delete replay;
+  delete cloud;
+  delete radio;
+  hostEthernetSetLink(true);
+  hostEthernetSetPort(0);
+}
+
+void HostGateway::configure(HostNode *node, uint16_t id) {
+  writeAddress(node->eeprom + EEPROM_RX_ADDR, id);
+  memcpy(node->eeprom + EEPROM_AES_CHANGING, network_key, AES_KEY_SIZE);
+  memcpy(node->eeprom + EEPROM_AES_UNIQUE, mama_key, AES_KEY_SIZE);
+  node->eeprom[EEPROM_FIRST_BOOT] = 0;
+  node->eeprom[EEPROM_CHILD_ID] = id >> 8;
+  node->eeprom[EEPROM_CHILD_ID+1] = id;
+  node->eeprom[EEPROM_COUNTER] = 0;
+  node->eeprom[EEPROM_COUNTER+1] = 0;
+}
+
+/**
+ * Sets the time of one AES block on the Mama and the replay node, 0 leaves
+ * AES out of the time. AES of the server is only counted.
+ */
+void HostGateway::setAesBlockTime(uint32_t us) {
+  mama_node.aes_block_us = us;
+  replay_node.aes_block_us = us;
+}
+
+/**
+ * Schedules a message from the Baby, in the order of time.
+ */
+void HostGateway::scheduleMessage(uint16_t baby, uint64_t time_us) {
+  HostGatewayMessage message;
+
+  message.baby = baby;
+  message.time_us = time_us;
+  message.sent_us = 0;
+  message.cloud_us = 0;
+  message.acked = false;
+  message.saved = false;
+  messages.push_back(message);
+}
+
+/**
+ * Schedules a message from every Baby once a period, each Baby at a random
+ * phase of its own.
+ */
+void HostGateway::replayBabies(uint32_t period_us, uint64_t start_us, uint64_t end_us) {
+  size_t first = messages.size();
+
+  for( uint16_t baby = 0; baby < baby_count; baby++ ) {
+    for( uint64_t time = start_us + nextRandom() % period_us; time < end_us; time += period_us ) {
+      scheduleMessage(baby + 1, time);
+    }
+  }
+  std::stable_sort(messages.begin() + first, messages.end(), compareTime);
+}
+
+/**
+ * Takes the Ethernet link down for the time, [start_us, end_us).
+ */
+void HostGateway::setOutage(uint64_t start_us, uint64_t end_us) {
+  outage_start_us = start_us;
+  outage_end_us = end_us;
+}
+
+/**
+ * Sends datablobs for the replay node from the server, as a data post or as
+ * a relay post.
+ *
+ * @return bool                   False if the server has no verified session
+ */
+bool HostGateway::sendDownlink(uint8_t count, bool relay) {
+  uint8_t blobs[15 * RF_PAYLOAD_SIZE];
+  uint8_t receiver[RF_ADDRESS_SIZE];
+  uint8_t key[AES_KEY_SIZE];
+  HostNode *previous = hostNode();
+
+  if( count == 0 || count > 15 ) {
+    return false;
+  }
+  memcpy(key, network_key, AES_KEY_SIZE);
+  writeAddress(receiver, 1);
+
+  // frames are crypted by the cloud
+  hostSelectNode(&server.node);
+  for( uint8_t i = 0; i < count; i++ ) {
+    uint8_t *blob = blobs + i*RF_PAYLOAD_SIZE;
+    memset(blob, 0, RF_PAYLOAD_SIZE);
+    blob[M_TYPE] = TYPE_CLOUD_EVENT_DOWN;
+    blob[M_LENGTH] = 6;
+    blob[M_VALUE] = HOST_GATEWAY_IO;
+    blob[M_VALUE+4] = i + 1;
+    for( uint8_t j = 0; j < M_LAST_DIGIT; j++ ) {
+      blob[M_LAST_DIGIT] ^= blob[j];
+    }
+    AES128_ECB_encrypt(blob, key, blob);
+  }
+  hostSelectNode(previous);
+
+  return relay ? server.sendRelayPost(receiver, blobs, count) : server.sendDataPost(receiver, blobs, count);
+}
+
+/**
+ * Runs the Mama, the replay node and the server until both nodes have
+ * reached the time.
+ */
+void HostGateway::run(uint64_t until_us) {
+  for (;;) {
+    if( mama_node.time_us <= replay_node.time_us ) {
+      if( mama_node.time_us >= until_us ) {
+        break;
+      }
+      stepMama();
+    }
+    else {
+      if( replay_node.time_us >= until_us ) {
+        break;
+      }
+      stepReplay();
+    }
+  }
+}
+
+/**
+ * One loop of the Mama INO.
+ */
+void HostGateway::stepMama() {
+  bool reply_needed = false;
+  byte action;
+  byte status;
+
+  hostEthernetSetLink(mama_node.time_us < outage_start_us || mama_node.time_us >= outage_end_us);
+  hostSelectNode(&mama_node);
+
+  if( radio->update() == RIOTS_OK && radio->checkRiotsMsgValidity() == RIOTS_OK ) {
+    cloud->forwardToCloud();
+  }
+
+  cloud->update(&action);
+  switch( action ) {
+    case SET_RADIO_RECEIVER:
+      radio->setRadioReceiverAddress(cloud->getNextReceiverAddress());
+    break;
+
+    case FORWARD_DATA:
+      while( cloud->getNextDataBlob() > 0 ) {
+        reply_needed = false;
+        status = radio->processMsg(&reply_needed);
+        if( reply_needed ) {
+          // answer to a message for the Mama itself, TYPE_IM_ALIVE verifies the connection
+          if( radio->messageDelivered(cloud->forwardToCloud()) ) {
+            cloud->connectionSettingsVerificated();
+          }
+        }
+        else if( status != RIOTS_OK ) {
+          radio->createCoreNotReachedMsg();
+          cloud->sendCoreNotReached();
+        }
+      }
+    break;
+
+    case RELAY_DATA:
+      radio->setRadioReceiverAddress(cloud->getNextReceiverAddress());
+      cloud->getNextRelayBlob();
+      cloud->relayDelivered(radio->processMsg(&reply_needed));
+    break;
+  }
+  cloud->processCachedMessage();
+  mama_node.advance(loop_us);
+
+  server.poll(mama_node.time_us);
+  collect();
+}
+
+/**
+ * Sends the next due message and receives the frames from the Mama.
+ */
+void HostGateway::stepReplay() {
+  hostSelectNode(&replay_node);
+
+  if( first_unsent < messages.size() && messages[first_unsent].time_us <= replay_node.time_us ) {
+    sendMessage(messages[first_unsent], first_unsent + 1);
+    first_unsent++;
+  }
+  if( replay->update(0) == RIOTS_OK && replay->decrypt(replay->getSharedKeyAddress()) == RIOTS_OK ) {
+    downlink_frames++;
+  }
+  replay_node.advance(HOST_GATEWAY_REPLAY_US);
+}
+
+/**
+ * Sends the cloud event of the Baby with the number of the message as data.
+ */
+void HostGateway::sendMessage(HostGatewayMessage &message, uint32_t number) {
+  byte *plain_data = replay->getPlainDataAddress();
+  uint16_t counter = ++counters[message.baby - 1];
+
+  memset(plain_data, 0, RF_PAYLOAD_SIZE);
+  plain_data[M_TYPE] = TYPE_CLOUD_EVENT;
+  plain_data[M_LENGTH] = 6;
+  plain_data[M_VALUE] = HOST_GATEWAY_IO;
+  plain_data[M_VALUE+1] = number >> 24;
+  plain_data[M_VALUE+2] = number >> 16;
+  plain_data[M_VALUE+3] = number >> 8;
+  plain_data[M_VALUE+4] = number;
+  plain_data[M_COUNTER] = counter >> 8;
+  plain_data[M_COUNTER+1] = counter;
+  plain_data[M_CHILD_ID] = message.baby >> 8;
+  plain_data[M_CHILD_ID+1] = message.baby;
+  for( uint8_t i = 0; i < M_LAST_DIGIT; i++ ) {
+    plain_data[M_LAST_DIGIT] ^= plain_data[i];
+  }
+  AES128_ECB_encrypt(plain_data, replay->getSharedKeyAddress(), replay->getTXCryptBuffAddress());
+
+  message.sent_us = replay_node.time_us;
+  message.acked = replay->send() == RIOTS_OK;
+}
+
+/**
+ * Matches the messages the server got to the schedule.
+ */
+void HostGateway::collect() {
+  for( ; collected < server.messages.size(); collected++ ) {
+    const HostCloudMessage &received = server.messages[collected];
+    const uint8_t *block = received.block;
+    uint32_t number = ((uint32_t)block[M_VALUE+1] << 24) | ((uint32_t)block[M_VALUE+2] << 16) |
+                      ((uint32_t)block[M_VALUE+3] << 8) | block[M_VALUE+4];
+
+    if( block[M_TYPE] != TYPE_CLOUD_EVENT || number < 1 || number > messages.size() ) {
+      continue;
+    }
+    HostGatewayMessage &message = messages[number - 1];
+    if( message.cloud_us ) {
+      duplicates++;
+      continue;
+    }
+    message.cloud_us = received.received_us;
+    message.saved = received.saved_time != 0;
+    cloud_messages++;
+  }
+}
+
+/* xorshift32, the runs are repeatable */
+uint32_t HostGateway::nextRandom() {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
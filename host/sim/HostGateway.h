@@ -0,0 +1,112 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostGateway_h
+#define HostGateway_h
+
+/*
+ * Mama gateway between simulated Babies and a HostCloudServer. The Mama runs
+ * the real Riots_MamaRadio and Riots_MamaCloud code, wired as in the Mama INO,
+ * on a HostNode with its I2C EEPROMs and nRF24L01. Its Ethernet connects to
+ * the server on the loopback interface.
+ *
+ * The Babies are replayed by one radio node: the messages of every Baby are
+ * scheduled in the order of their time and sent to the Mama as the Babies
+ * would send their cloud events, with the child id and counter of the Baby.
+ * The number of the message is sent as the data, so the messages the server
+ * gets can be matched to the schedule. Frames the cloud sends down to the
+ * replay node are counted.
+ *
+ * As HostNetwork, the gateway is a discrete-event simulation: the node with
+ * the earliest time runs next. The server is polled after every loop of the
+ * Mama with the time of the Mama. An outage takes the Ethernet link down for
+ * a while, the Mama then caches the messages to its secondary EEPROM.
+ *
+ * A data post is forwarded in one loop of the Mama, before the replay node
+ * runs again, so the replay node gets at most its RX FIFO of it. Relay posts
+ * go one datablob per loop.
+ */
+#include <stdint.h>
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Riots_MamaCloud.h"
+#include "Riots_MamaRadio.h"
+#include "HostCloudServer.h"
+#include "HostEeprom24.h"
+#include "HostNrf24.h"
+
+#define HOST_GATEWAY_LOOP_US        1000    // rest of loop() of the Mama besides the libraries
+#define HOST_GATEWAY_REPLAY_US      100     // poll interval of the replay node
+#define HOST_GATEWAY_ADDRESS_MARK   0x0A    // first byte of the radio addresses
+#define HOST_GATEWAY_IO             1       // IO index of the replayed cloud events
+
+struct HostGatewayMessage {
+  uint16_t baby;                          /*!< Child id of the replayed Baby                */
+  uint64_t time_us;                       /*!< Time the Baby sends the message              */
+  uint64_t sent_us;                       /*!< Time the replay node sent it, 0 not yet      */
+  uint64_t cloud_us;                      /*!< Time the server got it, 0 never              */
+  bool acked;                             /*!< Mama acknowledged the radio frame            */
+  bool saved;                             /*!< Server got it as a saved data post           */
+};
+
+class HostGateway {
+  public:
+    HostGateway(uint16_t baby_count, uint8_t protocol = RIOTS_ENVELOPE_VERSION, uint32_t seed = 1);
+    ~HostGateway();
+
+    void setAesBlockTime(uint32_t us);
+    void scheduleMessage(uint16_t baby, uint64_t time_us);
+    void replayBabies(uint32_t period_us, uint64_t start_us, uint64_t end_us);
+    void setOutage(uint64_t start_us, uint64_t end_us);
+    bool sendDownlink(uint8_t count, bool relay);
+    void run(uint64_t until_us);
+
+    HostRadioMedium medium;
+    HostNode mama_node;
+    HostI2cBus bus;
+    HostEeprom24 primary;
+    HostEeprom24 secondary;
+    HostNrf24 mama_nrf;
+    Riots_MamaRadio *radio;
+    Riots_MamaCloud *cloud;
+    HostNode replay_node;
+    HostNrf24 replay_nrf;
+    Riots_Radio *replay;
+    HostCloudServer server;
+    std::vector<HostGatewayMessage> messages; /*!< Scheduled messages in the order of their time */
+    uint16_t baby_count;
+    uint32_t loop_us;                       /*!< Time of one Mama loop besides the libraries  */
+    uint32_t cloud_messages;                /*!< Messages of the schedule got by the server   */
+    uint32_t duplicates;                    /*!< Messages the server got more than once       */
+    uint32_t downlink_frames;               /*!< Valid frames the replay node got from the Mama */
+    uint64_t outage_start_us;
+    uint64_t outage_end_us;
+
+  private:
+    void configure(HostNode *node, uint16_t id);
+    void stepMama();
+    void stepReplay();
+    void sendMessage(HostGatewayMessage &message, uint32_t number);
+    void collect();
+    uint32_t nextRandom();
+
+    std::vector<uint16_t> counters;         /*!< Message counter of every Baby                */
+    size_t first_unsent;
+    size_t collected;                       /*!< Server messages already matched              */
+    uint32_t random_state;
+};
+
+#endif // HostGateway_h
@@ -0,0 +1,238 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "HostNetwork.h"
+#include "Riots_Helper.h"
+#include "Riots_Memory.h"
+
+static const uint8_t network_key[AES_KEY_SIZE] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                                   0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+/* Radio address of the node, the Mama is node 0 */
+static void writeAddress(uint8_t *eeprom, uint16_t address, uint16_t id) {
+  eeprom[address]   = HOST_NETWORK_ADDRESS_MARK;
+  eeprom[address+1] = 0x00;
+  eeprom[address+2] = id >> 8;
+  eeprom[address+3] = id;
+}
+
+static void writeChildId(uint8_t *eeprom, uint16_t address, uint16_t id) {
+  eeprom[address]   = id >> 8;
+  eeprom[address+1] = id;
+}
+
+HostNetworkNode::HostNetworkNode(uint16_t id, HostRadioMedium *medium, bool is_mama) :
+  node(id), nrf(&node, medium, RIOTS_CE_PIN, RIOTS_CSN_PIN, RIOTS_IRQ_PIN), bus(&node),
+  eeprom(&node, RIOTS_PRIMARY_EEPROM >> 1), baby(NULL), mama(NULL), deliveries(0), duplicates(0) {
+  // value initialized, the libraries expect zeroed globals
+  if( is_mama ) {
+    mama = new Riots_MamaRadio();
+  }
+  else {
+    baby = new Riots_BabyRadio();
+  }
+}
+
+HostNetworkNode::~HostNetworkNode() {
+  delete baby;
+  delete mama;
+}
+
+/**
+ * Creates the Mama and a ring of the Babies, every Baby sends to the next one.
+ */
+HostNetwork::HostNetwork(uint8_t baby_count, uint32_t seed) : medium(seed), loop_us(HOST_NETWORK_LOOP_US),
+  cloud_events(0), first_unsent(0) {
+  if( baby_count > HOST_NETWORK_MAX_BABIES ) {
+    baby_count = HOST_NETWORK_MAX_BABIES;
+  }
+
+  mama = new HostNetworkNode(0, &medium, true);
+  configure(mama, 0);
+  hostSelectNode(&mama->node);
+  mama->mama->setup(0);
+
+  for( uint8_t i = 0; i < baby_count; i++ ) {
+    babies.push_back(new HostNetworkNode(i + 1, &medium, false));
+  }
+  for( uint8_t i = 0; i < baby_count; i++ ) {
+    configure(babies[i], i);
+    hostSelectNode(&babies[i]->node);
+    babies[i]->baby->setup(0);
+  }
+}
+
+HostNetwork::~HostNetwork() {
+  for( size_t i = 0; i < babies.size(); i++ ) {
+    delete babies[i];
+  }
+  delete mama;
+}
+
+void HostNetwork::configure(HostNetworkNode *board, uint8_t index) {
+  uint8_t *eeprom = board->node.eeprom;
+  uint16_t id = board->node.id;
+
+  writeAddress(eeprom, EEPROM_RX_ADDR, id);
+  memcpy(eeprom + EEPROM_AES_CHANGING, network_key, AES_KEY_SIZE);
+  memset(eeprom + EEPROM_AES_UNIQUE, id, AES_KEY_SIZE);
+  eeprom[EEPROM_FIRST_BOOT] = 0;
+  writeChildId(eeprom, EEPROM_CHILD_ID, id);
+  writeChildId(eeprom, EEPROM_COUNTER, 0);
+  if( board->mama ) {
+    return;
+  }
+
+  uint8_t count = babies.size();
+  uint16_t next = (index + 1) % count + 1;
+  uint16_t prev = (index + count - 1) % count + 1;
+
+  writeAddress(eeprom, EEPROM_MAMA_ADDR, 0);
+  writeAddress(eeprom, EEPROM_RING_NEXT, next);
+  writeAddress(eeprom, EEPROM_RING_PREV, prev);
+  writeChildId(eeprom, EEPROM_RING_NEXT_CHILD, next);
+  writeChildId(eeprom, EEPROM_RING_PREV_CHILD, prev);
+  eeprom[EEPROM_CORE_STATUS] = (1 << CORE_MAMA_ADDRESS_SET);
+  eeprom[EEPROM_NET_STATUS] = (1 << NET_CLOUD_CONNECTION) | (1 << NET_RING_CONNECTION);
+  eeprom[EEPROM_SLEEP_ENABLED] = 0;
+  eeprom[EEPROM_IO_INDEX] = 1;
+  eeprom[EEPROM_CORE_INDEX] = HOST_NETWORK_IO;
+  eeprom[EEPROM_RING_INDEX] = HOST_NETWORK_IO;
+}
+
+/**
+ * Sets the time of one AES block on every node, 0 leaves AES out of the time.
+ */
+void HostNetwork::setAesBlockTime(uint32_t us) {
+  mama->node.aes_block_us = us;
+  for( size_t i = 0; i < babies.size(); i++ ) {
+    babies[i]->node.aes_block_us = us;
+  }
+}
+
+/**
+ * Schedules a ring event from the Baby, in the order of time.
+ */
+void HostNetwork::scheduleEvent(uint8_t origin, uint64_t time_us) {
+  HostNetworkEvent event;
+
+  event.origin = origin;
+  event.time_us = time_us;
+  event.send_us = 0;
+  event.cloud_us = 0;
+  event.delivered_us.assign(babies.size(), 0);
+  event.deliveries = 0;
+  events.push_back(event);
+}
+
+/**
+ * Runs the loops of the nodes until every node has reached the time.
+ */
+void HostNetwork::run(uint64_t until_us) {
+  for (;;) {
+    HostNetworkNode *board = mama;
+    uint8_t index = 0;
+
+    for( uint8_t i = 0; i < babies.size(); i++ ) {
+      if( babies[i]->node.time_us < board->node.time_us ) {
+        board = babies[i];
+        index = i;
+      }
+    }
+    if( board->node.time_us >= until_us ) {
+      break;
+    }
+    step(board, index);
+  }
+}
+
+void HostNetwork::step(HostNetworkNode *board, uint8_t index) {
+  hostSelectNode(&board->node);
+  if( board->baby ) {
+    sendEvents(board, index);
+    if( board->baby->update(0) == RIOTS_DATA_AVAILABLE ) {
+      ringEvent(board, index);
+    }
+  }
+  else if( board->mama->update(0) == RIOTS_OK && board->mama->checkRiotsMsgValidity() == RIOTS_OK ) {
+    cloudEvent();
+  }
+  board->node.advance(loop_us);
+}
+
+void HostNetwork::sendEvents(HostNetworkNode *board, uint8_t index) {
+  for( size_t i = first_unsent; i < events.size() && events[i].time_us <= board->node.time_us; i++ ) {
+    if( events[i].origin == index && events[i].send_us == 0 ) {
+      events[i].send_us = board->node.time_us;
+      board->baby->send(HOST_NETWORK_IO, (int32_t)(i + 1), 0);
+    }
+  }
+  while( first_unsent < events.size() && events[first_unsent].send_us ) {
+    first_unsent++;
+  }
+}
+
+void HostNetwork::ringEvent(HostNetworkNode *board, uint8_t index) {
+  int32_t number = board->baby->getData();
+
+  if( number < 1 || (size_t)number > events.size() || board->baby->getIndex() != HOST_NETWORK_IO ) {
+    return;
+  }
+  HostNetworkEvent &event = events[number - 1];
+  if( event.delivered_us[index] ) {
+    board->duplicates++;
+    return;
+  }
+  event.delivered_us[index] = board->node.time_us;
+  event.deliveries++;
+  board->deliveries++;
+}
+
+void HostNetwork::cloudEvent() {
+  byte *plain_data = mama->mama->getPlainDataAddress();
+  int32_t number;
+
+  if( plain_data[M_TYPE] != TYPE_CLOUD_EVENT ) {
+    return;
+  }
+  number = ((int32_t)plain_data[M_VALUE+1] << 24) | ((int32_t)plain_data[M_VALUE+2] << 16) |
+           ((int32_t)plain_data[M_VALUE+3] << 8) | plain_data[M_VALUE+4];
+  if( number >= 1 && (size_t)number <= events.size() && events[number - 1].cloud_us == 0 ) {
+    events[number - 1].cloud_us = mama->node.time_us;
+    cloud_events++;
+  }
+}
+
+/**
+ * Tells if every Baby but the origin got the event from the ring.
+ */
+bool HostNetwork::ringComplete(const HostNetworkEvent &event) {
+  return event.send_us && (size_t)event.deliveries + 1 >= babies.size();
+}
+
+/**
+ * Time from send() to the last Baby of the ring which got the event.
+ */
+uint64_t HostNetwork::ringLatency(const HostNetworkEvent &event) {
+  uint64_t last = event.send_us;
+
+  for( size_t i = 0; i < event.delivered_us.size(); i++ ) {
+    if( event.delivered_us[i] > last ) {
+      last = event.delivered_us[i];
+    }
+  }
+  return last - event.send_us;
+}
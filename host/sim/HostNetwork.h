@@ -0,0 +1,103 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostNetwork_h
+#define HostNetwork_h
+
+/*
+ * Ring of simulated Babies and their Mama on one HostRadioMedium. Every node
+ * runs the real Riots_BabyRadio or Riots_MamaRadio code on a HostNode of its
+ * own, with the ring, the Mama address and the keys configured to the
+ * EEPROM as the cloud would have set them.
+ *
+ * The network is a discrete-event simulation: the node with the earliest
+ * time runs one loop, update() and loop_us of other work, so the nodes stay
+ * close to each other in time. A frame reaches the receiver when the time of
+ * the receiver passes the end of the frame. ACKs are decided when the frame
+ * is sent, as HostRadioMedium does.
+ *
+ * Ring events are scheduled to a Baby at a given time. The number of the
+ * event is sent as the data of send(), so the Babies which get it from the
+ * ring and the Mama which gets the cloud event can be told apart.
+ */
+#include <stdint.h>
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Riots_BabyRadio.h"
+#include "Riots_MamaRadio.h"
+#include "HostEeprom24.h"
+#include "HostNrf24.h"
+
+#define HOST_NETWORK_MAX_BABIES     (HOST_NRF24_MAX_RADIOS - 1)
+#define HOST_NETWORK_LOOP_US        1000    // rest of loop() besides update()
+#define HOST_NETWORK_IO             1       // IO of every Baby, mapped to the same ring IO
+#define HOST_NETWORK_ADDRESS_MARK   0x0A    // first byte of the radio addresses
+
+/**
+ * Board of the network: the radio, the I2C EEPROM of the base and the library.
+ */
+struct HostNetworkNode {
+  HostNetworkNode(uint16_t id, HostRadioMedium *medium, bool is_mama);
+  ~HostNetworkNode();
+
+  HostNode node;
+  HostNrf24 nrf;
+  HostI2cBus bus;
+  HostEeprom24 eeprom;
+  Riots_BabyRadio *baby;                  /*!< Library of a Baby, NULL on the Mama          */
+  Riots_MamaRadio *mama;                  /*!< Library of the Mama, NULL on a Baby          */
+  uint32_t deliveries;                    /*!< Ring events given to the INO                 */
+  uint32_t duplicates;                    /*!< Ring events given to the INO more than once  */
+};
+
+struct HostNetworkEvent {
+  uint8_t origin;                         /*!< Index of the sending Baby                    */
+  uint64_t time_us;                       /*!< Time to call send() at the origin            */
+  uint64_t send_us;                       /*!< Time send() was called, 0 not yet            */
+  uint64_t cloud_us;                      /*!< Time the Mama got the cloud event, 0 never   */
+  std::vector<uint64_t> delivered_us;     /*!< Time each Baby got the event, 0 never        */
+  uint16_t deliveries;                    /*!< Babies which got the event                   */
+};
+
+class HostNetwork {
+  public:
+    HostNetwork(uint8_t baby_count, uint32_t seed = 1);
+    ~HostNetwork();
+
+    void setAesBlockTime(uint32_t us);
+    void scheduleEvent(uint8_t origin, uint64_t time_us);
+    void run(uint64_t until_us);
+    bool ringComplete(const HostNetworkEvent &event);
+    uint64_t ringLatency(const HostNetworkEvent &event);
+
+    HostRadioMedium medium;
+    HostNetworkNode *mama;
+    std::vector<HostNetworkNode*> babies;
+    std::vector<HostNetworkEvent> events;   /*!< Scheduled events in the order of their time */
+    uint32_t loop_us;                       /*!< Time of one loop besides update()           */
+    uint32_t cloud_events;                  /*!< Cloud events of the schedule got by the Mama */
+
+  private:
+    void configure(HostNetworkNode *board, uint8_t index);
+    void step(HostNetworkNode *board, uint8_t index);
+    void sendEvents(HostNetworkNode *board, uint8_t index);
+    void ringEvent(HostNetworkNode *board, uint8_t index);
+    void cloudEvent();
+
+    size_t first_unsent;                    /*!< Events before this one have been sent       */
+};
+
+#endif // HostNetwork_h
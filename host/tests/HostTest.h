@@ -0,0 +1,50 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HostTest_h
+#define HostTest_h
+
+/*
+ * Checks of the host tests. A failed check is printed and makes the test
+ * program exit with 1 at the end, HOST_TEST_RUN prints the test names.
+ */
+#include <stdio.h>
+
+static int host_test_failures = 0;
+
+#define HOST_CHECK(condition) do { \
+    if( !(condition) ) { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      host_test_failures++; \
+    } \
+  } while(0)
+
+#define HOST_CHECK_EQUAL(expected, actual) do { \
+    long long _expected = (long long)(expected); \
+    long long _actual = (long long)(actual); \
+    if( _expected != _actual ) { \
+      printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, _actual, _expected); \
+      host_test_failures++; \
+    } \
+  } while(0)
+
+#define HOST_TEST_RUN(test) do { \
+    int _failures = host_test_failures; \
+    test(); \
+    printf("%s %s\n", host_test_failures == _failures ? "ok  " : "FAIL", #test); \
+  } while(0)
+
+#define HOST_TEST_RESULT() (host_test_failures ? 1 : 0)
+
+#endif // HostTest_h
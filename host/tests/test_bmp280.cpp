@@ -0,0 +1,164 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Riots_BMP280 integer compensation against the floating point one of the datasheet */
+#include "Riots_BMP280.h"
+#include "Riots_Memory.h"
+#include "HostBmp280.h"
+#include "HostTest.h"
+
+#define TEST_RAW_STEP       4099
+#define TEST_MAX_ERROR_PA   12.0    // relative accuracy of the sensor, 0.12 hPa
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostBmp280 bmp;
+  Riots_BMP280 sensor;
+
+  Board() : node(1), bus(&node), bmp(&node) {
+    hostSelectNode(&node);
+  }
+};
+
+struct Calibration {
+  uint16_t T1; int16_t T2, T3;
+  uint16_t P1; int16_t P2, P3, P4, P5, P6, P7, P8, P9;
+};
+
+static const Calibration example_calibration = { 27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000 };
+static const Calibration other_calibration = { 28009, 25654, 50, 39145, -10750, 3024, 5074, -83, -7, 9900, -10230, 4285 };
+
+/* Floating point compensation of the datasheet, returns Pa and the temperature in C */
+static double referencePressure(const Calibration &c, int32_t adc_P, int32_t adc_T, double *temperature) {
+  double var1, var2, p;
+  double t_fine;
+
+  var1 = ((double)adc_T/16384.0 - ((double)c.T1)/1024.0) * ((double)c.T2);
+  var2 = (((double)adc_T/131072.0 - ((double)c.T1)/8192.0) * ((double)adc_T/131072.0 - ((double)c.T1)/8192.0)) * ((double)c.T3);
+  t_fine = (int32_t)(var1 + var2);
+  *temperature = (var1 + var2) / 5120.0;
+
+  var1 = (t_fine/2.0) - 64000.0;
+  var2 = var1 * var1 * ((double)c.P6) / 32768.0;
+  var2 = var2 + var1 * ((double)c.P5) * 2.0;
+  var2 = (var2/4.0) + (((double)c.P4) * 65536.0);
+  var1 = (((double)c.P3) * var1 * var1 / 524288.0 + ((double)c.P2) * var1) / 524288.0;
+  var1 = (1.0 + var1/32768.0) * ((double)c.P1);
+  if ( var1 == 0.0 ) {
+    return 0;
+  }
+  p = 1048576.0 - (double)adc_P;
+  p = (p - (var2/4096.0)) * 6250.0 / var1;
+  var1 = ((double)c.P9) * p * p / 2147483648.0;
+  var2 = p * ((double)c.P8) / 32768.0;
+  return p + (var1 + var2 + ((double)c.P7)) / 16.0;
+}
+
+static void setup(Board *board, const Calibration &c) {
+  uint16_t words[12] = { c.T1, (uint16_t)c.T2, (uint16_t)c.T3, c.P1, (uint16_t)c.P2, (uint16_t)c.P3,
+                         (uint16_t)c.P4, (uint16_t)c.P5, (uint16_t)c.P6, (uint16_t)c.P7, (uint16_t)c.P8, (uint16_t)c.P9 };
+
+  board->bmp.setCalibration(words);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->sensor.setup());
+}
+
+static void testDatasheetExample() {
+  Board *board = new Board();
+
+  setup(board, example_calibration);
+  board->bmp.setRaw(415148, 519888);
+  HOST_CHECK_EQUAL(100656, board->sensor.getPressure());
+  delete board;
+}
+
+/* Raw readings over -40..85 C and 300..1100 hPa, returns the count of points */
+static uint32_t sweep(const Calibration &c) {
+  Board *board = new Board();
+  double worst = 0;
+  uint32_t points = 0;
+
+  setup(board, c);
+  for (int32_t adc_T = 0; adc_T < 0x100000; adc_T += TEST_RAW_STEP) {
+    for (int32_t adc_P = 0; adc_P < 0x100000; adc_P += TEST_RAW_STEP) {
+      double temperature;
+      double expected = referencePressure(c, adc_P, adc_T, &temperature);
+
+      if ( temperature < -40 || temperature > 85 || expected < 30000 || expected > 110000 ) {
+        continue;
+      }
+      board->bmp.setRaw(adc_P, adc_T);
+      double error = board->sensor.getPressure() - expected;
+      if ( error < 0 ) {
+        error = -error;
+      }
+      if ( error > worst ) {
+        worst = error;
+      }
+      points++;
+    }
+  }
+  printf("  %u points, largest difference %.1f Pa\n", points, worst);
+  HOST_CHECK(worst < TEST_MAX_ERROR_PA);
+  delete board;
+  return points;
+}
+
+static void testSweepExampleCalibration() {
+  HOST_CHECK(sweep(example_calibration) > 1000);
+}
+
+static void testSweepOtherCalibration() {
+  HOST_CHECK(sweep(other_calibration) > 1000);
+}
+
+/* First, before Riots_Memory has probed the bus the sensor stays in the standard mode */
+static void testSetupBeforeProbe() {
+  Board *board = new Board();
+
+  HOST_CHECK_EQUAL(RIOTS_OK, board->sensor.setup());
+  HOST_CHECK_EQUAL(RIOTS_I2C_STANDARD_MODE, board->bus.sclFrequency());
+  delete board;
+}
+
+static void testSetupKeepsBusSpeed() {
+  Board *board = new Board();
+
+  // Wire.begin() of the driver resets the bus to 100 kHz, setup restores the shared speed
+  Riots_Memory::setBusSpeed(RIOTS_I2C_FAST_MODE);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->sensor.setup());
+  HOST_CHECK_EQUAL(RIOTS_I2C_FAST_MODE, board->bus.sclFrequency());
+  delete board;
+}
+
+static void testNoSensor() {
+  HostNode node(1);
+  HostI2cBus bus(&node);
+  Riots_BMP280 sensor;
+
+  hostSelectNode(&node);
+  HOST_CHECK_EQUAL(RIOTS_FAIL, sensor.setup());
+  HOST_CHECK_EQUAL(RIOTS_SENSOR_FAIL, sensor.getPressure());
+}
+
+int main() {
+  HOST_TEST_RUN(testSetupBeforeProbe);
+  HOST_TEST_RUN(testDatasheetExample);
+  HOST_TEST_RUN(testSweepExampleCalibration);
+  HOST_TEST_RUN(testSweepOtherCalibration);
+  HOST_TEST_RUN(testSetupKeepsBusSpeed);
+  HOST_TEST_RUN(testNoSensor);
+  return HOST_TEST_RESULT();
+}
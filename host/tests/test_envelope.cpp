@@ -0,0 +1,166 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_Envelope round trips, tampering and replays */
+#include <string.h>
+
+#include "aes.h"
+#include "Riots_Envelope.h"
+#include "HostTest.h"
+
+#define TEST_OPERATION  0x08
+#define TEST_BUFFER     98
+
+static uint8_t session_key[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                   0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+/* Seals an envelope with a keep-alive and two data posts */
+static uint8_t sealEnvelope(Riots_Envelope *sender, uint8_t *frame, uint8_t first_value) {
+  uint8_t value[16];
+
+  sender->begin(frame, TEST_BUFFER, TEST_OPERATION);
+  HOST_CHECK(sender->addRecord(RIOTS_RECORD_KEEP_ALIVE, NULL, 0));
+  for (uint8_t i = 0; i < 2; i++) {
+    memset(value, first_value + i, sizeof(value));
+    HOST_CHECK(sender->addRecord(RIOTS_RECORD_DATA_POST, value, sizeof(value)));
+  }
+  HOST_CHECK_EQUAL(3, sender->records());
+  return sender->seal();
+}
+
+static void testRoundTrip() {
+  Riots_Envelope sender, receiver;
+  uint8_t frame[TEST_BUFFER];
+  uint8_t offset = 0, type, value_length, *value;
+  uint8_t length;
+
+  sender.startSession(session_key);
+  receiver.startSession(session_key);
+  length = sealEnvelope(&sender, frame, 0x40);
+
+  // 8 info bytes, 2 + 18 + 18 record bytes and the MAC fill 3 blocks
+  HOST_CHECK_EQUAL(RIOTS_ENVELOPE_HEADER_SIZE + 3 * RIOTS_ENVELOPE_BLOCK_SIZE, length);
+  HOST_CHECK_EQUAL(length - 1, frame[0]);
+  HOST_CHECK_EQUAL(TEST_OPERATION, frame[1]);
+  HOST_CHECK(receiver.open(frame, length));
+
+  HOST_CHECK_EQUAL(RIOTS_ENVELOPE_VERSION, frame[2]);
+  HOST_CHECK_EQUAL(3, frame[3]);
+  HOST_CHECK(Riots_Envelope::nextRecord(frame, &offset, &type, &value_length, &value));
+  HOST_CHECK_EQUAL(RIOTS_RECORD_KEEP_ALIVE, type);
+  HOST_CHECK_EQUAL(0, value_length);
+  for (uint8_t i = 0; i < 2; i++) {
+    HOST_CHECK(Riots_Envelope::nextRecord(frame, &offset, &type, &value_length, &value));
+    HOST_CHECK_EQUAL(RIOTS_RECORD_DATA_POST, type);
+    HOST_CHECK_EQUAL(16, value_length);
+    HOST_CHECK_EQUAL(0x40 + i, value[0]);
+    HOST_CHECK_EQUAL(0x40 + i, value[15]);
+  }
+  HOST_CHECK(!Riots_Envelope::nextRecord(frame, &offset, &type, &value_length, &value));
+}
+
+static void testCounter() {
+  Riots_Envelope sender, receiver;
+  uint8_t frames[3][TEST_BUFFER];
+  uint8_t lengths[3];
+
+  sender.startSession(session_key);
+  receiver.startSession(session_key);
+  for (uint8_t i = 0; i < 3; i++) {
+    lengths[i] = sealEnvelope(&sender, frames[i], i);
+  }
+  // same records, the counter makes every envelope different
+  HOST_CHECK(memcmp(frames[0], frames[1], lengths[0]) != 0);
+
+  HOST_CHECK(receiver.open(frames[1], lengths[1]));
+  HOST_CHECK_EQUAL(2, frames[1][RIOTS_ENVELOPE_COUNTER_OFFSET+3]);
+  // older envelope is rejected, a newer one is accepted
+  HOST_CHECK(!receiver.open(frames[0], lengths[0]));
+  HOST_CHECK(receiver.open(frames[2], lengths[2]));
+}
+
+static void testReplay() {
+  Riots_Envelope sender, receiver;
+  uint8_t frame[TEST_BUFFER];
+  uint8_t copy[TEST_BUFFER];
+  uint8_t length;
+
+  sender.startSession(session_key);
+  receiver.startSession(session_key);
+  length = sealEnvelope(&sender, frame, 0x10);
+  memcpy(copy, frame, length);
+  HOST_CHECK(receiver.open(frame, length));
+  HOST_CHECK(!receiver.open(copy, length));
+}
+
+static void testTamper() {
+  Riots_Envelope sender, receiver;
+  uint8_t frame[TEST_BUFFER];
+  uint8_t tampered[TEST_BUFFER];
+  uint8_t length;
+
+  sender.startSession(session_key);
+  length = sealEnvelope(&sender, frame, 0x20);
+
+  // every single bit flip, the header included, is detected
+  for (uint8_t i = 0; i < length; i++) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      receiver.startSession(session_key);
+      memcpy(tampered, frame, length);
+      tampered[i] ^= (1 << bit);
+      HOST_CHECK(!receiver.open(tampered, length));
+    }
+  }
+
+  // dropping the last block and fixing the length byte is detected
+  receiver.startSession(session_key);
+  memcpy(tampered, frame, length);
+  tampered[0] -= RIOTS_ENVELOPE_BLOCK_SIZE;
+  HOST_CHECK(!receiver.open(tampered, length - RIOTS_ENVELOPE_BLOCK_SIZE));
+
+  // the untouched frame still opens
+  receiver.startSession(session_key);
+  HOST_CHECK(receiver.open(frame, length));
+}
+
+static void testKeys() {
+  Riots_Envelope sender, receiver;
+  uint8_t other_key[16];
+  uint8_t frame[TEST_BUFFER];
+  uint8_t copy[TEST_BUFFER];
+  uint8_t plain[16];
+  uint8_t length;
+
+  sender.startSession(session_key);
+  length = sealEnvelope(&sender, frame, 0x30);
+  memcpy(copy, frame, length);
+
+  memcpy(other_key, session_key, sizeof(other_key));
+  other_key[0] ^= 0x01;
+  receiver.startSession(other_key);
+  HOST_CHECK(!receiver.open(frame, length));
+
+  // blocks are not crypted with the session key itself
+  AES128_ECB_decrypt(copy + RIOTS_ENVELOPE_HEADER_SIZE, session_key, plain);
+  HOST_CHECK(plain[0] != RIOTS_ENVELOPE_VERSION || plain[1] != 3);
+}
+
+int main() {
+  HOST_TEST_RUN(testRoundTrip);
+  HOST_TEST_RUN(testCounter);
+  HOST_TEST_RUN(testReplay);
+  HOST_TEST_RUN(testTamper);
+  HOST_TEST_RUN(testKeys);
+  return HOST_TEST_RESULT();
+}
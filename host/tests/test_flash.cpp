@@ -0,0 +1,641 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Riots_Flash transfers through handleFlashMessage, against the I2C EEPROM and the internal EEPROM */
+#include <string.h>
+
+#include "Riots_Flash.h"
+#include "Riots_Helper.h"
+#include "Riots_Lz.h"
+#include "HostEeprom24.h"
+#include "HostTest.h"
+
+#define TEST_PAGES  4
+#define TEST_SIZE   (TEST_PAGES * I2C_EEPROM_PAGE_SIZE)
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostEeprom24 primary;
+  Riots_Flash flash;
+
+  Board() : node(1), bus(&node), primary(&node, RIOTS_PRIMARY_EEPROM >> 1) {
+    hostSelectNode(&node);
+  }
+};
+
+/* Fills the unofficial image area and starts a transfer of TEST_PAGES pages */
+static void startTransfer(Board *board) {
+  uint8_t plain[16];
+  bool response_needed;
+
+  for (uint16_t i = 0; i < TEST_PAGES * I2C_EEPROM_PAGE_SIZE; i++) {
+    board->primary.memory[I2C_EEPROM_UO_FW + i] = (uint8_t)(i * 13 + 7);
+  }
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+
+  plain[M_LENGTH] = ENTER_PROGMODE_LEN;
+  plain[M_VALUE] = BOOT_LOAD_UNOFFICIAL;
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.handleFlashMessage(TYPE_ENTER_PROGMODE, plain, &response_needed));
+  plain[M_LENGTH] = PROG_FLASH_LEN;
+  plain[M_VALUE] = (TEST_PAGES * I2C_EEPROM_PAGE_SIZE) >> 8;
+  plain[M_VALUE+1] = (TEST_PAGES * I2C_EEPROM_PAGE_SIZE) & 0xFF;
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.handleFlashMessage(TYPE_PROG_FLASH, plain, &response_needed));
+}
+
+static void putHash(uint8_t *data, uint32_t hash) {
+  data[0] = hash >> 24;
+  data[1] = hash >> 16;
+  data[2] = hash >> 8;
+  data[3] = hash;
+}
+
+/* CRC32 bit by bit as a reference */
+static uint32_t crc32(const uint8_t *data, uint16_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+
+  for (uint16_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+    }
+  }
+  return ~crc;
+}
+
+/* CRC32 of the page in the EEPROM model */
+static uint32_t pageCrc(Board *board, uint8_t page) {
+  return crc32(&board->primary.memory[I2C_EEPROM_UO_FW + page * I2C_EEPROM_PAGE_SIZE], I2C_EEPROM_PAGE_SIZE);
+}
+
+/* Pages the node reports needed, for the hashes or the missing pages from the first one */
+static uint16_t neededPages(Board *board, uint8_t type, uint8_t first_page) {
+  uint8_t plain[16];
+  uint8_t confirm[2];
+  bool response_needed;
+
+  if ( type == TYPE_MISSING_PAGES ) {
+    plain[M_LENGTH] = MISSING_PAGES_LEN;
+    plain[M_VALUE] = first_page;
+    HOST_CHECK_EQUAL(RIOTS_OK, board->flash.handleFlashMessage(TYPE_MISSING_PAGES, plain, &response_needed));
+  }
+  HOST_CHECK_EQUAL(CONFIRM_PAGE_LEN, board->flash.addConfirmData(type, confirm));
+  return (confirm[0] << 8) | confirm[1];
+}
+
+static void testMatchingPages() {
+  Board *board = new Board();
+  uint8_t plain[16];
+  bool response_needed;
+  uint32_t transactions;
+
+  startTransfer(board);
+  plain[M_LENGTH] = 1 + 2 * RIOTS_PAGE_HASH_SIZE;
+  plain[M_VALUE] = 1;
+  putHash(&plain[M_VALUE+1], pageCrc(board, 1));
+  putHash(&plain[M_VALUE+1+RIOTS_PAGE_HASH_SIZE], pageCrc(board, 2));
+
+  // image header written by TYPE_PROG_FLASH is out of its write cycle
+  board->node.time_us += HOST_EEPROM24_WRITE_US;
+  transactions = board->bus.transactions;
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.handleFlashMessage(TYPE_PAGE_HASH, plain, &response_needed));
+  HOST_CHECK(response_needed);
+  HOST_CHECK_EQUAL(0, neededPages(board, TYPE_PAGE_HASH, 1));
+  // only the pages not hashed are still missing
+  HOST_CHECK_EQUAL(0x09, neededPages(board, TYPE_MISSING_PAGES, 0));
+  // one poll for the header write, then one sequential read per page: address and read starts
+  HOST_CHECK_EQUAL(1 + 2 * 2, board->bus.transactions - transactions);
+  delete board;
+}
+
+static void testHighBitsDiffer() {
+  Board *board = new Board();
+  uint8_t plain[16];
+  bool response_needed;
+
+  startTransfer(board);
+  // same low 16 bits, only the full CRC32 tells the pages apart
+  plain[M_LENGTH] = 1 + 2 * RIOTS_PAGE_HASH_SIZE;
+  plain[M_VALUE] = 0;
+  putHash(&plain[M_VALUE+1], pageCrc(board, 0) ^ 0x00010000);
+  putHash(&plain[M_VALUE+1+RIOTS_PAGE_HASH_SIZE], pageCrc(board, 1) ^ 0x80000000);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.handleFlashMessage(TYPE_PAGE_HASH, plain, &response_needed));
+  HOST_CHECK_EQUAL(0x03, neededPages(board, TYPE_PAGE_HASH, 0));
+  HOST_CHECK_EQUAL(0x0F, neededPages(board, TYPE_MISSING_PAGES, 0));
+  delete board;
+}
+
+static void testHashLengths() {
+  Board *board = new Board();
+  uint8_t plain[16];
+  bool response_needed;
+
+  startTransfer(board);
+  memset(plain, 0, sizeof(plain));
+  plain[M_LENGTH] = 1 + 2;
+  HOST_CHECK_EQUAL(RIOTS_FAIL, board->flash.handleFlashMessage(TYPE_PAGE_HASH, plain, &response_needed));
+  plain[M_LENGTH] = 1 + RIOTS_PAGE_HASH_SIZE + 2;
+  HOST_CHECK_EQUAL(RIOTS_FAIL, board->flash.handleFlashMessage(TYPE_PAGE_HASH, plain, &response_needed));
+  plain[M_LENGTH] = 1 + 3 * RIOTS_PAGE_HASH_SIZE;
+  HOST_CHECK_EQUAL(RIOTS_FAIL, board->flash.handleFlashMessage(TYPE_PAGE_HASH, plain, &response_needed));
+  // past the end of the image
+  plain[M_LENGTH] = 1 + RIOTS_PAGE_HASH_SIZE;
+  plain[M_VALUE] = TEST_PAGES;
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.handleFlashMessage(TYPE_PAGE_HASH, plain, &response_needed));
+  HOST_CHECK_EQUAL(0x01, neededPages(board, TYPE_PAGE_HASH, TEST_PAGES));
+  delete board;
+}
+
+static const uint8_t test_image_id[4] = { 0x01, 0x02, 0x03, 0x04 };
+
+/* Image to be sent, pages of code-like repeating words */
+static uint8_t imageByte(uint16_t offset) {
+  return (offset & 1) ? (uint8_t)(0x90 + (offset >> 7)) : (uint8_t)((offset * 7) % 23);
+}
+
+static void makeImage(uint8_t *image) {
+  for (uint16_t i = 0; i < TEST_SIZE; i++) {
+    image[i] = imageByte(i);
+  }
+}
+
+static uint8_t sendMessage(Board *board, uint8_t type, const uint8_t *value, uint8_t length, bool *response_needed) {
+  uint8_t plain[RF_PAYLOAD_SIZE+2];
+
+  memset(plain, 0, sizeof(plain));
+  plain[M_LENGTH] = length;
+  memcpy(&plain[M_VALUE], value, length);
+  *response_needed = false;
+  return board->flash.handleFlashMessage(type, plain, response_needed);
+}
+
+/* TYPE_ENTER_PROGMODE, with the capabilities when caps is not 0 */
+static void enterProgmode(Board *board, uint8_t boot_status, uint8_t caps) {
+  uint8_t value[2] = { boot_status, caps };
+  bool response_needed;
+
+  HOST_CHECK_EQUAL(RIOTS_OK, sendMessage(board, TYPE_ENTER_PROGMODE, value, caps ? ENTER_PROGMODE_CAPS_LEN : ENTER_PROGMODE_LEN, &response_needed));
+}
+
+/* TYPE_PROG_FLASH, the resume form when image_id is given */
+static void progFlash(Board *board, uint16_t size, const uint8_t *image_id) {
+  uint8_t value[PROG_FLASH_RESUME_LEN] = { (uint8_t)(size >> 8), (uint8_t)size };
+  bool response_needed;
+
+  if (image_id) {
+    memcpy(&value[2], image_id, 4);
+  }
+  HOST_CHECK_EQUAL(RIOTS_OK, sendMessage(board, TYPE_PROG_FLASH, value, image_id ? PROG_FLASH_RESUME_LEN : PROG_FLASH_LEN, &response_needed));
+}
+
+static void loadAddress(Board *board, uint16_t page) {
+  uint16_t address = page * I2C_EEPROM_PAGE_SIZE;
+  uint8_t value[2] = { (uint8_t)(address >> 8), (uint8_t)address };
+  bool response_needed;
+
+  HOST_CHECK_EQUAL(RIOTS_OK, sendMessage(board, TYPE_LOAD_ADDRESS, value, 2, &response_needed));
+}
+
+static uint8_t sendPacket(Board *board, uint8_t type, uint8_t packet, const uint8_t *data, uint8_t length, bool *response_needed) {
+  uint8_t value[RF_PAYLOAD_SIZE];
+
+  value[0] = packet;
+  memcpy(&value[1], data, length);
+  return sendMessage(board, type, value, length + 1, response_needed);
+}
+
+/* Raw page in RIOTS_PAGE_PACKET_DATA packets, valid both appended and as slices */
+static void sendRawPage(Board *board, uint16_t page, const uint8_t *data) {
+  bool response_needed;
+  uint8_t length;
+
+  loadAddress(board, page);
+  for (uint8_t packet = 0; packet < RIOTS_PAGE_PACKETS; packet++) {
+    length = I2C_EEPROM_PAGE_SIZE - packet * RIOTS_PAGE_PACKET_DATA;
+    if (length > RIOTS_PAGE_PACKET_DATA) {
+      length = RIOTS_PAGE_PACKET_DATA;
+    }
+    HOST_CHECK_EQUAL(RIOTS_OK, sendPacket(board, TYPE_PROG_PAGE, packet, &data[packet * RIOTS_PAGE_PACKET_DATA], length, &response_needed));
+    HOST_CHECK_EQUAL(response_needed, packet == RIOTS_PAGE_PACKETS - 1);
+  }
+}
+
+/* TYPE_LEAVE_PROGMODE with the CRC32 of the image */
+static uint8_t leaveProgmode(Board *board, uint32_t crc) {
+  uint8_t value[LEAVE_PROGMODE_CRC_LEN];
+  bool response_needed;
+
+  memcpy(value, test_image_id, 4);
+  putHash(&value[4], crc);
+  return sendMessage(board, TYPE_LEAVE_PROGMODE, value, LEAVE_PROGMODE_CRC_LEN, &response_needed);
+}
+
+static const uint8_t *stagedPage(Board *board, uint16_t page) {
+  return &board->primary.memory[I2C_EEPROM_UO_FW + page * I2C_EEPROM_PAGE_SIZE];
+}
+
+/* Boot status and image header are committed only by a verified image */
+static void checkCommitted(Board *board, bool committed) {
+  const uint8_t *header = &board->primary.memory[I2C_EEPROM_UO_FW_ID];
+
+  if (committed) {
+    HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_BOOT_STATUS], BOOT_LOAD_UNOFFICIAL);
+    HOST_CHECK(memcmp(header, test_image_id, 4) == 0);
+    HOST_CHECK_EQUAL((header[4] << 8) | header[5], TEST_SIZE);
+  }
+  else {
+    HOST_CHECK(board->node.eeprom[EEPROM_BOOT_STATUS] != BOOT_LOAD_UNOFFICIAL);
+    HOST_CHECK(memcmp(header, test_image_id, 4) != 0);
+  }
+}
+
+/* Pages compressed with Riots_Lz, one whole frame of tokens per packet */
+static void testLzPages() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+  uint8_t tokens[RF_PAYLOAD_SIZE];
+  uint8_t index, length, packet;
+  bool response_needed;
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, NULL);
+  for (uint16_t page = 0; page < TEST_PAGES; page++) {
+    loadAddress(board, page);
+    index = 0;
+    packet = 0;
+    while (index < I2C_EEPROM_PAGE_SIZE) {
+      length = Riots_Lz::encode(&image[page * I2C_EEPROM_PAGE_SIZE], I2C_EEPROM_PAGE_SIZE, &index, tokens, RF_PAYLOAD_SIZE - 3);
+      HOST_CHECK_EQUAL(RIOTS_OK, sendPacket(board, TYPE_PROG_PAGE_LZ, packet++, tokens, length, &response_needed));
+    }
+    HOST_CHECK(response_needed);
+    // compressed below the RIOTS_PAGE_PACKETS raw packets
+    HOST_CHECK(packet < RIOTS_PAGE_PACKETS);
+    board->flash.update();
+  }
+  HOST_CHECK_EQUAL(RIOTS_RESET, leaveProgmode(board, crc32(image, TEST_SIZE)));
+  HOST_CHECK(memcmp(stagedPage(board, 0), image, TEST_SIZE) == 0);
+  checkCommitted(board, true);
+  delete board;
+}
+
+/* Pages patched against the official image: copies from it and literal runs */
+static void testDeltaPages() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+  uint8_t tokens[RF_PAYLOAD_SIZE];
+  uint16_t source;
+  bool response_needed;
+
+  makeImage(image);
+  // official image is the new one with a byte changed on every page, shifted by 16 bytes
+  for (uint16_t i = 0; i < TEST_SIZE; i++) {
+    board->primary.memory[I2C_EEPROM_O_FW + 16 + i] = image[i];
+  }
+  for (uint16_t page = 0; page < TEST_PAGES; page++) {
+    image[page * I2C_EEPROM_PAGE_SIZE + 64] ^= 0x5A;
+  }
+
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, NULL);
+  for (uint16_t page = 0; page < TEST_PAGES; page++) {
+    loadAddress(board, page);
+    source = 16 + page * I2C_EEPROM_PAGE_SIZE;
+    // 64 bytes copied, one literal byte and 63 bytes copied
+    tokens[0] = RIOTS_DELTA_COPY | (64 - 1);
+    tokens[1] = source >> 8;
+    tokens[2] = source;
+    tokens[3] = 0;
+    tokens[4] = image[page * I2C_EEPROM_PAGE_SIZE + 64];
+    HOST_CHECK_EQUAL(RIOTS_OK, sendPacket(board, TYPE_PROG_PAGE_DELTA, 0, tokens, 5, &response_needed));
+    HOST_CHECK(!response_needed);
+    source += 65;
+    tokens[0] = RIOTS_DELTA_COPY | (63 - 1);
+    tokens[1] = source >> 8;
+    tokens[2] = source;
+    HOST_CHECK_EQUAL(RIOTS_OK, sendPacket(board, TYPE_PROG_PAGE_DELTA, 1, tokens, RIOTS_DELTA_COPY_LEN, &response_needed));
+    HOST_CHECK(response_needed);
+    board->flash.update();
+  }
+  HOST_CHECK_EQUAL(RIOTS_RESET, leaveProgmode(board, crc32(image, TEST_SIZE)));
+  HOST_CHECK(memcmp(stagedPage(board, 0), image, TEST_SIZE) == 0);
+  delete board;
+}
+
+/* Tokens going past the page or the image are rejected and leave the page as it was */
+static void testBadTokens() {
+  Board *board = new Board();
+  uint8_t tokens[RF_PAYLOAD_SIZE];
+  bool response_needed;
+
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, NULL);
+  loadAddress(board, 0);
+
+  // copy source past the end of the image area
+  tokens[0] = RIOTS_DELTA_COPY | 0x7F;
+  tokens[1] = RIOTS_IMAGE_MAX_SIZE >> 8;
+  tokens[2] = RIOTS_IMAGE_MAX_SIZE & 0xFF;
+  HOST_CHECK_EQUAL(RIOTS_FAIL, sendPacket(board, TYPE_PROG_PAGE_DELTA, 0, tokens, RIOTS_DELTA_COPY_LEN, &response_needed));
+  HOST_CHECK(response_needed);
+  // truncated copy
+  HOST_CHECK_EQUAL(RIOTS_FAIL, sendPacket(board, TYPE_PROG_PAGE_DELTA, 0, tokens, 2, &response_needed));
+  // missed is reported once
+  HOST_CHECK(!response_needed);
+
+  // LZ match before the start of the page
+  tokens[0] = RIOTS_LZ_MATCH_FLAG;
+  tokens[1] = 0;
+  HOST_CHECK_EQUAL(RIOTS_FAIL, sendPacket(board, TYPE_PROG_PAGE_LZ, 0, tokens, 2, &response_needed));
+  // nothing of the page taken, the first packet is still expected
+  tokens[0] = 0;
+  tokens[1] = 0xAA;
+  HOST_CHECK_EQUAL(RIOTS_OK, sendPacket(board, TYPE_PROG_PAGE_DELTA, 0, tokens, 2, &response_needed));
+  HOST_CHECK_EQUAL(1u, board->primary.write_cycles);
+  delete board;
+}
+
+/* Slices arrive in any order, the repeated last one asks for the gaps */
+static void testSlicesOutOfOrder() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+  uint8_t confirm[2];
+  const uint8_t order[RIOTS_PAGE_PACKETS] = { 10, 3, 0, 7, 1, 9, 2, 8, 4, 6, 5 };
+  const uint8_t *data;
+  uint8_t packet, length;
+  bool response_needed;
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, RIOTS_FLASH_CAP_SLICES);
+  HOST_CHECK_EQUAL(CONFIRM_PAGE_LEN, board->flash.addConfirmData(TYPE_ENTER_PROGMODE, confirm));
+  HOST_CHECK_EQUAL(confirm[1], RIOTS_FLASH_CAP_SLICES);
+  progFlash(board, TEST_SIZE, NULL);
+
+  loadAddress(board, 1);
+  HOST_CHECK_EQUAL(CONFIRM_PAGE_LEN, board->flash.addConfirmData(TYPE_LOAD_ADDRESS, confirm));
+  HOST_CHECK_EQUAL((confirm[0] << 8) | confirm[1], RIOTS_PAGE_PACKETS_MASK);
+
+  // every other slice lost on the first round
+  for (uint8_t i = 0; i < RIOTS_PAGE_PACKETS; i += 2) {
+    packet = order[i];
+    data = &image[I2C_EEPROM_PAGE_SIZE + packet * RIOTS_PAGE_PACKET_DATA];
+    length = packet == RIOTS_PAGE_PACKETS - 1 ? I2C_EEPROM_PAGE_SIZE % RIOTS_PAGE_PACKET_DATA : RIOTS_PAGE_PACKET_DATA;
+    sendPacket(board, TYPE_PROG_PAGE, packet, data, length, &response_needed);
+  }
+  // last slice came first, repeating it closes the round
+  data = &image[I2C_EEPROM_PAGE_SIZE + (RIOTS_PAGE_PACKETS - 1) * RIOTS_PAGE_PACKET_DATA];
+  HOST_CHECK_EQUAL(RIOTS_FAIL, sendPacket(board, TYPE_PROG_PAGE, RIOTS_PAGE_PACKETS - 1, data, I2C_EEPROM_PAGE_SIZE % RIOTS_PAGE_PACKET_DATA, &response_needed));
+  HOST_CHECK(response_needed);
+  board->flash.addConfirmData(TYPE_LOAD_ADDRESS, confirm);
+  HOST_CHECK_EQUAL((confirm[0] << 8) | confirm[1], (1 << 3) | (1 << 6) | (1 << 7) | (1 << 8) | (1 << 9));
+
+  // same page again keeps the slices received
+  loadAddress(board, 1);
+  for (uint8_t i = 1; i < RIOTS_PAGE_PACKETS; i += 2) {
+    packet = order[i];
+    data = &image[I2C_EEPROM_PAGE_SIZE + packet * RIOTS_PAGE_PACKET_DATA];
+    HOST_CHECK_EQUAL(RIOTS_OK, sendPacket(board, TYPE_PROG_PAGE, packet, data, RIOTS_PAGE_PACKET_DATA, &response_needed));
+  }
+  HOST_CHECK(response_needed);
+  board->flash.addConfirmData(TYPE_LOAD_ADDRESS, confirm);
+  HOST_CHECK_EQUAL((confirm[0] << 8) | confirm[1], 0);
+  // slice of the wrong size is not taken
+  loadAddress(board, 2);
+  HOST_CHECK_EQUAL(RIOTS_FAIL, sendPacket(board, TYPE_PROG_PAGE, 0, image, RIOTS_PAGE_PACKET_DATA - 1, &response_needed));
+
+  board->flash.update();
+  HOST_CHECK(memcmp(stagedPage(board, 1), &image[I2C_EEPROM_PAGE_SIZE], I2C_EEPROM_PAGE_SIZE) == 0);
+  delete board;
+}
+
+/* Transfers all the pages of the image and returns the board with them staged */
+static Board *transferImage(uint8_t *image) {
+  Board *board = new Board();
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, NULL);
+  for (uint16_t page = 0; page < TEST_PAGES; page++) {
+    sendRawPage(board, page, &image[page * I2C_EEPROM_PAGE_SIZE]);
+    board->flash.update();
+  }
+  return board;
+}
+
+static void testVerifyImage() {
+  uint8_t image[TEST_SIZE];
+  Board *board = transferImage(image);
+
+  HOST_CHECK_EQUAL(RIOTS_RESET, leaveProgmode(board, crc32(image, TEST_SIZE)));
+  checkCommitted(board, true);
+  // header is out of its write cycle for the bootloader
+  HOST_CHECK(!board->primary.busy());
+  delete board;
+}
+
+static void testWrongCrc() {
+  uint8_t image[TEST_SIZE];
+  Board *board = transferImage(image);
+
+  HOST_CHECK_EQUAL(RIOTS_FAIL, leaveProgmode(board, crc32(image, TEST_SIZE) ^ 1));
+  checkCommitted(board, false);
+  delete board;
+}
+
+/* Pages received right but not written right are caught by the read back */
+static void testReadBackMismatch() {
+  uint8_t image[TEST_SIZE];
+  Board *board = transferImage(image);
+
+  board->node.time_us += HOST_EEPROM24_WRITE_US;
+  board->primary.memory[I2C_EEPROM_UO_FW + 2 * I2C_EEPROM_PAGE_SIZE + 5] ^= 0x10;
+  HOST_CHECK_EQUAL(RIOTS_FAIL, leaveProgmode(board, crc32(image, TEST_SIZE)));
+  checkCommitted(board, false);
+  delete board;
+}
+
+/* A completed page is written by update() or when the next one completes, never twice */
+static void testWriteOrder() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+  uint32_t cycles;
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, NULL);
+  cycles = board->primary.write_cycles;
+
+  sendRawPage(board, 0, &image[0]);
+  HOST_CHECK_EQUAL(cycles, board->primary.write_cycles);
+  // next page completes before update(), the waiting page goes first
+  sendRawPage(board, 1, &image[I2C_EEPROM_PAGE_SIZE]);
+  HOST_CHECK_EQUAL(cycles + 1, board->primary.write_cycles);
+  HOST_CHECK(memcmp(stagedPage(board, 0), &image[0], I2C_EEPROM_PAGE_SIZE) == 0);
+  HOST_CHECK(memcmp(stagedPage(board, 1), &image[I2C_EEPROM_PAGE_SIZE], I2C_EEPROM_PAGE_SIZE) != 0);
+
+  board->flash.update();
+  HOST_CHECK_EQUAL(cycles + 2, board->primary.write_cycles);
+  HOST_CHECK(memcmp(stagedPage(board, 1), &image[I2C_EEPROM_PAGE_SIZE], I2C_EEPROM_PAGE_SIZE) == 0);
+  board->flash.update();
+  HOST_CHECK_EQUAL(cycles + 2, board->primary.write_cycles);
+  delete board;
+}
+
+/* Page still waiting for update() is written before the image is verified */
+static void testFlushBeforeLeave() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, NULL);
+  for (uint16_t page = 0; page < TEST_PAGES; page++) {
+    sendRawPage(board, page, &image[page * I2C_EEPROM_PAGE_SIZE]);
+  }
+  HOST_CHECK(memcmp(stagedPage(board, TEST_PAGES - 1), &image[TEST_SIZE - I2C_EEPROM_PAGE_SIZE], I2C_EEPROM_PAGE_SIZE) != 0);
+  HOST_CHECK_EQUAL(RIOTS_RESET, leaveProgmode(board, crc32(image, TEST_SIZE)));
+  HOST_CHECK(memcmp(stagedPage(board, 0), image, TEST_SIZE) == 0);
+  checkCommitted(board, true);
+  delete board;
+}
+
+static uint16_t resumePage(Board *board) {
+  uint8_t confirm[2];
+
+  HOST_CHECK_EQUAL(CONFIRM_PAGE_LEN, board->flash.addConfirmData(TYPE_PROG_FLASH, confirm));
+  return (confirm[0] << 8) | confirm[1];
+}
+
+/* Pages out of their write cycle survive a reset in the checkpoint */
+static void testCheckpointResume() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, test_image_id);
+  HOST_CHECK_EQUAL(0, resumePage(board));
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_STATUS], BOOT_LOAD_UNOFFICIAL);
+
+  sendRawPage(board, 0, &image[0]);
+  board->flash.update();
+  sendRawPage(board, 1, &image[I2C_EEPROM_PAGE_SIZE]);
+  board->flash.update();
+  // page 0 is marked when page 1 starts its write, page 1 after its write cycle
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_PAGES], 0x01);
+  board->node.time_us += HOST_EEPROM24_WRITE_US;
+  board->flash.update();
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_PAGES], 0x03);
+  // page 2 in the EEPROM write cycle when the node resets
+  sendRawPage(board, 2, &image[2 * I2C_EEPROM_PAGE_SIZE]);
+  board->flash.update();
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_PAGES], 0x03);
+
+  // reset, the library starts from scratch on the same EEPROMs
+  board->node.time_us += HOST_EEPROM24_WRITE_US;
+  memset(&board->flash, 0, sizeof(board->flash));
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, test_image_id);
+  HOST_CHECK_EQUAL(2, resumePage(board));
+  for (uint16_t page = 2; page < TEST_PAGES; page++) {
+    sendRawPage(board, page, &image[page * I2C_EEPROM_PAGE_SIZE]);
+    board->flash.update();
+  }
+  HOST_CHECK_EQUAL(RIOTS_RESET, leaveProgmode(board, crc32(image, TEST_SIZE)));
+  checkCommitted(board, true);
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_STATUS], RIOTS_EMPTY);
+  delete board;
+}
+
+/* Checkpoint of another image is not resumed */
+static void testCheckpointOtherImage() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+  uint8_t other_id[4] = { 0x01, 0x02, 0x03, 0x05 };
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, test_image_id);
+  sendRawPage(board, 0, &image[0]);
+  board->flash.update();
+  board->node.time_us += HOST_EEPROM24_WRITE_US;
+  board->flash.update();
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_PAGES], 0x01);
+
+  memset(&board->flash, 0, sizeof(board->flash));
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, other_id);
+  HOST_CHECK_EQUAL(0, resumePage(board));
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_PAGES], 0x00);
+  HOST_CHECK(memcmp(&board->node.eeprom[EEPROM_FLASH_IMAGE_ID], other_id, 4) == 0);
+
+  // the plain form clears the checkpoint
+  progFlash(board, TEST_SIZE, NULL);
+  HOST_CHECK_EQUAL(board->node.eeprom[EEPROM_FLASH_STATUS], RIOTS_EMPTY);
+  delete board;
+}
+
+/* TYPE_PROG_FLASH again without TYPE_ENTER_PROGMODE starts the count over */
+static void testRestartWithoutEnter() {
+  Board *board = new Board();
+  uint8_t image[TEST_SIZE];
+
+  makeImage(image);
+  HOST_CHECK_EQUAL(RIOTS_OK, board->flash.setup());
+  enterProgmode(board, BOOT_LOAD_UNOFFICIAL, 0);
+  progFlash(board, TEST_SIZE, NULL);
+  sendRawPage(board, 0, &image[0]);
+  sendRawPage(board, 1, &image[I2C_EEPROM_PAGE_SIZE]);
+  board->flash.update();
+
+  progFlash(board, TEST_SIZE, NULL);
+  for (uint16_t page = 0; page < TEST_PAGES; page++) {
+    sendRawPage(board, page, &image[page * I2C_EEPROM_PAGE_SIZE]);
+    board->flash.update();
+  }
+  HOST_CHECK_EQUAL(RIOTS_RESET, leaveProgmode(board, crc32(image, TEST_SIZE)));
+  checkCommitted(board, true);
+  delete board;
+}
+
+int main() {
+  HOST_TEST_RUN(testMatchingPages);
+  HOST_TEST_RUN(testHighBitsDiffer);
+  HOST_TEST_RUN(testHashLengths);
+  HOST_TEST_RUN(testLzPages);
+  HOST_TEST_RUN(testDeltaPages);
+  HOST_TEST_RUN(testBadTokens);
+  HOST_TEST_RUN(testSlicesOutOfOrder);
+  HOST_TEST_RUN(testVerifyImage);
+  HOST_TEST_RUN(testWrongCrc);
+  HOST_TEST_RUN(testReadBackMismatch);
+  HOST_TEST_RUN(testWriteOrder);
+  HOST_TEST_RUN(testFlushBeforeLeave);
+  HOST_TEST_RUN(testCheckpointResume);
+  HOST_TEST_RUN(testCheckpointOtherImage);
+  HOST_TEST_RUN(testRestartWithoutEnter);
+  return HOST_TEST_RESULT();
+}
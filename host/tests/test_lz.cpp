@@ -0,0 +1,123 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_Lz page round trips with the packet sizes of the radio frames */
+#include <string.h>
+
+#include "Riots_Lz.h"
+#include "HostTest.h"
+
+#define TEST_PAGE_SIZE  128
+
+static uint32_t test_random = 0x1234567;
+
+static uint8_t nextRandom() {
+  test_random ^= test_random << 13;
+  test_random ^= test_random >> 17;
+  test_random ^= test_random << 5;
+  return (uint8_t)test_random;
+}
+
+/* Compresses and decodes the page packet by packet, returns the packet count */
+static uint8_t roundTrip(const uint8_t *page, uint8_t packet_data) {
+  uint8_t tokens[16];
+  uint8_t decoded[TEST_PAGE_SIZE];
+  uint8_t index = 0, decoded_index = 0, packets = 0, length;
+
+  memset(decoded, 0, sizeof(decoded));
+  while ( index < TEST_PAGE_SIZE ) {
+    length = Riots_Lz::encode(page, TEST_PAGE_SIZE, &index, tokens, packet_data);
+    HOST_CHECK(length > 0);
+    HOST_CHECK(length <= packet_data);
+    HOST_CHECK(Riots_Lz::decode(decoded, TEST_PAGE_SIZE, &decoded_index, tokens, length));
+    HOST_CHECK_EQUAL(index, decoded_index);
+    packets++;
+  }
+  HOST_CHECK(memcmp(page, decoded, TEST_PAGE_SIZE) == 0);
+  return packets;
+}
+
+static void testRandomPages() {
+  uint8_t page[TEST_PAGE_SIZE];
+
+  for (uint8_t round = 0; round < 20; round++) {
+    for (uint8_t i = 0; i < TEST_PAGE_SIZE; i++) {
+      page[i] = nextRandom();
+    }
+    for (uint8_t packet_data = 2; packet_data <= 13; packet_data++) {
+      roundTrip(page, packet_data);
+    }
+  }
+}
+
+static void testPaddedPage() {
+  uint8_t page[TEST_PAGE_SIZE];
+
+  // end of an image, the rest of the page is erased flash
+  memset(page, 0xFF, sizeof(page));
+  for (uint8_t i = 0; i < 40; i++) {
+    page[i] = nextRandom();
+  }
+  HOST_CHECK(roundTrip(page, 13) < 10);
+
+  memset(page, 0xFF, sizeof(page));
+  HOST_CHECK_EQUAL(1, roundTrip(page, 13));
+}
+
+static void testCodeLikePage() {
+  uint8_t page[TEST_PAGE_SIZE];
+  // AVR code repeats the same instruction words with a few different operands
+  static const uint8_t words[8][2] = { {0x0E, 0x94}, {0x80, 0x91}, {0x90, 0x91}, {0x08, 0x95},
+                                       {0xCF, 0x93}, {0xDF, 0x93}, {0x0F, 0x92}, {0x1F, 0x92} };
+
+  for (uint8_t i = 0; i < TEST_PAGE_SIZE; i += 4) {
+    uint8_t word = nextRandom() & 0x07;
+    page[i]   = words[word][0];
+    page[i+1] = words[word][1];
+    page[i+2] = nextRandom() & 0x03;
+    page[i+3] = 0x01;
+  }
+  // fewer packets than the 10 raw ones
+  HOST_CHECK(roundTrip(page, 13) < 10);
+}
+
+static void testBadTokens() {
+  uint8_t page[TEST_PAGE_SIZE];
+  uint8_t index = 0;
+  uint8_t match_first[2] = { RIOTS_LZ_MATCH_FLAG, 0x00 };
+  uint8_t truncated_match[3] = { 0x00, 0x55, RIOTS_LZ_MATCH_FLAG };
+  uint8_t short_literals[3] = { 0x04, 0x11, 0x22 };
+  uint8_t literals[2] = { 0x00, 0x33 };
+  uint8_t overflow[2] = { 0xFF, 0x00 };
+
+  // nothing to match yet
+  HOST_CHECK(!Riots_Lz::decode(page, TEST_PAGE_SIZE, &index, match_first, sizeof(match_first)));
+  HOST_CHECK(!Riots_Lz::decode(page, TEST_PAGE_SIZE, &index, truncated_match, sizeof(truncated_match)));
+  HOST_CHECK(!Riots_Lz::decode(page, TEST_PAGE_SIZE, &index, short_literals, sizeof(short_literals)));
+  HOST_CHECK_EQUAL(0, index);
+
+  // a match past the end of the page
+  HOST_CHECK(Riots_Lz::decode(page, TEST_PAGE_SIZE, &index, literals, sizeof(literals)));
+  HOST_CHECK_EQUAL(1, index);
+  HOST_CHECK(!Riots_Lz::decode(page, TEST_PAGE_SIZE, &index, overflow, sizeof(overflow)));
+  HOST_CHECK_EQUAL(1, index);
+}
+
+int main() {
+  HOST_TEST_RUN(testRandomPages);
+  HOST_TEST_RUN(testPaddedPage);
+  HOST_TEST_RUN(testCodeLikePage);
+  HOST_TEST_RUN(testBadTokens);
+  return HOST_TEST_RESULT();
+}
@@ -0,0 +1,253 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Riots_MamaCloud connection handling over the host Ethernet */
+#include "Riots_MamaCloud.h"
+#include "HostEeprom24.h"
+#include "HostGateway.h"
+#include "HostTest.h"
+
+#define TEST_UNUSED_PORT  1     // nothing listens, connections are refused
+#define TEST_START_US     2000000ULL
+#define TEST_BABIES       50
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostEeprom24 primary;
+  HostEeprom24 secondary;
+  Riots_MamaCloud cloud;
+  Riots_Stats stats;
+  byte plain_data[RF_PAYLOAD_SIZE+2];
+  byte tx_crypt_buff[RF_PAYLOAD_SIZE+2];
+  byte rx_crypt_buff[RF_PAYLOAD_SIZE+2];
+  byte unique_aes[AES_KEY_SIZE];
+
+  Board() : node(1), bus(&node), primary(&node, RIOTS_PRIMARY_EEPROM >> 1), secondary(&node, RIOTS_SECONDARY_EEPROM >> 1) {
+    hostSelectNode(&node);
+    memset(&stats, 0, sizeof(stats));
+    memset(unique_aes, 0x11, sizeof(unique_aes));
+    cloud.setAddresses(plain_data, tx_crypt_buff, rx_crypt_buff, unique_aes);
+    cloud.setStatsAddress(&stats);
+    cloud.setup();
+  }
+};
+
+static void testMaintainOnlyAtAttempts() {
+  Board *board = new Board();
+  uint32_t maintains = Ethernet.maintain_calls;
+  uint32_t attempts = 0;
+  uint32_t longest = 0;
+  byte action;
+
+  hostEthernetSetPort(TEST_UNUSED_PORT);
+  hostEthernetSetLink(false);
+  while( board->node.time_us < 600000000ULL ) {
+    uint32_t calls = Ethernet.maintain_calls;
+    uint32_t requests = Ethernet.dns_lookups + Ethernet.connect_calls;
+    uint64_t start = board->node.time_us;
+
+    board->cloud.update(&action);
+    if( Ethernet.dns_lookups + Ethernet.connect_calls != requests ) {
+      attempts++;
+    }
+    else {
+      // update() between the attempts does not block on DHCP
+      HOST_CHECK_EQUAL(calls, Ethernet.maintain_calls);
+      if( board->node.time_us - start > longest ) {
+        longest = board->node.time_us - start;
+      }
+    }
+    delay(10);
+  }
+  HOST_CHECK(attempts > 0);
+  HOST_CHECK(Ethernet.maintain_calls > maintains);
+  // at most once per DHCP_MAINTAIN_INTERVAL and only with an attempt
+  HOST_CHECK(Ethernet.maintain_calls - maintains <= 600000UL / DHCP_MAINTAIN_INTERVAL);
+  HOST_CHECK(Ethernet.maintain_calls - maintains <= attempts);
+  HOST_CHECK(longest < 1000);
+
+  hostEthernetSetLink(true);
+  hostEthernetSetPort(0);
+  delete board;
+}
+
+/* SYNs without an answer do not stall update(), the attempt times out */
+static void testConnectInBackground() {
+  Board *board = new Board();
+  uint32_t lookups = Ethernet.dns_lookups;
+  uint32_t connects = Ethernet.connect_calls;
+  uint32_t attempts = 0;
+  uint32_t longest = 0;
+  byte action;
+
+  // address is resolved and cached by an attempt the server refuses
+  hostEthernetSetPort(TEST_UNUSED_PORT);
+  board->cloud.update(&action);
+  HOST_CHECK_EQUAL(Ethernet.dns_lookups - lookups, 1u);
+  HOST_CHECK_EQUAL(Ethernet.connect_calls - connects, 1u);
+
+  hostEthernetSetLink(false);
+  uint64_t end = board->node.time_us + 30000000ULL;
+  while( board->node.time_us < end ) {
+    uint32_t calls = Ethernet.maintain_calls;
+    uint32_t requests = Ethernet.connect_calls;
+    uint64_t start = board->node.time_us;
+
+    board->cloud.update(&action);
+    if( Ethernet.connect_calls != requests ) {
+      attempts++;
+    }
+    if( Ethernet.maintain_calls == calls && board->node.time_us - start > longest ) {
+      longest = board->node.time_us - start;
+    }
+    delay(10);
+  }
+  // backoff of 1, 2 and 4 s with CLOUD_CONNECT_TIMEOUT after each attempt
+  HOST_CHECK(attempts >= 3);
+  HOST_CHECK(attempts <= 30000 / CLOUD_CONNECT_TIMEOUT);
+  // cached address is used, resolved again only after CLOUD_RESOLVE_FAILURES
+  HOST_CHECK(Ethernet.dns_lookups - lookups < attempts);
+  HOST_CHECK_EQUAL(board->stats.cloud_reconnects, 0);
+  HOST_CHECK(longest < 1000);
+
+  hostEthernetSetLink(true);
+  hostEthernetSetPort(0);
+  delete board;
+}
+
+/* Session, envelopes and data posts against the loopback cloud server */
+static void testSession(uint8_t protocol) {
+  HostGateway *gateway = new HostGateway(TEST_BABIES, protocol);
+  const uint8_t mac[MAC_ADDRESS_SIZE] = { 0x52, 0x49, 0x4F, 0x54 };
+  const uint8_t address[RF_ADDRESS_SIZE] = { HOST_GATEWAY_ADDRESS_MARK, 0, 0, 0 };
+
+  gateway->replayBabies(1000000UL, TEST_START_US, TEST_START_US + 3000000ULL);
+  gateway->run(TEST_START_US + 4000000ULL);
+
+  HOST_CHECK_EQUAL(gateway->server.sessions, 1u);
+  HOST_CHECK(gateway->server.verified);
+  HOST_CHECK_EQUAL(gateway->server.envelopes, protocol != 0);
+  // introduction carries the MAC of the primary EEPROM and the radio address
+  HOST_CHECK(memcmp(gateway->server.mac, mac, sizeof(mac)) == 0);
+  HOST_CHECK(memcmp(gateway->server.mama_address, address, sizeof(address)) == 0);
+  HOST_CHECK_EQUAL(gateway->cloud_messages, (uint32_t)gateway->messages.size());
+  HOST_CHECK_EQUAL(gateway->messages.size(), (size_t)3*TEST_BABIES);
+  HOST_CHECK_EQUAL(gateway->duplicates, 0u);
+  HOST_CHECK_EQUAL(gateway->server.bad_frames, 0u);
+  delete gateway;
+}
+
+static void testSessionV1() {
+  testSession(0);
+}
+
+static void testSessionV2() {
+  testSession(RIOTS_ENVELOPE_VERSION);
+}
+
+/* Messages cached while the link is down all reach the cloud after it */
+static void testOutageBacklog() {
+  HostGateway *gateway = new HostGateway(TEST_BABIES);
+  uint64_t outage_start = TEST_START_US + 2000000ULL;
+  uint64_t outage_end = TEST_START_US + 5000000ULL;
+  uint32_t saved = 0;
+
+  gateway->replayBabies(1000000UL, TEST_START_US, TEST_START_US + 8000000ULL);
+  gateway->setOutage(outage_start, outage_end);
+  gateway->run(TEST_START_US + 20000000ULL);
+
+  HOST_CHECK_EQUAL(gateway->duplicates, 0u);
+  HOST_CHECK_EQUAL(gateway->server.sessions, 2u);
+  for( size_t i = 0; i < gateway->messages.size(); i++ ) {
+    const HostGatewayMessage &message = gateway->messages[i];
+    if( !message.cloud_us ) {
+      // only frames still in the TX buffer when the link went down are lost
+      HOST_CHECK(message.sent_us + (MAMA_CLOUD_TX_DEADLINE + 2) * 1000ULL >= outage_start);
+      HOST_CHECK(message.sent_us < outage_start + 2*HOST_GATEWAY_LOOP_US);
+    }
+    if( message.saved ) {
+      saved++;
+      HOST_CHECK(message.cloud_us >= outage_end);
+    }
+  }
+  HOST_CHECK(gateway->cloud_messages + 2 >= gateway->messages.size());
+  HOST_CHECK(saved >= 2*TEST_BABIES);
+  delete gateway;
+}
+
+/* Datablobs of data and relay posts reach the receiver, relay space comes back */
+static void testDownlink() {
+  HostGateway *gateway = new HostGateway(1);
+
+  gateway->run(TEST_START_US);
+  // a data post is sent in one loop of the Mama, the replay node reads its FIFO after it
+  HOST_CHECK(gateway->sendDownlink(HOST_NRF24_FIFO_DEPTH, false));
+  gateway->run(TEST_START_US + 1000000ULL);
+  HOST_CHECK_EQUAL(gateway->downlink_frames, (uint32_t)HOST_NRF24_FIFO_DEPTH);
+
+  HOST_CHECK(gateway->sendDownlink(14, true));
+  gateway->run(TEST_START_US + 2000000ULL);
+  HOST_CHECK_EQUAL(gateway->downlink_frames, HOST_NRF24_FIFO_DEPTH + 14u);
+  HOST_CHECK_EQUAL(gateway->server.relay_credit, 14u);
+  HOST_CHECK_EQUAL(gateway->server.relay_failures, 0u);
+  delete gateway;
+}
+
+/* Stats record is decoded field by field, in little endian */
+static void testStatsRecord() {
+  HostGateway *gateway = new HostGateway(1);
+  Riots_Stats *stats = gateway->radio->getStatsAddress();
+
+  gateway->loop_us = 100000;
+  gateway->run(TEST_START_US);
+  // counters the idle Mama does not change, each with bytes of its own
+  for( uint8_t i = 0; i < RIOTS_STATS_KEY_COUNT; i++ ) {
+    stats->decrypt_failures[i] = 0x1101 * (i + 1);
+  }
+  stats->radio_airtime_timeouts = 0x0A0B;
+  stats->counter_rejects = 0x1234;
+  stats->ring_drops = 0x5678;
+  stats->cloud_cached_records = 0x9ABC;
+  stats->cloud_replayed_records = 0xDEF0;
+  gateway->run(MAMA_STATS_INTERVAL * 1000ULL + TEST_START_US);
+
+  HOST_CHECK_EQUAL(gateway->server.stats_posts, 1u);
+  HOST_CHECK_EQUAL(gateway->server.bad_frames, 0u);
+  for( uint8_t i = 0; i < RIOTS_STATS_KEY_COUNT; i++ ) {
+    HOST_CHECK_EQUAL(gateway->server.stats.decrypt_failures[i], 0x1101 * (i + 1));
+  }
+  HOST_CHECK_EQUAL(gateway->server.stats.radio_airtime_timeouts, 0x0A0B);
+  HOST_CHECK_EQUAL(gateway->server.stats.counter_rejects, 0x1234);
+  HOST_CHECK_EQUAL(gateway->server.stats.ring_drops, 0x5678);
+  HOST_CHECK_EQUAL(gateway->server.stats.cloud_cached_records, 0x9ABC);
+  HOST_CHECK_EQUAL(gateway->server.stats.cloud_replayed_records, 0xDEF0);
+  HOST_CHECK_EQUAL(gateway->server.stats.cloud_reconnects, 1);
+  HOST_CHECK(gateway->server.stats.cloud_bytes_up > 0);
+  HOST_CHECK(gateway->server.stats.cloud_bytes_up <= stats->cloud_bytes_up);
+  HOST_CHECK(gateway->server.stats.cloud_bytes_down > 0);
+  delete gateway;
+}
+
+int main() {
+  HOST_TEST_RUN(testMaintainOnlyAtAttempts);
+  HOST_TEST_RUN(testConnectInBackground);
+  HOST_TEST_RUN(testSessionV1);
+  HOST_TEST_RUN(testSessionV2);
+  HOST_TEST_RUN(testOutageBacklog);
+  HOST_TEST_RUN(testDownlink);
+  HOST_TEST_RUN(testStatsRecord);
+  return HOST_TEST_RESULT();
+}
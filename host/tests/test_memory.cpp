@@ -0,0 +1,148 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_Memory against the 24-series EEPROM model through the TWI registers */
+#include "Riots_Memory.h"
+#include "HostEeprom24.h"
+#include "HostTest.h"
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostEeprom24 primary;
+  HostEeprom24 secondary;
+
+  Board(uint32_t max_scl = 400000UL) : node(1), bus(&node), primary(&node, RIOTS_PRIMARY_EEPROM >> 1, max_scl),
+    secondary(&node, RIOTS_SECONDARY_EEPROM >> 1, max_scl) {
+    hostSelectNode(&node);
+  }
+};
+
+static void testSetupFastMode() {
+  Board *board = new Board();
+
+  HOST_CHECK_EQUAL(1, Riots_Memory::setup(RIOTS_PRIMARY_EEPROM));
+  HOST_CHECK_EQUAL(RIOTS_I2C_FAST_MODE, Riots_Memory::getBusSpeed());
+  HOST_CHECK_EQUAL(RIOTS_I2C_FAST_MODE, board->bus.sclFrequency());
+  delete board;
+}
+
+static void testBlockRoundTrip() {
+  Board *board = new Board();
+  uint8_t data[300];
+  uint8_t back[300];
+
+  Riots_Memory::setup(RIOTS_PRIMARY_EEPROM);
+  for( uint16_t i = 0; i < sizeof(data); i++ ) {
+    data[i] = (uint8_t)(i * 7 + 3);
+  }
+  // starts in the middle of a page, crosses two page boundaries
+  Riots_Memory::writeBlock(0x0150, data, sizeof(data));
+  Riots_Memory::readBlock(0x0150, back, sizeof(back));
+  HOST_CHECK(memcmp(data, back, sizeof(data)) == 0);
+  HOST_CHECK(memcmp(data, &board->primary.memory[0x0150], sizeof(data)) == 0);
+  HOST_CHECK_EQUAL(3, board->primary.write_cycles);
+
+  Riots_Memory::write(0x0010, 0x5A, RIOTS_SECONDARY_EEPROM);
+  HOST_CHECK_EQUAL(0x5A, Riots_Memory::read(0x0010, RIOTS_SECONDARY_EEPROM));
+  HOST_CHECK_EQUAL(0xFF, board->primary.memory[0x0010]);
+  delete board;
+}
+
+static void testWriteCyclePerDevice() {
+  Board *board = new Board();
+  uint64_t start;
+
+  Riots_Memory::setup(RIOTS_PRIMARY_EEPROM);
+  Riots_Memory::write(0x0020, 0x11, RIOTS_PRIMARY_EEPROM);
+  HOST_CHECK(!Riots_Memory::isWriteDone(RIOTS_PRIMARY_EEPROM));
+
+  // the other EEPROM is not in its write cycle
+  start = board->node.time_us;
+  HOST_CHECK(Riots_Memory::isWriteDone(RIOTS_SECONDARY_EEPROM));
+  Riots_Memory::read(0x0020, RIOTS_SECONDARY_EEPROM);
+  HOST_CHECK(board->node.time_us - start < 1000);
+
+  // reading the primary waits for its write cycle
+  HOST_CHECK_EQUAL(0x11, Riots_Memory::read(0x0020, RIOTS_PRIMARY_EEPROM));
+  HOST_CHECK(board->node.time_us - start >= HOST_EEPROM24_WRITE_US - 1000);
+  HOST_CHECK(board->primary.busy_nacks > 0);
+  delete board;
+}
+
+static void testSetupDuringWriteCycle() {
+  Board *board = new Board();
+
+  // write cycle started before a reset, the EEPROM does not answer for a while
+  board->bus.start(RIOTS_PRIMARY_EEPROM >> 1, false);
+  board->bus.write(0x00);
+  board->bus.write(0x00);
+  board->bus.write(0x42);
+  board->bus.stop();
+  HOST_CHECK(board->primary.busy());
+
+  HOST_CHECK_EQUAL(1, Riots_Memory::setup(RIOTS_PRIMARY_EEPROM));
+  HOST_CHECK_EQUAL(RIOTS_I2C_FAST_MODE, Riots_Memory::getBusSpeed());
+  delete board;
+}
+
+static void testReadBlockBusHang() {
+  Board *board = new Board();
+  uint8_t data[64];
+  uint8_t back[64];
+  uint32_t polls;
+
+  Riots_Memory::setup(RIOTS_PRIMARY_EEPROM);
+  memset(data, 0x42, sizeof(data));
+  Riots_Memory::writeBlock(0x0200, data, sizeof(data));
+  Riots_Memory::waitWriteCycle(RIOTS_PRIMARY_EEPROM);
+
+  // address phase takes 4 bytes, the bus hangs after 10 data bytes
+  board->bus.hold_after = board->bus.bytes + 4 + 10;
+  polls = board->bus.twcr_polls;
+  Riots_Memory::readBlock(0x0200, back, sizeof(back));
+  HOST_CHECK_EQUAL(0x42, back[9]);
+  HOST_CHECK_EQUAL(I2C_READ_FAILED, back[10]);
+  HOST_CHECK_EQUAL(I2C_READ_FAILED, back[63]);
+  // one timeout, not one per remaining byte
+  HOST_CHECK(board->bus.twcr_polls - polls < 2 * I2C_TIMEOUT);
+
+  // bus recovers
+  board->bus.hold_after = 0;
+  Riots_Memory::readBlock(0x0200, back, sizeof(back));
+  HOST_CHECK(memcmp(data, back, sizeof(data)) == 0);
+  HOST_CHECK_EQUAL(I2C_READ_FAILED, Riots_Memory::read(0x0300));
+  delete board;
+}
+
+/* Last, the fallback to the standard mode is kept for good */
+static void testSetupFallback() {
+  Board *board = new Board(RIOTS_I2C_STANDARD_MODE);
+
+  HOST_CHECK_EQUAL(1, Riots_Memory::setup(RIOTS_PRIMARY_EEPROM));
+  HOST_CHECK_EQUAL(RIOTS_I2C_STANDARD_MODE, Riots_Memory::getBusSpeed());
+  Riots_Memory::write(0x0030, 0x33);
+  HOST_CHECK_EQUAL(0x33, Riots_Memory::read(0x0030));
+  delete board;
+}
+
+int main() {
+  HOST_TEST_RUN(testSetupFastMode);
+  HOST_TEST_RUN(testBlockRoundTrip);
+  HOST_TEST_RUN(testWriteCyclePerDevice);
+  HOST_TEST_RUN(testSetupDuringWriteCycle);
+  HOST_TEST_RUN(testReadBlockBusHang);
+  HOST_TEST_RUN(testSetupFallback);
+  return HOST_TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* HostNetwork rings of Riots_BabyRadio nodes and their Mama */
+#include "HostNetwork.h"
+#include "HostTest.h"
+
+#define TEST_BABIES       4
+#define TEST_EVENTS       8
+#define TEST_START_US     1000000ULL
+#define TEST_INTERVAL_US  100000ULL
+
+static HostNetwork* runRing(uint32_t aes_block_us, bool broken) {
+  HostNetwork *network = new HostNetwork(TEST_BABIES);
+
+  network->setAesBlockTime(aes_block_us);
+  if( broken ) {
+    network->medium.setLinkLoss(&network->babies[1]->nrf, &network->babies[2]->nrf, 1.0);
+  }
+  for( uint8_t i = 0; i < TEST_EVENTS; i++ ) {
+    network->scheduleEvent(broken ? 0 : i % TEST_BABIES, TEST_START_US + i * TEST_INTERVAL_US);
+  }
+  network->run(TEST_START_US + (TEST_EVENTS + 1) * TEST_INTERVAL_US);
+  return network;
+}
+
+static void testLosslessRing() {
+  HostNetwork *network = runRing(0, false);
+
+  for( uint8_t i = 0; i < TEST_EVENTS; i++ ) {
+    const HostNetworkEvent &event = network->events[i];
+    HOST_CHECK(network->ringComplete(event));
+    HOST_CHECK_EQUAL(0, event.delivered_us[event.origin]);
+    HOST_CHECK(network->ringLatency(event) > 0);
+    HOST_CHECK(network->ringLatency(event) < TEST_INTERVAL_US);
+  }
+  // the cloud frame of the origin may collide with the next Baby forwarding the event
+  HOST_CHECK(network->cloud_events >= TEST_EVENTS - 1);
+  for( uint8_t i = 0; i < TEST_BABIES; i++ ) {
+    HostNetworkNode *baby = network->babies[i];
+    // every event but the own ones, once
+    HOST_CHECK_EQUAL(TEST_EVENTS - TEST_EVENTS / TEST_BABIES, baby->deliveries);
+    HOST_CHECK_EQUAL(0, baby->duplicates);
+    HOST_CHECK_EQUAL(0, baby->baby->getStatsAddress()->ring_drops);
+    HOST_CHECK(baby->nrf.airtime_us > 0);
+    HOST_CHECK(baby->node.aes_blocks > 0);
+  }
+  HOST_CHECK(network->mama->node.aes_blocks >= TEST_EVENTS);
+  delete network;
+}
+
+static void testBrokenLink() {
+  HostNetwork *lossless = runRing(0, false);
+  HostNetwork *network = runRing(0, true);
+
+  // 1 -> 2 fails, the event goes back from 1 and around the other way
+  HOST_CHECK(network->babies[1]->baby->getStatsAddress()->ring_drops > 0);
+  HOST_CHECK(network->babies[2]->deliveries > 0);
+  HOST_CHECK(network->babies[3]->deliveries > 0);
+  HOST_CHECK(network->ringComplete(network->events[0]));
+  HOST_CHECK(network->ringLatency(network->events[0]) > lossless->ringLatency(lossless->events[0]));
+  HOST_CHECK_EQUAL(0, lossless->babies[1]->baby->getStatsAddress()->ring_drops);
+  delete network;
+  delete lossless;
+}
+
+static void testAesTime() {
+  HostNetwork *fast = runRing(0, false);
+  HostNetwork *slow = runRing(1000, false);
+
+  for( uint8_t i = 0; i < TEST_EVENTS; i++ ) {
+    // every hop decrypts and encrypts the event, polling in loop() hides a part of it
+    HOST_CHECK(slow->ringLatency(slow->events[i]) >= fast->ringLatency(fast->events[i]) + (TEST_BABIES - 1) * 1000);
+  }
+  for( uint8_t i = 0; i < TEST_BABIES; i++ ) {
+    HOST_CHECK_EQUAL(fast->babies[i]->node.aes_blocks, slow->babies[i]->node.aes_blocks);
+  }
+  delete slow;
+  delete fast;
+}
+
+int main() {
+  HOST_TEST_RUN(testLosslessRing);
+  HOST_TEST_RUN(testBrokenLink);
+  HOST_TEST_RUN(testAesTime);
+  return HOST_TEST_RESULT();
+}
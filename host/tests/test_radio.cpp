@@ -0,0 +1,267 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Riots_Radio of two nodes through the nRF24L01 model */
+#include "Arduino.h"
+#include "Riots_Radio.h"
+#include "aes.h"
+#include "HostNrf24.h"
+#include "HostTest.h"
+
+struct Board {
+  HostNode node;
+  HostNrf24 nrf;
+  Riots_Radio radio;
+
+  Board(uint16_t id, HostRadioMedium *medium, bool plus = true) :
+    node(id), nrf(&node, medium, RIOTS_CE_PIN, RIOTS_CSN_PIN, RIOTS_IRQ_PIN, plus) {
+    hostSelectNode(&node);
+    for( uint8_t i = 0; i < RF_ADDRESS_SIZE; i++ ) {
+      node.eeprom[EEPROM_RX_ADDR + i] = (uint8_t)(0x10 * id + i);
+    }
+    radio.setup(0xFF, 0xFF, 0xFF, 0xFF);
+  }
+};
+
+/* Runs the receiver until the frame has arrived or the time is up */
+static bool receive(Board *board, uint32_t timeout_ms) {
+  hostSelectNode(&board->node);
+  for( uint32_t i = 0; i < timeout_ms; i++ ) {
+    if( board->radio.update(0) == RIOTS_OK ) {
+      return true;
+    }
+    delay(1);
+  }
+  return false;
+}
+
+/* Lets the time of the receiver catch up with the sender */
+static void catchUp(Board *board, Board *sender) {
+  if( board->node.time_us < sender->node.time_us ) {
+    board->node.advance(sender->node.time_us - board->node.time_us);
+  }
+}
+
+static void testFrameExchange() {
+  HostRadioMedium medium;
+  Board *mama = new Board(1, &medium);
+  Board *baby = new Board(2, &medium);
+
+  hostSelectNode(&mama->node);
+  mama->radio.setTXAddress(baby->radio.getOwnRadioAddress());
+  for( uint8_t i = 0; i < RF_PAYLOAD_SIZE; i++ ) {
+    mama->radio.getTXCryptBuffAddress()[i] = i ^ 0xA5;
+  }
+  HOST_CHECK_EQUAL(RIOTS_OK, mama->radio.send());
+  HOST_CHECK_EQUAL(1, mama->radio.getStatsAddress()->radio_tx_frames);
+  HOST_CHECK_EQUAL(0, mama->radio.getStatsAddress()->radio_tx_failures);
+
+  HOST_CHECK(receive(baby, 200));
+  HOST_CHECK(memcmp(mama->radio.getTXCryptBuffAddress(), baby->radio.getRXCryptBuffAddress(), RF_PAYLOAD_SIZE) == 0);
+  HOST_CHECK_EQUAL(0, baby->radio.getRxPipe());
+  HOST_CHECK_EQUAL(1, baby->radio.getStatsAddress()->radio_rx_frames);
+
+  // and back
+  hostSelectNode(&baby->node);
+  baby->radio.setTXAddress(mama->radio.getOwnRadioAddress());
+  memset(baby->radio.getTXCryptBuffAddress(), 0x3C, RF_PAYLOAD_SIZE);
+  HOST_CHECK_EQUAL(RIOTS_OK, baby->radio.send());
+  HOST_CHECK(receive(mama, 200));
+  HOST_CHECK_EQUAL(0x3C, mama->radio.getRXCryptBuffAddress()[RF_PAYLOAD_SIZE - 1]);
+  delete baby;
+  delete mama;
+}
+
+static void testNoReceiver() {
+  HostRadioMedium medium;
+  Board *mama = new Board(1, &medium);
+  byte nobody[RF_ADDRESS_SIZE] = { 0x77, 0x77, 0x77, 0x77 };
+
+  mama->radio.setTXAddress(nobody);
+  HOST_CHECK_EQUAL(RIOTS_FAIL, mama->radio.send());
+  HOST_CHECK_EQUAL(1, mama->radio.getStatsAddress()->radio_tx_failures);
+  HOST_CHECK_EQUAL(0, mama->radio.getStatsAddress()->radio_airtime_timeouts);
+  // ARC=3, the frame went out 4 times
+  HOST_CHECK_EQUAL(4, mama->nrf.tx_frames);
+  delete mama;
+}
+
+static void testLossyLink() {
+  HostRadioMedium medium(7);
+  Board *mama = new Board(1, &medium);
+  Board *baby = new Board(2, &medium);
+  uint8_t delivered = 0;
+
+  medium.setLoss(0.5);
+  for( uint8_t i = 0; i < 20; i++ ) {
+    hostSelectNode(&mama->node);
+    mama->radio.setTXAddress(baby->radio.getOwnRadioAddress());
+    memset(mama->radio.getTXCryptBuffAddress(), i, RF_PAYLOAD_SIZE);
+    byte result = mama->radio.send();
+    bool received = false;
+    catchUp(baby, mama);
+    while( receive(baby, 1) ) {
+      received = true;
+      HOST_CHECK_EQUAL(i, baby->radio.getRXCryptBuffAddress()[0]);
+    }
+    if( result == RIOTS_OK ) {
+      // an acknowledged frame has been received, once
+      HOST_CHECK(received);
+      delivered++;
+    }
+  }
+  // half of the frames or ACKs are lost, retransmits deliver most of them
+  HOST_CHECK(delivered > 10);
+  HOST_CHECK(delivered < 20);
+  HOST_CHECK(medium.lost > 0);
+  delete baby;
+  delete mama;
+}
+
+static void testGroupFrame() {
+  HostRadioMedium medium;
+  // plain nRF24L01 needs ACTIVATE before W_TX_PAYLOAD_NOACK works
+  Board *mama = new Board(1, &medium, false);
+  Board *baby = new Board(2, &medium);
+  byte group[RF_ADDRESS_SIZE] = { RIOTS_GROUP_ADDRESS_MARK, 0x01, 0x02, 0x03 };
+
+  hostSelectNode(&baby->node);
+  baby->radio.setGroupAddress(group);
+
+  for( uint8_t round = 0; round < 2; round++ ) {
+    hostSelectNode(&mama->node);
+    mama->radio.setTXAddress(group);
+    memset(mama->radio.getTXCryptBuffAddress(), 0x5A + round, RF_PAYLOAD_SIZE);
+    uint32_t tx_frames = mama->nrf.tx_frames;
+    mama->radio.send(1);
+    // sent once, not retransmitted without an ACK
+    HOST_CHECK_EQUAL(tx_frames + 1, mama->nrf.tx_frames);
+    HOST_CHECK_EQUAL(0, mama->nrf.ignored_commands);
+
+    catchUp(baby, mama);
+    HOST_CHECK(receive(baby, 200));
+    HOST_CHECK_EQUAL(RIOTS_GROUP_PIPE, baby->radio.getRxPipe());
+    HOST_CHECK_EQUAL(0x5A + round, baby->radio.getRXCryptBuffAddress()[0]);
+
+    // setup again without a power cycle, ACTIVATE must not turn the features off
+    hostSelectNode(&mama->node);
+    mama->radio.setup(0xFF, 0xFF, 0xFF, 0xFF);
+  }
+  delete baby;
+  delete mama;
+}
+
+static void testGroupSequence() {
+  HostRadioMedium medium;
+  Board *baby = new Board(2, &medium);
+  byte key_part[AES_MSG_DELIVERY_SIZE];
+  byte plain[RF_PAYLOAD_SIZE];
+  byte *page_key = baby->radio.getGroupPageKeyAddress();
+
+  memset(key_part, 0x3C, sizeof(key_part));
+  baby->radio.saveGroupKey(0, key_part);
+  baby->radio.saveGroupKey(1, key_part);
+  HOST_CHECK_EQUAL(0, baby->radio.getGroupSequence());
+
+  // sequence numbers grow, an old or repeated one is a replay
+  HOST_CHECK(baby->radio.acceptGroupSequence(2));
+  HOST_CHECK(!baby->radio.acceptGroupSequence(2));
+  HOST_CHECK(!baby->radio.acceptGroupSequence(1));
+  HOST_CHECK_EQUAL(2, baby->radio.getGroupSequence());
+  HOST_CHECK(memcmp(page_key, baby->radio.getGroupKeyAddress(), AES_KEY_SIZE) != 0);
+
+  // a page packet opens only with the key of its sequence number
+  memset(plain, 0, sizeof(plain));
+  plain[M_TYPE] = TYPE_PROG_PAGE_LZ;
+  plain[M_LENGTH] = 0x02;
+  plain[M_LAST_DIGIT] = TYPE_PROG_PAGE_LZ ^ 0x02;
+  AES128_ECB_encrypt(plain, page_key, baby->radio.getRXCryptBuffAddress());
+  HOST_CHECK_EQUAL(RIOTS_OK, baby->radio.decrypt(page_key));
+  HOST_CHECK(baby->radio.acceptGroupSequence(3));
+  HOST_CHECK_EQUAL(RIOTS_FAIL, baby->radio.decrypt(page_key));
+  // failures of the page key are not counted
+  HOST_CHECK_EQUAL(0, baby->radio.getStatsAddress()->decrypt_failures[RIOTS_STATS_OTHER_KEY]);
+
+  // a new group key starts the sequence over
+  baby->radio.saveGroupKey(0, key_part);
+  HOST_CHECK_EQUAL(0, baby->radio.getGroupSequence());
+  HOST_CHECK(baby->radio.acceptGroupSequence(1));
+  delete baby;
+}
+
+/* A group frame captured before a reset is not accepted after it */
+static void testGroupReplayAfterReset() {
+  HostRadioMedium medium;
+  Board *mama = new Board(1, &medium);
+  Board *baby = new Board(2, &medium);
+  byte group[RF_ADDRESS_SIZE] = { RIOTS_GROUP_ADDRESS_MARK, 0x01, 0x02, 0x03 };
+  byte key_part[AES_MSG_DELIVERY_SIZE];
+  byte plain[RF_PAYLOAD_SIZE];
+  byte frame[RF_PAYLOAD_SIZE];
+  byte page_key[AES_KEY_SIZE];
+
+  hostSelectNode(&baby->node);
+  memset(key_part, 0x3C, sizeof(key_part));
+  baby->radio.setGroupAddress(group);
+  baby->radio.saveGroupKey(0, key_part);
+  baby->radio.saveGroupKey(1, key_part);
+
+  // TYPE_LOAD_ADDRESS of the group, sequence number 5
+  memset(plain, 0, sizeof(plain));
+  plain[M_TYPE] = TYPE_LOAD_ADDRESS;
+  plain[M_LENGTH] = GROUP_LOAD_ADDRESS_LEN;
+  plain[M_VALUE+3] = 5;
+  for( uint8_t i = 0; i < M_LAST_DIGIT; i++ ) {
+    plain[M_LAST_DIGIT] ^= plain[i];
+  }
+  AES128_ECB_encrypt(plain, baby->radio.getGroupKeyAddress(), frame);
+
+  for( uint8_t reset = 0; reset < 2; reset++ ) {
+    hostSelectNode(&mama->node);
+    mama->radio.setTXAddress(group);
+    memcpy(mama->radio.getTXCryptBuffAddress(), frame, RF_PAYLOAD_SIZE);
+    mama->radio.send(1);
+    catchUp(baby, mama);
+    HOST_CHECK(receive(baby, 200));
+    HOST_CHECK_EQUAL(RIOTS_OK, baby->radio.decrypt(baby->radio.getGroupKeyAddress()));
+    // accepted once, a replay after the reset is old
+    HOST_CHECK_EQUAL(reset == 0, baby->radio.acceptGroupSequence(5));
+    HOST_CHECK_EQUAL(5, baby->radio.getGroupSequence());
+
+    if( reset == 0 ) {
+      memcpy(page_key, baby->radio.getGroupPageKeyAddress(), AES_KEY_SIZE);
+      baby->radio.setup(0xFF, 0xFF, 0xFF, 0xFF);
+      // pages of the sequence open after the reset as before it
+      HOST_CHECK(memcmp(page_key, baby->radio.getGroupPageKeyAddress(), AES_KEY_SIZE) == 0);
+    }
+  }
+  HOST_CHECK(baby->radio.acceptGroupSequence(6));
+
+  // a new group key starts over, also after a reset
+  baby->radio.saveGroupKey(0, key_part);
+  baby->radio.setup(0xFF, 0xFF, 0xFF, 0xFF);
+  HOST_CHECK_EQUAL(0, baby->radio.getGroupSequence());
+  delete baby;
+  delete mama;
+}
+
+int main() {
+  HOST_TEST_RUN(testFrameExchange);
+  HOST_TEST_RUN(testNoReceiver);
+  HOST_TEST_RUN(testLossyLink);
+  HOST_TEST_RUN(testGroupFrame);
+  HOST_TEST_RUN(testGroupSequence);
+  HOST_TEST_RUN(testGroupReplayAfterReset);
+  return HOST_TEST_RESULT();
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Riots_SHT21 conversions against the register model of the sensor */
+#include "Riots_SHT21.h"
+#include "HostSht21.h"
+#include "HostTest.h"
+
+#define TEST_RAW_TEMPERATURE  0x6840
+#define TEST_RAW_HUMIDITY     0x7C82
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostSht21 sht;
+  Riots_SHT21 sensor;
+
+  Board() : node(1), bus(&node), sht(&node) {
+    hostSelectNode(&node);
+  }
+};
+
+/* Values of the datasheet formulas, in tenths as the library returns them */
+static int referenceTemperature(uint16_t raw) {
+  return (int)((175.72*((raw & 0xFFFC)/65536.0) - 46.85)*10);
+}
+
+static int referenceHumidity(uint16_t raw) {
+  return (int)((125*((raw & 0xFFFC)/65536.0) - 6)*10);
+}
+
+static void testAccurateMeasurement() {
+  Board *board = new Board();
+
+  HOST_CHECK_EQUAL(RIOTS_OK, board->sensor.setup());
+  board->sensor.startMeasurement();
+  HOST_CHECK_EQUAL(board->sht.user_register, ACCURATE_MEAS);
+  HOST_CHECK_EQUAL(board->sht.measurements, 1u);
+  // the sensor does not acknowledge its address before the conversion ends
+  HOST_CHECK_EQUAL(RIOTS_SENSOR_FAIL, board->sensor.readHumidity());
+  HOST_CHECK(board->sht.busy_nacks > 0);
+
+  delay(HOST_SHT21_MEAS_US / 1000);
+  HOST_CHECK_EQUAL(referenceHumidity(TEST_RAW_HUMIDITY), board->sensor.readHumidity());
+  HOST_CHECK_EQUAL(referenceTemperature(TEST_RAW_TEMPERATURE), board->sensor.readTemperature());
+  HOST_CHECK_EQUAL(449, board->sensor.readHumidity());
+  HOST_CHECK_EQUAL(247, board->sensor.readTemperature());
+  delete board;
+}
+
+static void testFastMeasurement() {
+  Board *board = new Board();
+
+  board->sensor.setup();
+  board->sensor.startMeasurement(1);
+  HOST_CHECK_EQUAL(board->sht.user_register, FASTER_MEAS);
+  delay(HOST_SHT21_FAST_MEAS_US / 1000);
+  HOST_CHECK_EQUAL(referenceHumidity(TEST_RAW_HUMIDITY), board->sensor.readHumidity());
+  HOST_CHECK_EQUAL(board->sht.busy_nacks, 0u);
+  delete board;
+}
+
+/* Status bits of the raw values are cleared before the conversion */
+static void testRange() {
+  Board *board = new Board();
+  const uint16_t raws[] = { 0x0004, 0x1236, 0x5555, 0x8002, 0xCCCE, 0xFFFE };
+
+  board->sensor.setup();
+  for( uint8_t i = 0; i < sizeof(raws)/sizeof(raws[0]); i++ ) {
+    board->sht.setRaw(raws[i], raws[i]);
+    board->sensor.startMeasurement();
+    delay(HOST_SHT21_MEAS_US / 1000);
+    HOST_CHECK_EQUAL(referenceHumidity(raws[i]), board->sensor.readHumidity());
+    HOST_CHECK_EQUAL(referenceTemperature(raws[i]), board->sensor.readTemperature());
+  }
+  delete board;
+}
+
+static void testMissingSensor() {
+  HostNode node(1);
+  HostI2cBus bus(&node);
+  Riots_SHT21 sensor;
+
+  hostSelectNode(&node);
+  sensor.setup();
+  sensor.startMeasurement();
+  delay(HOST_SHT21_MEAS_US / 1000);
+  HOST_CHECK_EQUAL(RIOTS_SENSOR_FAIL, sensor.readHumidity());
+  HOST_CHECK_EQUAL(RIOTS_SENSOR_FAIL, sensor.readTemperature());
+}
+
+int main() {
+  HOST_TEST_RUN(testAccurateMeasurement);
+  HOST_TEST_RUN(testFastMeasurement);
+  HOST_TEST_RUN(testRange);
+  HOST_TEST_RUN(testMissingSensor);
+  return HOST_TEST_RESULT();
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Riots_TMD3782x setup and conversions against the register model of the sensor */
+#include <math.h>
+
+#include "Riots_TMD3782x.h"
+#include "Wire.h"
+#include "HostTmd3782x.h"
+#include "HostTest.h"
+
+#define TEST_MAX_ERROR    0.01
+
+struct Board {
+  HostNode node;
+  HostI2cBus bus;
+  HostTmd3782x tmd;
+  Riots_TMD3782x sensor;
+
+  Board() : node(1), bus(&node), tmd(&node) {
+    hostSelectNode(&node);
+  }
+};
+
+static uint8_t readStatus() {
+  Wire.beginTransmission(HOST_TMD3782X_ADDRESS);
+  Wire.write(RIOTS_TMD3782X_COMMAND_TYPE | RIOTS_TMD3782X_STATE_REG);
+  Wire.endTransmission();
+  Wire.requestFrom(HOST_TMD3782X_ADDRESS, 1);
+  return Wire.read();
+}
+
+static void testSetup() {
+  Board *board = new Board();
+
+  board->sensor.setup();
+  HOST_CHECK_EQUAL(board->tmd.registers[HOST_TMD3782X_CONFIG], 0x00);
+  HOST_CHECK_EQUAL(board->tmd.registers[HOST_TMD3782X_CONTROL], 0x20);
+  HOST_CHECK_EQUAL(board->tmd.registers[HOST_TMD3782X_ATIME], 0xAD);
+  HOST_CHECK_EQUAL(board->tmd.registers[HOST_TMD3782X_ENABLE], 0x03);
+  // valid data after 83 integration cycles of 2.4 ms
+  HOST_CHECK_EQUAL(readStatus() & 0x01, 0);
+  delay(200);
+  HOST_CHECK_EQUAL(readStatus() & 0x01, 1);
+  board->sensor.stopMeasurement();
+  HOST_CHECK_EQUAL(readStatus() & 0x01, 0);
+  delete board;
+}
+
+static void testColorTemperature() {
+  Board *board = new Board();
+
+  board->sensor.setup();
+  delay(200);
+  board->sensor.readRgbcData();
+  // IR of 100 counts removed from every channel
+  HOST_CHECK(fabs(board->sensor.getColorTemperature() - (CT_COEF*200.0/300.0 + CT_OFFSET)) < TEST_MAX_ERROR);
+
+  // no red left after the IR
+  board->tmd.setRgbc(1000, 100, 1000, 100);
+  board->sensor.readRgbcData();
+  HOST_CHECK_EQUAL(board->sensor.getColorTemperature(), 0.0);
+  delete board;
+}
+
+/* Lux of the green channel, the red and blue ones are left out as zero */
+static void testLux() {
+  Board *board = new Board();
+
+  board->sensor.setup();
+  delay(200);
+  board->tmd.setRgbc(1000, 100, 1000, 100);
+  board->sensor.readRgbcData();
+  HOST_CHECK(fabs(board->sensor.getLux() - 900.0*DGF/152.0) < TEST_MAX_ERROR);
+
+  board->tmd.setRgbc(0, 0, 0, 0);
+  board->sensor.readRgbcData();
+  HOST_CHECK_EQUAL(board->sensor.getLux(), 0.0);
+  delete board;
+}
+
+/* Other device at the address, nothing is written */
+static void testWrongProduct() {
+  Board *board = new Board();
+
+  board->tmd.registers[HOST_TMD3782X_ID] = 0x69;
+  board->sensor.setup();
+  HOST_CHECK_EQUAL(board->tmd.registers[HOST_TMD3782X_ATIME], 0xFF);
+  HOST_CHECK_EQUAL(board->tmd.registers[HOST_TMD3782X_CONTROL], 0x00);
+  HOST_CHECK_EQUAL(board->tmd.registers[HOST_TMD3782X_ENABLE], 0x00);
+  delete board;
+}
+
+int main() {
+  HOST_TEST_RUN(testSetup);
+  HOST_TEST_RUN(testColorTemperature);
+  HOST_TEST_RUN(testLux);
+  HOST_TEST_RUN(testWrongProduct);
+  return HOST_TEST_RESULT();
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Load test of a Mama against the loopback cloud server with HostGateway:
+ *
+ *   riots_cloudsim [-b babies] [-p period_s] [-d duration_s] [-o outage_start_s] [-O outage_s]
+ *                  [-v protocol] [-L loop_us] [-a aes_block_us] [-s seed]
+ *
+ * Every Baby sends a cloud event once a period. Printed are the offered and
+ * delivered messages per second of simulated time, the messages per second
+ * the host simulated, the latency percentiles from the Baby to the server
+ * and the messages lost on the radio or on the way to the cloud. With an
+ * outage, the time to the next verified session and the time to drain the
+ * messages cached meanwhile are printed too.
+ *
+ * Add Babies or shorten the period until the delivered rate falls behind
+ * to find the capacity of one Mama.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "HostGateway.h"
+
+#define TOOL_BABIES       1000
+#define TOOL_PERIOD_S     60
+#define TOOL_DURATION_S   120
+#define TOOL_START_US     2000000ULL  // Mama has a session by then
+#define TOOL_DRAIN_US     5000000ULL  // time for the last messages
+
+static double percentile(std::vector<uint64_t> &values, double share) {
+  if( values.empty() ) {
+    return 0;
+  }
+  size_t index = (size_t)(share * (values.size() - 1) + 0.5);
+  return values[index] / 1000.0;
+}
+
+int main(int argc, char **argv) {
+  int babies = TOOL_BABIES, protocol = RIOTS_ENVELOPE_VERSION;
+  uint32_t period_s = TOOL_PERIOD_S, duration_s = TOOL_DURATION_S, outage_start_s = 0, outage_s = 0;
+  uint32_t loop_us = HOST_GATEWAY_LOOP_US, aes_us = 0, seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if ( i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2 ) {
+      babies = 0;
+      break;
+    }
+    const char *value = argv[++i];
+    switch ( argv[i-1][1] ) {
+      case 'b': babies = atoi(value); break;
+      case 'p': period_s = strtoul(value, NULL, 10); break;
+      case 'd': duration_s = strtoul(value, NULL, 10); break;
+      case 'o': outage_start_s = strtoul(value, NULL, 10); break;
+      case 'O': outage_s = strtoul(value, NULL, 10); break;
+      case 'v': protocol = atoi(value); break;
+      case 'L': loop_us = strtoul(value, NULL, 10); break;
+      case 'a': aes_us = strtoul(value, NULL, 10); break;
+      case 's': seed = strtoul(value, NULL, 10); break;
+      default: babies = 0;
+    }
+  }
+  if ( babies < 1 || babies > 0xFFFF || period_s < 1 || duration_s < 1 ||
+       ( protocol != 0 && protocol != RIOTS_ENVELOPE_VERSION ) ) {
+    fprintf(stderr, "usage: riots_cloudsim [-b babies] [-p period_s] [-d duration_s] [-o outage_start_s] [-O outage_s]\n"
+                    "                      [-v protocol 0|%d] [-L loop_us] [-a aes_block_us] [-s seed]\n",
+            RIOTS_ENVELOPE_VERSION);
+    return 2;
+  }
+
+  HostGateway *gateway = new HostGateway(babies, protocol, seed);
+  uint64_t end_us = TOOL_START_US + (uint64_t)duration_s * 1000000;
+  uint64_t outage_start_us = TOOL_START_US + (uint64_t)outage_start_s * 1000000;
+  uint64_t outage_end_us = outage_start_us + (uint64_t)outage_s * 1000000;
+
+  gateway->setAesBlockTime(aes_us);
+  gateway->loop_us = loop_us;
+  gateway->replayBabies(period_s * 1000000UL, TOOL_START_US, end_us);
+  if ( outage_s ) {
+    gateway->setOutage(outage_start_us, outage_end_us);
+  }
+  clock_t started = clock();
+  // drain is given after the outage too, the reconnect backoff may be long
+  uint64_t run_us = std::max<uint64_t>(end_us, outage_end_us + CONNECTION_RETRY_MAX * 1000ULL) + TOOL_DRAIN_US;
+  gateway->run(run_us);
+  double host_seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+  std::vector<uint64_t> latencies;
+  uint32_t not_acked = 0, saved = 0, lost = 0;
+  uint64_t drained_us = 0;
+  for (size_t i = 0; i < gateway->messages.size(); i++) {
+    const HostGatewayMessage &message = gateway->messages[i];
+    if ( !message.acked ) {
+      not_acked++;
+    }
+    if ( !message.cloud_us ) {
+      lost += message.acked ? 1 : 0;
+      continue;
+    }
+    latencies.push_back(message.cloud_us - message.time_us);
+    saved += message.saved ? 1 : 0;
+    if ( outage_s && message.time_us < outage_end_us && message.cloud_us > drained_us ) {
+      drained_us = message.cloud_us;
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  size_t offered = gateway->messages.size();
+  double seconds = (end_us - TOOL_START_US) / 1000000.0;
+  printf("%d babies every %u s for %u s, protocol %s, loop %u us, AES block %u us\n", babies, period_s,
+         duration_s, protocol ? "v2" : "v1", loop_us, aes_us);
+  printf("messages/s:       offered %.1f  delivered %.1f  simulated %.0f on the host\n", offered / seconds,
+         gateway->cloud_messages / seconds, host_seconds > 0 ? offered / host_seconds : 0.0);
+  printf("latency ms:       p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", percentile(latencies, 0.5),
+         percentile(latencies, 0.9), percentile(latencies, 0.99), percentile(latencies, 1.0));
+  printf("delivery:         %.2f%% of %zu, %u not acked on the radio, %u lost after the ACK, %u duplicates\n",
+         offered ? 100.0 * gateway->cloud_messages / offered : 0.0, offered, not_acked, lost, gateway->duplicates);
+  if ( outage_s ) {
+    uint64_t verified_us = gateway->server.verified_us;
+    printf("outage:           %u s, session again after %.1f s, %u cached, backlog drained %.1f s after the link\n",
+           outage_s, verified_us > outage_end_us ? (verified_us - outage_end_us) / 1000000.0 : 0.0, saved,
+           drained_us > outage_end_us ? (drained_us - outage_end_us) / 1000000.0 : 0.0);
+  }
+  Riots_Stats *stats = gateway->radio->getStatsAddress();
+  printf("mama:             %u rx overflows, %u sessions, %u reconnects, %u keep alives, %u bad frames\n",
+         gateway->mama_nrf.rx_overflows, gateway->server.sessions, stats->cloud_reconnects,
+         gateway->server.keep_alives, gateway->server.bad_frames);
+  delete gateway;
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compresses a firmware image to the page packets of a flash update:
+ *
+ *   riots_lz [-p packet_data] image.hex|image.bin
+ *
+ * The image is split to the I2C EEPROM pages and every page is compressed on
+ * its own with Riots_Lz, as Riots_Flash decodes it. A page that does not get
+ * fewer packets compressed is sent as raw TYPE_PROG_PAGE packets. Every
+ * compressed page is decoded back and compared before it is printed.
+ *
+ * One packet per line is written to stdout:
+ *
+ *   <page address> <type> <packet> <data bytes in hex>
+ *
+ * and the packet counts to stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Riots_Helper.h"
+#include "Riots_Lz.h"
+
+#define TOOL_IMAGE_SIZE     0x8000
+#define TOOL_PACKET_DATA    13    // 16 byte frame: type, length and packet index
+
+static uint8_t image[TOOL_IMAGE_SIZE];
+
+static uint8_t hexValue(const char *text) {
+  char digits[3] = { text[0], text[1], 0 };
+  return (uint8_t)strtoul(digits, NULL, 16);
+}
+
+/* Reads the data records of an Intel HEX file, returns the image size */
+static long readHex(FILE *file) {
+  char line[600];
+  long size = 0;
+
+  while ( fgets(line, sizeof(line), file) ) {
+    if ( line[0] != ':' || strlen(line) < 11 ) {
+      continue;
+    }
+    uint8_t count = hexValue(line+1);
+    uint16_t address = (hexValue(line+3) << 8) | hexValue(line+5);
+    uint8_t record = hexValue(line+7);
+
+    if ( record == 0x01 ) {
+      break;
+    }
+    if ( record != 0x00 ) {
+      continue;
+    }
+    if ( address + count > TOOL_IMAGE_SIZE || strlen(line) < 11 + 2 * (size_t)count ) {
+      return -1;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      image[address+i] = hexValue(line + 9 + 2*i);
+    }
+    if ( address + count > size ) {
+      size = address + count;
+    }
+  }
+  return size;
+}
+
+static void printPacket(uint16_t address, uint8_t type, uint8_t packet, const uint8_t *data, uint8_t length) {
+  printf("%04X %02X %02X ", address, type, packet);
+  for (uint8_t i = 0; i < length; i++) {
+    printf("%02X", data[i]);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  uint8_t packet_data = TOOL_PACKET_DATA;
+  const char *path = NULL;
+  FILE *file;
+  long size;
+
+  for (int i = 1; i < argc; i++) {
+    if ( strcmp(argv[i], "-p") == 0 && i + 1 < argc ) {
+      packet_data = (uint8_t)atoi(argv[++i]);
+    }
+    else {
+      path = argv[i];
+    }
+  }
+  if ( path == NULL || packet_data < 2 || packet_data > TOOL_PACKET_DATA ) {
+    fprintf(stderr, "usage: riots_lz [-p packet_data 2-%d] image.hex|image.bin\n", TOOL_PACKET_DATA);
+    return 2;
+  }
+
+  file = fopen(path, "rb");
+  if ( file == NULL ) {
+    perror(path);
+    return 1;
+  }
+  memset(image, 0xFF, sizeof(image));
+  if ( strlen(path) > 4 && strcmp(path + strlen(path) - 4, ".hex") == 0 ) {
+    size = readHex(file);
+  }
+  else {
+    size = (long)fread(image, 1, sizeof(image), file);
+  }
+  fclose(file);
+  if ( size <= 0 ) {
+    fprintf(stderr, "%s: no image data\n", path);
+    return 1;
+  }
+
+  uint8_t tokens[I2C_EEPROM_PAGE_SIZE][TOOL_PACKET_DATA];
+  uint8_t lengths[I2C_EEPROM_PAGE_SIZE];
+  uint8_t decoded[I2C_EEPROM_PAGE_SIZE];
+  uint8_t raw_per_page = (I2C_EEPROM_PAGE_SIZE + packet_data - 1) / packet_data;
+  long raw_packets = 0, packets = 0, lz_pages = 0;
+
+  for (long address = 0; address < size; address += I2C_EEPROM_PAGE_SIZE) {
+    const uint8_t *page = image + address;
+    uint8_t index = 0, decoded_index = 0, count = 0;
+
+    while ( index < I2C_EEPROM_PAGE_SIZE ) {
+      lengths[count] = Riots_Lz::encode(page, I2C_EEPROM_PAGE_SIZE, &index, tokens[count], packet_data);
+      if ( !Riots_Lz::decode(decoded, I2C_EEPROM_PAGE_SIZE, &decoded_index, tokens[count], lengths[count]) ) {
+        fprintf(stderr, "page %04lX: packet %d does not decode\n", address, count);
+        return 1;
+      }
+      count++;
+    }
+    if ( decoded_index != I2C_EEPROM_PAGE_SIZE || memcmp(decoded, page, I2C_EEPROM_PAGE_SIZE) != 0 ) {
+      fprintf(stderr, "page %04lX: decoded page differs\n", address);
+      return 1;
+    }
+
+    if ( count < raw_per_page ) {
+      for (uint8_t i = 0; i < count; i++) {
+        printPacket(address, TYPE_PROG_PAGE_LZ, i, tokens[i], lengths[i]);
+      }
+      packets += count;
+      lz_pages++;
+    }
+    else {
+      for (uint8_t i = 0; i < raw_per_page; i++) {
+        uint8_t length = I2C_EEPROM_PAGE_SIZE - i * packet_data;
+        printPacket(address, TYPE_PROG_PAGE, i, page + i * packet_data, length < packet_data ? length : packet_data);
+      }
+      packets += raw_per_page;
+    }
+    raw_packets += raw_per_page;
+  }
+
+  fprintf(stderr, "%ld bytes, %ld pages (%ld compressed), %ld packets instead of %ld (%ld%%)\n",
+          size, raw_packets / raw_per_page, lz_pages, packets, raw_packets, 100 * packets / raw_packets);
+  return 0;
+}
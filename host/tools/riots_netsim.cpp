@@ -0,0 +1,132 @@
+/*
+ * This file is part of Riots.
+ * Copyright © 2016 Riots Global OY; <copyright@myriots.com>
+ *
+ * Riots is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) any later version.
+ *
+ * Riots is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with Riots.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Simulates a ring of Babies and their Mama with HostNetwork:
+ *
+ *   riots_netsim [-n babies] [-e events] [-i interval_ms] [-l loss] [-d latency_us]
+ *                [-L loop_us] [-a aes_block_us] [-s seed]
+ *
+ * The Babies send ring events in turns, one every interval. Each event goes
+ * around the ring and to the cloud through the Mama. Printed are the ring
+ * latency percentiles, from send() to the last Baby which got the event, the
+ * delivery ratios and the airtime, AES blocks and drops of every node.
+ *
+ * Shorten the interval or add Babies until the ratios fall to find where the
+ * ring stops scaling.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "HostNetwork.h"
+
+#define TOOL_BABIES       8
+#define TOOL_EVENTS       100
+#define TOOL_INTERVAL_MS  200
+#define TOOL_START_US     1000000ULL  // setup of every node is done by then
+#define TOOL_DRAIN_US     2000000ULL  // time for the last event
+
+static double percentile(std::vector<uint64_t> &values, double share) {
+  if( values.empty() ) {
+    return 0;
+  }
+  size_t index = (size_t)(share * (values.size() - 1) + 0.5);
+  return values[index] / 1000.0;
+}
+
+static void printNode(const char *name, HostNetworkNode *board, double seconds) {
+  Riots_Stats *stats = board->baby ? board->baby->getStatsAddress() : NULL;
+
+  printf("%-6s %8u %8u %7.2f%% %9u %8u %8u %8u %8u\n", name, board->nrf.tx_frames, board->nrf.rx_frames,
+         100.0 * board->nrf.airtime_us / (seconds * 1000000), board->node.aes_blocks,
+         stats ? stats->ring_drops : 0, stats ? stats->counter_rejects : 0, board->deliveries, board->duplicates);
+}
+
+int main(int argc, char **argv) {
+  int babies = TOOL_BABIES, events = TOOL_EVENTS;
+  uint32_t interval_ms = TOOL_INTERVAL_MS, latency_us = 0, loop_us = HOST_NETWORK_LOOP_US, aes_us = 0, seed = 1;
+  float loss = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if ( i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2 ) {
+      babies = 0;
+      break;
+    }
+    const char *value = argv[++i];
+    switch ( argv[i-1][1] ) {
+      case 'n': babies = atoi(value); break;
+      case 'e': events = atoi(value); break;
+      case 'i': interval_ms = strtoul(value, NULL, 10); break;
+      case 'l': loss = (float)atof(value); break;
+      case 'd': latency_us = strtoul(value, NULL, 10); break;
+      case 'L': loop_us = strtoul(value, NULL, 10); break;
+      case 'a': aes_us = strtoul(value, NULL, 10); break;
+      case 's': seed = strtoul(value, NULL, 10); break;
+      default: babies = 0;
+    }
+  }
+  if ( babies < 2 || babies > HOST_NETWORK_MAX_BABIES || events < 1 || interval_ms < 1 ) {
+    fprintf(stderr, "usage: riots_netsim [-n babies 2-%d] [-e events] [-i interval_ms] [-l loss] [-d latency_us]\n"
+                    "                    [-L loop_us] [-a aes_block_us] [-s seed]\n", HOST_NETWORK_MAX_BABIES);
+    return 2;
+  }
+
+  HostNetwork *network = new HostNetwork(babies, seed);
+  network->medium.setLoss(loss);
+  network->medium.setLatency(latency_us);
+  network->setAesBlockTime(aes_us);
+  network->loop_us = loop_us;
+  for (int i = 0; i < events; i++) {
+    network->scheduleEvent(i % babies, TOOL_START_US + (uint64_t)i * interval_ms * 1000);
+  }
+  uint64_t end_us = TOOL_START_US + (uint64_t)events * interval_ms * 1000 + TOOL_DRAIN_US;
+  network->run(end_us);
+
+  std::vector<uint64_t> latencies;
+  uint32_t complete = 0, deliveries = 0, sent = 0;
+  for (size_t i = 0; i < network->events.size(); i++) {
+    const HostNetworkEvent &event = network->events[i];
+    sent += event.send_us ? 1 : 0;
+    deliveries += event.deliveries;
+    if ( network->ringComplete(event) ) {
+      latencies.push_back(network->ringLatency(event));
+      complete++;
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  double seconds = end_us / 1000000.0;
+  printf("%d babies, %d events every %u ms, loss %.2f, latency %u us, loop %u us, AES block %u us\n",
+         babies, events, interval_ms, loss, latency_us, loop_us, aes_us);
+  printf("ring latency ms:  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", percentile(latencies, 0.5),
+         percentile(latencies, 0.9), percentile(latencies, 0.99), percentile(latencies, 1.0));
+  printf("ring delivery:    %.1f%% of the babies, %.1f%% of the events to every baby\n",
+         100.0 * deliveries / ((double)events * (babies - 1)), 100.0 * complete / events);
+  printf("cloud delivery:   %.1f%% of the events\n", 100.0 * network->cloud_events / events);
+  printf("medium:           %u frames, %u lost, %u collisions, %u events not sent\n",
+         network->medium.frames, network->medium.lost, network->medium.collisions, events - sent);
+  printf("\nnode   tx frames rx frames airtime AES blocks    drops  rejects delivered duplicates\n");
+  printNode("mama", network->mama, seconds);
+  for (int i = 0; i < babies; i++) {
+    char name[8];
+    snprintf(name, sizeof(name), "baby%d", i + 1);
+    printNode(name, network->babies[i], seconds);
+  }
+  delete network;
+  return 0;
+}